@@ -0,0 +1,560 @@
+//===-- bench.cc - benchmark entry point -----------------------*- C++ -*-===//
+
+#include "util/common.hh"
+#include "util/log.hh"
+#include "util/philox.hh"
+#include "util/profiler.hh"
+#include "exp/exp.hh"
+#include "proc/runner.hh"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unistd.h> // getopt, optarg
+
+
+#define BENCH_WARMUP 50      // ticks before measuring
+#define BENCH_TICKS 200      // ticks measured
+#define BENCH_SEED 1         // seed of the random number engines
+#define BENCH_FRAME 16       // milliseconds between frames taken (threaded)
+#define BENCH_TOLERANCE 5.0f // percent of ticks/s lost before a regression
+
+#if 1 == STATE_COMPACT
+#define BENCH_COMPACT "true" // whether counters and grid cells are 16-bit
+#else
+#define BENCH_COMPACT "false"
+#endif
+
+
+// Case: One point of the benchmark matrix.
+
+struct Case
+{
+  std::string  backend; // "plain", "threaded", or "cl"
+  unsigned int num;     // number of particles
+  float        dpe;     // density (particles per unit of area)
+  float        scope;   // vicinity radius
+};
+
+
+// Result: Measurement of a Case.
+
+struct Result
+{
+  Case          bench;
+  bool          ran;      // false if the backend is unavailable
+  unsigned int  width;    // world width (and height)
+  unsigned long ticks;    // ticks measured
+  double        seconds;  // wall time of the measured ticks
+  double        rate;     // ticks per second
+  std::size_t   arena;    // bytes of particle columns in use
+  std::size_t   resident; // bytes of resident memory gained (at the peak)
+  std::vector<Profiler::Stat> stats;
+};
+
+
+// Stopwatch: Times the ticks after warm-up, on the ticking thread, and
+//            quits once enough have been measured.
+
+class Stopwatch : public Observer
+{
+ public:
+  Stopwatch(Control& ctrl, unsigned long warmup, unsigned long ticks)
+    : ctrl_(ctrl), warmup_(warmup), ticks_(ticks)
+  {
+    this->started_ = false;
+    this->first_ = 0;
+    this->last_ = 0;
+    if (0 == warmup) {
+      this->start();
+    }
+  }
+
+  void
+  react(Issue issue) override
+  {
+    if (Issue::ProcNextDone != issue) {
+      return;
+    }
+    unsigned long tick = this->ctrl_.tick_;
+    if (!this->started_ && this->warmup_ <= tick) {
+      this->start();
+      return;
+    }
+    if (this->started_ && this->first_ + this->ticks_ <= tick) {
+      this->stop_ = std::chrono::steady_clock::now();
+      this->last_ = tick;
+      this->stats_ = Profiler::stats();
+      this->ctrl_.quit();
+    }
+  }
+
+  /// measure(): Fill in a Result, once ticking quit.
+  /// \param result  destination
+  void
+  measure(Result& result) const
+  {
+    result.ticks = this->last_ - this->first_;
+    result.seconds = std::chrono::duration_cast<std::chrono::duration<double>>(
+      this->stop_ - this->start_).count();
+    result.rate = 0.0 < result.seconds ? result.ticks / result.seconds : 0.0;
+    result.stats = this->stats_;
+  }
+
+ private:
+  void
+  start()
+  {
+    Profiler::reset();
+    this->started_ = true;
+    this->first_ = this->ctrl_.tick_;
+    this->start_ = std::chrono::steady_clock::now();
+  }
+
+  Control&      ctrl_;
+  unsigned long warmup_;
+  unsigned long ticks_;
+  bool          started_;
+  unsigned long first_;   // tick when measuring started
+  unsigned long last_;    // tick when measuring stopped
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point stop_;
+  std::vector<Profiler::Stat> stats_;
+};
+
+
+/// resident(): Get the resident memory of this process.
+/// \param peak  whether to get the peak since reset_peak() instead
+/// \returns  number of bytes (0 if unknown)
+static std::size_t
+resident(bool peak = false)
+{
+  std::ifstream stream("/proc/self/status");
+  std::string key = peak ? "VmHWM:" : "VmRSS:";
+  std::string word;
+  std::size_t kib;
+  while (stream >> word) {
+    if (key == word && stream >> kib) {
+      return kib * 1024;
+    }
+  }
+  return 0;
+}
+
+
+/// reset_peak(): Start measuring the peak resident memory anew.
+/// \returns  whether the peak was reset (Linux 4.0 and later)
+static bool
+reset_peak()
+{
+  std::ofstream stream("/proc/self/clear_refs");
+  stream << "5";
+  stream.flush();
+  return static_cast<bool>(stream);
+}
+
+
+/// run(): Run a Case headless from a seeded State, and measure it.
+/// \param bench  Case
+/// \param warmup  ticks before measuring
+/// \param ticks  ticks measured
+/// \param seed  seed of the random number engines
+/// \returns  Result
+static Result
+run(const Case& bench, unsigned long warmup, unsigned long ticks,
+    unsigned int seed)
+{
+  Result result = {bench, false, 0, 0, 0.0, 0.0, 0, 0, {}};
+  // memory gained by this case alone, as earlier cases leave theirs mapped
+  std::size_t before = resident();
+  bool peaked = reset_peak();
+  bool cl_wanted = "cl" == bench.backend;
+  Log log(16, true);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, !cl_wanted);
+  auto exp = Exp(log, expctrl, state, proc, !cl_wanted);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  if (cl_wanted && !ctrl.cl_good()) {
+    return result;
+  }
+
+  Philox::reseed(seed);
+  unsigned int side = static_cast<unsigned int>(
+    std::lround(std::sqrt(bench.num / bench.dpe)));
+  Stative input = {-1, static_cast<int>(bench.num), side, side,
+                   state.alpha_, state.beta_, bench.scope, state.ascope_,
+                   state.speed_, state.noise_, state.prad_, state.coloring_};
+  ctrl.change(input, true);
+
+  Stopwatch watch(ctrl, warmup, ticks);
+  ctrl.attach_to_proc(watch);
+  if ("threaded" == bench.backend) {
+    Runner runner(log, ctrl);
+    runner.start();
+    while (runner.running()) {
+      runner.update(); // as a canvas would, at display rate
+      std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_FRAME));
+    }
+    runner.stop();
+  } else {
+    while (!ctrl.quit_) {
+      ctrl.next();
+    }
+  }
+  ctrl.detach_from_proc(watch);
+
+  result.ran = true;
+  result.width = side;
+  watch.measure(result);
+  result.arena = state.arena_->used();
+  std::size_t after = resident(peaked);
+  result.resident = after > before ? after - before : 0;
+  return result;
+}
+
+
+/// split(): Split a comma-separated list.
+/// \param list  list
+/// \returns  items
+static std::vector<std::string>
+split(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::istringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+
+/// find_stat(): Find the summary of a phase in a Result.
+/// \param result  Result
+/// \param phase  phase
+/// \returns  summary, or NULL if the phase has no samples
+static const Profiler::Stat*
+find_stat(const Result& result, Phase phase)
+{
+  for (const Profiler::Stat& stat : result.stats) {
+    if (phase == stat.phase) {
+      return &stat;
+    }
+  }
+  return NULL;
+}
+
+
+/// write_json(): Write Results as a JSON document.
+/// \param path  path to the destination file
+/// \param results  Results
+/// \param warmup  ticks before measuring
+/// \param seed  seed of the random number engines
+/// \returns  whether the write was successful
+static bool
+write_json(const std::string& path, const std::vector<Result>& results,
+           unsigned long warmup, unsigned int seed)
+{
+  std::ofstream stream(path);
+  if (!stream) {
+    return false;
+  }
+  stream << "{\"version\":\"" << VERSION << "\",\"compact\":" << BENCH_COMPACT
+         << ",\"warmup\":" << warmup << ",\"seed\":" << seed
+         << ",\"results\":[";
+  bool first = true;
+  for (const Result& result : results) {
+    const Case& bench = result.bench;
+    stream << (first ? "" : ",") << "\n{\"backend\":\"" << bench.backend
+           << "\",\"num\":" << bench.num << ",\"dpe\":" << bench.dpe
+           << ",\"scope\":" << bench.scope
+           << ",\"ran\":" << (result.ran ? "true" : "false");
+    first = false;
+    if (!result.ran) {
+      stream << "}";
+      continue;
+    }
+    stream << ",\"width\":" << result.width << ",\"height\":" << result.width
+           << ",\"ticks\":" << result.ticks
+           << ",\"seconds\":" << result.seconds
+           << ",\"ticks_per_s\":" << result.rate
+           << ",\"arena_bytes\":" << result.arena
+           << ",\"resident_bytes\":" << result.resident << ",\"phases\":[";
+    bool first_stat = true;
+    for (const Profiler::Stat& stat : result.stats) {
+      stream << (first_stat ? "" : ",") << "{\"phase\":\""
+             << Profiler::name(stat.phase) << "\",\"count\":" << stat.count
+             << ",\"mean\":" << stat.mean << ",\"p50\":" << stat.p50
+             << ",\"p90\":" << stat.p90 << ",\"p99\":" << stat.p99
+             << ",\"max\":" << stat.max << "}";
+      first_stat = false;
+    }
+    stream << "]}";
+  }
+  stream << "\n]}\n";
+  stream.close();
+  return static_cast<bool>(stream);
+}
+
+
+/// write_csv(): Write the Results that ran as CSV, a row per Case, with the
+///              mean and p99 (us) of every phase.
+/// \param path  path to the destination file
+/// \param results  Results
+/// \returns  whether the write was successful
+static bool
+write_csv(const std::string& path, const std::vector<Result>& results)
+{
+  std::ofstream stream(path);
+  if (!stream) {
+    return false;
+  }
+  int phases = static_cast<int>(Phase::Count);
+  stream << "backend,num,dpe,scope,width,height,ticks,seconds,ticks_per_s,"
+         << "arena_bytes,resident_bytes";
+  for (int p = 0; p < phases; ++p) {
+    std::string name = Profiler::name(static_cast<Phase>(p));
+    stream << "," << name << "_mean_us," << name << "_p99_us";
+  }
+  stream << "\n";
+  for (const Result& result : results) {
+    if (!result.ran) {
+      continue;
+    }
+    const Case& bench = result.bench;
+    stream << bench.backend << "," << bench.num << "," << bench.dpe << ","
+           << bench.scope << "," << result.width << "," << result.width << ","
+           << result.ticks << "," << result.seconds << "," << result.rate
+           << "," << result.arena << "," << result.resident;
+    for (int p = 0; p < phases; ++p) {
+      const Profiler::Stat* stat = find_stat(result, static_cast<Phase>(p));
+      if (NULL == stat) {
+        stream << ",,";
+      } else {
+        stream << "," << stat->mean << "," << stat->p99;
+      }
+    }
+    stream << "\n";
+  }
+  stream.close();
+  return static_cast<bool>(stream);
+}
+
+
+/// read_csv(): Read the rows of a file written by write_csv().
+/// \param path  path to the file
+/// \param rows  destination of the columns by name, per "backend,num,dpe,
+///              scope" key
+/// \returns  whether the file was readable
+static bool
+read_csv(const std::string& path,
+         std::map<std::string,std::map<std::string,std::string>>& rows)
+{
+  std::ifstream stream(path);
+  std::string line;
+  if (!std::getline(stream, line)) {
+    return false;
+  }
+  std::vector<std::string> header;
+  std::istringstream names(line);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    header.push_back(name);
+  }
+  while (std::getline(stream, line)) {
+    std::map<std::string,std::string> row;
+    std::istringstream values(line);
+    std::string value;
+    for (std::size_t i = 0; i < header.size(); ++i) {
+      value.clear();
+      std::getline(values, value, ',');
+      row[header[i]] = value;
+    }
+    rows[row["backend"] + "," + row["num"] + "," + row["dpe"] + "," +
+         row["scope"]] = row;
+  }
+  return true;
+}
+
+
+/// compare(): Print the change of ticks/s and of mean tick, seek and move
+///            times between two result files.
+/// \param before  path to the earlier CSV result file
+/// \param after  path to the later CSV result file
+/// \param tolerance  percent of ticks/s that may be lost
+/// \returns  0 if no Case regressed, 1 if some did, -1 on unreadable files
+static int
+compare(const std::string& before, const std::string& after,
+        float tolerance)
+{
+  std::map<std::string,std::map<std::string,std::string>> old_rows;
+  std::map<std::string,std::map<std::string,std::string>> new_rows;
+  if (!read_csv(before, old_rows) || !read_csv(after, new_rows)) {
+    std::cerr << "unreadable result file" << std::endl;
+    return -1;
+  }
+  const char* columns[] = {"ticks_per_s", "tick_mean_us", "seek_mean_us",
+                           "move_mean_us"};
+  int regressions = 0;
+  std::cout << std::left << std::setw(28) << "backend,num,dpe,scope"
+            << std::right;
+  for (const char* column : columns) {
+    std::cout << std::setw(20) << column;
+  }
+  std::cout << "\n" << std::fixed << std::setprecision(1);
+  for (auto& entry : new_rows) {
+    auto found = old_rows.find(entry.first);
+    std::cout << std::left << std::setw(28) << entry.first << std::right;
+    if (old_rows.end() == found) {
+      std::cout << std::setw(20) << "(new)\n";
+      continue;
+    }
+    for (const char* column : columns) {
+      std::string old_value = found->second[column];
+      std::string new_value = entry.second[column];
+      if (old_value.empty() || new_value.empty()) {
+        std::cout << std::setw(20) << "-";
+        continue;
+      }
+      double from = std::stod(old_value);
+      double to = std::stod(new_value);
+      double change = 0.0 < from ? 100.0 * (to - from) / from : 0.0;
+      std::ostringstream cell;
+      cell << std::fixed << std::setprecision(1) << to << " ("
+           << std::showpos << change << "%)";
+      std::cout << std::setw(20) << cell.str();
+      if (std::string("ticks_per_s") == column && change < -tolerance) {
+        ++regressions;
+      }
+    }
+    std::cout << "\n";
+  }
+  for (auto& entry : old_rows) {
+    if (new_rows.end() == new_rows.find(entry.first)) {
+      std::cout << std::left << std::setw(28) << entry.first << std::right
+                << std::setw(20) << "(gone)\n";
+    }
+  }
+  std::cout << regressions << " regression(s) beyond " << tolerance
+            << "% of ticks/s." << std::endl;
+  return regressions ? 1 : 0;
+}
+
+
+/// help(): Print usage help.
+static void
+help()
+{
+  std::cout << "Usage: benchemergence -(?h|b LIST|n LIST|d LIST|s LIST|"
+            << "w NUM|t NUM|r NUM|o PREFIX|c OLD,NEW|T NUM)\n"
+            << "\nBenchmark the particle system headless, over the matrix of\n"
+            << "backends, numbers of particles, densities, and scopes.\n\n"
+            << "Options:\n"
+            << "  -?|-h      show this help\n"
+            << "  -b LIST    backends (plain,threaded,cl)\n"
+            << "  -n LIST    numbers of particles (1000,5000,20000)\n"
+            << "  -d LIST    densities in dpe (0.04,0.08)\n"
+            << "  -s LIST    scopes (5)\n"
+            << "  -w NUM     warm-up ticks, not measured (" << BENCH_WARMUP
+            << ")\n"
+            << "  -t NUM     measured ticks (" << BENCH_TICKS << ")\n"
+            << "  -r NUM     seed of the random number engines ("
+            << BENCH_SEED << ")\n"
+            << "  -o PREFIX  write PREFIX.json and PREFIX.csv (bench)\n"
+            << "  -c OLD,NEW compare two CSV result files instead, failing\n"
+            << "               on a loss of ticks/s beyond the tolerance\n"
+            << "  -T NUM     tolerance of -c in percent ("
+            << BENCH_TOLERANCE << ")\n"
+            << std::endl;
+}
+
+
+/// main(): Benchmark entry point.
+int
+main(int argc, char* argv[])
+{
+  std::vector<std::string> backends = {"plain", "threaded", "cl"};
+  std::vector<std::string> nums = {"1000", "5000", "20000"};
+  std::vector<std::string> dpes = {"0.04", "0.08"};
+  std::vector<std::string> scopes = {"5"};
+  unsigned long warmup = BENCH_WARMUP;
+  unsigned long ticks = BENCH_TICKS;
+  unsigned int seed = BENCH_SEED;
+  std::string prefix = "bench";
+  std::vector<std::string> comparison;
+  float tolerance = BENCH_TOLERANCE;
+  int opt;
+  while (-1 != (opt = getopt(argc, argv, "?b:c:d:hn:o:r:s:t:T:w:"))) {
+    if      ('b' == opt) { backends = split(optarg); }
+    else if ('c' == opt) { comparison = split(optarg); }
+    else if ('d' == opt) { dpes = split(optarg); }
+    else if ('n' == opt) { nums = split(optarg); }
+    else if ('o' == opt) { prefix = optarg; }
+    else if ('r' == opt) { seed = std::stoul(optarg); }
+    else if ('s' == opt) { scopes = split(optarg); }
+    else if ('t' == opt) { ticks = std::stoul(optarg); }
+    else if ('T' == opt) { tolerance = std::stof(optarg); }
+    else if ('w' == opt) { warmup = std::stoul(optarg); }
+    else { help(); return '?' == opt || 'h' == opt ? 0 : -1; }
+  }
+  if (!comparison.empty()) {
+    if (2 != comparison.size()) {
+      help();
+      return -1;
+    }
+    return compare(comparison[0], comparison[1], tolerance);
+  }
+
+  Profiler::enable(true);
+  std::vector<Result> results;
+  std::cout << std::left << std::setw(10) << "backend" << std::right
+            << std::setw(8) << "num" << std::setw(7) << "dpe"
+            << std::setw(7) << "scope" << std::setw(12) << "ticks/s"
+            << std::setw(10) << "tick p50" << std::setw(10) << "seek p50"
+            << std::setw(10) << "move p50" << std::setw(10) << "arena"
+            << "  (us, KiB)\n" << std::fixed;
+  for (const std::string& backend : backends) {
+    for (const std::string& num : nums) {
+      for (const std::string& dpe : dpes) {
+        for (const std::string& scope : scopes) {
+          Case bench = {backend, static_cast<unsigned int>(std::stoul(num)),
+                        std::stof(dpe), std::stof(scope)};
+          Result result = run(bench, warmup, ticks, seed);
+          results.push_back(result);
+          std::cout << std::left << std::setw(10) << backend << std::right
+                    << std::setw(8) << bench.num << std::setprecision(2)
+                    << std::setw(7) << bench.dpe << std::setprecision(1)
+                    << std::setw(7) << bench.scope;
+          if (!result.ran) {
+            std::cout << std::setw(12) << "n/a" << std::endl;
+            continue;
+          }
+          std::cout << std::setw(12) << result.rate;
+          for (Phase phase : {Phase::Tick, Phase::Seek, Phase::Move}) {
+            const Profiler::Stat* stat = find_stat(result, phase);
+            std::cout << std::setw(10) << (stat ? stat->p50 : 0.0f);
+          }
+          std::cout << std::setw(10) << result.arena / 1024 << std::endl;
+        }
+      }
+    }
+  }
+
+  bool ok = write_json(prefix + ".json", results, warmup, seed);
+  ok = write_csv(prefix + ".csv", results) && ok;
+  if (!ok) {
+    std::cerr << "could not write " << prefix << ".json/.csv" << std::endl;
+    return -1;
+  }
+  std::cout << "Results written to " << prefix << ".json and " << prefix
+            << ".csv." << std::endl;
+  return 0;
+}
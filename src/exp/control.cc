@@ -136,8 +136,8 @@ ExpControl::spawn(State& s)
   float spread = 2.5f;
   float min = center - spread;
   float max = center + spread;
-  std::vector<float>& px = s.px_;
-  std::vector<float>& py = s.py_;
+  Column<float>& px = s.px_;
+  Column<float>& py = s.py_;
   for (int i = 0; i < s.num_; ++i) {
     px.push_back(Util::distr(min, max));
     py.push_back(Util::distr(min, max));
@@ -198,6 +198,7 @@ void
 ExpControl::next(Exp& exp, Control& c)
 {
   int e = this->experiment_;
+  c.exp_.do_rdf(c.tick_); // alongside any experiment
   if (!e) {
     return;
   }
@@ -218,7 +219,7 @@ ExpControl::next(Exp& exp, Control& c)
 
   if (2 == eg) { ex.do_exp_2(tick); return; }
 
-  if (3 == eg) { ex.do_exp_3(tick); return; }
+  if (3 == eg) { ex.do_exp_3(tick, 1 == c.countdown_); return; }
 
   if (4 == eg) {
     this->next4_first(c);
@@ -271,10 +272,9 @@ ExpControl::next4_first(Control& c)
 
   if (1 == c.tick_ && 0.0001f > c.dpe_) {
     if (41 == e || 42 == e) {
-      if (1 < ex.exp_4_count_) {
-        std::cout << "\n";
-      }
-      std::cout << ex.exp_4_count_ << ":" << std::flush;
+      Record record(c.tick_, e, "instance");
+      record.integer("instance", ex.exp_4_count_);
+      ex.metrics_->add(std::move(record));
     }
   }
 }
@@ -289,7 +289,7 @@ ExpControl::next4_iterate(Control& c)
   ex.exp_4_dbscan_done_ = 0;
 
   if (0.1001f > c.dpe_ && 40 == e || 41 == e) {
-    std::cout << ";";
+    ex.metrics_->add(Record(c.tick_, e, "step"));
   }
   if (0.1001f < c.dpe_) {
     ++ex.exp_4_count_;
@@ -338,10 +338,9 @@ ExpControl::next5_first(Control& c)
 
   if (54 == e || 55 == e || 56 == e) {
     if (1 == c.tick_ && 0.0001f > c.state_.noise_) {
-      if (1 < ex.exp_5_count_) {
-        std::cout << "\n";
-      }
-      std::cout << ex.exp_5_count_ << ":" << std::flush;
+      Record record(c.tick_, e, "instance");
+      record.integer("instance", ex.exp_5_count_);
+      ex.metrics_->add(std::move(record));
     }
   }
 }
@@ -369,7 +368,7 @@ ExpControl::next5_iterate(Control& c)
       ++ex.exp_5_count_;
       noise = -5.0f; // will reset noise to 0
     } else {
-      std::cout << ";";
+      ex.metrics_->add(Record(c.tick_, e, "step"));
     }
     if (100 < ex.exp_5_count_) { // * 10 separate instances
       c.quit();
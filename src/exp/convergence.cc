@@ -0,0 +1,190 @@
+#include "convergence.hh"
+#include "../util/binary.hh"
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+
+Convergence::Convergence(unsigned int window /* = 0 */,
+                         float threshold /* = 2.0f */,
+                         unsigned int warmup /* = 0 */)
+  : window_(window), threshold_(threshold), warmup_(warmup)
+{
+  this->clear();
+}
+
+
+void
+Convergence::add(unsigned int tick, const std::vector<double>& values)
+{
+  unsigned int window = this->window_;
+  if (0 == window) {
+    return;
+  }
+  if (tick < this->tick_ || values.size() != this->series_) {
+    this->clear();
+    this->series_ = values.size();
+    this->values_.assign(this->series_ * window, 0.0);
+    this->sum_.assign(this->series_, 0.0);
+    this->sumsq_.assign(this->series_, 0.0);
+    this->sumkx_.assign(this->series_, 0.0);
+  }
+  this->tick_ = tick;
+
+  double old;
+  double value;
+  for (unsigned int s = 0; s < this->series_; ++s) {
+    double* ring = this->values_.data() + s * window;
+    value = values[s];
+    if (this->count_ < window) {
+      // age index of the newest value is count_
+      ring[(this->head_ + this->count_) % window] = value;
+      this->sumkx_[s] += this->count_ * value;
+    } else {
+      // drop the oldest, so every age index decreases by one
+      old = ring[this->head_];
+      this->sumkx_[s] += old - this->sum_[s] + (window - 1) * value;
+      this->sum_[s] -= old;
+      this->sumsq_[s] -= old * old;
+      ring[this->head_] = value;
+    }
+    this->sum_[s] += value;
+    this->sumsq_[s] += value * value;
+  }
+  if (this->count_ < window) {
+    ++this->count_;
+  } else {
+    this->head_ = (this->head_ + 1) % window;
+  }
+}
+
+
+Verdict
+Convergence::verdict() const
+{
+  if (0 == this->window_ || this->count_ < this->window_) {
+    return Verdict::Changing;
+  }
+
+  bool flat = true;
+  double n = this->count_;
+  double variance;
+  for (unsigned int s = 0; s < this->series_; ++s) {
+    variance = this->sumsq_[s] / n - (this->sum_[s] / n) * (this->sum_[s] / n);
+    flat = flat && 1e-9 >= variance;
+  }
+  if (flat) {
+    return Verdict::Absorbing;
+  }
+  if (this->tick_ < this->warmup_) {
+    return Verdict::Changing;
+  }
+  for (unsigned int s = 0; s < this->series_; ++s) {
+    if (this->threshold_ < std::fabs(this->trend(s))) {
+      return Verdict::Changing;
+    }
+  }
+  return Verdict::Stationary;
+}
+
+
+double
+Convergence::trend(unsigned int s) const
+{
+  double n = this->count_;
+  if (3.0 > n) {
+    return 0.0;
+  }
+  // least squares of value against age index k = 0..n-1
+  double sk = n * (n - 1) / 2;
+  double skk = n * (n - 1) * (2 * n - 1) / 6;
+  double sx = this->sum_[s];
+  double sxx = this->sumsq_[s] - sx * sx / n;
+  double sxy = this->sumkx_[s] - sk * sx / n;
+  skk -= sk * sk / n;
+  double slope = sxy / skk;
+  double residual = std::max(0.0, sxx - slope * sxy) / (n - 2);
+  if (1e-12 >= std::fabs(slope)) {
+    return 0.0;
+  }
+  if (1e-12 >= residual) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return slope / std::sqrt(residual / skk);
+}
+
+
+std::string
+Convergence::describe() const
+{
+  std::ostringstream text;
+  double n = std::max(1u, this->count_);
+  double mean;
+  double variance;
+  text << std::fixed << std::setprecision(2);
+  for (unsigned int s = 0; s < this->series_; ++s) {
+    mean = this->sum_[s] / n;
+    variance = std::max(0.0, this->sumsq_[s] / n - mean * mean);
+    text << (0 < s ? " " : "") << mean << "~" << std::sqrt(variance) << "/"
+         << this->trend(s);
+  }
+  return text.str();
+}
+
+
+void
+Convergence::clear()
+{
+  this->values_.clear();
+  this->sum_.clear();
+  this->sumsq_.clear();
+  this->sumkx_.clear();
+  this->series_ = 0;
+  this->count_ = 0;
+  this->head_ = 0;
+  this->tick_ = 0;
+}
+
+
+void
+Convergence::checkpoint(std::ostream& stream) const
+{
+  Binary::put<uint32_t>(stream, this->window_);
+  Binary::put(stream, this->threshold_);
+  Binary::put<uint32_t>(stream, this->warmup_);
+  Binary::put(stream, this->values_);
+  Binary::put(stream, this->sum_);
+  Binary::put(stream, this->sumsq_);
+  Binary::put(stream, this->sumkx_);
+  Binary::put<uint32_t>(stream, this->series_);
+  Binary::put<uint32_t>(stream, this->count_);
+  Binary::put<uint32_t>(stream, this->head_);
+  Binary::put<uint32_t>(stream, this->tick_);
+}
+
+
+bool
+Convergence::restore(std::istream& stream)
+{
+  uint32_t fields[6];
+  if (!Binary::get(stream, fields[0]) ||
+      !Binary::get(stream, this->threshold_) ||
+      !Binary::get(stream, fields[1]) || !Binary::get(stream, this->values_) ||
+      !Binary::get(stream, this->sum_) || !Binary::get(stream, this->sumsq_) ||
+      !Binary::get(stream, this->sumkx_)) {
+    return false;
+  }
+  for (unsigned int f = 2; f < 6; ++f) {
+    if (!Binary::get(stream, fields[f])) {
+      return false;
+    }
+  }
+  this->window_ = fields[0];
+  this->warmup_ = fields[1];
+  this->series_ = fields[2];
+  this->count_ = fields[3];
+  this->head_ = fields[4];
+  this->tick_ = fields[5];
+  return this->values_.size() == this->series_ * this->window_;
+}
@@ -0,0 +1,92 @@
+//===-- exp/convergence.hh - Convergence class declaration -----*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Convergence class, which monitors a few series (such as
+/// the type counters and cluster counts) over a sliding window of time steps,
+/// to tell when a run has reached a stationary or absorbing state.
+/// The window mean, variance and least-squares trend of every series are
+/// updated online, in constant time per time step.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Verdict: State of the monitored series.
+
+enum class Verdict
+{
+  Changing = 0, // window not full yet, or some series still trends
+  Stationary,   // no series trends significantly over the window
+  Absorbing     // no series has changed at all over the window
+};
+
+
+class Convergence
+{
+ public:
+  /// constructor: Prepare an empty monitor.
+  /// \param window  number of time steps per window (0 disables monitoring)
+  /// \param threshold  greatest |t| of a trend deemed insignificant
+  /// \param warmup  time steps before which no run is deemed stationary
+  Convergence(unsigned int window = 0, float threshold = 2.0f,
+              unsigned int warmup = 0);
+
+  /// add(): Append the values of the series at a time step.
+  ///         A time step earlier than the last starts over (a new run).
+  /// \param tick  current time step
+  /// \param values  value per series (the number of series must not change)
+  void add(unsigned int tick, const std::vector<double>& values);
+
+  /// verdict(): Tell whether the series have converged.
+  /// \returns  verdict over the current window
+  Verdict verdict() const;
+
+  /// describe(): Describe the window statistics, eg. for logging decisions.
+  /// \returns  "mean~stddev/t" per series
+  std::string describe() const;
+
+  /// clear(): Forget all values (eg. at the start of a new run).
+  void clear();
+
+  /// checkpoint(): Write the configuration and window so far.
+  /// \param stream  destination binary stream
+  void checkpoint(std::ostream& stream) const;
+
+  /// restore(): Replace the monitor with one written by checkpoint().
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
+  /// enabled(): Whether monitoring is enabled.
+  /// \returns  true if there is a window
+  inline bool
+  enabled() const
+  {
+    return 0 < this->window_;
+  }
+
+  unsigned int window_;    // number of time steps per window
+  float        threshold_; // greatest |t| of an insignificant trend
+  unsigned int warmup_;    // time steps before any stationary verdict
+
+ private:
+  /// trend(): Get the t statistic of the least-squares slope of a series.
+  /// \param s  series index
+  /// \returns  t statistic (0 if flat, infinite if a perfect line)
+  double trend(unsigned int s) const;
+
+  std::vector<double> values_; // ring buffer per series (series-major)
+  std::vector<double> sum_;    // sum of values per series
+  std::vector<double> sumsq_;  // sum of squared values per series
+  std::vector<double> sumkx_;  // sum of (age index * value) per series
+  unsigned int        series_; // number of series
+  unsigned int        count_;  // number of values in window
+  unsigned int        head_;   // ring position of the oldest value
+  unsigned int        tick_;   // last time step added
+};
@@ -0,0 +1,77 @@
+#include "convergence.hh"
+#include "../util/util.hh"
+#include <sstream>
+
+
+TEST_CASE("Convergence::verdict")
+{
+  auto convergence = Convergence(100, 2.0f, 300);
+
+  SECTION("disabled") {
+    auto disabled = Convergence();
+    for (unsigned int tick = 0; tick < 200; ++tick) {
+      disabled.add(tick, {1.0});
+    }
+    REQUIRE(!disabled.enabled());
+    REQUIRE(Verdict::Changing == disabled.verdict());
+  }
+
+  SECTION("absorbing") {
+    for (unsigned int tick = 0; tick < 99; ++tick) {
+      convergence.add(tick, {7.0, 3.0});
+    }
+    REQUIRE(Verdict::Changing == convergence.verdict()); // window not full
+    convergence.add(99, {7.0, 3.0});
+    REQUIRE(Verdict::Absorbing == convergence.verdict()); // despite warmup
+  }
+
+  SECTION("trending") {
+    for (unsigned int tick = 0; tick < 1000; ++tick) {
+      convergence.add(tick, {Util::distr(-1.0f, 1.0f), 0.05 * tick});
+    }
+    REQUIRE(Verdict::Changing == convergence.verdict());
+  }
+
+  SECTION("stationary") {
+    Verdict verdict = Verdict::Changing;
+    unsigned int tick = 0;
+    for (; tick < 10000 && Verdict::Stationary != verdict; ++tick) {
+      convergence.add(tick, {100.0 + Util::distr(-5.0f, 5.0f),
+                             20.0 + Util::distr(-1.0f, 1.0f)});
+      verdict = convergence.verdict();
+    }
+    REQUIRE(Verdict::Stationary == verdict);
+    REQUIRE(300 <= tick); // not before warmup
+  }
+
+  SECTION("restart") {
+    for (unsigned int tick = 0; tick < 100; ++tick) {
+      convergence.add(tick, {1.0});
+    }
+    REQUIRE(Verdict::Absorbing == convergence.verdict());
+    convergence.add(0, {1.0}); // a new run
+    REQUIRE(Verdict::Changing == convergence.verdict());
+  }
+}
+
+
+TEST_CASE("Convergence::checkpoint")
+{
+  auto convergence = Convergence(50, 2.0f, 0);
+  auto restored = Convergence();
+  std::stringstream stream;
+
+  for (unsigned int tick = 0; tick < 80; ++tick) {
+    convergence.add(tick, {static_cast<double>(tick % 7), 2.0});
+  }
+  convergence.checkpoint(stream);
+  REQUIRE(restored.restore(stream));
+  REQUIRE(restored.window_ == convergence.window_);
+  REQUIRE(restored.describe() == convergence.describe());
+  for (unsigned int tick = 80; tick < 200; ++tick) {
+    convergence.add(tick, {static_cast<double>(tick % 7), 2.0});
+    restored.add(tick, {static_cast<double>(tick % 7), 2.0});
+  }
+  REQUIRE(restored.verdict() == convergence.verdict());
+  REQUIRE(restored.describe() == convergence.describe());
+}
@@ -1,12 +1,22 @@
 #include "exp.hh"
+#include "../util/binary.hh"
 #include "../util/common.hh"
 #include "../util/util.hh"
 #include <algorithm>
+#include <sstream>
 
 
 Exp::Exp(Log& log, ExpControl& expctrl, State& state, Proc& proc, bool no_cl)
-  : log_(log), expctrl_(expctrl), state_(state), proc_(proc), no_cl_(no_cl)
+  : log_(log), expctrl_(expctrl), state_(state), proc_(proc), no_cl_(no_cl),
+    type_history_(log, "emergence." + std::to_string(getpid()) + ".types"),
+    metrics_(new Metrics(log, std::cout)),
+    heatmap_path_("emergence." + std::to_string(getpid()) + ".heatmap")
 {
+  this->rdf_every_ = 0;
+  this->rdf_window_ = 10;
+  this->grid_cols_ = 0;
+  this->grid_rows_ = 0;
+  this->grid_stride_ = 0;
   this->magentas_ = 0;
   this->blues_ = 0;
   this->yellows_ = 0;
@@ -18,10 +28,6 @@ Exp::Exp(Log& log, ExpControl& expctrl, State& state, Proc& proc, bool no_cl)
   this->exp_5_est_done_ = 0;
   this->exp_5_dbscan_done_ = 0;
 
-  for (int p = 0; p < state.num_; ++p) {
-    this->type_history_.push_back({});
-  }
-
   // sprite particle positions begin at 0,0
   this->sprites_ = {
     {Type::Nutrient, gen_sprite({
@@ -386,71 +392,33 @@ void
 Exp::type()
 {
   State& state = this->state_;
-  bool cl = !this->no_cl_;
-  std::vector<Type>& pt = state.pt_;
-  std::vector<unsigned int>& pn = state.pn_;
-  float ascope = state.ascope_squared_;
-  this->magentas_ = 0;
-  this->blues_ = 0;
-  this->yellows_ = 0;
-  this->browns_ = 0;
-  this->greens_ = 0;
-  unsigned int n;
-
-  // cl
-  std::vector<unsigned int>& pan = state.pan_;
-
-  // non-cl
-  std::vector<float>& pld = state.pld_;
-  std::vector<float>& prd = state.prd_;
-  unsigned int n_stride = state.n_stride_;
-
-  for (unsigned int p = 0; p < state.num_; ++p) {
-    n = pn[p];
-
-#if 1 == CL_ENABLED
-
-    if (cl) {
-      if (15 <  n && 15 < pan[p]) {
-        pt[p] = Type::MatureSpore;
-        ++this->magentas_;
-        continue;
-      }
-    } else {
-
-#endif
-
-      if (15 < n && 15 < plain_alt_neighborhood(pld, prd, p, n_stride, ascope))
-      {
-        pt[p] = Type::MatureSpore;
-        ++this->magentas_;
-        continue;
-      }
-
-#if 1 == CL_ENABLED
-
-    }
-
-#endif
-
-    if (15 < n && n <= 35) {
-      pt[p] = Type::CellHull;
-      ++this->blues_;
-      continue;
-    }
-    if (35 < n) {
-      pt[p] = Type::CellCore;
-      ++this->yellows_;
-      continue;
-    }
-    if (13 <= n && n <= 15) {
-      pt[p] = Type::PrematureSpore;
-      ++this->browns_;
-      continue;
-    }
-    pt[p] = Type::Nutrient;
-    ++this->greens_;
+  unsigned int num = state.num_;
+  Column<Type>& pt = state.pt_;
+  Column<Count>& pn = state.pn_;
+  Column<Count>& pan = state.pan_;
+  // the plain seek may have already typed the particles (see Proc::typed_)
+  bool typed = this->proc_.typed_;
+  unsigned int magentas = 0;
+  unsigned int blues = 0;
+  unsigned int yellows = 0;
+  unsigned int browns = 0;
+  Type t;
+
+  // single branchless pass, so that it can be vectorised
+  for (unsigned int p = 0; p < num; ++p) {
+    t = typed ? pt[p] : State::type_of(pn[p], pan[p]);
+    pt[p] = t;
+    magentas += Type::MatureSpore    == t;
+    blues    += Type::CellHull       == t;
+    yellows  += Type::CellCore       == t;
+    browns   += Type::PrematureSpore == t;
   }
+
+  this->magentas_ = magentas;
+  this->blues_ = blues;
+  this->yellows_ = yellows;
+  this->browns_ = browns;
+  this->greens_ = num - magentas - blues - yellows - browns;
 }
 
 
@@ -474,7 +442,6 @@ void
 Exp::reset_cluster()
 {
   this->proc_.neighbors_sets_.clear();
-  this->proc_.neighbors_dists_.clear();
   this->nearest_neighbor_dists_.clear();
   this->cores_.clear();
   this->vague_.clear();
@@ -482,6 +449,7 @@ Exp::reset_cluster()
   this->palette_.clear();
   this->cell_clusters_.clear();
   this->spore_clusters_.clear();
+  this->shapes_.clear();
   this->districts_.clear();
 }
 
@@ -498,12 +466,12 @@ Exp::color(Coloring scheme)
 {
   State& state = this->state_;
   unsigned int num = state.num_;
-  std::vector<Type>& pt = state.pt_;
-  std::vector<unsigned int>& pn = state.pn_;
-  std::vector<float>& xr = state.xr_;
-  std::vector<float>& xg = state.xg_;
-  std::vector<float>& xb = state.xb_;
-  std::vector<float>& xa = state.xa_;
+  Column<Type>& pt = state.pt_;
+  Column<Count>& pn = state.pn_;
+  Column<float>& xr = state.xr_;
+  Column<float>& xg = state.xg_;
+  Column<float>& xb = state.xb_;
+  Column<float>& xa = state.xa_;
 
   if (Coloring::Original == scheme) {
     for (unsigned int p = 0; p < num; ++p) {
@@ -644,6 +612,7 @@ Exp::cluster(float radius, unsigned int minpts)
   this->dbscan_categorise(radius, minpts);
   this->dbscan_collect();
   this->type_clusters();
+  Shape::of_all(this->state_, this->clusters_, this->shapes_);
 }
 
 
@@ -677,76 +646,44 @@ Exp::inject(Type type, bool greater)
   }
   float w = static_cast<float>(state.width_);
   float h = static_cast<float>(state.height_);
-  unsigned int n_stride = state.n_stride_;
   unsigned int size = sprite.size();
   float dist_x = Util::distr(0.0f, w);
   float dist_y = Util::distr(0.0f, h);
+  std::vector<float> px(size);
+  std::vector<float> py(size);
+  std::vector<float> pf(size);
   float x;
   float y;
-  unsigned int si = 0;
-  unsigned int i_stride;
 
-  for (int i = state.num_; i < state.num_ + size; ++i) {
+  for (unsigned int si = 0; si < size; ++si) {
     SpritePt& p = sprite[si];
-    ++si;
-    i_stride = n_stride * si;
     x = std::get<0>(p) + dist_x; if (w <= x) { x -= w; }
     y = std::get<1>(p) + dist_y; if (h <= y) { y -= h; }
-    state.px_.push_back(x);
-    state.py_.push_back(y);
-    state.pf_.push_back(std::get<2>(p));
-    state.pc_.push_back(std::get<3>(p));
-    state.ps_.push_back(std::get<4>(p));
-    state.pn_.push_back(0);
-    state.pl_.push_back(0);
-    state.pr_.push_back(0);
-    state.pan_.push_back(0);
-    for (int j = 0; j < n_stride; ++j) { state.pls_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { state.prs_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { state.pld_.push_back(-1.0f); }
-    for (int j = 0; j < n_stride; ++j) { state.prd_.push_back(-1.0f); }
-    state.pt_.push_back(type);
-    state.xr_.push_back(1.0f);
-    state.xg_.push_back(1.0f);
-    state.xb_.push_back(1.0f);
-    state.xa_.push_back(1.0f);
+    px[si] = x;
+    py[si] = y;
+    pf[si] = std::get<2>(p);
+  }
+  unsigned int first = state.append(px, py, pf, type, 1.0f);
+  for (unsigned int i = first; i < first + size; ++i) {
     this->injected_.push_back(i);
   }
-  state.num_ += size;
   this->sprite_x_ = dist_x;
   this->sprite_y_ = dist_y;
 }
 
 
-unsigned int
-Exp::plain_alt_neighborhood(std::vector<float>& pld, std::vector<float>& prd,
-                            unsigned int p, unsigned int n_stride,
-                            float ascope)
+void
+Exp::remap(const std::vector<int>& remap)
 {
-  unsigned int pstride = n_stride * p;
-  unsigned int count = 0;
-  float dist;
-
-  for (int i = 0; i < n_stride; ++i) {
-    dist = pld[pstride + i];
-    if (0 > dist) {
-      break;
-    }
-    if (ascope >= dist) {
-      ++count;
+  std::vector<unsigned int> injected;
+  for (unsigned int i : this->injected_) {
+    if (i < remap.size() && 0 <= remap[i]) {
+      injected.push_back(remap[i]);
     }
   }
-  for (int i = 0; i < n_stride; ++i) {
-    dist = prd[pstride + i];
-    if (0 > dist) {
-      break;
-    }
-    if (ascope >= dist) {
-      ++count;
-    }
-  }
-
-  return count;
+  this->injected_.swap(injected);
+  this->type_history_.remap(remap);
+  this->reset_cluster();
 }
 
 
@@ -769,41 +706,36 @@ Exp::palette_sample()
 
 
 void
-Exp::nearest_neighbor_dists()
+Exp::nearest_neighbor_dists(bool everyone /* = false */)
 {
-  State& state = this->state_;
-  std::unordered_map<int,std::vector<float>>& nd =
-    this->proc_.neighbors_dists_;
-  float max = static_cast<float>(state_.width_);
-  float nearest;
-
-  for (int p = 0; p < state_.num_; ++p) {
-    if (!nd[p].size()) {
+  Proc& proc = this->proc_;
+  std::vector<float>& nearest = proc.nearest_dists_;
+  std::vector<float> dists;
+  unsigned int num = std::min(static_cast<std::size_t>(this->state_.num_),
+                              nearest.size());
+
+  for (unsigned int p = 0; p < num; ++p) {
+    if (0.0f <= nearest[p]) {
+      this->nearest_neighbor_dists_.push_back(nearest[p]);
       continue;
     }
-    nearest = max;
-    for (float dist : nd[p]) {
-      if (nearest > dist) {
-        nearest = dist;
-      }
+    if (!everyone) {
+      continue;
+    }
+    proc.knn(this->grid_, this->grid_cols_, this->grid_rows_,
+             this->grid_stride_, p, 1, dists);
+    if (!dists.empty()) {
+      this->nearest_neighbor_dists_.push_back(dists[0]);
     }
-    this->nearest_neighbor_dists_.push_back(nearest);
   }
 }
 
 
 void
-Exp::record_types()
+Exp::record_types(unsigned int tick)
 {
   State& state = this->state_;
-  std::vector<Type>& pt = state.pt_;
-  std::vector<std::vector<Type>>& history = this->type_history_;
-
-  for (int p = 0; p < state.num_; ++p) {
-    if (history[p].empty() || pt[p] != history[p].back()) {
-      history[p].push_back(pt[p]);
-    }
-  }
+  this->type_history_.record(tick, state.pt_.data(), state.num_);
 }
 
 
@@ -813,13 +745,13 @@ Exp::dbscan_categorise(float radius, unsigned int minpts)
   std::unordered_map<int,std::vector<int>>& ns = this->proc_.neighbors_sets_;
   std::vector<int>& cores = this->cores_;
   std::vector<int>& vague = this->vague_;
-  auto grid = std::vector<int>();
-  int cols;
-  int rows;
-  unsigned int stride;
+  Proc& proc = this->proc_;
 
-  this->proc_.plain_seek(radius, grid, cols, rows, stride,
-                         &Proc::tally_neighbors);
+  // nearest neighbors come along in the same pass (see nearest_neighbor_dists)
+  proc.nearest_ = true;
+  proc.plain_seek(radius, this->grid_, this->grid_cols_, this->grid_rows_,
+                  this->grid_stride_, &Proc::tally_neighbors);
+  proc.nearest_ = false;
 
   auto it = ns.begin();
   while (it != ns.end()) {
@@ -943,8 +875,8 @@ Exp::dhi()
   State& state = this->state_;
   unsigned int width = state.width_;
   unsigned int height = state.height_;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
+  Column<float>& px = state.px_;
+  Column<float>& py = state.py_;
   float scope = state.scope_;
   float scopesq = scope * scope;
   float dx;
@@ -1036,6 +968,277 @@ Exp::dhi()
 }
 
 
+bool
+Exp::checkpoint(std::ostream& stream)
+{
+  auto counts = [&stream](const std::unordered_map<int,int>& map) {
+    Binary::put<uint64_t>(stream, map.size());
+    for (const std::pair<const int,int>& pair : map) {
+      Binary::put<int32_t>(stream, pair.first);
+      Binary::put<int32_t>(stream, pair.second);
+    }
+  };
+
+  Binary::put<uint32_t>(stream, this->exp_4_count_);
+  Binary::put<uint32_t>(stream, this->exp_5_count_);
+  Binary::put<int32_t>(stream, this->exp_4_est_done_);
+  Binary::put<int32_t>(stream, this->exp_4_dbscan_done_);
+  Binary::put(stream, this->exp_4_est_how_);
+  Binary::put(stream, this->exp_4_dbscan_how_);
+  Binary::put<int32_t>(stream, this->exp_5_est_done_);
+  Binary::put<int32_t>(stream, this->exp_5_dbscan_done_);
+  Binary::put(stream, this->exp_5_est_how_);
+  Binary::put(stream, this->exp_5_dbscan_how_);
+  counts(this->exp_5_est_size_counts_);
+  counts(this->exp_5_dbscan_size_counts_);
+  this->convergence_.checkpoint(stream);
+  Binary::put(stream, this->sprite_x_);
+  Binary::put(stream, this->sprite_y_);
+  Binary::put(stream, this->injected_);
+  Binary::put<uint32_t>(stream, this->rdf_every_);
+  Binary::put<uint32_t>(stream, this->rdf_window_);
+  this->rdf_.checkpoint(stream);
+  this->heatmap_.checkpoint(stream);
+  return this->type_history_.checkpoint(stream);
+}
+
+
+bool
+Exp::restore(std::istream& stream)
+{
+  auto counts = [&stream](std::unordered_map<int,int>& map) {
+    uint64_t size;
+    int32_t key;
+    int32_t value;
+    map.clear();
+    if (!Binary::get(stream, size)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < size; ++i) {
+      if (!Binary::get(stream, key) || !Binary::get(stream, value)) {
+        return false;
+      }
+      map[key] = value;
+    }
+    return true;
+  };
+  uint32_t exp_4_count;
+  uint32_t exp_5_count;
+  int32_t exp_4_est_done;
+  int32_t exp_4_dbscan_done;
+  int32_t exp_5_est_done;
+  int32_t exp_5_dbscan_done;
+  uint32_t rdf_every;
+  uint32_t rdf_window;
+
+  this->reset_cluster();
+  if (!Binary::get(stream, exp_4_count) || !Binary::get(stream, exp_5_count)
+      || !Binary::get(stream, exp_4_est_done) ||
+      !Binary::get(stream, exp_4_dbscan_done) ||
+      !Binary::get(stream, this->exp_4_est_how_) ||
+      !Binary::get(stream, this->exp_4_dbscan_how_) ||
+      !Binary::get(stream, exp_5_est_done) ||
+      !Binary::get(stream, exp_5_dbscan_done) ||
+      !Binary::get(stream, this->exp_5_est_how_) ||
+      !Binary::get(stream, this->exp_5_dbscan_how_) ||
+      !counts(this->exp_5_est_size_counts_) ||
+      !counts(this->exp_5_dbscan_size_counts_) ||
+      !this->convergence_.restore(stream) ||
+      !Binary::get(stream, this->sprite_x_) ||
+      !Binary::get(stream, this->sprite_y_) ||
+      !Binary::get(stream, this->injected_) ||
+      !Binary::get(stream, rdf_every) || !Binary::get(stream, rdf_window) ||
+      !this->rdf_.restore(stream) || !this->heatmap_.restore(stream) ||
+      !this->type_history_.restore(stream)) {
+    return false;
+  }
+  this->exp_4_count_ = exp_4_count;
+  this->exp_5_count_ = exp_5_count;
+  this->exp_4_est_done_ = exp_4_est_done;
+  this->exp_4_dbscan_done_ = exp_4_dbscan_done;
+  this->exp_5_est_done_ = exp_5_est_done;
+  this->exp_5_dbscan_done_ = exp_5_dbscan_done;
+  this->rdf_every_ = rdf_every;
+  this->rdf_window_ = rdf_window;
+  return true;
+}
+
+
+void
+Exp::metrics(const std::string& path)
+{
+  this->metrics_.reset(); // write out pending results first
+  this->metrics_.reset(new Metrics(this->log_, path));
+}
+
+
+void
+Exp::converge(unsigned int window, float threshold /* = 2.0f */,
+              unsigned int warmup /* = 0 */)
+{
+  this->convergence_ = Convergence(window, threshold, warmup);
+}
+
+
+bool
+Exp::converged(unsigned int tick, const std::vector<double>& values,
+               std::string& how)
+{
+  Convergence& convergence = this->convergence_;
+  if (!convergence.enabled()) {
+    return false;
+  }
+  convergence.add(tick, values);
+  Verdict verdict = convergence.verdict();
+  if (Verdict::Changing == verdict) {
+    return false;
+  }
+  how = Verdict::Absorbing == verdict ? "absorbed" : "stationary";
+  this->log_.add(Attn::O, "Converged (" + how + ") at tick "
+                          + std::to_string(tick) + " over "
+                          + std::to_string(convergence.window_) + " ticks: "
+                          + convergence.describe());
+  convergence.clear();
+  return true;
+}
+
+
+void
+Exp::heatmap(const std::string& path, float bin /* = 1.0f */)
+{
+  this->heatmap_ = Heatmap(bin);
+  this->heatmap_path_ = path;
+}
+
+
+void
+Exp::rdf(unsigned int every, unsigned int window /* = 10 */,
+         float radius /* = 0.0f */, unsigned int bins /* = 64 */)
+{
+  if (0.0f >= radius) {
+    radius = 4.0f * this->state_.scope_;
+  }
+  this->rdf_ = Rdf(radius, bins);
+  this->rdf_every_ = every;
+  this->rdf_window_ = std::max(1u, window);
+}
+
+
+void
+Exp::do_rdf(unsigned int tick)
+{
+  if (!this->rdf_every_ || tick % this->rdf_every_) {
+    return;
+  }
+  Rdf& rdf = this->rdf_;
+  rdf.sample(this->state_);
+  if (rdf.samples() < this->rdf_window_) {
+    return;
+  }
+  std::vector<double> k;
+  std::vector<double> s = rdf.structure(rdf.bins_, k);
+  Record record(tick, this->expctrl_.experiment_, "rdf");
+  record.integer("samples", rdf.samples())
+        .reals("r", rdf.r())
+        .reals("g", rdf.g())
+        .reals("k", std::move(k))
+        .reals("s", std::move(s));
+  this->metrics_->add(std::move(record));
+  rdf.clear();
+}
+
+
+void
+Exp::cluster_fields(Record& record, float radius, unsigned int minpts)
+{
+  unsigned int num = this->state_.num_;
+  record.integer("mature_spores", this->magentas_)
+        .integer("cell_hulls", this->blues_)
+        .integer("cell_cores", this->yellows_)
+        .real("radius", radius)
+        .integer("minpts", minpts)
+        .integer("clusters", this->clusters_.size())
+        .integer("cells", this->cell_clusters_.size())
+        .integer("spores", this->spore_clusters_.size())
+        .integer("cores", this->cores_.size())
+        .integer("vagues", this->vague_.size())
+        .integer("noise", num - this->cores_.size() - this->vague_.size());
+
+  // structures recognised from the cluster shapes
+  unsigned int structures[11] = {};
+  for (const Shape& shape : this->shapes_) {
+    ++structures[static_cast<int>(shape.type)];
+  }
+  record.integer("rings", structures[static_cast<int>(Type::Ring)])
+        .integer("premature_cells",
+                 structures[static_cast<int>(Type::PrematureCell)])
+        .integer("triangle_cells",
+                 structures[static_cast<int>(Type::TriangleCell)])
+        .integer("square_cells",
+                 structures[static_cast<int>(Type::SquareCell)])
+        .integer("pentagon_cells",
+                 structures[static_cast<int>(Type::PentagonCell)]);
+}
+
+
+void
+Exp::survival_record(unsigned int tick, float dpe)
+{
+  Record record(tick, this->expctrl_.experiment_, "survival");
+  record.integer("instance", this->exp_4_count_)
+        .real("dpe", dpe)
+        .integer("est_done", this->exp_4_est_done_)
+        .text("est_how", this->exp_4_est_how_)
+        .integer("dbscan_done", this->exp_4_dbscan_done_)
+        .text("dbscan_how", this->exp_4_dbscan_how_);
+  this->metrics_->add(std::move(record));
+}
+
+
+void
+Exp::size_record(unsigned int tick, int est_done, const std::string& est_how,
+                 int dbscan_done, const std::string& dbscan_how)
+{
+  std::vector<long long> est_sizes;
+  std::vector<long long> est_counts;
+  std::vector<long long> dbscan_sizes;
+  std::vector<long long> dbscan_counts;
+  for (std::pair<int,int> size_count : this->exp_5_est_size_counts_) {
+    est_sizes.push_back(size_count.first);
+    est_counts.push_back(size_count.second);
+  }
+  for (std::pair<int,int> size_count : this->exp_5_dbscan_size_counts_) {
+    dbscan_sizes.push_back(size_count.first);
+    dbscan_counts.push_back(size_count.second);
+  }
+  Record record(tick, this->expctrl_.experiment_, "size");
+  record.integer("instance", this->exp_5_count_)
+        .integer("est_done", est_done)
+        .text("est_how", est_how)
+        .integers("est_sizes", std::move(est_sizes))
+        .integers("est_counts", std::move(est_counts))
+        .integer("dbscan_done", dbscan_done)
+        .text("dbscan_how", dbscan_how)
+        .integers("dbscan_sizes", std::move(dbscan_sizes))
+        .integers("dbscan_counts", std::move(dbscan_counts));
+  this->metrics_->add(std::move(record));
+}
+
+
+void
+Exp::noise_record(unsigned int tick, unsigned int noise)
+{
+  Record record(tick, this->expctrl_.experiment_, "noise");
+  record.integer("instance", this->exp_5_count_)
+        .integer("noise", noise)
+        .integer("est_done", this->exp_5_est_done_)
+        .text("est_how", this->exp_5_est_how_)
+        .integer("dbscan_done", this->exp_5_dbscan_done_)
+        .text("dbscan_how", this->exp_5_dbscan_how_);
+  this->metrics_->add(std::move(record));
+}
+
+
 void
 Exp::do_meta_exp(unsigned int tick)
 {
@@ -1045,14 +1248,14 @@ Exp::do_meta_exp(unsigned int tick)
   float radius = 0.6f * this->state_.scope_;
   unsigned int minpts = 14;
   this->cluster(radius, minpts);
-  std::cout << tick << ": "
-            << this->magentas_              << " magenta(mature_spore), "
-            << this->blues_                 << " blue(cell_hull), "
-            << this->yellows_               << " yellow(cell_core), "
-            << this->clusters_.size()       << " clusters, "
-            << this->cell_clusters_.size()  << " cells, "
-            << this->spore_clusters_.size() << " spores"
-            << std::endl;
+  Record record(tick, this->expctrl_.experiment_, "meta");
+  record.integer("mature_spores", this->magentas_)
+        .integer("cell_hulls", this->blues_)
+        .integer("cell_cores", this->yellows_)
+        .integer("clusters", this->clusters_.size())
+        .integer("cells", this->cell_clusters_.size())
+        .integer("spores", this->spore_clusters_.size());
+  this->metrics_->add(std::move(record));
 }
 
 
@@ -1067,11 +1270,11 @@ Exp::do_exp_1a(unsigned int tick) {
     this->nearest_neighbor_dists_.clear();
     this->nearest_neighbor_dists();
 
-    std::cout << tick << ":";
-    for (float dist : this->nearest_neighbor_dists_) {
-      std::cout << " " << dist;
-    }
-    std::cout << std::endl;
+    Record record(tick, this->expctrl_.experiment_, "occupancy");
+    record.reals("nn_dists",
+                 std::vector<double>(this->nearest_neighbor_dists_.begin(),
+                                     this->nearest_neighbor_dists_.end()));
+    this->metrics_->add(std::move(record));
   }
 }
 
@@ -1093,11 +1296,11 @@ Exp::do_exp_1b(unsigned int tick) {
     this->nearest_neighbor_dists_.clear();
     this->nearest_neighbor_dists();
 
-    std::cout << tick << ":";
-    for (float dist : this->nearest_neighbor_dists_) {
-      std::cout << " " << dist;
-    }
-    std::cout << std::endl;
+    Record record(tick, this->expctrl_.experiment_, "occupancy");
+    record.reals("nn_dists",
+                 std::vector<double>(this->nearest_neighbor_dists_.begin(),
+                                     this->nearest_neighbor_dists_.end()));
+    this->metrics_->add(std::move(record));
   }
 }
 
@@ -1109,78 +1312,50 @@ Exp::do_exp_2(unsigned int tick) {
     return;
   }
   State& state = this->state_;
-  unsigned int num = state.num_;
   float radius = state.scope_;
   unsigned int minpts = 14;
 
   this->cluster(radius, minpts);
 
-  std::cout << std::fixed << std::setprecision(2)
-            << tick << ": "
-            << this->magentas_              << " mature_spores, "
-            << this->blues_                 << " cell_hulls, "
-            << this->yellows_               << " cell_cores "
-            << "(dbscan " << radius << "," << minpts << ": "
-            << this->clusters_.size()       << " clusters, "
-            << this->cell_clusters_.size()  << " cells, "
-            << this->spore_clusters_.size() << " spores, "
-            << this->cores_.size()          << " cores, "
-            << this->vague_.size()          << " vagues, "
-            << num - cores_.size() - vague_.size() << " noise)"
-            << std::endl;
-
-  this->record_types();
-  std::vector<std::vector<Type>>& history = this->type_history_;
-  char t;
+  Record record(tick, this->expctrl_.experiment_, "population");
+  this->cluster_fields(record, radius, minpts);
+  this->metrics_->add(std::move(record));
+
+  this->record_types(tick);
   if (100000 == tick || 1000000 == tick) {
-    std::cout << "types: ";
-    for (int p = 0; p < num; ++p) {
-      std::cout << p;
-      for (Type type : history[p]) {
-        t = 'g';
-        if      (Type::MatureSpore    == type) { t = 'm'; }
-        else if (Type::CellHull       == type) { t = 'b'; }
-        else if (Type::CellCore       == type) { t = 'y'; }
-        else if (Type::PrematureSpore == type) { t = 'w'; }
-        std::cout << " " << t;
-      }
-      if (p != num - 1) {
-        std::cout << ",";
-      }
-    }
-    std::cout << std::endl;
+    std::ostringstream types;
+    this->type_history_.out(types);
+    Record history(tick, this->expctrl_.experiment_, "types");
+    history.text("types", types.str());
+    this->metrics_->add(std::move(history));
   }
 }
 
 
 void
-Exp::do_exp_3(unsigned int tick) {
-  // heat map
-  State& state = this->state_;
-  std::vector<Type>& pt = state.pt_;
-  std::vector<unsigned int>& pl = state.pl_;
-  std::vector<unsigned int>& pr = state.pr_;
-  unsigned int num = this->injected_.size();
-  unsigned int p;
-  Type type;
-  char t = 'x';
-
-  std::cout << tick << ":";
-  for (int i = 0; i < num; ++i) {
-    // TODO: something's not right
-    p = this->injected_[i];
-    type = pt[p];
-    if      (Type::Nutrient       == type) { t = 'g'; }
-    else if (Type::PrematureSpore == type) { t = 'w'; }
-    else if (Type::MatureSpore    == type) { t = 'm'; }
-    else if (Type::CellHull       == type) { t = 'b'; }
-    else if (Type::CellCore       == type) { t = 'y'; }
-    std::cout << " " << p << " " << t << " " << pl[p] << " " << pr[p];
-    if (num - 1 > i) {
-      std::cout << ",";
-    }
+Exp::do_exp_3(unsigned int tick, bool last) {
+  // heat map, relative to the sprite placement
+  Heatmap& heatmap = this->heatmap_;
+  heatmap.sample(this->state_, this->injected_, this->sprite_x_,
+                 this->sprite_y_);
+  if (!last) {
+    return;
+  }
+
+  const std::string& path = this->heatmap_path_;
+  if (!heatmap.save(path)) {
+    this->log_.add(Attn::E, "Heat map not written to: " + path);
+    return;
   }
-  std::cout << std::endl;
+  this->log_.add(Attn::O, "Wrote heat map of " + std::to_string(heatmap.ticks_)
+                          + " ticks to: " + path);
+  Record record(tick, this->expctrl_.experiment_, "heatmap");
+  record.text("path", path)
+        .integer("ticks", heatmap.ticks_)
+        .integer("cols", heatmap.cols())
+        .integer("rows", heatmap.rows())
+        .real("bin", heatmap.bin_);
+  this->metrics_->add(std::move(record));
 }
 
 
@@ -1214,13 +1389,7 @@ Exp::do_exp_4a(unsigned int tick) {
       this->exp_4_dbscan_done_ = tick;
       this->exp_4_dbscan_how_ = "end";
     }
-    std::cout << std::fixed << std::setprecision(3) << " " << dpe << " "
-              << std::fixed << std::setprecision(0)
-              << this->exp_4_est_done_ << " "
-              << this->exp_4_est_how_ << " est "
-              << this->exp_4_dbscan_done_ << " "
-              << this->exp_4_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->survival_record(tick, dpe);
     return true;
   }
 
@@ -1245,14 +1414,10 @@ Exp::do_exp_4a(unsigned int tick) {
     }
   }
 
+  this->converge_exp_4(tick, num_clusters);
+
   if (this->exp_4_est_done_ && this->exp_4_dbscan_done_) {
-    std::cout << std::fixed << std::setprecision(3) << " " << dpe << " "
-              << std::fixed << std::setprecision(0)
-              << this->exp_4_est_done_ << " "
-              << this->exp_4_est_how_ << " est "
-              << this->exp_4_dbscan_done_ << " "
-              << this->exp_4_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->survival_record(tick, dpe);
     return true;
   }
 
@@ -1290,13 +1455,7 @@ Exp::do_exp_4b(unsigned int tick) {
       this->exp_4_dbscan_done_ = tick;
       this->exp_4_dbscan_how_ = "end";
     }
-    std::cout << std::fixed << std::setprecision(3) << " " << dpe << " "
-              << std::fixed << std::setprecision(0)
-              << this->exp_4_est_done_ << " "
-              << this->exp_4_est_how_ << " est "
-              << this->exp_4_dbscan_done_ << " "
-              << this->exp_4_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->survival_record(tick, dpe);
     return true;
   }
 
@@ -1324,14 +1483,10 @@ Exp::do_exp_4b(unsigned int tick) {
     }
   }
 
+  this->converge_exp_4(tick, num_clusters);
+
   if (this->exp_4_est_done_ && this->exp_4_dbscan_done_) {
-    std::cout << std::fixed << std::setprecision(3) << " " << dpe << " "
-              << std::fixed << std::setprecision(0)
-              << this->exp_4_est_done_ << " "
-              << this->exp_4_est_how_ << " est "
-              << this->exp_4_dbscan_done_ << " "
-              << this->exp_4_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->survival_record(tick, dpe);
     return true;
   }
 
@@ -1342,7 +1497,12 @@ Exp::do_exp_4b(unsigned int tick) {
 bool
 Exp::do_exp_4c(unsigned int tick) {
   // survival: clusters emerging from spore and cell
-  if (25000 != tick) {
+  std::string how = "end";
+  if (25000 != tick &&
+      !this->converged(tick, {static_cast<double>(this->magentas_),
+                              static_cast<double>(this->blues_),
+                              static_cast<double>(this->yellows_),
+                              static_cast<double>(this->browns_)}, how)) {
     return false;
   }
 
@@ -1361,25 +1521,42 @@ Exp::do_exp_4c(unsigned int tick) {
 
   this->cluster(radius, minpts);
 
-  std::cout << this->exp_4_count_ << ": "
-            << std::fixed << std::setprecision(3) << dpe << ": "
-            << std::fixed << std::setprecision(0)
-            << this->magentas_              << " mature_spores, "
-            << this->blues_                 << " cell_hulls, "
-            << this->yellows_               << " cell_cores "
-            << "(dbscan " << radius << "," << minpts << ": "
-            << this->clusters_.size()       << " clusters, "
-            << this->cell_clusters_.size()  << " cells, "
-            << this->spore_clusters_.size() << " spores, "
-            << this->cores_.size()          << " cores, "
-            << this->vague_.size()          << " vagues, "
-            << num - cores_.size() - vague_.size() << " noise)"
-            << std::endl;
+  Record record(tick, e, "survival_clusters");
+  record.integer("instance", this->exp_4_count_)
+        .real("dpe", dpe)
+        .text("how", how);
+  this->cluster_fields(record, radius, minpts);
+  this->metrics_->add(std::move(record));
 
   return true;
 }
 
 
+void
+Exp::converge_exp_4(unsigned int tick, unsigned int num_clusters)
+{
+  std::string how;
+  if (this->exp_4_est_done_ && this->exp_4_dbscan_done_) {
+    return;
+  }
+  if (!this->converged(tick, {static_cast<double>(this->magentas_),
+                              static_cast<double>(this->blues_),
+                              static_cast<double>(this->yellows_),
+                              static_cast<double>(this->browns_),
+                              static_cast<double>(num_clusters)}, how)) {
+    return;
+  }
+  if (!this->exp_4_est_done_) {
+    this->exp_4_est_done_ = tick;
+    this->exp_4_est_how_ = how;
+  }
+  if (!this->exp_4_dbscan_done_) {
+    this->exp_4_dbscan_done_ = tick;
+    this->exp_4_dbscan_how_ = how;
+  }
+}
+
+
 bool
 Exp::do_exp_5a(unsigned int tick) {
   // size and lifetime: 0.03, 0.035, 0.04 p/su
@@ -1419,22 +1596,14 @@ Exp::do_exp_5a(unsigned int tick) {
     }
   }
 
-  if (25000 == tick) {
-    std::cout << this->exp_5_count_ << ": " << tick << " end est";
-    int i = 0;
-    for (std::pair<int,int> est_size_count : est_size_counts) {
-      std::cout << (0 < i ? "," : "") << " " << est_size_count.first
-                << " " << est_size_count.second;
-      ++i;
-    }
-    std::cout << "; " << tick << " end dbscan";
-    i = 0;
-    for (std::pair<int,int> dbscan_size_count : dbscan_size_counts) {
-      std::cout << (0 < i ? "," : "") << " " << dbscan_size_count.first
-                << " " << dbscan_size_count.second;
-      ++i;
-    }
-    std::cout << std::endl;
+  std::string how = "end";
+  if (25000 == tick ||
+      this->converged(tick, {static_cast<double>(this->blues_),
+                             static_cast<double>(this->yellows_),
+                             static_cast<double>(num_clusters),
+                             static_cast<double>(this->cell_clusters_.size())},
+                      how)) {
+    this->size_record(tick, tick, how, tick, how);
     est_size_counts.clear();
     dbscan_size_counts.clear();
     return true;
@@ -1466,24 +1635,8 @@ Exp::do_exp_5a(unsigned int tick) {
   }
 
   if (this->exp_5_est_done_ && this->exp_5_dbscan_done_) {
-    std::cout << this->exp_5_count_ << ": "
-              << this->exp_5_est_done_ << " "
-              << this->exp_5_est_how_ << " est";
-    int i = 0;
-    for (std::pair<int,int> est_size_count : est_size_counts) {
-      std::cout << (0 < i ? "," : "") << " " << est_size_count.first
-                << " " << est_size_count.second;
-      ++i;
-    }
-    std::cout << "; " << this->exp_5_dbscan_done_ << " "
-              << this->exp_5_dbscan_how_ << " dbscan";
-    i = 0;
-    for (std::pair<int,int> dbscan_size_count : dbscan_size_counts) {
-      std::cout << (0 < i ? "," : "") << " " << dbscan_size_count.first
-                << " " << dbscan_size_count.second;
-      ++i;
-    }
-    std::cout << std::endl;
+    this->size_record(tick, this->exp_5_est_done_, this->exp_5_est_how_,
+                      this->exp_5_dbscan_done_, this->exp_5_dbscan_how_);
     est_size_counts.clear();
     dbscan_size_counts.clear();
     return true;
@@ -1521,12 +1674,7 @@ Exp::do_exp_5b(unsigned int tick) {
       this->exp_5_dbscan_done_ = tick;
       this->exp_5_dbscan_how_ = "end";
     }
-    std::cout << std::fixed << std::setprecision(0) << " " << noise << " "
-              << this->exp_5_est_done_ << " "
-              << this->exp_5_est_how_ << " est "
-              << this->exp_5_dbscan_done_ << " "
-              << this->exp_5_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->noise_record(tick, noise);
     return true;
   }
 
@@ -1555,13 +1703,24 @@ Exp::do_exp_5b(unsigned int tick) {
     }
   }
 
+  std::string how;
+  if (!(this->exp_5_est_done_ && this->exp_5_dbscan_done_) &&
+      this->converged(tick, {static_cast<double>(size),
+                             static_cast<double>(num_clusters),
+                             static_cast<double>(this->cell_clusters_.size())},
+                      how)) {
+    if (!this->exp_5_est_done_) {
+      this->exp_5_est_done_ = tick;
+      this->exp_5_est_how_ = how;
+    }
+    if (!this->exp_5_dbscan_done_) {
+      this->exp_5_dbscan_done_ = tick;
+      this->exp_5_dbscan_how_ = how;
+    }
+  }
+
   if (this->exp_5_est_done_ && this->exp_5_dbscan_done_) {
-    std::cout << std::fixed << std::setprecision(0) << " " << noise << " "
-              << this->exp_5_est_done_ << " "
-              << this->exp_5_est_how_ << " est "
-              << this->exp_5_dbscan_done_ << " "
-              << this->exp_5_dbscan_how_ << " dbscan"
-              << std::flush;
+    this->noise_record(tick, noise);
     return true;
   }
 
@@ -1572,18 +1731,24 @@ Exp::do_exp_5b(unsigned int tick) {
 bool
 Exp::do_exp_6(unsigned int tick) {
   // param sweep
-  if (500 != tick) {
+  std::string how = "end";
+  if (500 != tick &&
+      !this->converged(tick, {static_cast<double>(this->magentas_),
+                              static_cast<double>(this->blues_),
+                              static_cast<double>(this->yellows_),
+                              static_cast<double>(this->browns_),
+                              static_cast<double>(this->greens_)}, how)) {
     return false;
   }
 
   State& state = this->state_;
 
-  std::cout << std::fixed << std::setprecision(0)
-            << "alpha=" << Util::rad_to_deg(state.alpha_)
-            << ",beta=" << Util::rad_to_deg(state.beta_)
-            << ": " << std::fixed << std::setprecision(4)
-            << this->dhi()
-            << std::endl;
+  Record record(tick, this->expctrl_.experiment_, "sweep");
+  record.real("alpha", Util::rad_to_deg(state.alpha_))
+        .real("beta", Util::rad_to_deg(state.beta_))
+        .real("dhi", this->dhi())
+        .text("how", how);
+  this->metrics_->add(std::move(record));
 
   return true;
 }
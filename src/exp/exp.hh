@@ -11,8 +11,15 @@
 #pragma once
 
 #include "control.hh"
+#include "convergence.hh"
+#include "heatmap.hh"
+#include "history.hh"
+#include "metrics.hh"
+#include "rdf.hh"
+#include "shape.hh"
 #include "../proc/proc.hh"
 #include "../state/state.hh"
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -40,7 +47,7 @@ typedef std::tuple<float,float,float,float,float> SpritePt;
 typedef std::vector<SpritePt>                     SpritePts;
 
 
-enum class Type;
+enum class Type : uint8_t;
 class ExpControl;
 class Proc;
 class State;
@@ -61,7 +68,7 @@ class Exp
   /// \param experiment  specific experiment being performed
   void init_experiment(int experiment_group, int experiment);
 
-  /// type(): Assign type to particle.
+  /// type(): Assign type to every particle and count the particles per type.
   void type();
 
   /// reset_exp(): Clear out all experimentation data structures.
@@ -97,6 +104,56 @@ class Exp
   /// \param greater  whether the greater scope is to be injected
   void inject(Type type, bool greater);
 
+  /// remap(): Follow the particles to their new indices after some were
+  ///          removed from State. Clusters refer to old indices, so they are
+  ///          cleared out.
+  /// \param remap  new index per old index (-1 if removed)
+  void remap(const std::vector<int>& remap);
+
+  /// checkpoint(): Write the experimentation state that carries over between
+  ///               time steps (recurrence, type history, injection, etc.).
+  /// \param stream  destination binary stream
+  /// \returns  whether writing was successful
+  bool checkpoint(std::ostream& stream);
+
+  /// restore(): Replace the experimentation state with one written by
+  ///            checkpoint().
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
+  /// metrics(): Write experiment results to a file instead of stdout.
+  /// \param path  path to the destination file (format chosen by extension)
+  void metrics(const std::string& path);
+
+  /// rdf(): Sample g(r) periodically alongside any experiment.
+  /// \param every  number of ticks between samples (0 disables sampling)
+  /// \param window  number of samples averaged per report
+  /// \param radius  greatest pair distance binned (0 for 4x the scope)
+  /// \param bins  number of bins
+  void rdf(unsigned int every, unsigned int window = 10, float radius = 0.0f,
+           unsigned int bins = 64);
+
+  /// do_rdf(): Sample g(r) if due, and report g(r) and S(k) once a window of
+  ///           samples is complete.
+  /// \param tick  current time step
+  void do_rdf(unsigned int tick);
+
+  /// converge(): Configure the convergence monitor, which ends repetitions
+  ///             of experiments 4, 5, and 6 early once they are stationary.
+  ///             Off unless configured (see -s), so that results stay
+  ///             comparable with full runs.
+  /// \param window  number of time steps per window (0 disables monitoring)
+  /// \param threshold  greatest |t| of a trend deemed insignificant
+  /// \param warmup  time steps before which no run is deemed stationary
+  void converge(unsigned int window, float threshold = 2.0f,
+                unsigned int warmup = 0);
+
+  /// heatmap(): Configure the heat map of experiment 3.
+  /// \param path  path to the destination file (.png, or else binary)
+  /// \param bin  width and height of a histogram bin (in space units)
+  void heatmap(const std::string& path, float bin = 1.0f);
+
   /// do_meta_exp(): Perform and report on meta-experiments.
   ///                Used for counting color classes and finding averages.
   /// \param tick  current time step
@@ -104,11 +161,12 @@ class Exp
 
   /// do_exp_*(): Perform and report on a experiment variation.
   /// \param tick  current time step
+  /// \param last  (some) whether this is the last time step
   /// \returns  (some) true if system should halt, change, etc.
   void do_exp_1a(unsigned int tick); // occupancy, t in {0,150}
   void do_exp_1b(unsigned int tick); // occupancy, t in {60,90,180,400,700}
   void do_exp_2(unsigned int tick);  // population
-  void do_exp_3(unsigned int tick);  // heat map
+  void do_exp_3(unsigned int tick, bool last); // heat map
   bool do_exp_4a(unsigned int tick); // survival, mature spore
   bool do_exp_4b(unsigned int tick); // survival, triangle cell
   bool do_exp_4c(unsigned int tick); // survival by reproduction
@@ -129,20 +187,30 @@ class Exp
   std::string exp_5_dbscan_how_;
   std::unordered_map<int,int> exp_5_est_size_counts_;
   std::unordered_map<int,int> exp_5_dbscan_size_counts_;
+  Convergence convergence_; // steady state monitor of repetitions
   // meta, nearest neighbors, color change, etc.
   unsigned int magentas_; // number of mature spore particles
   unsigned int blues_;    // number of cell hull particles
   unsigned int yellows_;  // number of cell core particles
   unsigned int browns_;   // number of premature spore particles
   unsigned int greens_;   // number of nutrient particles
-  std::vector<float>             nearest_neighbor_dists_; // nn distances
-  std::vector<std::vector<Type>> type_history_;           // type changes
+  std::vector<float> nearest_neighbor_dists_; // nn distances
+  TypeHistory        type_history_;           // type changes
+  std::unique_ptr<Metrics> metrics_;          // experiment results sink
+  // heat map
+  Heatmap     heatmap_;
+  std::string heatmap_path_; // destination of the heat map
+  // radial distribution
+  Rdf          rdf_;
+  unsigned int rdf_every_;  // ticks between samples (0 if disabled)
+  unsigned int rdf_window_; // samples per report
   // clustering
   std::vector<int>           cores_;          // "core" particles
   std::vector<int>           vague_;          // "border" or "noise" pts
   std::vector<std::set<int>> clusters_;       // set of clusters
   std::unordered_set<int>    cell_clusters_;  // set of cell cluster indices
   std::unordered_set<int>    spore_clusters_; // set of spore cluster indices
+  std::vector<Shape>         shapes_;         // shape per cluster
   std::vector<std::set<int>> districts_;      // set of greater clusters
   // injection
   std::unordered_map<Type,SpritePts> sprites_;         // sprites definition
@@ -152,30 +220,54 @@ class Exp
   std::vector<unsigned int>          injected_;        // injected particles
 
  private:
-  /// plain_alt_neighborhood(): Non-OpenCL version of alternative neighborhood
-  ///                           gathering.
-  ///                           Count neighbors in an alternative radius.
-  ///                           Used for coloring spores.
-  /// \param pld  left neighbor distances
-  /// \param prd  right neighbor distances
-  /// \param p  particle index
-  /// \param n_stride  neighbor list stride
-  /// \param alt_scope  alternative radius squared
-  /// \returns  number of neighbors within alternative radius
-  unsigned int plain_alt_neighborhood(std::vector<float>& pld,
-                                      std::vector<float>& prd,
-                                      unsigned int p, unsigned int n_stride,
-                                      float alt_scope);
-
   /// palette_sample(): Generate stack (cache) of random colors for clusters.
   /// \returns  set of random colors
   std::vector<float> palette_sample();
 
-  /// nearest_neighbor_dists(): Compute nearest neighbor distances.
-  void nearest_neighbor_dists();
+  /// nearest_neighbor_dists(): Collect nearest neighbor distances, as found
+  ///                           during the seek of the last cluster().
+  /// \param everyone  whether particles without neighbors within the
+  ///                  clustering radius are included (through a k-NN query)
+  void nearest_neighbor_dists(bool everyone = false);
+
+  /// converged(): Feed the convergence monitor, and log its decision once
+  ///              the series have converged.
+  /// \param tick  current time step
+  /// \param values  value per series
+  /// \param how  destination of how the run ended ("stationary" or
+  ///             "absorbed")
+  /// \returns  true if the run may end
+  bool converged(unsigned int tick, const std::vector<double>& values,
+                 std::string& how);
+
+  /// converge_exp_4(): End an instance of experiments 4a/4b whose outcome is
+  ///                   still undecided once the run has converged.
+  /// \param tick  current time step
+  /// \param num_clusters  number of clusters
+  void converge_exp_4(unsigned int tick, unsigned int num_clusters);
 
   /// record_types(): Record type changes for every particle.
-  void record_types();
+  /// \param tick  current time step
+  void record_types(unsigned int tick);
+
+  /// cluster_fields(): Append the particle type and cluster counts to a
+  ///                   record, as reported after clustering.
+  /// \param record  record to be reported
+  /// \param radius  DBSCAN neighborhood radius used
+  /// \param minpts  DBSCAN minimum number of neighbors used
+  void cluster_fields(Record& record, float radius, unsigned int minpts);
+
+  /// survival_record(), size_record(), noise_record(): Report the outcome of
+  ///                   an instance of experiments 4a/4b, 5a, and 5b.
+  /// \param tick  current time step
+  /// \param dpe  density of particles in the surrounding environment
+  /// \param est_done, dbscan_done  time step of outcome per estimation
+  /// \param est_how, dbscan_how  outcome per estimation
+  /// \param noise  movement noise (degrees)
+  void survival_record(unsigned int tick, float dpe);
+  void size_record(unsigned int tick, int est_done, const std::string& est_how,
+                   int dbscan_done, const std::string& dbscan_how);
+  void noise_record(unsigned int tick, unsigned int noise);
 
   /// dbscan_categorise(): Compute neighborhoods of each particle and
   ///                      categorise them as either "core", "noise", or
@@ -222,6 +314,10 @@ class Exp
   Proc&       proc_;
   State&      state_;
   bool                            no_cl_;
+  std::vector<int>                grid_;     // grid of the last cluster()
+  int                             grid_cols_;
+  int                             grid_rows_;
+  unsigned int                    grid_stride_;
   std::vector<std::vector<float>> palette_;  // cluster color cache
   unsigned int                    palette_index_;
   std::vector<unsigned int>       inspect_;  // particles under inspection
@@ -0,0 +1,168 @@
+#include "heatmap.hh"
+#include "../state/state.hh"
+#include "../util/binary.hh"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stb/stb_image_write.h> // implemented in view/image.cc
+
+
+#define HEATMAP_VERSION 1
+
+
+Heatmap::Heatmap(float bin /* = 1.0f */)
+  : bin_(0.0f < bin ? bin : 1.0f), ticks_(0), cols_(0), rows_(0),
+    width_(0.0f), height_(0.0f)
+{
+}
+
+
+void
+Heatmap::reset(unsigned int width, unsigned int height)
+{
+  this->width_ = static_cast<float>(width);
+  this->height_ = static_cast<float>(height);
+  this->cols_ = std::max(1u, static_cast<unsigned int>(
+                               std::ceil(this->width_ / this->bin_)));
+  this->rows_ = std::max(1u, static_cast<unsigned int>(
+                               std::ceil(this->height_ / this->bin_)));
+  this->counts_.assign(TYPE_COUNT * this->cols_ * this->rows_, 0);
+  this->ticks_ = 0;
+}
+
+
+void
+Heatmap::sample(const State& state, const std::vector<unsigned int>& particles,
+                float x, float y)
+{
+  const Column<float>& px = state.px_;
+  const Column<float>& py = state.py_;
+  const Column<Type>& pt = state.pt_;
+  float w = this->width_;
+  float h = this->height_;
+  unsigned int cols = this->cols_;
+  unsigned int rows = this->rows_;
+  unsigned int plane = cols * rows;
+  int col;
+  int row;
+  float dx;
+  float dy;
+
+  if (state.width_ != this->width_ || state.height_ != this->height_) {
+    this->reset(state.width_, state.height_);
+    w = this->width_;
+    h = this->height_;
+    cols = this->cols_;
+    rows = this->rows_;
+    plane = cols * rows;
+  }
+  for (unsigned int p : particles) {
+    if (static_cast<unsigned int>(state.num_) <= p) {
+      continue;
+    }
+    // offset in [-w/2, w/2), so that the origin lands in the middle
+    dx = px[p] - x; dx -= w * std::floor(dx / w + 0.5f);
+    dy = py[p] - y; dy -= h * std::floor(dy / h + 0.5f);
+    col = cols / 2 + static_cast<int>(std::floor(dx / this->bin_));
+    row = rows / 2 + static_cast<int>(std::floor(dy / this->bin_));
+    col = std::max(0, std::min(static_cast<int>(cols) - 1, col));
+    row = std::max(0, std::min(static_cast<int>(rows) - 1, row));
+    ++this->counts_[plane * static_cast<int>(pt[p]) + cols * row + col];
+  }
+  ++this->ticks_;
+}
+
+
+uint64_t
+Heatmap::at(Type type, unsigned int col, unsigned int row) const
+{
+  if (this->cols_ <= col || this->rows_ <= row) {
+    return 0;
+  }
+  return this->counts_[this->cols_ * this->rows_ * static_cast<int>(type)
+                       + this->cols_ * row + col];
+}
+
+
+bool
+Heatmap::save(const std::string& path) const
+{
+  unsigned int cols = this->cols_;
+  unsigned int rows = this->rows_;
+  unsigned int plane = cols * rows;
+
+  if (this->counts_.empty()) {
+    return false;
+  }
+  if (4 <= path.size() && 0 == path.compare(path.size() - 4, 4, ".png")) {
+    // one tile per type, except Type::None
+    unsigned int tiles = TYPE_COUNT - 1;
+    unsigned int stride = cols * tiles;
+    auto pixels = std::vector<unsigned char>(stride * rows, 0);
+    for (unsigned int t = 0; t < tiles; ++t) {
+      const uint64_t* counts = this->counts_.data() + plane * (t + 1);
+      uint64_t max = *std::max_element(counts, counts + plane);
+      if (0 == max) {
+        continue;
+      }
+      double scale = 255.0 / std::log1p(static_cast<double>(max));
+      for (unsigned int r = 0; r < rows; ++r) {
+        for (unsigned int c = 0; c < cols; ++c) {
+          pixels[stride * r + cols * t + c] = static_cast<unsigned char>(
+            scale * std::log1p(static_cast<double>(counts[cols * r + c])));
+        }
+      }
+    }
+    stbi_flip_vertically_on_write(true); // rows go up, like the canvas
+    return 0 != stbi_write_png(path.c_str(), stride, rows, 1, pixels.data(),
+                               stride);
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  file.write("EMHM", 4);
+  Binary::put<uint32_t>(file, HEATMAP_VERSION);
+  Binary::put<uint32_t>(file, cols);
+  Binary::put<uint32_t>(file, rows);
+  Binary::put<float>(file, this->bin_);
+  Binary::put<uint32_t>(file, this->ticks_);
+  Binary::put<uint32_t>(file, TYPE_COUNT);
+  file.write(reinterpret_cast<const char*>(this->counts_.data()),
+             this->counts_.size() * sizeof(uint64_t));
+  return static_cast<bool>(file);
+}
+
+
+void
+Heatmap::checkpoint(std::ostream& stream) const
+{
+  Binary::put(stream, this->bin_);
+  Binary::put<uint32_t>(stream, this->ticks_);
+  Binary::put<uint32_t>(stream, this->cols_);
+  Binary::put<uint32_t>(stream, this->rows_);
+  Binary::put(stream, this->width_);
+  Binary::put(stream, this->height_);
+  Binary::put(stream, this->counts_);
+}
+
+
+bool
+Heatmap::restore(std::istream& stream)
+{
+  uint32_t ticks;
+  uint32_t cols;
+  uint32_t rows;
+  if (!Binary::get(stream, this->bin_) || !Binary::get(stream, ticks) ||
+      !Binary::get(stream, cols) || !Binary::get(stream, rows) ||
+      !Binary::get(stream, this->width_) || !Binary::get(stream, this->height_)
+      || !Binary::get(stream, this->counts_)) {
+    return false;
+  }
+  this->ticks_ = ticks;
+  this->cols_ = cols;
+  this->rows_ = rows;
+  return this->counts_.size() == TYPE_COUNT * cols * rows
+         || this->counts_.empty();
+}
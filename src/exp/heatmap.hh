@@ -0,0 +1,86 @@
+//===-- exp/heatmap.hh - Heatmap class declaration -------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Heatmap class, which accumulates a 2D histogram of
+/// particle positions per type, relative to an origin (eg. the placement of
+/// an injected sprite), over many time steps, to be written out once as a
+/// binary or PNG raster.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+enum class Type : uint8_t;
+class State;
+
+class Heatmap
+{
+ public:
+  /// constructor: Prepare an empty histogram.
+  /// \param bin  width and height of a histogram bin (in space units)
+  Heatmap(float bin = 1.0f);
+
+  /// reset(): Clear the histogram, and size it to cover a whole space
+  ///          centered on the origin.
+  /// \param width  space width
+  /// \param height  space height
+  void reset(unsigned int width, unsigned int height);
+
+  /// sample(): Count the positions of particles at the current time step.
+  ///           Offsets wrap around the edges of the space.
+  /// \param state  State object
+  /// \param particles  particle indices
+  /// \param x  origin x
+  /// \param y  origin y
+  void sample(const State& state, const std::vector<unsigned int>& particles,
+              float x, float y);
+
+  /// at(): Get the count of a bin.
+  /// \param type  particle type
+  /// \param col  bin column (the origin is at cols() / 2)
+  /// \param row  bin row (the origin is at rows() / 2)
+  /// \returns  number of particles counted in the bin
+  uint64_t at(Type type, unsigned int col, unsigned int row) const;
+
+  /// save(): Write the histogram to a file, as a PNG of one tile per type
+  ///         (in Type order, log-scaled per tile) if the path ends in .png,
+  ///         or else as raw counts.
+  /// \param path  path to the destination file
+  /// \returns  whether the write was successful
+  bool save(const std::string& path) const;
+
+  /// checkpoint(): Write the histogram so far.
+  /// \param stream  destination binary stream
+  void checkpoint(std::ostream& stream) const;
+
+  /// restore(): Replace the histogram with one written by checkpoint().
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
+  /* binary heat map format (native endianness)
+   *
+   * "EMHM" VERSION(u32) COLS(u32) ROWS(u32) BIN(f32) TICKS(u32) TYPES(u32)
+   * COUNT(u64) * COLS * ROWS * TYPES // per type, row by row
+   */
+
+  inline unsigned int cols() const { return this->cols_; }
+  inline unsigned int rows() const { return this->rows_; }
+
+  float        bin_;   // width and height of a bin
+  unsigned int ticks_; // number of time steps sampled
+
+ private:
+  std::vector<uint64_t> counts_; // per type, row, column
+  unsigned int          cols_;   // number of bin columns
+  unsigned int          rows_;   // number of bin rows
+  float                 width_;  // space width
+  float                 height_; // space height
+};
@@ -0,0 +1,57 @@
+#include "heatmap.hh"
+#include "../state/state.hh"
+#include <fstream>
+#include <stdio.h>
+
+
+#define TESTHEATMAP "testemergence.heatmap"
+#define TESTHEATMAPPNG "testemergence.heatmap.png"
+
+
+TEST_CASE("Heatmap::sample")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto heatmap = Heatmap(2.0f);
+  float w = static_cast<float>(state.width_);
+  float h = static_cast<float>(state.height_);
+  auto particles = std::vector<unsigned int>{0, 1, 2};
+
+  state.num_ = 3;
+  state.px_[0] = 10.5f; state.py_[0] = 10.5f; state.pt_[0] = Type::CellCore;
+  state.px_[1] = 13.0f; state.py_[1] = 10.5f; state.pt_[1] = Type::CellHull;
+  state.px_[2] = 8.5f;  state.py_[2] = h - 1.0f; // across the edge
+  state.pt_[2] = Type::CellHull;
+  heatmap.sample(state, particles, 10.0f, 10.0f);
+  heatmap.sample(state, particles, 10.0f, 10.0f);
+  unsigned int cols = heatmap.cols();
+  unsigned int rows = heatmap.rows();
+  REQUIRE(static_cast<unsigned int>(std::ceil(w / 2.0f)) == cols);
+  REQUIRE(static_cast<unsigned int>(std::ceil(h / 2.0f)) == rows);
+  REQUIRE(2 == heatmap.ticks_);
+  REQUIRE(2 == heatmap.at(Type::CellCore, cols / 2, rows / 2));
+  REQUIRE(2 == heatmap.at(Type::CellHull, cols / 2 + 1, rows / 2));
+  REQUIRE(2 == heatmap.at(Type::CellHull, cols / 2 - 1, rows / 2 - 6));
+  REQUIRE(0 == heatmap.at(Type::CellCore, cols / 2 + 1, rows / 2));
+  REQUIRE(0 == heatmap.at(Type::CellCore, cols, rows));
+
+  REQUIRE(heatmap.save(TESTHEATMAP));
+  std::ifstream file(TESTHEATMAP, std::ios::binary);
+  char magic[4];
+  uint32_t header[3];
+  float bin;
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  file.read(reinterpret_cast<char*>(&bin), sizeof(float));
+  REQUIRE("EMHM" == std::string(magic, 4));
+  REQUIRE(cols == header[1]);
+  REQUIRE(rows == header[2]);
+  REQUIRE(2.0f == bin);
+  file.seekg(0, std::ios::end);
+  REQUIRE(28 + 8 * 11 * cols * rows == file.tellg());
+  remove(TESTHEATMAP);
+
+  REQUIRE(heatmap.save(TESTHEATMAPPNG));
+  remove(TESTHEATMAPPNG);
+}
@@ -0,0 +1,409 @@
+#include "history.hh"
+#include "../state/state.hh"
+#include "../util/binary.hh"
+#include <algorithm>
+#include <stdio.h> // remove
+#include <unistd.h> // truncate
+
+
+// runs are 32 bits: 24 bits of tick (relative to a base) and 8 bits of type
+#define RUN_TICK_MAX 0xffffff
+#define RUN_NONE 0xff
+#define RUN_GONE 0xffffffff // particle slot of a chunk, if not in the chunk
+
+
+TypeHistory::TypeHistory(Log& log, const std::string& path,
+                         std::size_t budget /* = 64 MiB */)
+  : log_(log), path_(path), budget_(budget)
+{
+  this->bytes_ = 0;
+  this->base_ = 0;
+  this->kept_ = false;
+  this->stuck_ = false;
+  this->full_ = false;
+}
+
+
+TypeHistory::~TypeHistory()
+{
+  this->clear();
+}
+
+
+void
+TypeHistory::record(unsigned long tick, const Type* pt,
+                    unsigned int num)
+{
+  std::vector<uint8_t>& last = this->last_;
+  std::vector<std::vector<uint32_t>>& runs = this->runs_;
+
+  if (last.size() < num) {
+    last.resize(num, RUN_NONE);
+    runs.resize(num);
+  }
+  if (0 < this->bytes_ && !this->stuck_ &&
+      (this->budget_ < this->bytes_ || RUN_TICK_MAX < tick - this->base_)) {
+    this->spill();
+  }
+  if (0 < this->bytes_ && RUN_TICK_MAX < tick - this->base_) {
+    // (only when stuck) later ticks would not fit in the runs
+    if (!this->full_) {
+      this->full_ = true;
+      this->log_.add(Attn::E, "Type history stopped recording at tick "
+                     + std::to_string(tick) + ", as it could not spill.");
+    }
+    return;
+  }
+  if (0 == this->bytes_) {
+    this->base_ = tick;
+  }
+
+  uint32_t rel = static_cast<uint32_t>(tick - this->base_) << 8;
+  uint8_t type;
+  for (unsigned int p = 0; p < num; ++p) {
+    type = static_cast<uint8_t>(pt[p]);
+    if (type == last[p]) {
+      continue;
+    }
+    last[p] = type;
+    runs[p].push_back(rel | type);
+    this->bytes_ += sizeof(uint32_t);
+  }
+}
+
+
+Type
+TypeHistory::at(unsigned int p, unsigned long tick)
+{
+  Type type = Type::None;
+
+  if (p >= this->last_.size()) {
+    return type;
+  }
+  if (TypeHistory::find(this->runs_[p], this->base_, tick, type)) {
+    return type;
+  }
+  std::vector<uint32_t> runs;
+  unsigned int q;
+  for (auto chunk = this->chunks_.rbegin(); chunk != this->chunks_.rend();
+       ++chunk) {
+    if (chunk->base > tick || !TypeHistory::slot(*chunk, p, q)) {
+      continue;
+    }
+    if (!this->read(*chunk, q, runs)) {
+      break;
+    }
+    if (TypeHistory::find(runs, chunk->base, tick, type)) {
+      return type;
+    }
+  }
+
+  return Type::None;
+}
+
+
+void
+TypeHistory::out(std::ostream& stream)
+{
+  unsigned int num = this->last_.size();
+  std::vector<uint32_t> runs;
+  unsigned int q;
+  auto letters = [&stream](const std::vector<uint32_t>& runs) {
+    Type type;
+    char t;
+    for (uint32_t run : runs) {
+      type = static_cast<Type>(run & 0xff);
+      t = 'g';
+      if      (Type::MatureSpore    == type) { t = 'm'; }
+      else if (Type::CellHull       == type) { t = 'b'; }
+      else if (Type::CellCore       == type) { t = 'y'; }
+      else if (Type::PrematureSpore == type) { t = 'w'; }
+      stream << " " << t;
+    }
+  };
+
+  for (unsigned int p = 0; p < num; ++p) {
+    stream << p;
+    for (const Chunk& chunk : this->chunks_) {
+      if (TypeHistory::slot(chunk, p, q) && this->read(chunk, q, runs)) {
+        letters(runs);
+      }
+    }
+    letters(this->runs_[p]);
+    if (p != num - 1) {
+      stream << ",";
+    }
+  }
+}
+
+
+bool
+TypeHistory::checkpoint(std::ostream& stream)
+{
+  std::fstream& file = this->file_;
+  uint64_t length = 0;
+
+  // spilled chunks stay in the spill file, of which only the length is kept
+  if (file.is_open()) {
+    file.seekp(0, std::ios::end);
+    length = file.tellp();
+    file.flush();
+    if (!file) {
+      file.clear();
+      return false;
+    }
+    this->kept_ = true;
+  }
+  Binary::put<uint64_t>(stream, this->base_);
+  Binary::put<uint64_t>(stream, this->bytes_);
+  Binary::put(stream, this->last_);
+  for (const std::vector<uint32_t>& runs : this->runs_) {
+    Binary::put(stream, runs);
+  }
+  Binary::put<uint64_t>(stream, this->chunks_.size());
+  for (const Chunk& chunk : this->chunks_) {
+    Binary::put<int64_t>(stream, chunk.offset);
+    Binary::put<uint32_t>(stream, chunk.num);
+    Binary::put<uint64_t>(stream, chunk.base);
+    Binary::put(stream, chunk.slots);
+  }
+  Binary::put(stream, this->path_);
+  Binary::put<uint64_t>(stream, length);
+  return static_cast<bool>(stream);
+}
+
+
+bool
+TypeHistory::restore(std::istream& stream)
+{
+  uint64_t base;
+  uint64_t bytes;
+  uint64_t count;
+  int64_t offset;
+  std::string path;
+  uint64_t length;
+
+  this->clear();
+  if (!Binary::get(stream, base) || !Binary::get(stream, bytes) ||
+      !Binary::get(stream, this->last_)) {
+    return false;
+  }
+  this->base_ = base;
+  this->bytes_ = bytes;
+  this->runs_.resize(this->last_.size());
+  for (std::vector<uint32_t>& runs : this->runs_) {
+    if (!Binary::get(stream, runs)) {
+      return false;
+    }
+  }
+  if (!Binary::get(stream, count)) {
+    return false;
+  }
+  this->chunks_.resize(count);
+  for (Chunk& chunk : this->chunks_) {
+    if (!Binary::get(stream, offset) || !Binary::get(stream, chunk.num) ||
+        !Binary::get(stream, base) || !Binary::get(stream, chunk.slots)) {
+      return false;
+    }
+    chunk.offset = offset;
+    chunk.base = base;
+  }
+  if (!Binary::get(stream, path) || !Binary::get(stream, length)) {
+    return false;
+  }
+  if (0 == length) {
+    return true;
+  }
+
+  // continue the spill file of the checkpointed run, dropping what was
+  // spilled after the checkpoint
+  std::fstream& file = this->file_;
+  file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekg(0, std::ios::end);
+  if (!file || static_cast<uint64_t>(file.tellg()) < length ||
+      0 != truncate(path.c_str(), length)) {
+    file.close();
+    this->log_.add(Attn::E, "Type history spill file '" + path
+                   + "' is missing or shorter than its checkpoint.");
+    return false;
+  }
+  this->path_ = path;
+  this->kept_ = true;
+  return true;
+}
+
+
+void
+TypeHistory::remap(const std::vector<int>& remap)
+{
+  unsigned int num = this->last_.size();
+  unsigned int kept = 0;
+  unsigned int q;
+
+  for (Chunk& chunk : this->chunks_) {
+    if (chunk.slots.empty()) {
+      chunk.slots.resize(num);
+      for (unsigned int i = 0; i < num; ++i) {
+        chunk.slots[i] = i < chunk.num ? i : RUN_GONE;
+      }
+    }
+  }
+  // kept particles keep their order, so they move down in place
+  for (unsigned int p = 0; p < num; ++p) {
+    if (p >= remap.size() || 0 > remap[p]) {
+      this->bytes_ -= this->runs_[p].size() * sizeof(uint32_t);
+      continue;
+    }
+    this->last_[kept] = this->last_[p];
+    this->runs_[kept].swap(this->runs_[p]);
+    for (Chunk& chunk : this->chunks_) {
+      chunk.slots[kept] = TypeHistory::slot(chunk, p, q) ? q : RUN_GONE;
+    }
+    ++kept;
+  }
+  this->last_.resize(kept);
+  this->runs_.resize(kept);
+  if (0 == kept) {
+    this->chunks_.clear(); // (an empty slots would mean every particle)
+  }
+  for (Chunk& chunk : this->chunks_) {
+    chunk.slots.resize(kept);
+  }
+}
+
+
+void
+TypeHistory::clear()
+{
+  this->last_.clear();
+  this->runs_.clear();
+  this->bytes_ = 0;
+  this->base_ = 0;
+  this->stuck_ = false;
+  this->full_ = false;
+  if (this->file_.is_open()) {
+    this->file_.close();
+    if (!this->kept_) {
+      remove(this->path_.c_str());
+    }
+  }
+  this->chunks_.clear();
+}
+
+
+void
+TypeHistory::spill()
+{
+  std::fstream& file = this->file_;
+  std::vector<std::vector<uint32_t>>& runs = this->runs_;
+
+  if (!file.is_open()) {
+    file.open(this->path_, std::ios::in | std::ios::out | std::ios::binary
+                           | std::ios::trunc);
+    if (!file) {
+      this->log_.add(Attn::E, "Could not open type history spill file '"
+                     + this->path_ + "'.");
+      // keep growing in memory rather than losing history
+      this->stuck_ = true;
+      return;
+    }
+  }
+
+  Chunk chunk = {0, static_cast<unsigned int>(runs.size()), this->base_};
+  uint32_t num = chunk.num;
+  uint64_t base = chunk.base;
+  uint32_t count;
+  file.seekp(0, std::ios::end);
+  chunk.offset = file.tellp();
+  file.write(reinterpret_cast<const char*>(&num), sizeof(num));
+  file.write(reinterpret_cast<const char*>(&base), sizeof(base));
+  for (std::vector<uint32_t>& r : runs) {
+    count = r.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  }
+  for (std::vector<uint32_t>& r : runs) {
+    file.write(reinterpret_cast<const char*>(r.data()),
+               r.size() * sizeof(uint32_t));
+  }
+  file.flush();
+  if (!file) {
+    file.clear(); // for reading the chunks spilled before
+    this->log_.add(Attn::E, "Could not write to type history spill file '"
+                   + this->path_ + "'.");
+    // keep growing in memory rather than losing history
+    this->stuck_ = true;
+    return;
+  }
+  for (std::vector<uint32_t>& r : runs) {
+    r.clear();
+    r.shrink_to_fit();
+  }
+  this->chunks_.push_back(chunk);
+  this->bytes_ = 0;
+}
+
+
+bool
+TypeHistory::slot(const Chunk& chunk, unsigned int p, unsigned int& q)
+{
+  if (chunk.slots.empty()) {
+    q = p;
+  } else if (p < chunk.slots.size()) {
+    q = chunk.slots[p];
+  } else {
+    q = RUN_GONE;
+  }
+  return q < chunk.num;
+}
+
+
+bool
+TypeHistory::read(const Chunk& chunk, unsigned int p,
+                  std::vector<uint32_t>& runs)
+{
+  std::fstream& file = this->file_;
+  std::vector<uint32_t> counts(p + 1);
+  std::streamoff head = sizeof(uint32_t) + sizeof(uint64_t);
+  std::streamoff skip = 0;
+
+  file.seekg(chunk.offset + head);
+  file.read(reinterpret_cast<char*>(counts.data()),
+            counts.size() * sizeof(uint32_t));
+  for (unsigned int i = 0; i < p; ++i) {
+    skip += counts[i];
+  }
+  runs.resize(counts[p]);
+  file.seekg(chunk.offset + head + chunk.num * sizeof(uint32_t)
+             + skip * sizeof(uint32_t));
+  file.read(reinterpret_cast<char*>(runs.data()),
+            runs.size() * sizeof(uint32_t));
+  if (!file) {
+    file.clear();
+    this->log_.add(Attn::E, "Could not read from type history spill file '"
+                   + this->path_ + "'.");
+    return false;
+  }
+  return true;
+}
+
+
+bool
+TypeHistory::find(const std::vector<uint32_t>& runs, unsigned long base,
+                  unsigned long tick, Type& type)
+{
+  if (runs.empty() || tick < base) {
+    return false;
+  }
+  unsigned long rel = tick - base;
+  if (RUN_TICK_MAX < rel) {
+    rel = RUN_TICK_MAX;
+  }
+  // runs are ordered by tick, so find the first run after tick
+  auto after = std::upper_bound(runs.begin(), runs.end(),
+                                static_cast<uint32_t>(rel << 8 | 0xff));
+  if (after == runs.begin()) {
+    return false;
+  }
+  type = static_cast<Type>(*(after - 1) & 0xff);
+  return true;
+}
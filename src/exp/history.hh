@@ -0,0 +1,149 @@
+//===-- exp/history.hh - TypeHistory class declaration ---------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the TypeHistory class, which is a compact, append-only
+/// record of particle type changes over time, used by Exp for long runs.
+/// Type changes are run-length encoded per particle with tick stamps, and are
+/// spilled in chunks to a binary file once a memory budget is exceeded.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "../util/log.hh"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+enum class Type : uint8_t;
+
+class TypeHistory
+{
+ public:
+  /// constructor: Prepare an empty history.
+  /// \param log  Log object
+  /// \param path  path to the spill file (only created if budget is exceeded)
+  /// \param budget  number of bytes of runs kept in memory before spilling
+  TypeHistory(Log& log, const std::string& path,
+              std::size_t budget = 64 * 1024 * 1024);
+
+  /// move constructor: (for owners constructed by copy initialisation)
+  TypeHistory(TypeHistory&& other) = default;
+
+  /// destructor: Close and remove the spill file (unless a checkpoint refers
+  ///             to it).
+  ~TypeHistory();
+
+  /// record(): Append the types of particles that changed since last record.
+  ///           If spilling failed, nothing is recorded once the in-memory
+  ///           runs span more ticks than a run can stamp (2^24).
+  /// \param tick  current time step
+  /// \param pt  particle types (num of them)
+  /// \param num  number of particles
+  void record(unsigned long tick, const Type* pt,
+              unsigned int num);
+
+  /// at(): Get the type of a particle at a given time step.
+  /// \param p  particle index
+  /// \param tick  time step
+  /// \returns  particle type, or Type::None if nothing was recorded by then
+  Type at(unsigned int p, unsigned long tick);
+
+  /// out(): Export the whole history in the text format of experiment 2,
+  ///        ie. "0 g m g,1 g,..." (index followed by type letters).
+  /// \param stream  destination stream
+  void out(std::ostream& stream);
+
+  /// checkpoint(): Write the in-memory history, and the path and length of
+  ///               the spill file (which is then left on disk).
+  /// \param stream  destination binary stream
+  /// \returns  whether writing was successful
+  bool checkpoint(std::ostream& stream);
+
+  /// restore(): Replace the history with one written by checkpoint(),
+  ///            truncating the spill file to its checkpointed length.
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
+  /// remap(): Follow the removal of particles (see State::remove()),
+  ///          dropping the history of removed particles and moving the rest
+  ///          to their new indices.
+  /// \param remap  new index per old index (-1 if removed)
+  void remap(const std::vector<int>& remap);
+
+  /// clear(): Forget the whole history and remove the spill file (unless a
+  ///          checkpoint refers to it).
+  void clear();
+
+  /// size(): Get the number of particles having a history.
+  /// \returns  number of particles
+  inline unsigned int
+  size() const
+  {
+    return this->last_.size();
+  }
+
+ private:
+  // Chunk: Location and time span of a spilled chunk.
+  struct Chunk
+  {
+    std::streamoff        offset; // start of chunk in spill file
+    unsigned int          num;    // number of particles in chunk
+    unsigned long         base;   // tick to which run ticks are relative
+    std::vector<uint32_t> slots;  // index in chunk per particle, once any
+                                  // were removed (RUN_GONE if not in chunk)
+  };
+
+  /* spill file format (native endianness)
+   *
+   * - Sequence of chunks, each being:
+   *
+   * NUM(u32) BASE(u64) COUNT0(u32) ... COUNT{NUM-1}(u32)
+   * RUNS0(u32 * COUNT0) ... RUNS{NUM-1}(u32 * COUNT{NUM-1})
+   *
+   * - where a run is (tick - BASE) << 8 | type.
+   */
+
+  /// spill(): Write in-memory runs as one chunk to the spill file, or keep
+  ///          them in memory (for good) if that fails.
+  void spill();
+
+  /// slot(): Find the index of a particle in a spilled chunk.
+  /// \param chunk  spilled chunk
+  /// \param p  particle index
+  /// \param q  destination of index in chunk
+  /// \returns  whether the particle is in the chunk
+  static bool slot(const Chunk& chunk, unsigned int p, unsigned int& q);
+
+  /// read(): Read the runs of a particle from a spilled chunk.
+  /// \param chunk  spilled chunk
+  /// \param p  particle index in chunk
+  /// \param runs  destination of runs
+  /// \returns  whether reading was successful
+  bool read(const Chunk& chunk, unsigned int p, std::vector<uint32_t>& runs);
+
+  /// find(): Find the type of the latest run at or before a time step.
+  /// \param runs  runs of a particle
+  /// \param base  tick to which run ticks are relative
+  /// \param tick  time step
+  /// \param type  destination of type
+  /// \returns  whether such a run exists
+  static bool find(const std::vector<uint32_t>& runs, unsigned long base,
+                   unsigned long tick, Type& type);
+
+  Log&                               log_;
+  std::string                        path_;   // spill file path
+  std::size_t                        budget_; // in-memory bytes allowed
+  std::size_t                        bytes_;  // in-memory bytes used
+  unsigned long                      base_;   // tick of in-memory runs
+  std::vector<uint8_t>               last_;   // last recorded type (8-bit)
+  std::vector<std::vector<uint32_t>> runs_;   // in-memory runs per particle
+  std::vector<Chunk>                 chunks_; // spilled chunks
+  std::fstream                       file_;   // spill file
+  bool                               kept_;   // whether checkpoints need it
+  bool                               stuck_;  // whether spilling failed
+  bool                               full_;   // whether recording stopped
+};
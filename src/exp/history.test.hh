@@ -0,0 +1,154 @@
+#include "history.hh"
+#include "../state/state.hh"
+#include <sstream>
+
+
+#define TESTHISTORY "testemergence.types"
+
+
+TEST_CASE("TypeHistory::record")
+{
+  auto log = Log(1, QUIET);
+  auto history = TypeHistory(log, TESTHISTORY);
+  std::vector<Type> pt = {Type::Nutrient, Type::MatureSpore};
+
+  history.record(0, pt.data(), 2);
+  pt[0] = Type::CellHull;
+  history.record(100, pt.data(), 2);
+  history.record(200, pt.data(), 2);
+  REQUIRE(2 == history.size());
+  REQUIRE(Type::Nutrient == history.at(0, 0));
+  REQUIRE(Type::Nutrient == history.at(0, 99));
+  REQUIRE(Type::CellHull == history.at(0, 100));
+  REQUIRE(Type::CellHull == history.at(0, 250));
+  REQUIRE(Type::MatureSpore == history.at(1, 200));
+  REQUIRE(Type::None == history.at(2, 200));
+
+  std::ostringstream out;
+  history.out(out);
+  REQUIRE("0 g b,1 m" == out.str());
+}
+
+TEST_CASE("TypeHistory::spill")
+{
+  auto log = Log(1, QUIET);
+  auto history = TypeHistory(log, TESTHISTORY, 16); // spill every few runs
+  std::vector<Type> pt = {Type::Nutrient, Type::Nutrient, Type::Nutrient};
+  Type cycle[] = {Type::Nutrient, Type::PrematureSpore, Type::MatureSpore};
+
+  for (unsigned int tick = 0; tick < 30; ++tick) {
+    pt[tick % 3] = cycle[tick % 3];
+    pt[(tick + 1) % 3] = cycle[(tick + 2) % 3];
+    history.record(tick, pt.data(), 3);
+  }
+  std::vector<Type> now = pt;
+  for (unsigned int tick = 0; tick < 30; ++tick) {
+    // replay to compare against the reader
+    pt = {Type::Nutrient, Type::Nutrient, Type::Nutrient};
+    for (unsigned int t = 0; t <= tick; ++t) {
+      pt[t % 3] = cycle[t % 3];
+      pt[(t + 1) % 3] = cycle[(t + 2) % 3];
+    }
+    for (unsigned int p = 0; p < 3; ++p) {
+      REQUIRE(pt[p] == history.at(p, tick));
+    }
+  }
+  REQUIRE(now[0] == history.at(0, 1000));
+
+  std::ifstream spilled(TESTHISTORY);
+  REQUIRE(spilled.good());
+  spilled.close();
+  history.clear();
+  spilled.open(TESTHISTORY);
+  REQUIRE(!spilled.good());
+}
+
+TEST_CASE("TypeHistory::spill, failing")
+{
+  auto log = Log(1, QUIET);
+  auto history = TypeHistory(log, "testemergence/none/types", 4);
+  std::vector<Type> pt = {Type::Nutrient};
+
+  // runs stay in memory, and are not stamped past 24 bits of ticks
+  history.record(0, pt.data(), 1);
+  pt[0] = Type::CellHull;
+  history.record(1, pt.data(), 1);
+  pt[0] = Type::CellCore;
+  history.record(2, pt.data(), 1);
+  pt[0] = Type::MatureSpore;
+  history.record(0x1000000 + 2, pt.data(), 1);
+  REQUIRE(Type::Nutrient == history.at(0, 0));
+  REQUIRE(Type::CellHull == history.at(0, 1));
+  REQUIRE(Type::CellCore == history.at(0, 2));
+  REQUIRE(Type::CellCore == history.at(0, 0x1000000 + 2));
+}
+
+TEST_CASE("TypeHistory::remap")
+{
+  auto log = Log(1, QUIET);
+  auto history = TypeHistory(log, TESTHISTORY, 8); // spill every few runs
+  std::vector<Type> pt = {Type::Nutrient, Type::CellHull, Type::CellCore};
+  Type cycle[] = {Type::Nutrient, Type::CellHull, Type::MatureSpore};
+
+  // particle p cycles from cycle[p], so that each has its own history
+  for (unsigned int tick = 0; tick < 20; ++tick) {
+    for (unsigned int p = 0; p < 3; ++p) {
+      pt[p] = cycle[(tick + p) % 3];
+    }
+    history.record(tick, pt.data(), 3);
+  }
+  history.remap({0, -1, 1}); // particle 1 is removed
+  REQUIRE(2 == history.size());
+  for (unsigned int tick = 0; tick < 20; ++tick) {
+    REQUIRE(cycle[tick % 3] == history.at(0, tick));
+    REQUIRE(cycle[(tick + 2) % 3] == history.at(1, tick));
+  }
+  std::ostringstream out;
+  history.out(out);
+  REQUIRE(std::string::npos == out.str().find(",2"));
+
+  pt = {Type::CellCore, Type::CellCore, Type::MatureSpore}; // one appended
+  history.record(20, pt.data(), 3);
+  REQUIRE(Type::CellCore == history.at(1, 20));
+  REQUIRE(cycle[(19 + 2) % 3] == history.at(1, 19));
+  REQUIRE(Type::MatureSpore == history.at(2, 20));
+  REQUIRE(Type::None == history.at(2, 19));
+  history.clear();
+}
+
+TEST_CASE("TypeHistory::checkpoint")
+{
+  auto log = Log(1, QUIET);
+  auto history = TypeHistory(log, TESTHISTORY, 8); // spill every few runs
+  std::vector<Type> pt = {Type::Nutrient, Type::CellCore};
+  Type cycle[] = {Type::Nutrient, Type::CellHull, Type::MatureSpore};
+
+  for (unsigned int tick = 0; tick < 20; ++tick) {
+    pt[0] = cycle[tick % 3];
+    history.record(tick, pt.data(), 2);
+  }
+  std::stringstream checkpoint;
+  REQUIRE(history.checkpoint(checkpoint));
+  std::ostringstream before;
+  history.out(before);
+  // spilled after the checkpoint, so dropped on restore
+  for (unsigned int tick = 20; tick < 40; ++tick) {
+    pt[0] = cycle[tick % 3];
+    history.record(tick, pt.data(), 2);
+  }
+  history.clear();
+  std::ifstream spilled(TESTHISTORY); // left on disk for the checkpoint
+  REQUIRE(spilled.good());
+  spilled.close();
+
+  auto restored = TypeHistory(log, TESTHISTORY, 8);
+  REQUIRE(restored.restore(checkpoint));
+  std::ostringstream after;
+  restored.out(after);
+  REQUIRE(before.str() == after.str());
+  REQUIRE(Type::CellHull == restored.at(0, 13));
+  REQUIRE(Type::CellCore == restored.at(1, 0));
+  REQUIRE(Type::CellHull == restored.at(0, 30)); // as of tick 19
+  restored.clear();
+  remove(TESTHISTORY);
+}
@@ -0,0 +1,603 @@
+#include "metrics.hh"
+#include "../util/binary.hh"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+
+#define METRICS_VERSION 1
+#define METRICS_INTERVAL 500 // milliseconds between writes of partial batches
+
+
+namespace
+{
+
+/// sizes(): Write size and count pairs as ", size count" (legacy).
+inline void
+sizes(std::ostream& out, const std::vector<long long>& sizes,
+      const std::vector<long long>& counts)
+{
+  for (std::size_t i = 0; i < sizes.size() && i < counts.size(); ++i) {
+    out << (0 < i ? "," : "") << " " << sizes[i] << " " << counts[i];
+  }
+}
+
+/// quote(): Escape text for JSON.
+inline void
+quote(std::ostream& out, const std::string& text)
+{
+  out << '"';
+  for (char c : text) {
+    if      ('"'  == c) { out << "\\\""; }
+    else if ('\\' == c) { out << "\\\\"; }
+    else if ('\n' == c) { out << "\\n"; }
+    else if ('\t' == c) { out << "\\t"; }
+    else if (0x20 > static_cast<unsigned char>(c)) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec << std::setfill(' ');
+    }
+    else { out << c; }
+  }
+  out << '"';
+}
+
+/// number(): Write a real for CSV or JSON (null when not finite).
+inline void
+number(std::ostream& out, double value, const char* none)
+{
+  if (std::isfinite(value)) {
+    out << value;
+  } else {
+    out << none;
+  }
+}
+
+} // namespace
+
+
+Record::Record(unsigned long tick, int experiment, const std::string& name)
+  : tick_(tick), experiment_(experiment), name_(name)
+{}
+
+
+Record&
+Record::integer(const std::string& name, long long value)
+{
+  Field field = {name, Kind::Integer};
+  field.integer = value;
+  this->fields_.push_back(std::move(field));
+  return *this;
+}
+
+
+Record&
+Record::real(const std::string& name, double value)
+{
+  Field field = {name, Kind::Real};
+  field.real = value;
+  this->fields_.push_back(std::move(field));
+  return *this;
+}
+
+
+Record&
+Record::text(const std::string& name, const std::string& value)
+{
+  Field field = {name, Kind::Text};
+  field.text = value;
+  this->fields_.push_back(std::move(field));
+  return *this;
+}
+
+
+Record&
+Record::integers(const std::string& name, std::vector<long long> values)
+{
+  Field field = {name, Kind::Integers};
+  field.integers = std::move(values);
+  this->fields_.push_back(std::move(field));
+  return *this;
+}
+
+
+Record&
+Record::reals(const std::string& name, std::vector<double> values)
+{
+  Field field = {name, Kind::Reals};
+  field.reals = std::move(values);
+  this->fields_.push_back(std::move(field));
+  return *this;
+}
+
+
+const Record::Field&
+Record::get(const std::string& name) const
+{
+  static const Field none = {"", Kind::Integer, 0, 0.0};
+  for (const Field& field : this->fields_) {
+    if (name == field.name) {
+      return field;
+    }
+  }
+  return none;
+}
+
+
+Metrics::Metrics(Log& log, std::ostream& stream,
+                 Encoding encoding /* = Encoding::Legacy */)
+  : log_(log), stream_(&stream), encoding_(encoding), batch_(1),
+    threaded_(false)
+{
+  this->start();
+}
+
+
+Metrics::Metrics(Log& log, const std::string& path,
+                 unsigned int batch /* = 64 */)
+  : log_(log), encoding_(Metrics::encoding_of(path)), batch_(batch),
+    threaded_(true)
+{
+  std::ios::openmode mode = std::ios::out | std::ios::trunc;
+  if (Encoding::Columnar == this->encoding_) {
+    mode |= std::ios::binary;
+  }
+  this->file_.open(path, mode);
+  if (this->file_) {
+    this->stream_ = &this->file_;
+    log.add(Attn::O, "Writing experiment metrics to '" + path + "'.");
+  } else {
+    log.add(Attn::E, "Could not open metrics file '" + path + "'.");
+    this->stream_ = &std::cout;
+    this->encoding_ = Encoding::Legacy;
+    this->threaded_ = false;
+  }
+  this->start();
+}
+
+
+Metrics::~Metrics()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->done_ = true;
+  }
+  this->cond_.notify_all();
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+  if (this->file_.is_open()) {
+    this->file_.close();
+  }
+}
+
+
+void
+Metrics::start()
+{
+  this->added_ = 0;
+  this->written_ = 0;
+  this->wanted_ = 0;
+  this->done_ = false;
+  if (Encoding::Columnar == this->encoding_) {
+    uint32_t version = METRICS_VERSION;
+    this->stream_->write("EMCM", 4);
+    Binary::put(*this->stream_, version);
+  }
+  if (this->threaded_) {
+    this->thread_ = std::thread(&Metrics::work, this);
+  }
+}
+
+
+void
+Metrics::add(Record&& record)
+{
+  bool full;
+  if (!this->threaded_) {
+    // in order with whatever else the adding thread prints
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->pending_.push_back(std::move(record));
+    this->write(this->pending_);
+    this->pending_.clear();
+    ++this->added_;
+    ++this->written_;
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->pending_.push_back(std::move(record));
+    ++this->added_;
+    full = this->batch_ <= this->pending_.size();
+  }
+  if (full) {
+    this->cond_.notify_all();
+  }
+}
+
+
+void
+Metrics::flush()
+{
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  unsigned long wanted = this->added_;
+  this->wanted_ = wanted;
+  this->cond_.notify_all();
+  this->cond_.wait(lock, [this, wanted] { return this->written_ >= wanted; });
+}
+
+
+Encoding
+Metrics::encoding_of(const std::string& path)
+{
+  auto ends = [&path](const std::string& extension) {
+    return path.size() >= extension.size()
+           && 0 == path.compare(path.size() - extension.size(),
+                                extension.size(), extension);
+  };
+  if (ends(".csv"))   { return Encoding::Csv; }
+  if (ends(".jsonl")) { return Encoding::Jsonl; }
+  if (ends(".col"))   { return Encoding::Columnar; }
+  return Encoding::Legacy;
+}
+
+
+void
+Metrics::work()
+{
+  std::vector<Record> batch;
+  bool done = false;
+
+  while (!done) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      // wake up for a full batch, a flush, the end, or after a while anyway
+      this->cond_.wait_for(
+        lock, std::chrono::milliseconds(METRICS_INTERVAL), [this] {
+          return this->done_ || this->batch_ <= this->pending_.size()
+                 || this->written_ < this->wanted_;
+        });
+      done = this->done_;
+      batch.swap(this->pending_);
+    }
+    if (!batch.empty()) {
+      this->write(batch);
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->written_ += batch.size();
+    }
+    this->cond_.notify_all(); // flush() may be waiting
+    batch.clear();
+  }
+}
+
+
+void
+Metrics::write(const std::vector<Record>& batch)
+{
+  std::ostream& out = *this->stream_;
+  std::size_t begin = 0;
+
+  switch (this->encoding_) {
+  case Encoding::Legacy:
+    for (const Record& record : batch) { this->legacy(record, out); }
+    break;
+  case Encoding::Csv:
+    for (const Record& record : batch) { this->csv(record, out); }
+    break;
+  case Encoding::Jsonl:
+    for (const Record& record : batch) { this->jsonl(record, out); }
+    break;
+  case Encoding::Columnar:
+    // a block holds consecutive records of the same layout
+    for (std::size_t end = 1; end <= batch.size(); ++end) {
+      if (end < batch.size()) {
+        const Record& first = batch[begin];
+        const Record& next = batch[end];
+        bool same = first.name_ == next.name_
+                    && first.fields_.size() == next.fields_.size();
+        for (std::size_t f = 0; same && f < first.fields_.size(); ++f) {
+          same = first.fields_[f].name == next.fields_[f].name
+                 && first.fields_[f].kind == next.fields_[f].kind;
+        }
+        if (same) {
+          continue;
+        }
+      }
+      this->columnar(batch, begin, end, out);
+      begin = end;
+    }
+    break;
+  }
+  out.flush();
+  if (!out) {
+    this->log_.add(Attn::E, "Could not write experiment metrics.");
+  }
+}
+
+
+void
+Metrics::legacy(const Record& record, std::ostream& stream)
+{
+  // formatted separately so that stream flags do not leak between records
+  std::ostringstream out;
+  const std::string& name = record.name_;
+  unsigned long tick = record.tick_;
+  auto i = [&record](const char* name) { return record.get(name).integer; };
+  auto r = [&record](const char* name) { return record.get(name).real; };
+  auto t = [&record](const char* name) { return record.get(name).text; };
+  auto dbscan = [&](int precision) {
+    out << std::fixed << std::setprecision(precision)
+        << i("mature_spores") << " mature_spores, "
+        << i("cell_hulls")    << " cell_hulls, "
+        << i("cell_cores")    << " cell_cores "
+        << "(dbscan " << r("radius") << "," << i("minpts") << ": "
+        << i("clusters")      << " clusters, "
+        << i("cells")         << " cells, "
+        << i("spores")        << " spores, "
+        << i("cores")         << " cores, "
+        << i("vagues")        << " vagues, "
+        << i("noise")         << " noise)"
+        << "\n";
+  };
+
+  if ("meta" == name) {
+    out << tick << ": "
+        << i("mature_spores") << " magenta(mature_spore), "
+        << i("cell_hulls")    << " blue(cell_hull), "
+        << i("cell_cores")    << " yellow(cell_core), "
+        << i("clusters")      << " clusters, "
+        << i("cells")         << " cells, "
+        << i("spores")        << " spores"
+        << "\n";
+  } else if ("occupancy" == name) {
+    out << tick << ":";
+    for (double dist : record.get("nn_dists").reals) {
+      out << " " << static_cast<float>(dist);
+    }
+    out << "\n";
+  } else if ("population" == name) {
+    out << tick << ": ";
+    dbscan(2);
+  } else if ("types" == name) {
+    out << "types: " << t("types") << "\n";
+  } else if ("heatmap" == name) {
+    out << tick << ": heat map of " << i("ticks") << " ticks, " << i("cols")
+        << "x" << i("rows") << " bins of " << r("bin") << ": " << t("path")
+        << "\n";
+  } else if ("survival" == name) {
+    out << std::fixed << std::setprecision(3) << " " << r("dpe") << " "
+        << i("est_done") << " " << t("est_how") << " est "
+        << i("dbscan_done") << " " << t("dbscan_how") << " dbscan";
+  } else if ("survival_clusters" == name) {
+    out << i("instance") << ": "
+        << std::fixed << std::setprecision(3) << r("dpe") << ": ";
+    dbscan(0);
+  } else if ("size" == name) {
+    out << i("instance") << ": "
+        << i("est_done") << " " << t("est_how") << " est";
+    sizes(out, record.get("est_sizes").integers,
+          record.get("est_counts").integers);
+    out << "; " << i("dbscan_done") << " " << t("dbscan_how") << " dbscan";
+    sizes(out, record.get("dbscan_sizes").integers,
+          record.get("dbscan_counts").integers);
+    out << "\n";
+  } else if ("noise" == name) {
+    out << " " << i("noise") << " "
+        << i("est_done") << " " << t("est_how") << " est "
+        << i("dbscan_done") << " " << t("dbscan_how") << " dbscan";
+  } else if ("sweep" == name) {
+    out << std::fixed << std::setprecision(0)
+        << "alpha=" << r("alpha") << ",beta=" << r("beta") << ": "
+        << std::setprecision(4) << r("dhi") << "\n";
+  } else if ("rdf" == name) {
+    const std::vector<double>& rs = record.get("r").reals;
+    const std::vector<double>& gs = record.get("g").reals;
+    const std::vector<double>& ks = record.get("k").reals;
+    const std::vector<double>& ss = record.get("s").reals;
+    out << "rdf " << tick << ":";
+    for (std::size_t k = 0; k < rs.size() && k < gs.size(); ++k) {
+      out << (0 < k ? "," : "") << " " << rs[k] << " " << gs[k];
+    }
+    out << "\nsf " << tick << ":";
+    for (std::size_t k = 0; k < ks.size() && k < ss.size(); ++k) {
+      out << (0 < k ? "," : "") << " " << ks[k] << " " << ss[k];
+    }
+    out << "\n";
+  } else if ("instance" == name) {
+    if (1 < i("instance")) {
+      out << "\n";
+    }
+    out << i("instance") << ":";
+  } else if ("step" == name) {
+    out << ";";
+  } else {
+    // unknown layout: name, tick, and fields in order
+    out << name << " " << tick << ":";
+    for (const Record::Field& field : record.fields_) {
+      out << " " << field.name << "=";
+      if      (Record::Kind::Integer == field.kind) { out << field.integer; }
+      else if (Record::Kind::Real    == field.kind) { out << field.real; }
+      else if (Record::Kind::Text    == field.kind) { out << field.text; }
+      else if (Record::Kind::Integers == field.kind) {
+        for (long long v : field.integers) { out << v << ";"; }
+      } else {
+        for (double v : field.reals) { out << v << ";"; }
+      }
+    }
+    out << "\n";
+  }
+
+  stream << out.str();
+}
+
+
+void
+Metrics::csv(const Record& record, std::ostream& out)
+{
+  // a header precedes every change of layout
+  std::string layout = record.name_;
+  for (const Record::Field& field : record.fields_) {
+    layout += "," + field.name;
+  }
+  if (layout != this->layout_) {
+    this->layout_ = layout;
+    out << "tick,experiment,record";
+    for (const Record::Field& field : record.fields_) {
+      out << "," << field.name;
+    }
+    out << "\n";
+  }
+
+  out << std::setprecision(9)
+      << record.tick_ << "," << record.experiment_ << "," << record.name_;
+  for (const Record::Field& field : record.fields_) {
+    out << ",";
+    switch (field.kind) {
+    case Record::Kind::Integer:
+      out << field.integer;
+      break;
+    case Record::Kind::Real:
+      number(out, field.real, "");
+      break;
+    case Record::Kind::Text:
+      // quoted, as text may contain commas (eg. type histories)
+      out << '"';
+      for (char c : field.text) {
+        out << c << ('"' == c ? "\"" : "");
+      }
+      out << '"';
+      break;
+    case Record::Kind::Integers:
+      // lists are space-separated within a cell
+      for (std::size_t k = 0; k < field.integers.size(); ++k) {
+        out << (0 < k ? " " : "") << field.integers[k];
+      }
+      break;
+    case Record::Kind::Reals:
+      for (std::size_t k = 0; k < field.reals.size(); ++k) {
+        out << (0 < k ? " " : "");
+        number(out, field.reals[k], "nan");
+      }
+      break;
+    }
+  }
+  out << "\n";
+}
+
+
+void
+Metrics::jsonl(const Record& record, std::ostream& out)
+{
+  out << std::setprecision(9)
+      << "{\"tick\":" << record.tick_
+      << ",\"experiment\":" << record.experiment_
+      << ",\"record\":";
+  quote(out, record.name_);
+  for (const Record::Field& field : record.fields_) {
+    out << ",";
+    quote(out, field.name);
+    out << ":";
+    switch (field.kind) {
+    case Record::Kind::Integer:
+      out << field.integer;
+      break;
+    case Record::Kind::Real:
+      number(out, field.real, "null");
+      break;
+    case Record::Kind::Text:
+      quote(out, field.text);
+      break;
+    case Record::Kind::Integers:
+      out << "[";
+      for (std::size_t k = 0; k < field.integers.size(); ++k) {
+        out << (0 < k ? "," : "") << field.integers[k];
+      }
+      out << "]";
+      break;
+    case Record::Kind::Reals:
+      out << "[";
+      for (std::size_t k = 0; k < field.reals.size(); ++k) {
+        out << (0 < k ? "," : "");
+        number(out, field.reals[k], "null");
+      }
+      out << "]";
+      break;
+    }
+  }
+  out << "}\n";
+}
+
+
+void
+Metrics::columnar(const std::vector<Record>& batch, std::size_t begin,
+                  std::size_t end, std::ostream& out)
+{
+  const Record& first = batch[begin];
+  uint32_t rows = end - begin;
+  uint16_t fields = first.fields_.size();
+  uint32_t length;
+
+  Binary::put<uint16_t>(out, first.name_.size());
+  out.write(first.name_.data(), first.name_.size());
+  Binary::put(out, rows);
+  Binary::put(out, fields);
+  for (std::size_t row = begin; row < end; ++row) {
+    uint64_t tick = batch[row].tick_;
+    Binary::put(out, tick);
+  }
+  for (std::size_t row = begin; row < end; ++row) {
+    int32_t experiment = batch[row].experiment_;
+    Binary::put(out, experiment);
+  }
+  for (uint16_t f = 0; f < fields; ++f) {
+    Record::Kind kind = first.fields_[f].kind;
+    uint8_t k = static_cast<uint8_t>(kind);
+    Binary::put<uint16_t>(out, first.fields_[f].name.size());
+    out.write(first.fields_[f].name.data(), first.fields_[f].name.size());
+    Binary::put(out, k);
+    if (Record::Kind::Integer == kind) {
+      for (std::size_t row = begin; row < end; ++row) {
+        int64_t value = batch[row].fields_[f].integer;
+        Binary::put(out, value);
+      }
+    } else if (Record::Kind::Real == kind) {
+      for (std::size_t row = begin; row < end; ++row) {
+        Binary::put(out, batch[row].fields_[f].real);
+      }
+    } else if (Record::Kind::Text == kind) {
+      for (std::size_t row = begin; row < end; ++row) {
+        length = batch[row].fields_[f].text.size();
+        Binary::put(out, length);
+      }
+      for (std::size_t row = begin; row < end; ++row) {
+        const std::string& text = batch[row].fields_[f].text;
+        out.write(text.data(), text.size());
+      }
+    } else if (Record::Kind::Integers == kind) {
+      for (std::size_t row = begin; row < end; ++row) {
+        length = batch[row].fields_[f].integers.size();
+        Binary::put(out, length);
+      }
+      for (std::size_t row = begin; row < end; ++row) {
+        for (long long v : batch[row].fields_[f].integers) {
+          int64_t value = v;
+          Binary::put(out, value);
+        }
+      }
+    } else {
+      for (std::size_t row = begin; row < end; ++row) {
+        length = batch[row].fields_[f].reals.size();
+        Binary::put(out, length);
+      }
+      for (std::size_t row = begin; row < end; ++row) {
+        const std::vector<double>& reals = batch[row].fields_[f].reals;
+        out.write(reinterpret_cast<const char*>(reals.data()),
+                  reals.size() * sizeof(double));
+      }
+    }
+  }
+}
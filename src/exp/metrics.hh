@@ -0,0 +1,181 @@
+//===-- exp/metrics.hh - Metrics class declaration -------------*- C++ -*-===//
+///
+/// \file
+/// Definition of the Encoding enum and declarations of the Record and Metrics
+/// classes, through which experiments report their results.
+/// A Record is a typed row (tick, experiment, record name, named fields), and
+/// Metrics encodes records as either the legacy text format (that
+/// tools/plot.py parses), CSV, JSON Lines, or a binary columnar file.
+/// Records for a file are batched and encoded on a background writer thread;
+/// records for a stream (eg. stdout, which Log and Headless also print to) are
+/// encoded right away on the adding thread, so that lines do not interleave.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "../util/log.hh"
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Encoding: Output format of Metrics.
+
+enum class Encoding
+{
+  Legacy = 0, // free text per experiment, as formerly written to stdout
+  Csv,        // comma-separated values, with a header per record layout
+  Jsonl,      // one JSON object per line
+  Columnar    // binary blocks of columns per record layout
+};
+
+
+class Record
+{
+ public:
+  // Kind: Type of a field value.
+  enum class Kind
+  {
+    Integer = 0,
+    Real,
+    Text,
+    Integers,
+    Reals
+  };
+
+  // Field: Named value of a record.
+  struct Field
+  {
+    std::string            name;
+    Kind                   kind;
+    long long              integer;
+    double                 real;
+    std::string            text;
+    std::vector<long long> integers;
+    std::vector<double>    reals;
+  };
+
+  /// constructor: Start an empty record.
+  /// \param tick  time step the record refers to
+  /// \param experiment  specific experiment being performed
+  /// \param name  record name, which also selects the legacy text layout
+  Record(unsigned long tick, int experiment, const std::string& name);
+
+  /// integer(), real(), text(), integers(), reals(): Append a field.
+  /// \param name  field name
+  /// \param value  field value
+  /// \returns  this record, for chaining
+  Record& integer(const std::string& name, long long value);
+  Record& real(const std::string& name, double value);
+  Record& text(const std::string& name, const std::string& value);
+  Record& integers(const std::string& name, std::vector<long long> values);
+  Record& reals(const std::string& name, std::vector<double> values);
+
+  /// get(): Find a field by name.
+  /// \param name  field name
+  /// \returns  field, or an empty field of the integer kind if absent
+  const Field& get(const std::string& name) const;
+
+  unsigned long      tick_;
+  int                experiment_;
+  std::string        name_;
+  std::vector<Field> fields_;
+};
+
+
+class Metrics
+{
+ public:
+  /// constructor: Write records to a stream, on the thread adding them.
+  /// \param log  Log object
+  /// \param stream  destination stream (must outlive Metrics)
+  /// \param encoding  output format
+  Metrics(Log& log, std::ostream& stream, Encoding encoding = Encoding::Legacy);
+
+  /// constructor: Write records to a file on the writer thread, with the
+  ///              output format chosen by its extension (.csv, .jsonl, .col,
+  ///              else legacy text). Falls back to legacy text on stdout
+  ///              (written like a stream) if it cannot be opened.
+  /// \param log  Log object
+  /// \param path  path to the destination file
+  /// \param batch  number of records that triggers a write
+  Metrics(Log& log, const std::string& path, unsigned int batch = 64);
+
+  /// destructor: Write pending records and stop any writer thread.
+  ~Metrics();
+
+  /// add(): Queue a record for writing.
+  /// \param record  record to be written
+  void add(Record&& record);
+
+  /// flush(): Block until every queued record has been written.
+  void flush();
+
+  /// encoding_of(): Choose an output format by file extension.
+  /// \param path  path to a file
+  /// \returns  output format
+  static Encoding encoding_of(const std::string& path);
+
+  /* columnar file format (native endianness)
+   *
+   * "EMCM" VERSION(u32)
+   * blocks of consecutive records with the same layout, each being:
+   *   NAMELEN(u16) NAME ROWS(u32) FIELDS(u16)
+   *   TICK(u64 * ROWS) EXPERIMENT(i32 * ROWS)
+   *   columns, each being:
+   *     NAMELEN(u16) NAME KIND(u8)
+   *     integer:  (i64 * ROWS)
+   *     real:     (f64 * ROWS)
+   *     text:     (LEN(u32) * ROWS) bytes
+   *     integers: (LEN(u32) * ROWS) (i64 * sum of LEN)
+   *     reals:    (LEN(u32) * ROWS) (f64 * sum of LEN)
+   */
+
+ private:
+  /// start(): Write the file header and start any writer thread.
+  void start();
+
+  /// work(): Writer thread loop.
+  void work();
+
+  /// write(): Encode a batch of records to the stream.
+  /// \param batch  records to be written
+  void write(const std::vector<Record>& batch);
+
+  /// legacy(), csv(), jsonl(): Encode one record.
+  /// \param record  record to be encoded
+  /// \param out  destination stream
+  void legacy(const Record& record, std::ostream& out);
+  void csv(const Record& record, std::ostream& out);
+  void jsonl(const Record& record, std::ostream& out);
+
+  /// columnar(): Encode records having the same layout as one block.
+  /// \param batch  records to be written
+  /// \param begin  index of the first record of the block
+  /// \param end  index after the last record of the block
+  /// \param out  destination stream
+  void columnar(const std::vector<Record>& batch, std::size_t begin,
+                std::size_t end, std::ostream& out);
+
+  Log&                    log_;
+  std::ofstream           file_;
+  std::ostream*           stream_;
+  Encoding                encoding_;
+  unsigned int            batch_;    // number of records that triggers a write
+  std::string             layout_;   // layout of last CSV header
+  bool                    threaded_; // whether a writer thread encodes records
+  // writer thread
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  std::vector<Record>     pending_;  // records waiting to be written
+  unsigned long           added_;    // number of records queued so far
+  unsigned long           written_;  // number of records written so far
+  unsigned long           wanted_;   // number of records flush() waits for
+  bool                    done_;     // whether writer thread should finish
+};
@@ -0,0 +1,124 @@
+#include "metrics.hh"
+#include "../state/state.hh"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+
+#define TESTMETRICS "testemergence.jsonl"
+
+TEST_CASE("Metrics::legacy")
+{
+  auto log = Log(1, QUIET);
+  std::ostringstream out;
+  {
+    Metrics metrics(log, out);
+    Record population(100, 2, "population");
+    population.integer("mature_spores", 3)
+              .integer("cell_hulls", 4)
+              .integer("cell_cores", 5)
+              .real("radius", 5.0)
+              .integer("minpts", 14)
+              .integer("clusters", 6)
+              .integer("cells", 1)
+              .integer("spores", 2)
+              .integer("cores", 30)
+              .integer("vagues", 40)
+              .integer("noise", 50);
+    metrics.add(std::move(population));
+    Record heatmap(7, 31, "heatmap");
+    heatmap.text("path", "heat.png")
+           .integer("ticks", 101)
+           .integer("cols", 250)
+           .integer("rows", 250)
+           .real("bin", 1.0);
+    metrics.add(std::move(heatmap));
+    Record instance(1, 41, "instance");
+    instance.integer("instance", 2);
+    metrics.add(std::move(instance));
+    Record survival(30, 41, "survival");
+    survival.integer("instance", 2)
+            .real("dpe", 0.0526)
+            .integer("est_done", 30)
+            .text("est_how", "grew")
+            .integer("dbscan_done", 25)
+            .text("dbscan_how", "decayed");
+    metrics.add(std::move(survival));
+    metrics.add(Record(30, 41, "step"));
+    metrics.flush();
+  }
+  REQUIRE("100: 3 mature_spores, 4 cell_hulls, 5 cell_cores "
+          "(dbscan 5.00,14: 6 clusters, 1 cells, 2 spores, 30 cores, "
+          "40 vagues, 50 noise)\n"
+          "7: heat map of 101 ticks, 250x250 bins of 1: heat.png\n"
+          "\n2: 0.053 30 grew est 25 decayed dbscan;" == out.str());
+}
+
+
+TEST_CASE("Metrics::csv")
+{
+  auto log = Log(1, QUIET);
+  std::ostringstream out;
+  {
+    Metrics metrics(log, out, Encoding::Csv);
+    Record a(0, 11, "occupancy");
+    a.reals("nn_dists", {1.5, 2.25});
+    metrics.add(std::move(a));
+    Record b(150, 11, "occupancy");
+    b.reals("nn_dists", {3.0});
+    metrics.add(std::move(b));
+    Record c(100, 2, "types");
+    c.text("types", "0 g b,1 \"m\"");
+    metrics.add(std::move(c));
+  }
+  REQUIRE("tick,experiment,record,nn_dists\n"
+          "0,11,occupancy,1.5 2.25\n"
+          "150,11,occupancy,3\n"
+          "tick,experiment,record,types\n"
+          "100,2,types,\"0 g b,1 \"\"m\"\"\"\n" == out.str());
+}
+
+
+TEST_CASE("Metrics::jsonl")
+{
+  auto log = Log(1, QUIET);
+  std::ostringstream out;
+  {
+    Metrics metrics(log, out, Encoding::Jsonl);
+    Record record(500, 6, "sweep");
+    record.real("alpha", 180.0).real("beta", 17.0).text("note", "a\"b");
+    record.integers("sizes", {1, 2});
+    metrics.add(std::move(record));
+    REQUIRE(!out.str().empty()); // written by the adding thread
+  }
+  REQUIRE("{\"tick\":500,\"experiment\":6,\"record\":\"sweep\","
+          "\"alpha\":180,\"beta\":17,\"note\":\"a\\\"b\",\"sizes\":[1,2]}\n"
+          == out.str());
+  REQUIRE(Encoding::Csv == Metrics::encoding_of("out.csv"));
+  REQUIRE(Encoding::Jsonl == Metrics::encoding_of("out.jsonl"));
+  REQUIRE(Encoding::Columnar == Metrics::encoding_of("out.col"));
+  REQUIRE(Encoding::Legacy == Metrics::encoding_of("out.txt"));
+}
+
+
+TEST_CASE("Metrics file")
+{
+  auto log = Log(1, QUIET);
+  {
+    Metrics metrics(log, TESTMETRICS, 2);
+    for (unsigned long tick = 0; tick < 3; ++tick) {
+      Record record(tick, 11, "step");
+      metrics.add(std::move(record));
+    }
+    metrics.flush();
+  }
+  std::ifstream file(TESTMETRICS);
+  std::string line;
+  unsigned int lines = 0;
+  while (std::getline(file, line)) {
+    REQUIRE(0 == line.find("{\"tick\":" + std::to_string(lines)));
+    ++lines;
+  }
+  REQUIRE(3 == lines);
+  remove(TESTMETRICS);
+}
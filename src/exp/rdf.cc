@@ -0,0 +1,357 @@
+#include "rdf.hh"
+#include "../state/state.hh"
+#include "../util/binary.hh"
+#include "../util/common.hh"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <math.h> // j0
+#include <mutex>
+#include <thread>
+
+
+#define RDF_THREAD_MIN 4096 // fewer particles than this are binned by one thread
+
+
+struct Rdf::Pool
+{
+  /// constructor: Start the workers (the caller of run() being the first).
+  /// \param threads  number of threads binning, including the caller
+  Pool(unsigned int threads)
+    : threads_(threads), generation_(0), running_(0), quit_(false)
+  {
+    for (unsigned int t = 1; t < threads; ++t) {
+      this->workers_.push_back(std::thread(&Pool::work, this, t));
+    }
+  }
+
+  /// destructor: Stop the workers.
+  ~Pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->quit_ = true;
+    }
+    this->start_.notify_all();
+    for (std::thread& worker : this->workers_) {
+      worker.join();
+    }
+  }
+
+  /// run(): Call job(t) for every thread t, and wait for all of them.
+  /// \param job  job of a thread
+  void
+  run(const std::function<void(unsigned int)>& job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->job_ = &job;
+      this->running_ = this->threads_ - 1;
+      ++this->generation_;
+    }
+    this->start_.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->done_.wait(lock, [this] { return 0 == this->running_; });
+  }
+
+  /// work(): Worker loop.
+  /// \param t  thread number
+  void
+  work(unsigned int t)
+  {
+    uint64_t seen = 0;
+    const std::function<void(unsigned int)>* job;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->start_.wait(lock, [this, seen] {
+          return this->quit_ || seen != this->generation_;
+        });
+        if (this->quit_) {
+          return;
+        }
+        seen = this->generation_;
+        job = this->job_;
+      }
+      (*job)(t);
+      {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        --this->running_;
+      }
+      this->done_.notify_one();
+    }
+  }
+
+  unsigned int             threads_;
+  std::vector<std::thread> workers_;
+  std::mutex               mutex_;
+  std::condition_variable  start_;
+  std::condition_variable  done_;
+  const std::function<void(unsigned int)>* job_;
+  uint64_t                 generation_; // number of run() calls
+  unsigned int             running_;    // workers yet to finish the job
+  bool                     quit_;
+};
+
+
+Rdf::Rdf(float radius /* = 20.0f */, unsigned int bins /* = 64 */)
+  : radius_(radius), bins_(std::max(1u, bins)), cols_(1), rows_(1)
+{
+  this->clear();
+}
+
+
+Rdf::Rdf(Rdf&& other) = default;
+Rdf& Rdf::operator=(Rdf&& other) = default;
+Rdf::~Rdf() = default;
+
+
+void
+Rdf::clear()
+{
+  this->counts_.assign(this->bins_, 0);
+  this->ideal_ = 0.0;
+  this->density_ = 0.0;
+  this->width_ = 0.0f;
+  this->samples_ = 0;
+}
+
+
+void
+Rdf::sample(const State& state)
+{
+  int num = state.num_;
+  float w = static_cast<float>(state.width_);
+  float h = static_cast<float>(state.height_);
+  if (2 > num || 0.0f >= this->radius_) {
+    return;
+  }
+  if (this->counts_.size() != this->bins_) {
+    this->clear();
+  }
+  if (0.0f == this->width_) {
+    // fixed for the whole window
+    float radius = std::min(this->radius_, 0.5f * std::min(w, h));
+    this->width_ = radius / this->bins_;
+  }
+  float radius = this->width_ * this->bins_;
+  this->plot(state, radius);
+
+  unsigned int threads = 1;
+  if (RDF_THREAD_MIN <= num) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!this->pool_ || threads != this->pool_->threads_) {
+      this->pool_.reset(new Pool(threads));
+    }
+  }
+  this->histograms_.resize(threads);
+  for (std::vector<uint64_t>& histogram : this->histograms_) {
+    histogram.assign(this->bins_, 0);
+  }
+  int chunk = (num + threads - 1) / threads;
+  std::function<void(unsigned int)> job = [&](unsigned int t) {
+    int begin = std::min(num, static_cast<int>(t) * chunk);
+    int end = std::min(num, begin + chunk);
+    this->tally(state, radius, begin, end, this->histograms_[t]);
+  };
+  if (1 < threads) {
+    this->pool_->run(job);
+  } else {
+    job(0);
+  }
+  for (unsigned int t = 0; t < threads; ++t) {
+    for (unsigned int b = 0; b < this->bins_; ++b) {
+      this->counts_[b] += this->histograms_[t][b];
+    }
+  }
+
+  double area = static_cast<double>(w) * h;
+  this->ideal_ += 0.5 * num * (num - 1) / area;
+  this->density_ += num / area;
+  ++this->samples_;
+}
+
+
+void
+Rdf::plot(const State& state, float radius)
+{
+  int num = state.num_;
+  float w = static_cast<float>(state.width_);
+  float h = static_cast<float>(state.height_);
+  const Column<float>& px = state.px_;
+  const Column<float>& py = state.py_;
+  // grid units at least as wide as the radius, so 3x3 units cover all pairs
+  int cols = std::max(1, static_cast<int>(w / std::ceil(radius)));
+  int rows = std::max(1, static_cast<int>(h / std::ceil(radius)));
+  float unit_width = w / cols;
+  float unit_height = h / rows;
+  int col;
+  int row;
+
+  // counting sort of the particles by grid unit
+  this->cols_ = cols;
+  this->rows_ = rows;
+  this->units_.resize(num);
+  this->starts_.assign(cols * rows + 1, 0);
+  this->order_.resize(num);
+  for (int i = 0; i < num; ++i) {
+    col = std::min(cols - 1, static_cast<int>(px[i] / unit_width));
+    row = std::min(rows - 1, static_cast<int>(py[i] / unit_height));
+    this->units_[i] = cols * row + col;
+    ++this->starts_[this->units_[i] + 1];
+  }
+  for (int u = 0; u < cols * rows; ++u) {
+    this->starts_[u + 1] += this->starts_[u];
+  }
+  std::vector<uint32_t> next(this->starts_.begin(), this->starts_.end() - 1);
+  for (int i = 0; i < num; ++i) {
+    this->order_[next[this->units_[i]]++] = i;
+  }
+}
+
+
+void
+Rdf::tally(const State& state, float radius, int begin, int end,
+           std::vector<uint64_t>& counts) const
+{
+  const Column<float>& px = state.px_;
+  const Column<float>& py = state.py_;
+  float w = static_cast<float>(state.width_);
+  float h = static_cast<float>(state.height_);
+  int cols = this->cols_;
+  int rows = this->rows_;
+  float radiussq = radius * radius;
+  float width = this->width_;
+  unsigned int last = this->bins_ - 1;
+  unsigned int units[9];
+  unsigned int count;
+  unsigned int u;
+  unsigned int bin;
+  int srccol;
+  int srcrow;
+  float dx;
+  float dy;
+  float distsq;
+  int dsti;
+
+  for (int srci = begin; srci < end; ++srci) {
+    // the 3x3 vicinity, without duplicates when the grid is narrow
+    srccol = this->units_[srci] % cols;
+    srcrow = this->units_[srci] / cols;
+    count = 0;
+    for (int dr = -1; dr <= 1; ++dr) {
+      for (int dc = -1; dc <= 1; ++dc) {
+        u = cols * ((srcrow + dr + rows) % rows) + (srccol + dc + cols) % cols;
+        if (std::find(units, units + count, u) == units + count) {
+          units[count++] = u;
+        }
+      }
+    }
+    for (unsigned int v = 0; v < count; ++v) {
+      for (uint32_t p = this->starts_[units[v]];
+           p < this->starts_[units[v] + 1]; ++p) {
+        dsti = this->order_[p];
+        // count every pair once
+        if (srci <= dsti) {
+          continue;
+        }
+        // shortest distance across the wrapping edges
+        dx = std::fabs(px[dsti] - px[srci]); dx = std::min(dx, w - dx);
+        dy = std::fabs(py[dsti] - py[srci]); dy = std::min(dy, h - dy);
+        distsq = (dx * dx) + (dy * dy);
+        if (radiussq <= distsq) {
+          continue;
+        }
+        bin = static_cast<unsigned int>(std::sqrt(distsq) / width);
+        ++counts[std::min(bin, last)];
+      }
+    }
+  }
+}
+
+
+void
+Rdf::checkpoint(std::ostream& stream) const
+{
+  Binary::put(stream, this->radius_);
+  Binary::put<uint32_t>(stream, this->bins_);
+  Binary::put(stream, this->counts_);
+  Binary::put(stream, this->ideal_);
+  Binary::put(stream, this->density_);
+  Binary::put(stream, this->width_);
+  Binary::put<uint32_t>(stream, this->samples_);
+}
+
+
+bool
+Rdf::restore(std::istream& stream)
+{
+  uint32_t bins;
+  uint32_t samples;
+  if (!Binary::get(stream, this->radius_) || !Binary::get(stream, bins) ||
+      !Binary::get(stream, this->counts_) || !Binary::get(stream, this->ideal_)
+      || !Binary::get(stream, this->density_) ||
+      !Binary::get(stream, this->width_) || !Binary::get(stream, samples)) {
+    return false;
+  }
+  this->bins_ = bins;
+  this->samples_ = samples;
+  return true;
+}
+
+
+std::vector<double>
+Rdf::g() const
+{
+  auto g = std::vector<double>(this->bins_, 0.0);
+  double width = this->width_;
+  double shell;
+
+  if (0.0 >= this->ideal_) {
+    return g;
+  }
+  for (unsigned int b = 0; b < this->bins_; ++b) {
+    shell = M_PI * width * width * ((b + 1.0) * (b + 1.0) - b * b);
+    g[b] = this->counts_[b] / (this->ideal_ * shell);
+  }
+  return g;
+}
+
+
+std::vector<double>
+Rdf::r() const
+{
+  auto r = std::vector<double>(this->bins_);
+  for (unsigned int b = 0; b < this->bins_; ++b) {
+    r[b] = (b + 0.5) * this->width_;
+  }
+  return r;
+}
+
+
+std::vector<double>
+Rdf::structure(unsigned int count, std::vector<double>& k) const
+{
+  std::vector<double> g = this->g();
+  std::vector<double> r = this->r();
+  auto s = std::vector<double>(count, 1.0);
+  double width = this->width_;
+  double radius = width * this->bins_;
+  double density = this->samples_ ? this->density_ / this->samples_ : 0.0;
+
+  k.assign(count, 0.0);
+  if (0 == this->samples_) {
+    return s;
+  }
+  for (unsigned int i = 0; i < count; ++i) {
+    k[i] = (i + 1) * TAU / radius;
+    double sum = 0.0;
+    for (unsigned int b = 0; b < this->bins_; ++b) {
+      sum += r[b] * (g[b] - 1.0) * j0(k[i] * r[b]) * width;
+    }
+    s[i] = 1.0 + TAU * density * sum;
+  }
+  return s;
+}
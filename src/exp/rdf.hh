@@ -0,0 +1,114 @@
+//===-- exp/rdf.hh - Rdf class declaration ---------------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Rdf class, which accumulates the radial distribution
+/// function g(r) of the particles over a window of time steps, from which the
+/// (2D) static structure factor S(k) is derived.
+/// Pairs are found through a private grid (its units at least as wide as the
+/// greatest radius, so the seek grid of State is left alone), and are binned
+/// into per-thread histograms by a pool of threads kept between samples.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+
+class State;
+
+class Rdf
+{
+ public:
+  /// constructor: Prepare an empty accumulation.
+  /// \param radius  greatest pair distance binned (r_max)
+  /// \param bins  number of bins between 0 and radius
+  Rdf(float radius = 20.0f, unsigned int bins = 64);
+
+  /// move constructor, move assignment, destructor: (Pool is private.)
+  Rdf(Rdf&& other);
+  Rdf& operator=(Rdf&& other);
+  ~Rdf();
+
+  /// sample(): Accumulate the pair distances of the current particles.
+  ///           The radius is capped at half the smaller side of the space,
+  ///           beyond which wrapping makes distances ambiguous.
+  /// \param state  State object
+  void sample(const State& state);
+
+  /// clear(): Forget all samples (eg. at the start of a new window).
+  void clear();
+
+  /// g(): Get the normalised g(r) averaged over the samples.
+  /// \returns  g(r) per bin (1 for an ideal gas)
+  std::vector<double> g() const;
+
+  /// r(): Get the bin centers.
+  /// \returns  r per bin
+  std::vector<double> r() const;
+
+  /// structure(): Get the structure factor from g(r) by a 2D Hankel
+  ///              transform, S(k) = 1 + 2 pi rho int r (g(r) - 1) J0(kr) dr.
+  /// \param count  number of wavenumbers, which are multiples of 2pi/radius
+  /// \param k  destination of wavenumbers
+  /// \returns  S(k) per wavenumber
+  std::vector<double> structure(unsigned int count,
+                                std::vector<double>& k) const;
+
+  /// checkpoint(): Write the accumulation so far.
+  /// \param stream  destination binary stream
+  void checkpoint(std::ostream& stream) const;
+
+  /// restore(): Replace the accumulation with one written by checkpoint().
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
+  /// samples(): Get the number of samples accumulated so far.
+  /// \returns  number of samples
+  inline unsigned int
+  samples() const
+  {
+    return this->samples_;
+  }
+
+  float        radius_; // greatest pair distance binned (r_max)
+  unsigned int bins_;   // number of bins
+
+ private:
+  // Pool: Threads binning for sample(), kept between samples.
+  struct Pool;
+
+  /// plot(): Sort the particles into the private grid.
+  /// \param state  State object
+  /// \param radius  greatest pair distance binned
+  void plot(const State& state, float radius);
+
+  /// tally(): Bin the pair distances of a range of particles.
+  /// \param state  State object
+  /// \param radius  greatest pair distance binned
+  /// \param begin  first particle of range
+  /// \param end  particle after the last of range
+  /// \param counts  destination histogram
+  void tally(const State& state, float radius, int begin, int end,
+             std::vector<uint64_t>& counts) const;
+
+  std::unique_ptr<Pool> pool_;    // created by the first threaded sample
+  // private grid: particles ordered by unit, units starting at starts_
+  int                   cols_;
+  int                   rows_;
+  std::vector<uint32_t> units_;   // grid unit per particle
+  std::vector<uint32_t> starts_;  // index into order_ per grid unit (and end)
+  std::vector<int>      order_;   // particle indices ordered by grid unit
+  std::vector<std::vector<uint64_t>> histograms_; // per thread
+
+  std::vector<uint64_t> counts_;  // pairs per bin over all samples
+  double                ideal_;   // sum of pairs per unit area (ideal gas)
+  double                density_; // sum of densities
+  float                 width_;   // bin width of current accumulation
+  unsigned int          samples_; // number of samples
+};
@@ -0,0 +1,57 @@
+#include "rdf.hh"
+#include "../state/state.hh"
+#include "../util/util.hh"
+
+
+TEST_CASE("Rdf::sample")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto rdf = Rdf(20.0f, 20);
+
+  // a square lattice of spacing 5 has its first peaks at 5 and 5 * sqrt(2)
+  unsigned int side = state.width_ / 5;
+  state.num_ = side * side;
+  for (unsigned int i = 0; i < side; ++i) {
+    for (unsigned int j = 0; j < side; ++j) {
+      state.px_[side * i + j] = 5.0f * i + 0.01f;
+      state.py_[side * i + j] = 5.0f * j + 0.01f;
+    }
+  }
+  std::vector<Coord> gcol(state.gcol_.begin(), state.gcol_.end());
+  rdf.sample(state);
+  rdf.sample(state);
+  REQUIRE(2 == rdf.samples());
+  // the seek grid is left alone
+  REQUIRE(std::equal(gcol.begin(), gcol.end(), state.gcol_.begin()));
+  std::vector<double> g = rdf.g();
+  std::vector<double> r = rdf.r();
+  REQUIRE(20 == g.size());
+  REQUIRE(Approx(0.5) == r[0]);
+  REQUIRE(0.0 == g[0]);
+  REQUIRE(0.0 == g[3]);
+  REQUIRE(2.0 < g[4] + g[5]);  // 5, give or take rounding
+  REQUIRE(2.0 < g[7]);         // 7.07
+  REQUIRE(0.0 == g[8]);
+
+  // an ideal gas is flat
+  state.num_ = 5000;
+  for (int i = 0; i < state.num_; ++i) {
+    state.px_[i] = Util::distr(0.0f, static_cast<float>(state.width_));
+    state.py_[i] = Util::distr(0.0f, static_cast<float>(state.height_));
+  }
+  rdf.clear();
+  rdf.sample(state);
+  rdf.sample(state); // threads are kept
+  g = rdf.g();
+  for (unsigned int b = 5; b < g.size(); ++b) {
+    REQUIRE(Approx(1.0).margin(0.15) == g[b]);
+  }
+  std::vector<double> k;
+  std::vector<double> s = rdf.structure(8, k);
+  REQUIRE(8 == k.size());
+  for (double sk : s) {
+    REQUIRE(Approx(1.0).margin(0.5) == sk);
+  }
+}
@@ -0,0 +1,252 @@
+#include "shape.hh"
+#include "../state/state.hh"
+#include "../util/common.hh"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+
+#define SHAPE_THREAD_MIN 4096 // fewer particles than this use one thread
+#define SHAPE_MERGE 0.25f     // hull vertices closer than this * gyration merge
+#define SHAPE_TURN 0.6f       // turns sharper than this (radians) are corners
+
+
+namespace
+{
+
+typedef std::pair<float,float> Point;
+
+/// cross(): Cross product of OA and OB (positive if counter-clockwise).
+inline float
+cross(const Point& o, const Point& a, const Point& b)
+{
+  return (a.first - o.first) * (b.second - o.second)
+         - (a.second - o.second) * (b.first - o.first);
+}
+
+/// convex_hull(): Convex hull in counter-clockwise order (monotone chain),
+///                without collinear points.
+std::vector<Point>
+convex_hull(std::vector<Point> points)
+{
+  std::size_t n = points.size();
+  std::size_t k = 0;
+  if (3 > n) {
+    return points;
+  }
+  std::sort(points.begin(), points.end());
+  auto h = std::vector<Point>(2 * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    while (2 <= k && 0.0f >= cross(h[k - 2], h[k - 1], points[i])) { --k; }
+    h[k++] = points[i];
+  }
+  for (std::size_t i = n - 1, t = k + 1; 0 < i; --i) {
+    while (t <= k && 0.0f >= cross(h[k - 2], h[k - 1], points[i - 1])) { --k; }
+    h[k++] = points[i - 1];
+  }
+  h.resize(k - 1);
+  return h;
+}
+
+/// count_corners(): Count the sharp turns of a convex hull, after merging
+///                  vertices that lie close together (eg. a rounded side).
+unsigned int
+count_corners(const std::vector<Point>& h, float merge)
+{
+  auto kept = std::vector<Point>();
+  float mergesq = merge * merge;
+  float dx;
+  float dy;
+  for (const Point& p : h) {
+    if (!kept.empty()) {
+      dx = p.first - kept.back().first;
+      dy = p.second - kept.back().second;
+      if (mergesq > (dx * dx) + (dy * dy)) {
+        continue;
+      }
+    }
+    kept.push_back(p);
+  }
+  while (1 < kept.size()) {
+    dx = kept.front().first - kept.back().first;
+    dy = kept.front().second - kept.back().second;
+    if (mergesq <= (dx * dx) + (dy * dy)) {
+      break;
+    }
+    kept.pop_back();
+  }
+
+  std::size_t n = kept.size();
+  unsigned int count = 0;
+  if (3 > n) {
+    return 0;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    const Point& a = kept[(i + n - 1) % n];
+    const Point& b = kept[i];
+    const Point& c = kept[(i + 1) % n];
+    float turn = atan2f(cross(a, b, c),
+                        (b.first - a.first) * (c.first - b.first)
+                        + (b.second - a.second) * (c.second - b.second));
+    if (SHAPE_TURN < std::fabs(turn)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+
+Shape
+Shape::of(const State& state, const std::set<int>& cluster)
+{
+  const Column<float>& px = state.px_;
+  const Column<float>& py = state.py_;
+  const Column<Type>& pt = state.pt_;
+  float w = static_cast<float>(state.width_);
+  float h = static_cast<float>(state.height_);
+  Shape shape = {static_cast<unsigned int>(cluster.size())};
+  shape.type = Type::None;
+  if (0 == shape.size) {
+    return shape;
+  }
+
+  // circular mean, so that clusters across the edges are not torn apart
+  float xc = 0.0f;
+  float xs = 0.0f;
+  float yc = 0.0f;
+  float ys = 0.0f;
+  for (int p : cluster) {
+    xc += cosf(px[p] / w * TAU); xs += sinf(px[p] / w * TAU);
+    yc += cosf(py[p] / h * TAU); ys += sinf(py[p] / h * TAU);
+    if      (Type::CellCore == pt[p]) { ++shape.cores; }
+    else if (Type::CellHull == pt[p]) { ++shape.hulls; }
+  }
+  float cx = atan2f(xs, xc) / TAU * w;
+  float cy = atan2f(ys, yc) / TAU * h;
+
+  // unwrap around the circular mean, then refine the centroid
+  auto points = std::vector<Point>();
+  points.reserve(shape.size);
+  float dx;
+  float dy;
+  float mx = 0.0f;
+  float my = 0.0f;
+  for (int p : cluster) {
+    dx = px[p] - cx;
+    dy = py[p] - cy;
+    dx -= w * std::round(dx / w);
+    dy -= h * std::round(dy / h);
+    points.push_back({dx, dy});
+    mx += dx;
+    my += dy;
+  }
+  mx /= shape.size;
+  my /= shape.size;
+  shape.x = std::fmod(cx + mx + w, w);
+  shape.y = std::fmod(cy + my + h, h);
+
+  // gyration tensor
+  float sxx = 0.0f;
+  float sxy = 0.0f;
+  float syy = 0.0f;
+  for (Point& point : points) {
+    point.first -= mx;
+    point.second -= my;
+    sxx += point.first * point.first;
+    sxy += point.first * point.second;
+    syy += point.second * point.second;
+  }
+  sxx /= shape.size;
+  sxy /= shape.size;
+  syy /= shape.size;
+  float half = 0.5f * (sxx + syy);
+  float spread = std::sqrt(0.25f * (sxx - syy) * (sxx - syy) + sxy * sxy);
+  shape.major = half + spread;
+  shape.minor = std::max(0.0f, half - spread);
+  shape.gyration = std::sqrt(sxx + syy);
+
+  float innersq = 0.25f * (sxx + syy);
+  unsigned int inner = 0;
+  for (const Point& point : points) {
+    if (innersq > point.first * point.first + point.second * point.second) {
+      ++inner;
+    }
+  }
+  shape.inner = static_cast<float>(inner) / shape.size;
+  shape.ratio = shape.hulls ? static_cast<float>(shape.cores) / shape.hulls
+                            : static_cast<float>(shape.cores);
+
+  std::vector<Point> vertices = convex_hull(points);
+  shape.hull = vertices.size();
+  shape.corners = count_corners(vertices, SHAPE_MERGE * shape.gyration);
+  shape.type = Shape::classify(shape);
+
+  return shape;
+}
+
+
+void
+Shape::of_all(const State& state, const std::vector<std::set<int>>& clusters,
+              std::vector<Shape>& shapes)
+{
+  std::size_t num = clusters.size();
+  std::size_t particles = 0;
+  for (const std::set<int>& cluster : clusters) {
+    particles += cluster.size();
+  }
+  shapes.resize(num);
+
+  unsigned int threads = 1;
+  if (SHAPE_THREAD_MIN <= particles) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // interleaved, as cluster sizes vary a lot
+  auto describe = [&state, &clusters, &shapes, num, threads](unsigned int t) {
+    for (std::size_t c = t; c < num; c += threads) {
+      shapes[c] = Shape::of(state, clusters[c]);
+    }
+  };
+  auto workers = std::vector<std::thread>();
+  for (unsigned int t = 1; t < threads; ++t) {
+    workers.push_back(std::thread(describe, t));
+  }
+  describe(0);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+
+Type
+Shape::classify(const Shape& shape)
+{
+  unsigned int size = shape.size;
+
+  if (13 > size) {
+    return Type::None;
+  }
+  if (17 > size) {
+    return Type::PrematureSpore;
+  }
+  if (23 > size) {
+    return Type::MatureSpore;
+  }
+  if (30 <= size && 0.05f > shape.inner) {
+    return Type::Ring;
+  }
+  if (0 == shape.cores) {
+    return Type::PrematureCell;
+  }
+  if (3 == shape.corners) {
+    return Type::TriangleCell;
+  }
+  if (4 == shape.corners) {
+    return Type::SquareCell;
+  }
+  if (5 <= shape.corners) {
+    return Type::PentagonCell;
+  }
+  return Type::PrematureCell;
+}
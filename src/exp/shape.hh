@@ -0,0 +1,58 @@
+//===-- exp/shape.hh - Shape struct declaration ----------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Shape struct, which holds the shape descriptors of a
+/// particle cluster (as found by DBSCAN in Exp), and from which the structure
+/// (Type) of the cluster is recognised.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+
+enum class Type : uint8_t;
+class State;
+
+struct Shape
+{
+  /// of(): Compute the shape descriptors of a cluster.
+  /// \param state  State object
+  /// \param cluster  particle indices of the cluster
+  /// \returns  shape descriptors, including the recognised structure
+  static Shape of(const State& state, const std::set<int>& cluster);
+
+  /// of_all(): Compute the shape descriptors of many clusters, spread over
+  ///           threads when there are many particles.
+  /// \param state  State object
+  /// \param clusters  clusters
+  /// \param shapes  destination of shape descriptors per cluster
+  static void of_all(const State& state,
+                     const std::vector<std::set<int>>& clusters,
+                     std::vector<Shape>& shapes);
+
+  /// classify(): Recognise the structure from the shape descriptors.
+  ///             Spores go by size, like Exp::type_of_cluster(); cells are
+  ///             told apart by the corners of their convex hull, rings by
+  ///             their empty middle, and premature cells by lacking a core.
+  /// \param shape  shape descriptors
+  /// \returns  structure, or Type::None if unrecognised (eg. noise)
+  static Type classify(const Shape& shape);
+
+  unsigned int size;     // number of particles
+  float        x;        // centroid x (circular mean, aware of wrapping)
+  float        y;        // centroid y (circular mean, aware of wrapping)
+  float        major;    // greater eigenvalue of the gyration tensor
+  float        minor;    // lesser eigenvalue of the gyration tensor
+  float        gyration; // radius of gyration
+  unsigned int hull;     // number of convex hull vertices
+  unsigned int corners;  // number of convex hull corners (sharp turns)
+  unsigned int cores;    // number of cell core particles
+  unsigned int hulls;    // number of cell hull particles
+  float        ratio;    // cell core to cell hull particles
+  float        inner;    // fraction of particles within gyration / 2
+  Type         type;     // recognised structure
+};
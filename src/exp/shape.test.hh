@@ -0,0 +1,100 @@
+#include "shape.hh"
+#include "../util/common.hh"
+#include "../util/util.hh"
+
+
+TEST_CASE("Shape::of")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cluster = std::set<int>();
+  float w = static_cast<float>(state.width_);
+  Shape shape;
+
+  // a ring has an empty middle
+  for (int i = 0; i < 36; ++i) {
+    state.px_[i] = 50.0f + 10.0f * cosf(TAU * i / 36);
+    state.py_[i] = 50.0f + 10.0f * sinf(TAU * i / 36);
+    state.pt_[i] = Type::CellHull;
+    cluster.insert(i);
+  }
+  shape = Shape::of(state, cluster);
+  REQUIRE(36 == shape.size);
+  REQUIRE(Approx(50.0f).margin(0.01f) == shape.x);
+  REQUIRE(Approx(50.0f).margin(0.01f) == shape.y);
+  REQUIRE(Approx(10.0f).margin(0.01f) == shape.gyration);
+  REQUIRE(Approx(shape.major).margin(0.01f) == shape.minor);
+  REQUIRE(0.0f == shape.inner);
+  REQUIRE(Type::Ring == shape.type);
+
+  // a square, torn across the wrapping edges
+  for (int i = 0; i < 36; ++i) {
+    state.px_[i] = std::fmod(w - 4.0f + 1.5f * (i % 6), w);
+    state.py_[i] = 50.0f + 1.5f * (i / 6);
+    state.pt_[i] = 14 == i ? Type::CellCore : Type::CellHull;
+  }
+  shape = Shape::of(state, cluster);
+  REQUIRE(Approx(w - 0.25f).margin(0.01f) == shape.x);
+  REQUIRE(Approx(53.75f).margin(0.01f) == shape.y);
+  REQUIRE(4 == shape.hull);
+  REQUIRE(4 == shape.corners);
+  REQUIRE(1 == shape.cores);
+  REQUIRE(35 == shape.hulls);
+  REQUIRE(Type::SquareCell == shape.type);
+
+  // a triangle, and without a core a premature cell
+  int p = 0;
+  for (int j = 0; j < 8; ++j) {
+    for (int i = 0; i < 8 - j; ++i, ++p) {
+      state.px_[p] = 50.0f + 1.5f * i + 0.75f * j;
+      state.py_[p] = 50.0f + 1.3f * j;
+    }
+  }
+  shape = Shape::of(state, cluster);
+  REQUIRE(3 == shape.corners);
+  REQUIRE(Type::TriangleCell == shape.type);
+  state.pt_[14] = Type::CellHull;
+  REQUIRE(Type::PrematureCell == Shape::of(state, cluster).type);
+
+  // spores go by size
+  cluster.clear();
+  for (int i = 0; i < 20; ++i) {
+    cluster.insert(i);
+  }
+  REQUIRE(Type::MatureSpore == Shape::of(state, cluster).type);
+}
+
+
+TEST_CASE("Shape::of_all")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto clusters = std::vector<std::set<int>>(3);
+  auto shapes = std::vector<Shape>();
+
+  // a pentagon of concentric pentagons, with a core in the middle
+  for (int r = 0; r < 5; ++r) {
+    for (int i = 0; i < 10; ++i) {
+      int p = 10 * r + i;
+      float radius = (2.0f * r + 2.0f) * (0 == i % 2 ? 1.0f : cosf(TAU / 10));
+      state.px_[p] = 100.0f + radius * cosf(TAU * i / 10);
+      state.py_[p] = 100.0f + radius * sinf(TAU * i / 10);
+      state.pt_[p] = 0 == r ? Type::CellCore : Type::CellHull;
+      clusters[0].insert(p);
+    }
+  }
+  for (int p = 50; p < 55; ++p) {
+    state.px_[p] = 10.0f + p;
+    state.py_[p] = 10.0f;
+    clusters[2].insert(p);
+  }
+  Shape::of_all(state, clusters, shapes);
+  REQUIRE(3 == shapes.size());
+  REQUIRE(5 == shapes[0].corners);
+  REQUIRE(Type::PentagonCell == shapes[0].type);
+  REQUIRE(0 == shapes[1].size);
+  REQUIRE(Type::None == shapes[1].type);
+  REQUIRE(Type::None == shapes[2].type);
+}
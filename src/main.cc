@@ -2,10 +2,17 @@
 
 #include "util/common.hh"
 #include "util/log.hh"
+#include "util/philox.hh"
+#include "util/profiler.hh"
 #include "exp/exp.hh"
+#include "proc/runner.hh"
+#include "proc/server.hh"
 #include "view/view.hh"
+#include <algorithm>
+#include <csignal>
 #include <fstream>
 #include <map>
+#include <sstream>
 #include <unistd.h> // getopt, optarg, optopt
 
 
@@ -15,6 +22,9 @@ args(int argc, char* argv[]);
 static void
 argue(Log& log, std::map<std::string,std::string>& opts);
 
+static void
+on_checkpoint_signal(int signal);
+
 
 /// main(): Program entry point containing the processing loop.
 int
@@ -37,12 +47,31 @@ main(int argc, char* argv[])
   if (!opts["exp"].empty()) {
     experiment = std::stoi(opts["exp"]);
   }
+  std::string resume = opts["resume"];
+  if (!resume.empty() && opts["exp"].empty() &&
+      !Control::peek(resume, experiment)) {
+    log.add(Attn::E, "not a checkpoint: " + resume);
+    return -1;
+  }
   bool headless = !opts["headless"].empty();
   std::string init = opts["input"];
   bool no_cl = !opts["nocl"].empty();
   bool gui_on = opts["nogui"].empty();
   bool pause = !opts["pause"].empty();
   bool three = !opts["three"].empty();
+  bool threaded = !opts["threaded"].empty();
+  std::string trajectory = opts["trajectory"];
+  std::string metrics = opts["metrics"];
+  std::string rdf = opts["rdf"];
+  std::string heatmap = opts["heatmap"];
+  std::string checkpoint = opts["checkpoint"];
+  std::string live = opts["live"];
+  std::string steady = opts["steady"];
+  std::string frame = opts["frame"];
+  std::string profile = opts["profile"];
+  std::string seed = opts["seed"];
+  std::string socket_path = opts["socket"];
+  bool particle_noise = !opts["particlenoise"].empty();
 
   /* dependency & observation graph
    * ----------   ...........
@@ -56,23 +85,131 @@ main(int argc, char* argv[])
    */
 
   // system objects
+  Profiler::enable(!profile.empty());
+  if (!seed.empty()) {
+    Philox::reseed(std::stoull(seed)); // before any spawn
+  }
   auto expctrl = ExpControl(log, experiment);
   auto state = State(log, expctrl);
   auto cl = Cl(log); // stub object if OpenCL is unavailable
   auto proc = Proc(log, state, cl, no_cl);
+  proc.particle_noise_ = particle_noise;
   auto exp = Exp(log, expctrl, state, proc, no_cl);
+  if (!metrics.empty()) {
+    exp.metrics(metrics);
+  }
+  if (!rdf.empty()) {
+    // EVERY[,WINDOW[,RADIUS[,BINS]]]
+    std::replace(rdf.begin(), rdf.end(), ',', ' ');
+    std::istringstream words(rdf);
+    unsigned int every = 0;
+    unsigned int window = 10;
+    float radius = 0.0f;
+    unsigned int bins = 64;
+    words >> every >> window >> radius >> bins;
+    exp.rdf(every, window, radius, bins);
+  }
+  if (!heatmap.empty()) {
+    // FILE[,BIN]
+    std::size_t comma = heatmap.rfind(',');
+    float bin = 1.0f;
+    if (std::string::npos != comma) {
+      std::istringstream(heatmap.substr(comma + 1)) >> bin;
+      heatmap.erase(comma);
+    }
+    exp.heatmap(heatmap, bin);
+  }
   auto ctrl = Control(log, state, proc, expctrl, exp, init, pause);
+  if (!trajectory.empty()) {
+    ctrl.record(trajectory);
+  }
+  if (!steady.empty()) {
+    // WINDOW[,T[,WARMUP]] (runs are never ended early otherwise)
+    std::replace(steady.begin(), steady.end(), ',', ' ');
+    std::istringstream words(steady);
+    unsigned int window = 0;
+    float threshold = 2.0f;
+    unsigned int warmup = 0;
+    words >> window >> threshold >> warmup;
+    exp.converge(window, threshold, warmup);
+  }
+  if (!frame.empty()) {
+    // TICKS[,BUDGET]
+    std::replace(frame.begin(), frame.end(), ',', ' ');
+    std::istringstream words(frame);
+    unsigned int ticks = 1;
+    float budget = 10.0f;
+    words >> ticks >> budget;
+    ctrl.pace(ticks, budget);
+  }
+  if (!checkpoint.empty()) {
+    // FILE[,EVERY]
+    std::size_t comma = checkpoint.rfind(',');
+    unsigned int every = 0;
+    if (std::string::npos != comma) {
+      std::istringstream(checkpoint.substr(comma + 1)) >> every;
+      checkpoint.erase(comma);
+    }
+    ctrl.checkpoint_to(checkpoint, every);
+  }
+  if (!resume.empty() && !ctrl.resume(resume)) {
+    return -1;
+  }
+  if (!live.empty()) {
+    // NAME[,EVERY[,SLOTS[,COLORS]]], after resuming for the capacity
+    std::replace(live.begin(), live.end(), ',', ' ');
+    std::istringstream words(live);
+    std::string name;
+    unsigned int every = 1;
+    unsigned int slots = LIVE_SLOTS;
+    unsigned int colors = 0;
+    words >> name >> every >> slots >> colors;
+    if (!ctrl.share(name, every, slots, 0 != colors)) {
+      return -1;
+    }
+  }
+  signal(SIGUSR1, on_checkpoint_signal);
+  std::unique_ptr<Server> server;
+  if (!socket_path.empty()) {
+    server.reset(new Server(log, ctrl, socket_path));
+    if (!server->good()) {
+      return -1;
+    }
+  }
   auto uistate = UiState(ctrl);
   std::unique_ptr<View> view = View::init(log, ctrl, uistate,
                                           headless, gui_on, three);
   log.add(Attn::O, "PID: " + std::to_string(ctrl.pid_), !headless);
+  log.add(Attn::O, "Seed: " + std::to_string(Philox::seed()), !headless);
 
   // execution
   expctrl.message();
   view->intro();
+  std::unique_ptr<Runner> runner;
+  if (threaded) {
+    runner.reset(new Runner(log, ctrl));
+    if (!view->decouple(*runner)) {
+      log.add(Attn::E, "Only the canvas can run apart from the simulation.");
+      runner.reset();
+    }
+  }
+  if (runner) {
+    runner->start();
+    while (runner->running()) {
+      view->exec(); // at display rate, while the simulation thread ticks
+    }
+    runner->stop();
+  }
   while (!ctrl.quit_) {
     ctrl.next();
   }
+  if (!profile.empty()) {
+    if (Profiler::dump(profile)) {
+      log.add(Attn::O, "Profile written to '" + profile + "'.");
+    } else {
+      log.add(Attn::E, "Could not write profile to '" + profile + "'.");
+    }
+  }
 
   return 0;
 }
@@ -85,7 +222,8 @@ usage()
   char* me = strdup(ME);
   me[0] += 0x20;
   std::cout << "Usage: " << me
-            << " -(?h|3|c|e NUM|g|i FILE|p|q|v|x)"
+            << " -(?h|3|c|d SPEC|e NUM|f SPEC|g|H SPEC|i FILE|j|k SPEC|l SPEC|"
+            << "m FILE|N|p|P FILE|q|r FILE|S NUM|s SPEC|t FILE|u FILE|v|x)"
             << std::endl;
   free(me);
 }
@@ -101,6 +239,8 @@ help()
             << "  -?|-h    show this help\n"
             << "  -v       show version\n"
             << "  -c       disable OpenCL\n"
+            << "  -d SPEC  sample g(r) every few ticks, with SPEC being\n"
+            << "             EVERY[,WINDOW[,RADIUS[,BINS]]] (10, 4*scope, 64)\n"
             << "  -e NUM   do an experiment\n"
             << "             occupancy:    [11, 12], [13, 14], [15]\n"
             << "             population:   [2]\n"
@@ -109,8 +249,34 @@ help()
             << "             size & noise: [51, 52, 53], [54, 55, 56]\n"
             << "             param sweep:  [6]\n"
             << "             performance:  [71, 72, 73, 74]\n"
+            << "  -f SPEC  process several ticks per drawn frame, with SPEC\n"
+            << "             being TICKS[,BUDGET] (TICKS of 0 adapts to fill\n"
+            << "             BUDGET ms per frame; 10)\n"
+            << "  -H SPEC  write the heat map of exp 3, with SPEC being\n"
+            << "             FILE[,BIN] (.png or else binary; 1 unit per bin)\n"
             << "  -i FILE  supply an initial state\n"
+            << "  -k SPEC  write checkpoints (also on USR1), with SPEC being\n"
+            << "             FILE[,EVERY] (every EVERY ticks, or 0)\n"
+            << "  -l SPEC  share live frames in shared memory, with SPEC\n"
+            << "             being NAME[,EVERY[,SLOTS[,COLORS]]] (1, 4, 0;\n"
+            << "             read with tapemergence NAME)\n"
+            << "  -m FILE  write experiment results to a file\n"
+            << "             (.csv, .jsonl, .col, or else plain text)\n"
+            << "  -N       draw movement noise per particle, not per tick\n"
             << "  -p       start paused\n"
+            << "  -P FILE  time the phases of ticking and drawing, and write\n"
+            << "             percentiles to FILE (JSON) on quitting\n"
+            << "  -q       suppress logging to stdout (in headless mode, also\n"
+            << "             progress, leaving only the final summary)\n"
+            << "  -r FILE  resume from a checkpoint\n"
+            << "  -S NUM   seed the random numbers, to reproduce a run\n"
+            << "  -s SPEC  end exps 4, 5, 6 early once converged, with SPEC\n"
+            << "             being WINDOW[,T[,WARMUP]] (WINDOW of 0 disables),\n"
+            << "             eg. 2000,2,5000 for exps 4, 5 and 100,2,200 for 6\n"
+            << "  -t FILE  record the trajectory of every tick\n"
+            << "  -u FILE  take requests on a Unix socket at FILE (send\n"
+            << "             'help' for the protocol), eg. with\n"
+            << "             echo stats | nc -U FILE\n"
             << "  -x       run in headless mode\n\n"
             << "Options for graphical mode:\n"
             << "  -3       start in 3d mode\n"
@@ -118,7 +284,7 @@ help()
             << "             C-c, C-q: quit\n"
             << "             Space:    pause/resume\n"
             << "             S:        step\n"
-            << "  -q       suppress logging to stdout\n"
+            << "  -j       simulate on a thread apart from drawing\n"
             << std::endl;
 }
 
@@ -131,30 +297,59 @@ static std::map<std::string,std::string>
 args(int argc, char* argv[])
 {
   std::map<std::string,std::string> opts = {
+    {"checkpoint", ""},
     {"exp", ""},
+    {"frame", ""},
     {"headless", ""},
+    {"heatmap", ""},
     {"input", ""},
+    {"live", ""},
+    {"metrics", ""},
     {"nocl", ""},
     {"nogui", ""},
+    {"particlenoise", ""},
     {"pause", ""},
+    {"profile", ""},
     {"quiet", ""},
     {"quit", ""},
+    {"rdf", ""},
+    {"resume", ""},
+    {"seed", ""},
+    {"socket", ""},
+    {"steady", ""},
     {"return", ""},
-    {"three", ""}
+    {"three", ""},
+    {"threaded", ""},
+    {"trajectory", ""}
   };
   int opt;
-  while (-1 != (opt = getopt(argc, argv, "?3ce:gi:hpqvx"))) {
+  const char* optstring = "?3cd:e:f:gH:i:hjk:l:m:NpP:qr:S:s:t:u:vx";
+  while (-1 != (opt = getopt(argc, argv, optstring))) {
     if ('?' == opt || 'h' == opt) {
       opts["quit"] = "help";
       opts["return"] = "0";
     }
     else if ('3' == opt) { opts["three"] = "."; }
     else if ('c' == opt) { opts["nocl"]  = "."; }
+    else if ('d' == opt) { opts["rdf"]   = optarg; }
     else if ('e' == opt) { opts["exp"]   = optarg; }
+    else if ('f' == opt) { opts["frame"] = optarg; }
     else if ('g' == opt) { opts["nogui"] = "."; }
+    else if ('H' == opt) { opts["heatmap"] = optarg; }
     else if ('i' == opt) { opts["input"] = optarg; }
+    else if ('j' == opt) { opts["threaded"] = "."; }
+    else if ('k' == opt) { opts["checkpoint"] = optarg; }
+    else if ('l' == opt) { opts["live"] = optarg; }
+    else if ('m' == opt) { opts["metrics"] = optarg; }
+    else if ('N' == opt) { opts["particlenoise"] = "."; }
     else if ('p' == opt) { opts["pause"] = "."; }
+    else if ('P' == opt) { opts["profile"] = optarg; }
     else if ('q' == opt) { opts["quiet"] = "."; }
+    else if ('r' == opt) { opts["resume"] = optarg; }
+    else if ('S' == opt) { opts["seed"] = optarg; }
+    else if ('s' == opt) { opts["steady"] = optarg; }
+    else if ('t' == opt) { opts["trajectory"] = optarg; }
+    else if ('u' == opt) { opts["socket"] = optarg; }
     else if ('v' == opt) { opts["quit"] = "version"; opts["return"] = "0"; }
     else if ('x' == opt) { opts["headless"] = "."; }
     else if (':' == opt) { opts["quit"] = "noarg"; opts["return"] = "-1"; }
@@ -233,3 +428,11 @@ argue(Log& log, std::map<std::string,std::string>& opts)
   log.add(Attn::O, message);
 }
 
+
+/// on_checkpoint_signal(): Have a checkpoint written after the current tick.
+/// \param signal  signal number (SIGUSR1)
+static void
+on_checkpoint_signal(int /* signal */)
+{
+  Control::checkpoint_signal_ = 1;
+}
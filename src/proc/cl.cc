@@ -3,9 +3,18 @@
 #if 1 == CL_ENABLED
 
 #include "../util/common.hh"
+#include "../util/philox.hh"
+#include "../util/profiler.hh"
 
 
-Cl::Cl(Log& log)
+// the kernels count and locate with 32-bit atomics and integers, so no
+// compact build runs them (see STATE_COMPACT)
+static_assert(sizeof(Count) == sizeof(cl_uint) &&
+              sizeof(Coord) == sizeof(cl_int),
+              "OpenCL needs 32-bit particle counters and grid coordinates.");
+
+
+Cl::Cl(Log& log, bool any_device /* = false */)
   : log_(log)
 {
   std::vector<cl::Platform> platforms;
@@ -29,6 +38,18 @@ Cl::Cl(Log& log)
     this->device_ = devices.front();
     break;
   }
+  // a CPU device (eg. PoCL) for lack of a GPU, if allowed
+  if (any_device && this->device_.getInfo<CL_DEVICE_NAME>().empty()) {
+    for (auto& platform : platforms) {
+      platform.getDevices(CL_DEVICE_TYPE_CPU, &devices);
+      if (0 == devices.size()) {
+        continue;
+      }
+      this->platform_ = platform;
+      this->device_ = devices.front();
+      break;
+    }
+  }
   std::string name = this->device_.getInfo<CL_DEVICE_NAME>();
   if (name.empty()) {
     log.add(Attn::Ecl, "No device found.");
@@ -36,16 +57,15 @@ Cl::Cl(Log& log)
   }
 
   this->context_ = cl::Context(this->device_);
-  //this->queue_ = cl::CommandQueue(this->context_, this->device_);
-  // profiling
-  this->queue_ = cl::CommandQueue(this->context_, this->device_, CL_QUEUE_PROFILING_ENABLE);
+  // profiling enabled for device time of kernels (see Profiler)
+  this->queue_ = cl::CommandQueue(this->context_, this->device_,
+                                  CL_QUEUE_PROFILING_ENABLE);
   this->max_cu_ = this->device_.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
   this->max_freq_ = this->device_.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
   this->max_gmem_ = this->device_.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
 
   this->prep_seek();
-  //this->prep_naive_seek();
-  this->prep_move();
+  this->prep_move(); // (naive seek is prepared on its first use)
 
   log.add(Attn::O,
           "Started OpenCL module and found\n  device: " + name
@@ -99,10 +119,15 @@ Cl::prep_seek()
     "  bool c_o = false;\n"
     "  bool r_u = false;\n"
     "  bool r_o = false;\n"
-    "  if      (cc == 0)        { c_u = true; c = COLS - 1; }\n"
-    "  else if (cc == COLS - 1) { c_o = true; ccc = 0; }\n"
-    "  if      (rr == 0)        { r_u = true; r = ROWS - 1; }\n"
-    "  else if (rr == ROWS - 1) { r_o = true; rrr = 0; }\n"
+    "  if (cc == 0)        { c_u = true; c = COLS - 1; }\n"
+    "  if (cc == COLS - 1) { c_o = true; ccc = 0; }\n"
+    "  if (rr == 0)        { r_u = true; r = ROWS - 1; }\n"
+    "  if (rr == ROWS - 1) { r_o = true; rrr = 0; }\n"
+    // units recur in small grids: visit each once, at the nearest image
+    "  bool small = COLS < 3 || ROWS < 3;\n"
+    "  if (small) {\n"
+    "    c_u = false; c_o = false; r_u = false; r_o = false;\n"
+    "  }\n"
     "  int vic[54] = {c,   r,   c_u,   false, r_u,   false,\n"
     "                 cc,  r,   false, false, r_u,   false,\n"
     "                 ccc, r,   false, c_o,   r_u,   false,\n"
@@ -125,7 +150,15 @@ Cl::prep_seek()
     "  float srcs;\n"
     "  float dstc;\n"
     "  float dsts;\n"
+    "  bool seen;\n"
     "  for (int v = 0; v < 54; v += 6) {\n"
+    "    seen = false;\n"
+    "    for (int u = 0; small && u < v; u += 6) {\n"
+    "      seen = seen || (vic[u] == vic[v] && vic[u + 1] == vic[v + 1]);\n"
+    "    }\n"
+    "    if (seen) {\n"
+    "      continue;\n"
+    "    }\n"
     "    stride = (COLS * (vic[v + 1] * GSTRIDE)) + (vic[v] * GSTRIDE);\n"
     "    c_u = vic[v + 2];\n"
     "    c_o = vic[v + 3];\n"
@@ -147,6 +180,10 @@ Cl::prep_seek()
     "      dsty = PY[dsti];\n"
     "      dy = dsty - srcy;\n"
     "      if (r_u) { dy -= H; } else if (r_o) { dy += H; }\n"
+    "      if      (dx >  0.5f * W) { dx -= W; }\n"
+    "      else if (dx < -0.5f * W) { dx += W; }\n"
+    "      if      (dy >  0.5f * H) { dy -= H; }\n"
+    "      else if (dy < -0.5f * H) { dy += H; }\n"
     "      dist = (dx * dx) + (dy * dy);\n"
     "      if (SCOPE < dist) {\n"
     "        continue;\n"
@@ -230,11 +267,11 @@ void
 Cl::seek(unsigned int n, unsigned int w, unsigned int h,
          float scope, float ascope, int cols, int rows,
          unsigned int grid_stride, std::vector<int>& grid,
-         std::vector<int>& gcol, std::vector<int>& grow,
-         std::vector<float>& px, std::vector<float>& py,
-         std::vector<float>& pc, std::vector<float>& ps,
-         std::vector<unsigned int>& pn, std::vector<unsigned int>& pan,
-         std::vector<unsigned int>& pl, std::vector<unsigned int>& pr)
+         Column<Coord>& gcol, Column<Coord>& grow,
+         Column<float>& px, Column<float>& py,
+         Column<float>& pc, Column<float>& ps,
+         Column<Count>& pn, Column<Count>& pan,
+         Column<Count>& pl, Column<Count>& pr)
 {
   const cl_uint float_size = n * sizeof(float);
   const cl_uint int_size = n * sizeof(int);
@@ -280,27 +317,20 @@ Cl::seek(unsigned int n, unsigned int w, unsigned int h,
     this->queue_.enqueueWriteBuffer(PAN, CL_TRUE, 0, uint_size, pan.data());
     this->queue_.enqueueWriteBuffer(PL, CL_TRUE, 0, uint_size, pl.data());
     this->queue_.enqueueWriteBuffer(PR, CL_TRUE, 0, uint_size, pr.data());
-    /**
-    // profiling
     cl::Event event;
     this->queue_.enqueueNDRangeKernel(this->kernel_seek_,
                                       cl::NullRange, n, cl::NullRange, NULL,
                                       &event);
-    event.wait();
-    //*/
-    this->queue_.enqueueNDRangeKernel(this->kernel_seek_,
-                                      cl::NullRange, n, cl::NullRange);
     this->queue_.enqueueReadBuffer(PN, CL_TRUE, 0, uint_size, pn.data());
     this->queue_.enqueueReadBuffer(PAN, CL_TRUE, 0, uint_size, pan.data());
     this->queue_.enqueueReadBuffer(PL, CL_TRUE, 0, uint_size, pl.data());
     this->queue_.enqueueReadBuffer(PR, CL_TRUE, 0, uint_size, pr.data());
     this->queue_.finish();
-    /**
-    // profiling
-    std::cout << event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-                 event.getProfilingInfo<CL_PROFILING_COMMAND_START>()
-              << std::endl;
-    //*/
+    if (Profiler::enabled()) {
+      Profiler::add(Phase::SeekDevice,
+                    event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                    event.getProfilingInfo<CL_PROFILING_COMMAND_START>());
+    }
   } catch (cl_int err) {
     this->log_.add(Attn::Ecl, std::to_string(err));
   }
@@ -310,7 +340,7 @@ Cl::seek(unsigned int n, unsigned int w, unsigned int h,
 void
 Cl::prep_move()
 {
-  std::string code =
+  std::string code = Philox::cl_source() +
     "__kernel void particles_move(\n"
     "  __private float TAU,\n"
     "  __private float W,\n"
@@ -319,6 +349,11 @@ Cl::prep_move()
     "  __private float B,\n"
     "  __private float S,\n"
     "  __private float E,\n"
+    "  __private float D,\n"
+    "  __private unsigned int K0,\n"
+    "  __private unsigned int K1,\n"
+    "  __private unsigned int T0,\n"
+    "  __private unsigned int T1,\n"
     "  __global const unsigned int* PN,\n"
     "  __global const unsigned int* PL,\n"
     "  __global const unsigned int* PR,\n"
@@ -330,7 +365,14 @@ Cl::prep_move()
     ") {\n"
     "  int i = get_global_id(0);\n"
     "  int signum = (0 < (int)(PR[i] - PL[i])) - ((int)(PR[i] - PL[i]) < 0);\n"
-    "  float f = fmod(PF[i] + A + (B * PN[i] * (float)signum) + E, TAU);\n"
+    "  float e = E;\n"
+    "  if (0.0f != D) {\n"
+    "    uint w[4];\n"
+    "    philox_words(K0, K1, T0, T1, i, "
+    + std::to_string(static_cast<uint32_t>(Stream::Noise)) + ", w);\n"
+    "    e = D * philox_gauss(w[0], w[1]);\n"
+    "  }\n"
+    "  float f = fmod(PF[i] + A + (B * PN[i] * (float)signum) + e, TAU);\n"
     "  if (f < 0) { f += TAU; }\n"
     "  PF[i] = f;\n"
     "  PC[i] = native_cos(f);\n"
@@ -361,12 +403,13 @@ Cl::prep_move()
 
 void
 Cl::move(unsigned int n, unsigned int w, unsigned int h,
-         float a, float b, float s, float e,
-         std::vector<unsigned int>& pn,
-         std::vector<unsigned int>& pl, std::vector<unsigned int>& pr,
-         std::vector<float>& px, std::vector<float>& py,
-         std::vector<float>& pf,
-         std::vector<float>& pc, std::vector<float>& ps)
+         float a, float b, float s, float e, float d,
+         uint64_t seed, uint64_t tick,
+         Column<Count>& pn,
+         Column<Count>& pl, Column<Count>& pr,
+         Column<float>& px, Column<float>& py,
+         Column<float>& pf,
+         Column<float>& pc, Column<float>& ps)
 {
   const cl_uint float_size = n * sizeof(float);
   const cl_uint uint_size = n * sizeof(unsigned int);
@@ -389,41 +432,39 @@ Cl::move(unsigned int n, unsigned int w, unsigned int h,
     this->kernel_move_.setArg( 4, static_cast<cl_float>(b));
     this->kernel_move_.setArg( 5, static_cast<cl_float>(s));
     this->kernel_move_.setArg( 6, static_cast<cl_float>(e));
-    this->kernel_move_.setArg( 7, PN);
-    this->kernel_move_.setArg( 8, PL);
-    this->kernel_move_.setArg( 9, PR);
-    this->kernel_move_.setArg(10, PX);
-    this->kernel_move_.setArg(11, PY);
-    this->kernel_move_.setArg(12, PF);
-    this->kernel_move_.setArg(13, PC);
-    this->kernel_move_.setArg(14, PS);
+    this->kernel_move_.setArg( 7, static_cast<cl_float>(d));
+    this->kernel_move_.setArg( 8, static_cast<cl_uint>(seed));
+    this->kernel_move_.setArg( 9, static_cast<cl_uint>(seed >> 32));
+    this->kernel_move_.setArg(10, static_cast<cl_uint>(tick));
+    this->kernel_move_.setArg(11, static_cast<cl_uint>(tick >> 32));
+    this->kernel_move_.setArg(12, PN);
+    this->kernel_move_.setArg(13, PL);
+    this->kernel_move_.setArg(14, PR);
+    this->kernel_move_.setArg(15, PX);
+    this->kernel_move_.setArg(16, PY);
+    this->kernel_move_.setArg(17, PF);
+    this->kernel_move_.setArg(18, PC);
+    this->kernel_move_.setArg(19, PS);
     this->queue_.enqueueWriteBuffer(PX, CL_TRUE, 0, float_size, px.data());
     this->queue_.enqueueWriteBuffer(PY, CL_TRUE, 0, float_size, py.data());
     this->queue_.enqueueWriteBuffer(PF, CL_TRUE, 0, float_size, pf.data());
     this->queue_.enqueueWriteBuffer(PC, CL_TRUE, 0, float_size, pc.data());
     this->queue_.enqueueWriteBuffer(PS, CL_TRUE, 0, float_size, ps.data());
-    /**
-    // profiling
     cl::Event event;
     this->queue_.enqueueNDRangeKernel(this->kernel_move_,
                                       cl::NullRange, n, cl::NullRange, NULL,
                                       &event);
-    event.wait();
-    //*/
-    this->queue_.enqueueNDRangeKernel(this->kernel_move_,
-                                      cl::NullRange, n, cl::NullRange);
     this->queue_.enqueueReadBuffer(PX, CL_TRUE, 0, float_size, px.data());
     this->queue_.enqueueReadBuffer(PY, CL_TRUE, 0, float_size, py.data());
     this->queue_.enqueueReadBuffer(PF, CL_TRUE, 0, float_size, pf.data());
     this->queue_.enqueueReadBuffer(PC, CL_TRUE, 0, float_size, pc.data());
     this->queue_.enqueueReadBuffer(PS, CL_TRUE, 0, float_size, ps.data());
     this->queue_.finish();
-    /**
-    // profiling
-    std::cout << event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-                 event.getProfilingInfo<CL_PROFILING_COMMAND_START>()
-              << std::endl;
-    //*/
+    if (Profiler::enabled()) {
+      Profiler::add(Phase::MoveDevice,
+                    event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                    event.getProfilingInfo<CL_PROFILING_COMMAND_START>());
+    }
   } catch (cl_int err) {
     this->log_.add(Attn::Ecl, std::to_string(err));
   }
@@ -442,6 +483,8 @@ Cl::prep_naive_seek()
     "\n"
     "__kernel void particles_naive_seek(\n"
     "  __private unsigned int N,\n"
+    "  __private float W,\n"
+    "  __private float H,\n"
     "  __private float SCOPE,\n"
     "  __private float ASCOPE,\n"
     "  __global const float* PX,\n"
@@ -472,9 +515,13 @@ Cl::prep_naive_seek()
     "    srcx = PX[srci];\n"
     "    dstx = PX[dsti];\n"
     "    dx = dstx - srcx;\n"
+    "    if      (dx >  0.5f * W) { dx -= W; }\n"
+    "    else if (dx < -0.5f * W) { dx += W; }\n"
     "    srcy = PY[srci];\n"
     "    dsty = PY[dsti];\n"
     "    dy = dsty - srcy;\n"
+    "    if      (dy >  0.5f * H) { dy -= H; }\n"
+    "    else if (dy < -0.5f * H) { dy += H; }\n"
     "    dist = (dx * dx) + (dy * dy);\n"
     "    if (SCOPE < dist) {\n"
     "      continue;\n"
@@ -501,7 +548,8 @@ Cl::prep_naive_seek()
     std::string name = "particles_naive_seek";
     cl::Program program(this->context_, code, CL_TRUE);
     int compile_err;
-    this->kernel_seek_ = cl::Kernel(program, name.c_str(), &compile_err);
+    this->kernel_naive_seek_ = cl::Kernel(program, name.c_str(),
+                                          &compile_err);
     if (compile_err) {
       log.add(Attn::Ecl, std::to_string(compile_err) + ": failed to compile '"
               + name + "'.");
@@ -513,15 +561,19 @@ Cl::prep_naive_seek()
 
 
 void
-Cl::naive_seek(unsigned int n, float scope, float ascope,
-               std::vector<float>& px, std::vector<float>& py,
-               std::vector<float>& pc, std::vector<float>& ps,
-               std::vector<unsigned int>& pn, std::vector<unsigned int>& pan,
-               std::vector<unsigned int>& pl, std::vector<unsigned int>& pr)
+Cl::naive_seek(unsigned int n, unsigned int w, unsigned int h,
+               float scope, float ascope,
+               Column<float>& px, Column<float>& py,
+               Column<float>& pc, Column<float>& ps,
+               Column<Count>& pn, Column<Count>& pan,
+               Column<Count>& pl, Column<Count>& pr)
 {
   const cl_uint float_size = n * sizeof(float);
   const cl_uint int_size = n * sizeof(int);
   const cl_uint uint_size = n * sizeof(unsigned int);
+  if (NULL == this->kernel_naive_seek_()) {
+    this->prep_naive_seek();
+  }
   try {
     cl::Buffer PX(this->context_, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
                   float_size, px.data());
@@ -535,22 +587,25 @@ Cl::naive_seek(unsigned int n, float scope, float ascope,
     cl::Buffer PAN(this->context_, CL_MEM_READ_WRITE, uint_size);
     cl::Buffer PL(this->context_, CL_MEM_READ_WRITE, uint_size);
     cl::Buffer PR(this->context_, CL_MEM_READ_WRITE, uint_size);
-    this->kernel_seek_.setArg( 0, static_cast<cl_uint>(n));
-    this->kernel_seek_.setArg( 1, static_cast<cl_float>(scope));
-    this->kernel_seek_.setArg( 2, static_cast<cl_float>(ascope));
-    this->kernel_seek_.setArg( 3, PX);
-    this->kernel_seek_.setArg( 4, PY);
-    this->kernel_seek_.setArg( 5, PC);
-    this->kernel_seek_.setArg( 6, PS);
-    this->kernel_seek_.setArg( 7, PN);
-    this->kernel_seek_.setArg( 8, PAN);
-    this->kernel_seek_.setArg( 9, PL);
-    this->kernel_seek_.setArg(10, PR);
+    cl::Kernel& kernel = this->kernel_naive_seek_;
+    kernel.setArg( 0, static_cast<cl_uint>(n));
+    kernel.setArg( 1, static_cast<cl_float>(w));
+    kernel.setArg( 2, static_cast<cl_float>(h));
+    kernel.setArg( 3, static_cast<cl_float>(scope));
+    kernel.setArg( 4, static_cast<cl_float>(ascope));
+    kernel.setArg( 5, PX);
+    kernel.setArg( 6, PY);
+    kernel.setArg( 7, PC);
+    kernel.setArg( 8, PS);
+    kernel.setArg( 9, PN);
+    kernel.setArg(10, PAN);
+    kernel.setArg(11, PL);
+    kernel.setArg(12, PR);
     this->queue_.enqueueWriteBuffer(PN, CL_TRUE, 0, uint_size, pn.data());
     this->queue_.enqueueWriteBuffer(PAN, CL_TRUE, 0, uint_size, pan.data());
     this->queue_.enqueueWriteBuffer(PL, CL_TRUE, 0, uint_size, pl.data());
     this->queue_.enqueueWriteBuffer(PR, CL_TRUE, 0, uint_size, pr.data());
-    this->queue_.enqueueNDRangeKernel(this->kernel_seek_,
+    this->queue_.enqueueNDRangeKernel(kernel,
                                       cl::NullRange, n, cl::NullRange);
     this->queue_.enqueueReadBuffer(PN, CL_TRUE, 0, uint_size, pn.data());
     this->queue_.enqueueReadBuffer(PAN, CL_TRUE, 0, uint_size, pan.data());
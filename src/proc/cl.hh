@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include "../util/arena.hh"
+#include "../util/common.hh"
 #include "../util/log.hh"
 
 #if 1 == CL_ENABLED
@@ -29,7 +31,9 @@ class Cl
   /// constructor: Initialise the OpenCL device and build the computation
   ///              kernels.
   /// \param log  Log object
-  Cl(Log& log);
+  /// \param any_device  whether to settle for a CPU device (eg. PoCL) if
+  ///                    there is no GPU
+  Cl(Log& log, bool any_device = false);
 
   /// prep_seek(): Pre-build the kernel for performing particle seeking.
   ///              See Proc::plain_seek(), plain_seek_vicinity(), and
@@ -59,11 +63,11 @@ class Cl
   void seek(unsigned int n, unsigned int w, unsigned int h, float scope,
             float ascope, int cols, int rows, unsigned int grid_stride,
             std::vector<int>& grid,
-            std::vector<int>& gcol, std::vector<int>& grow,
-            std::vector<float>& px, std::vector<float>& py,
-            std::vector<float>& pc, std::vector<float>& ps,
-            std::vector<unsigned int>& pn, std::vector<unsigned int>& pan,
-            std::vector<unsigned int>& pl, std::vector<unsigned int>& pr);
+            Column<Coord>& gcol, Column<Coord>& grow,
+            Column<float>& px, Column<float>& py,
+            Column<float>& pc, Column<float>& ps,
+            Column<Count>& pn, Column<Count>& pan,
+            Column<Count>& pl, Column<Count>& pr);
 
   /// prep_move(): Pre-build the kernel for performing particle moving.
   ///              See Proc::plain_move() for the non-OpenCL variant.
@@ -76,7 +80,11 @@ class Cl
   /// \param a  alpha parameter
   /// \param b  beta parameter
   /// \param s  speed parameter
-  /// \param e  noise parameter
+  /// \param e  noise sample (of all particles)
+  /// \param d  noise parameter, if each particle draws its own noise
+  ///           instead (or 0)
+  /// \param seed  seed of the run (see Philox)
+  /// \param tick  tick being processed
   /// \param pn  N particle parameter vector
   /// \param pl  L particle parameter vector
   /// \param pr  R particle parameter vector
@@ -86,26 +94,29 @@ class Cl
   /// \param pc  cos(PHI) particle parameter vector
   /// \param ps  sin(PHI) particle parameter vector
   void move(unsigned int n, unsigned int w, unsigned int h,
-            float a, float b, float s, float e,
-            std::vector<unsigned int>& pn,
-            std::vector<unsigned int>& pl, std::vector<unsigned int>& pr,
-            std::vector<float>& px, std::vector<float>& py,
-            std::vector<float>& pf,
-            std::vector<float>& pc, std::vector<float>& ps);
+            float a, float b, float s, float e, float d,
+            uint64_t seed, uint64_t tick,
+            Column<Count>& pn,
+            Column<Count>& pl, Column<Count>& pr,
+            Column<float>& px, Column<float>& py,
+            Column<float>& pf,
+            Column<float>& pc, Column<float>& ps);
 
   /// prep_naive_seek(): Pre-build the kernel for performing naive particle
   ///                    seeking.
   void prep_naive_seek();
 
-  /// naive_seek: Perform naive particle seeking (for benchmarking).
+  /// naive_seek: Perform naive particle seeking (for benchmarking and
+  ///             checking seek()), comparing every pair of particles.
   ///             See seek() for params.
-  void naive_seek(unsigned int n, float scope, float ascope,
-                  std::vector<float>& px, std::vector<float>& py,
-                  std::vector<float>& pc, std::vector<float>& ps,
-                  std::vector<unsigned int>& pn,
-                  std::vector<unsigned int>& pan,
-                  std::vector<unsigned int>& pl,
-                  std::vector<unsigned int>& pr);
+  void naive_seek(unsigned int n, unsigned int w, unsigned int h,
+                  float scope, float ascope,
+                  Column<float>& px, Column<float>& py,
+                  Column<float>& pc, Column<float>& ps,
+                  Column<Count>& pn,
+                  Column<Count>& pan,
+                  Column<Count>& pl,
+                  Column<Count>& pr);
 
   /// good(): Whether OpenCL is enabled.
   /// \returns  true if OpenCL is enabled
@@ -119,7 +130,8 @@ class Cl
 
   /// constructor: Stub (OpenCL unavailable).
   /// \param log  (unused) Log object
-  inline Cl(Log& /* log */) {}
+  /// \param any_device  (unused) whether to settle for a CPU device
+  inline Cl(Log& /* log */, bool /* any_device */ = false) {}
 
   /// good(): Stub (OpenCL unavailable).
   /// \returns  false
@@ -141,6 +153,7 @@ class Cl
   cl::CommandQueue queue_;
   cl::Kernel       kernel_seek_;
   cl::Kernel       kernel_move_;
+  cl::Kernel       kernel_naive_seek_;
   unsigned int     max_cu_;   // max GPU compute units
   unsigned int     max_freq_; // max GPU frequency
   unsigned int     max_gmem_; // max global memory
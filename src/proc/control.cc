@@ -1,9 +1,21 @@
 #include "control.hh"
+#include "../state/snapshot.hh"
+#include "../util/binary.hh"
 #include "../util/common.hh"
+#include "../util/philox.hh"
+#include "../util/profiler.hh"
 #include "../util/util.hh"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <sstream>
+#include <stdio.h> // rename
+
+
+#define CHECKPOINT_VERSION 7
+
+
+volatile std::sig_atomic_t Control::checkpoint_signal_ = 0;
 
 
 Control::Control(Log& log, State& state, Proc& proc, ExpControl& expctrl,
@@ -16,85 +28,31 @@ Control::Control(Log& log, State& state, Proc& proc, ExpControl& expctrl,
   this->tick_ = 0;
   this->step_ = false;
   this->quit_ = false;
+  this->dpe_ = 0.0f;
+  this->checkpoint_path_ = "emergence." + std::to_string(this->pid_)
+                           + ".checkpoint";
+  this->checkpoint_every_ = 0;
+  this->live_every_ = 1;
+  this->saver_.reset(new Saver(log));
+  this->pace_ticks_ = 1;
+  this->pace_budget_ = 10000.0f;
+  this->pace_tick_ = 0.0f;
+  this->pace_ = 1;
   if (!init_path.empty()) {
     this->load(init_path);
   }
   expctrl.control(*this);
   this->countdown_ = this->duration_;
   this->gui_change_ = false;
-  this->profile_ago_ = std::chrono::steady_clock::now();
-  this->profile_fps_ = 0;
-  this->profile_count_ = 0;
-  //this->profile_max_ = 10;
-  this->profile_max_ = 120;
 
   log.add(Attn::O, "Started control module.");
 }
 
 
-void
-Control::profile()
-{
-  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-  ++this->profile_fps_;
-  int since = std::chrono::duration_cast<std::chrono::microseconds>(
-    now - this->profile_ago_).count();
-  if (1000000 > since) {
-    this->profile_last_ = now;
-    return;
-  }
-  if (this->profile_max_ <= this->profile_count_) {
-    this->quit();
-    return;
-  }
-  int last = std::chrono::duration_cast<std::chrono::microseconds>(
-    now - this->profile_last_).count();
-  std::cout << this->profile_fps_ + static_cast<float>(since - 1000000) / last
-            << "\n";
-  this->profile_fps_ = 0;
-  this->profile_ago_ = now;
-  ++this->profile_count_;
-  /**
-  if (this->profile_max_ <= this->profile_count_) {
-    this->profile_count_ = 0;
-    State& state = this->state_;
-    float dpe = 0.002f + static_cast<float>(state.num_) / state.width_ / state.height_;
-    unsigned int w = state.width_ + 50;
-    unsigned int h = state.height_ + 50;
-    int n = static_cast<int>(w * h * dpe);
-    float v = state.scope_ + 2.0f;
-    if (1500 < w) {
-      this->quit();
-      return;
-    }
-    std::cout << "\nw" << w << ",h" << h << ",d" << dpe << ",v" << v << ":";
-    Stative stative = {
-      -1, n, w, h,
-      state.alpha_, state.beta_,
-      v, v * 0.26f,
-      state.speed_, 0.0f, state.prad_, state.coloring_
-    };
-    this->duration_ = 1;
-    this->change(stative, true);
-    this->gui_change_ = true; // let UiState reflect true State
-    return;
-  }
-  int last = std::chrono::duration_cast<std::chrono::microseconds>(
-    now - this->profile_last_).count();
-  std::cout << " "
-            << this->profile_fps_ + static_cast<float>(since - 1000000) / last;
-  this->profile_fps_ = 0;
-  this->profile_ago_ = now;
-  ++this->profile_count_;
-  //*/
-}
-
-
 void
 Control::next()
 {
-  //this->profile();
-
+  this->saver_->report(); // outcomes of background saves
   // when countdown drops to 0, Proc should exclaim completion
   Proc& proc = this->proc_;
   long long countdown = this->countdown_;
@@ -109,17 +67,85 @@ Control::next()
     return;
   }
 
+  // several ticks per frame, but stop short of the countdown, of pausing
+  // (stepping, or by an experiment), and of quitting
+  unsigned int ticks = this->step_ ? 1 : this->pace_;
+  unsigned int done = 0;
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  do {
+    this->tick();
+    ++done;
+  } while (done < ticks && 0 != this->countdown_ && !this->paused_ &&
+           !this->quit_);
+  float took = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  proc.notify(Issue::ProcNextDone); // Views react, once per frame
+
+  if (0 == this->pace_ticks_) {
+    float per = took / done;
+    this->pace_tick_ = 0.0f < this->pace_tick_ ?
+                       0.8f * this->pace_tick_ + 0.2f * per : per;
+    float fit = this->pace_budget_ / std::max(this->pace_tick_, 1.0f);
+    this->pace_ = static_cast<unsigned int>(
+      std::min(std::max(fit, 1.0f), static_cast<float>(CONTROL_PACE_MAX)));
+  }
+}
+
+
+void
+Control::tick()
+{
+  PROFILE(Tick);
   Exp& exp = this->exp_;
 
-  exp.type();
-  proc.next();
-  this->expctrl_.next(exp, *this);
+  {
+    PROFILE(Type);
+    exp.type();
+  }
+  this->proc_.tick_ = this->tick_;
+  this->proc_.next(false);
+  {
+    PROFILE(Exp);
+    this->expctrl_.next(exp, *this);
+  }
   this->step_ = false;
   ++this->tick_;
-  if (-1 >= countdown) {
-    return;
+  if (this->trajectory_) {
+    this->trajectory_->record(this->tick_, this->state_);
+  }
+  if (this->live_ && 0 == this->tick_ % this->live_every_) {
+    if (this->live_->colors()) {
+      // (only the GUI colors each frame otherwise)
+      this->color(static_cast<Coloring>(this->state_.coloring_));
+    }
+    this->live_->publish(this->tick_, this->state_);
+  }
+  if (-1 < this->countdown_) {
+    --this->countdown_;
   }
-  --this->countdown_;
+  if (Control::checkpoint_signal_ ||
+      (this->checkpoint_every_ && 0 == this->tick_ % this->checkpoint_every_)) {
+    Control::checkpoint_signal_ = 0;
+    this->checkpoint(this->checkpoint_path_);
+  }
+}
+
+
+void
+Control::pace(unsigned int ticks, float budget /* = 10.0f */)
+{
+  this->pace_ticks_ = ticks;
+  this->pace_budget_ = 1000.0f * budget;
+  this->pace_tick_ = 0.0f;
+  this->pace_ = 0 < ticks ? ticks : 1;
+  std::ostringstream message;
+  if (0 < ticks) {
+    message << "Pacing " << ticks << " tick(s) per frame.";
+  } else {
+    message << "Pacing ticks to fill " << budget << " ms per frame.";
+  }
+  this->log_.add(Attn::O, message.str());
 }
 
 
@@ -197,10 +223,34 @@ Control::save(const std::string& path)
 }
 
 
+void
+Control::save_background(const std::string& path)
+{
+  std::unique_ptr<Snapshot::Image> image(new Snapshot::Image());
+  Snapshot::take(this->state_, this->duration_, *image);
+  this->saver_->save(path, std::move(image));
+  this->log_.add(Attn::O, "Saving state to '" + path + "' in the background.");
+}
+
+
 bool
 Control::load_file(const std::string& path)
 {
   State& truth = this->state_;
+  if (Snapshot::is(path)) {
+    long long duration = this->duration_;
+    if (!Snapshot::load(path, truth, duration)) {
+      return false;
+    }
+    this->duration_ = duration;
+    this->countdown_ = duration;
+    this->tick_ = 0;
+    if (0 == truth.num_) {
+      truth.num_ = 1000;
+      truth.spawn();
+    }
+    return true;
+  }
   std::ifstream stream(path);
   if (!stream) {
     return false;
@@ -237,12 +287,10 @@ Control::load_file(const std::string& path)
 
   float w = static_cast<float>(truth.width_);
   float h = static_cast<float>(truth.height_);
-  unsigned int n_stride = truth.n_stride_;
   unsigned int i;
   float px;
   float py;
   float pf;
-  float pf_rad;
   unsigned int count = 0;
   truth.clear();
   while (std::getline(stream, line)) {
@@ -256,28 +304,11 @@ Control::load_file(const std::string& path)
     if (!(linestream >> py)) { py = Util::distr(0.0f, h); }
     truth.py_.push_back(py);
     if (!(linestream >> pf)) { pf = Util::distr(0.0f, 360.0f); }
-    pf_rad = Util::deg_to_rad(pf);
-    truth.pf_.push_back(pf_rad);
-    truth.pc_.push_back(cosf(pf_rad));
-    truth.ps_.push_back(sinf(pf_rad));
-    truth.pn_.push_back(0);
-    truth.pl_.push_back(0);
-    truth.pr_.push_back(0);
-    truth.pan_.push_back(0);
-    for (int j = 0; j < n_stride; ++j) { truth.pls_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { truth.prs_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { truth.pld_.push_back(-1.0f); }
-    for (int j = 0; j < n_stride; ++j) { truth.prd_.push_back(-1.0f); }
-    truth.pt_.push_back(Type::None);
-    truth.gcol_.push_back(0);
-    truth.grow_.push_back(0);
-    truth.xr_.push_back(1.0f);
-    truth.xg_.push_back(1.0f);
-    truth.xb_.push_back(1.0f);
-    truth.xa_.push_back(0.5f);
+    truth.pf_.push_back(Util::deg_to_rad(pf));
     ++count;
   }
-  truth.num_ = count;
+  truth.num_ = 0;
+  truth.complete(); // derive the other parameters in bulk
   if (0 == count) {
     truth.num_ = 1000;
     truth.spawn();
@@ -290,32 +321,169 @@ Control::load_file(const std::string& path)
 bool
 Control::save_file(const std::string& path)
 {
-  State& truth = this->state_;
-  std::ofstream stream(path);
-  if (!stream) {
+  Snapshot::Image image;
+  Snapshot::take(this->state_, this->duration_, image);
+  return Snapshot::write(path, image);
+}
+
+
+bool
+Control::checkpoint(const std::string& path)
+{
+  std::string part = path + ".part";
+  std::ofstream stream(part, std::ios::binary | std::ios::trunc);
+  bool good = static_cast<bool>(stream);
+  if (good) {
+    stream.write("EMCK", 4);
+    Binary::put<uint32_t>(stream, CHECKPOINT_VERSION);
+    Binary::put<int32_t>(stream, this->expctrl_.experiment_);
+    Binary::put<uint64_t>(stream, this->tick_);
+    Binary::put<int64_t>(stream, this->countdown_);
+    Binary::put<int64_t>(stream, this->duration_);
+    Binary::put(stream, this->dpe_);
+    Binary::put<uint64_t>(stream, Philox::seed());
+    Binary::put<uint64_t>(stream, this->state_.spawns_);
+    for (unsigned int r = 0; r < UTIL_RNGS; ++r) {
+      std::ostringstream engine;
+      engine << Util::rng(r);
+      Binary::put(stream, engine.str());
+    }
+    this->state_.checkpoint(stream);
+    good = this->exp_.checkpoint(stream);
+    stream.write("EMCX", 4);
+    stream.close();
+    good = good && static_cast<bool>(stream);
+  }
+  if (!good || 0 != rename(part.c_str(), path.c_str())) {
+    ::remove(part.c_str());
+    this->log_.add(Attn::E, "Could not write checkpoint to '" + path + "'.");
+    return false;
+  }
+  this->log_.add(Attn::O, "Wrote checkpoint of tick "
+                          + std::to_string(this->tick_) + " to '" + path
+                          + "'.");
+  return true;
+}
+
+
+void
+Control::checkpoint_to(const std::string& path, unsigned int every)
+{
+  if (!path.empty()) {
+    this->checkpoint_path_ = path;
+  }
+  this->checkpoint_every_ = every;
+}
+
+
+bool
+Control::resume(const std::string& path)
+{
+  std::ifstream stream(path, std::ios::binary);
+  char magic[4];
+  uint32_t version;
+  int32_t experiment;
+  uint64_t tick;
+  int64_t countdown;
+  int64_t duration;
+  float dpe;
+  uint64_t seed;
+  uint64_t spawns;
+  std::string engines[UTIL_RNGS];
+  auto fail = [this, &path](const std::string& why) {
+    this->log_.add(Attn::E, "Could not resume from '" + path + "': " + why);
+    return false;
+  };
+
+  if (!stream.read(magic, 4) || 0 != std::string(magic, 4).compare("EMCK")) {
+    return fail("not a checkpoint.");
+  }
+  if (!Binary::get(stream, version) || CHECKPOINT_VERSION != version) {
+    return fail("unsupported version.");
+  }
+  if (!Binary::get(stream, experiment) ||
+      this->expctrl_.experiment_ != experiment) {
+    return fail("checkpoint is of experiment " + std::to_string(experiment)
+                + ".");
+  }
+  if (!Binary::get(stream, tick) || !Binary::get(stream, countdown) ||
+      !Binary::get(stream, duration) || !Binary::get(stream, dpe) ||
+      !Binary::get(stream, seed) || !Binary::get(stream, spawns)) {
+    return fail("truncated.");
+  }
+  for (std::string& engine : engines) {
+    if (!Binary::get(stream, engine)) {
+      return fail("truncated.");
+    }
+  }
+  if (!this->state_.restore(stream) || !this->exp_.restore(stream) ||
+      !stream.read(magic, 4) || 0 != std::string(magic, 4).compare("EMCX")) {
+    return fail("truncated; the run is left in an undefined state.");
+  }
+  Philox::reseed(seed); // before the engines, which it would seed
+  this->state_.spawns_ = spawns; // so that respawns draw as they would have
+  for (unsigned int r = 0; r < UTIL_RNGS; ++r) {
+    std::istringstream(engines[r]) >> Util::rng(r);
+  }
+  this->tick_ = tick;
+  this->countdown_ = countdown;
+  this->duration_ = duration;
+  this->dpe_ = dpe;
+  this->gui_change_ = true; // let UiState reflect true State
+  this->log_.add(Attn::O, "Resumed from tick " + std::to_string(tick)
+                          + " of '" + path + "'.");
+  return true;
+}
+
+
+bool
+Control::peek(const std::string& path, int& experiment)
+{
+  std::ifstream stream(path, std::ios::binary);
+  char magic[4];
+  uint32_t version;
+  int32_t e;
+
+  if (!stream.read(magic, 4) || 0 != std::string(magic, 4).compare("EMCK") ||
+      !Binary::get(stream, version) || !Binary::get(stream, e)) {
     return false;
   }
-  stream << this->duration_ << ' '
-         << truth.width_ << ' '
-         << truth.height_ << ' '
-         << Util::rad_to_deg(truth.alpha_) << ' '
-         << Util::rad_to_deg(truth.beta_) << ' '
-         << truth.scope_ << ' '
-         << truth.ascope_ << ' '
-         << truth.speed_ << ' '
-         << Util::rad_to_deg(truth.noise_) << ' '
-         << truth.prad_ << '\n';
-  for (int i = 0; i < truth.num_; ++i) {
-    stream << i << ' '
-           << truth.px_[i] << ' '
-           << truth.py_[i] << ' '
-           << Util::rad_to_deg(truth.pf_[i]) << '\n';
-  }
-  stream.close();
+  experiment = e;
   return true;
 }
 
 
+bool
+Control::record(const std::string& path, unsigned int keyframe /* = 100 */)
+{
+  this->trajectory_.reset(); // finish previous recording first
+  this->trajectory_.reset(new Trajectory(this->log_, path, keyframe));
+  if (this->trajectory_->good()) {
+    return true;
+  }
+  this->trajectory_.reset();
+  return false;
+}
+
+
+bool
+Control::share(const std::string& name, unsigned int every /* = 1 */,
+               unsigned int slots /* = LIVE_SLOTS */,
+               bool colors /* = false */)
+{
+  this->live_.reset(); // stop previous sharing first
+  unsigned int num = static_cast<unsigned int>(std::max(this->state_.num_, 1));
+  this->live_every_ = std::max(every, 1u);
+  this->live_.reset(new Live(this->log_, name, LIVE_HEADROOM * num, slots,
+                             this->live_every_, colors));
+  if (this->live_->good()) {
+    return true;
+  }
+  this->live_.reset();
+  return false;
+}
+
+
 void
 Control::pause(bool yesno)
 {
@@ -363,7 +531,10 @@ Control::reset_exp()
 std::string
 Control::color(Coloring scheme)
 {
-  this->exp_.color(scheme);
+  {
+    PROFILE(Color);
+    this->exp_.color(scheme);
+  }
 
   std::string which;
   if      (Coloring::Original  == scheme) { which = "original"; }
@@ -443,3 +614,17 @@ Control::inject(Type type, bool greater)
   return message.str();
 }
 
+
+std::vector<int>
+Control::remove(const std::vector<unsigned int>& particles)
+{
+  State& state = this->state_;
+  unsigned int num = state.num_;
+
+  std::vector<int> remap = state.remove(particles); // Canvas reacts
+  this->exp_.remap(remap);
+  this->log_.add(Attn::O, "Removed " + std::to_string(num - state.num_) +
+                 " particles.");
+  return remap;
+}
+
@@ -13,10 +13,18 @@
 #include "proc.hh"
 #include "../exp/control.hh"
 #include "../exp/exp.hh"
+#include "../state/live.hh"
+#include "../state/saver.hh"
+#include "../state/trajectory.hh"
 #include <chrono>
+#include <csignal>
+#include <memory>
 
 
-enum class Type;
+#define CONTROL_PACE_MAX 100000 // most ticks per frame when adapting
+
+
+enum class Type : uint8_t;
 enum class Coloring;
 class Exp;
 class ExpControl;
@@ -60,6 +68,13 @@ class Control
   /// next(): Handle processing iteration, pausing, ticking, etc.
   void next();
 
+  /// pace(): Set how many ticks to process per next() (per drawn frame).
+  ///         Only the last of them notifies Views, so the ticks in between
+  ///         cost no drawing.
+  /// \param ticks  fixed number of ticks, or 0 to adapt to the budget
+  /// \param budget  milliseconds of ticking per frame to aim for (adapting)
+  void pace(unsigned int ticks, float budget = 10.0f);
+
   /// exp_next(): Handle experimentation.
   void exp_next();
 
@@ -84,6 +99,12 @@ class Control
   /// \returns  whether the save was successful
   bool save(const std::string& path);
 
+  /// save_background(): Record the current state without waiting for the
+  ///                    file to be written. Only the columns get copied
+  ///                    here, and the outcome is logged on a later next().
+  /// \param path  path to the file to save the current state to
+  void save_background(const std::string& path);
+
   /* state file format
    *
    * - Delimited by horizontal space (' ') and vertical space ('\n')
@@ -97,16 +118,74 @@ class Control
    * ...
    */
 
-  /// load_file(): Parse a file containing an initialising State.
+  /// load_file(): Parse a file containing an initialising State, or map it
+  ///              if it is a binary snapshot (see Snapshot).
   /// \param path  path to the file containing an initial state
   /// \returns  whether the load was successful
   bool load_file(const std::string& path);
 
-  /// save_file(): Write the current State to a file.
+  /// save_file(): Write the current State to a file, as a binary snapshot if
+  ///              the path ends in SNAPSHOT_EXTENSION.
   /// \param path  path to the file to save the current state to
   /// \returns  whether the save was successful
   bool save_file(const std::string& path);
 
+  /// checkpoint(): Write everything needed to continue the run exactly
+  ///               (ticking, State, Exp, and random number engines).
+  ///               The file is replaced only once it has been written whole.
+  /// \param path  path to the checkpoint file
+  /// \returns  whether the checkpoint was written
+  bool checkpoint(const std::string& path);
+
+  /// checkpoint_to(): Configure periodic checkpoints (and where SIGUSR1
+  ///                  writes a checkpoint to).
+  /// \param path  path to the checkpoint file
+  /// \param every  number of ticks between checkpoints (0 for none)
+  void checkpoint_to(const std::string& path, unsigned int every);
+
+  /// resume(): Continue a run from a checkpoint.
+  ///           The experiment being performed must be the checkpoint's.
+  /// \param path  path to the checkpoint file
+  /// \returns  whether the run was restored
+  bool resume(const std::string& path);
+
+  /// peek(): Get the experiment of a checkpoint, without restoring it.
+  /// \param path  path to the checkpoint file
+  /// \param experiment  destination of experiment
+  /// \returns  whether the file is a checkpoint
+  static bool peek(const std::string& path, int& experiment);
+
+  /* checkpoint file format (native endianness)
+   *
+   * "EMCK" VERSION(u32) EXPERIMENT(i32)
+   * TICK(u64) COUNTDOWN(i64) DURATION(i64) DPE(f32) SEED(u64) // see Philox
+   * SPAWNS(u64)                    // see State::spawns_
+   * RNG0(str) RNG1(str) RNG2(str) // engine states (see Util::rng())
+   * STATE                          // see State::checkpoint()
+   * EXP                            // see Exp::checkpoint()
+   * "EMCX"
+   *
+   * - where str is LENGTH(u64) followed by LENGTH bytes, and vectors are
+   *   likewise prefixed by their size.
+   */
+
+  /// record(): Start recording the particles of every following tick.
+  /// \param path  path to the trajectory file
+  /// \param keyframe  number of ticks between keyframes
+  /// \returns  whether recording has started
+  bool record(const std::string& path, unsigned int keyframe = 100);
+
+  /// share(): Start publishing the particles of every few ticks to shared
+  ///          memory (see Live), with room for LIVE_HEADROOM times as many
+  ///          particles as there are now.
+  /// \param name  name of the shared memory
+  /// \param every  number of ticks between frames
+  /// \param slots  number of frames in the ring
+  /// \param colors  whether frames hold colors
+  /// \returns  whether publishing has started
+  bool share(const std::string& name, unsigned int every = 1,
+             unsigned int slots = LIVE_SLOTS, bool colors = false);
+
   // Proc /////////////////////////////////////////////////////////////////////
 
   /// Observer pattern helpers for at/de-taching View to Proc.
@@ -154,6 +233,12 @@ class Control
   /// \returns  analysis result message
   std::string inject(Type type, bool greater);
 
+  /// remove(): Remove particles from State, keeping the order of the rest,
+  ///           and let Exp and the views follow the remaining particles.
+  /// \param particles  indices of particles to remove
+  /// \returns  new index per old index (-1 if removed)
+  std::vector<int> remove(const std::vector<unsigned int>& particles);
+
   // members //////////////////////////////////////////////////////////////////
 
   Exp&        exp_;
@@ -170,16 +255,24 @@ class Control
   bool          gui_change_;
   float         dpe_;
 
+  static volatile std::sig_atomic_t checkpoint_signal_; // set on SIGUSR1
+
  private:
-  /// profile(): Print the framerate.
-  void profile();
+  /// tick(): Process one tick (Proc, Exp, recording, sharing,
+  ///         checkpointing).
+  void tick();
 
   Log&     log_;
   Proc&    proc_;
-  std::chrono::steady_clock::time_point profile_ago_;
-  std::chrono::steady_clock::time_point profile_last_;
-  unsigned int profile_fps_;
-  unsigned int profile_count_;
-  unsigned int profile_max_;
+  std::unique_ptr<Trajectory> trajectory_; // recorder (if recording)
+  std::unique_ptr<Saver> saver_;           // background file writer
+  std::unique_ptr<Live> live_;             // publisher (if sharing)
+  unsigned int live_every_;                // ticks between shared frames
+  unsigned int pace_ticks_;  // ticks per next() (0 if adapting)
+  float        pace_budget_; // microseconds of ticking per next() (adapting)
+  float        pace_tick_;   // microseconds per tick, moving average
+  unsigned int pace_;        // ticks for the next next()
+  std::string  checkpoint_path_;  // destination of checkpoints
+  unsigned int checkpoint_every_; // ticks between checkpoints (0 if none)
 };
 
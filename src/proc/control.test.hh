@@ -1,4 +1,5 @@
 #include "control.hh"
+#include "../state/snapshot.hh"
 #include "../util/util.hh"
 #include <stdio.h>
 
@@ -163,3 +164,154 @@ TEST_CASE("Control::save")
   REQUIRE("1" == words[0]);
 }
 
+
+TEST_CASE("Control::save snapshot")
+{
+  std::string f = TESTFILE SNAPSHOT_EXTENSION;
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  auto state2 = State(log, expctrl);
+  auto proc2 = Proc(log, state2, cl, true);
+  auto exp2 = Exp(log, expctrl, state2, proc2, true);
+  auto ctrl2 = Control(log, state2, proc2, expctrl, exp2, "", false);
+
+  proc.next();
+  exp.type();
+  state.speed_ = 0.5f;
+  ctrl.duration_ = 123;
+  REQUIRE(ctrl.save(f));
+  REQUIRE(Snapshot::is(f));
+  REQUIRE(!Snapshot::is(TESTFILE));
+  Stative loaded = ctrl2.load(f);
+  REQUIRE(state.num_ == loaded.num);
+  REQUIRE(123 == ctrl2.duration_);
+  REQUIRE(0.5f == state2.speed_);
+  REQUIRE(state.alpha_ == state2.alpha_);
+  REQUIRE(state.px_ == state2.px_);
+  REQUIRE(state.py_ == state2.py_);
+  REQUIRE(state.pf_ == state2.pf_); // exact, unlike the text format
+  REQUIRE(state.pc_ == state2.pc_);
+  REQUIRE(state.pt_ == state2.pt_);
+  REQUIRE(state.xr_ == state2.xr_);
+  REQUIRE(state.xa_ == state2.xa_);
+  REQUIRE(state.pls_.size() == state2.pls_.size());
+  rm_file(f);
+}
+
+
+
+TEST_CASE("Control::checkpoint")
+{
+  std::string f = TESTFILE;
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  Stative stative = {
+    100, 500, 100, 100,
+    state.alpha_, state.beta_, state.scope_, state.ascope_,
+    state.speed_, Util::deg_to_rad(10.0f), state.prad_, state.coloring_
+  };
+  ctrl.change(stative, true);
+  exp.injected_ = {1, 2, 3};
+  for (int i = 0; i < 5; ++i) {
+    ctrl.next();
+  }
+  REQUIRE(ctrl.checkpoint(f));
+  for (int i = 0; i < 5; ++i) {
+    ctrl.next();
+  }
+  int experiment = -1;
+  REQUIRE(Control::peek(f, experiment));
+  REQUIRE(0 == experiment);
+
+  // continuing from the checkpoint gives the very same run
+  auto state2 = State(log, expctrl);
+  auto proc2 = Proc(log, state2, cl, true);
+  auto exp2 = Exp(log, expctrl, state2, proc2, true);
+  auto ctrl2 = Control(log, state2, proc2, expctrl, exp2, "", false);
+  REQUIRE(ctrl2.resume(f));
+  REQUIRE(5 == ctrl2.tick_);
+  REQUIRE(95 == ctrl2.countdown_);
+  REQUIRE(500 == state2.num_);
+  REQUIRE(Approx(Util::deg_to_rad(10.0f)) == state2.noise_);
+  REQUIRE(std::vector<unsigned int>{1, 2, 3} == exp2.injected_);
+  for (int i = 0; i < 5; ++i) {
+    ctrl2.next();
+  }
+  REQUIRE(state.px_ == state2.px_);
+  REQUIRE(state.py_ == state2.py_);
+  REQUIRE(state.pf_ == state2.pf_);
+  REQUIRE(state.pt_ == state2.pt_);
+  ctrl.change(stative, true);
+  ctrl2.change(stative, true);
+  REQUIRE(state.px_ == state2.px_); // respawns too
+
+  // only into the same experiment
+  auto expctrl3 = ExpControl(log, 2);
+  auto ctrl3 = Control(log, state2, proc2, expctrl3, exp2, "", false);
+  REQUIRE_FALSE(ctrl3.resume(f));
+  rm_file(f);
+}
+
+
+TEST_CASE("Control::pace")
+{
+  struct Frames : Observer
+  {
+    unsigned int count = 0;
+    void react(Issue issue) override
+    {
+      this->count += Issue::ProcNextDone == issue;
+    }
+  } frames;
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  Stative stative = {
+    12, 200, 100, 100,
+    state.alpha_, state.beta_, state.scope_, state.ascope_,
+    state.speed_, state.noise_, state.prad_, state.coloring_
+  };
+  ctrl.change(stative, true);
+  ctrl.countdown_ = ctrl.duration_;
+  ctrl.attach_to_proc(frames);
+
+  // fixed, but short of the countdown, and one tick when stepping
+  ctrl.pace(5);
+  ctrl.next();
+  REQUIRE(5 == ctrl.tick_);
+  REQUIRE(1 == frames.count);
+  ctrl.next();
+  ctrl.next();
+  REQUIRE(12 == ctrl.tick_);
+  REQUIRE(0 == ctrl.countdown_);
+  REQUIRE(3 == frames.count);
+  ctrl.next(); // done
+  REQUIRE(ctrl.paused_);
+  ctrl.step_ = true;
+  ctrl.next();
+  REQUIRE(13 == ctrl.tick_);
+
+  // adapting to a budget fills it with more than one tick
+  ctrl.pause(false);
+  ctrl.countdown_ = -1;
+  ctrl.pace(0, 5.0f);
+  ctrl.next();
+  unsigned long tick = ctrl.tick_;
+  ctrl.next();
+  REQUIRE(1 < ctrl.tick_ - tick);
+  ctrl.detach_from_proc(frames);
+}
@@ -1,80 +1,107 @@
 #include "proc.hh"
 #include "../util/common.hh"
+#include "../util/philox.hh"
+#include "../util/profiler.hh"
 #include "../util/util.hh"
-#include <chrono>
+#include <algorithm>
+#include <limits>
 #include <GL/glew.h>
 
 
 Proc::Proc(Log& log, State& state, Cl& cl, bool no_cl)
-  : state_(state), cl_(cl)
+  : state_(state), log_(log), cl_(cl)
 {
+  this->clamped_ = false;
   this->cl_good_ = this->cl_.good();
+  this->type_ = true;
+  this->typed_ = false;
+  this->nearest_ = false;
+  this->particle_noise_ = false;
+  this->tick_ = 0;
   if (no_cl) {
     this->cl_good_ = false;
   }
   if (!this->cl_good_) {
     log.add(Attn::O, "Proceeding without OpenCL parallelisation.");
   }
+  state.attach(*this);
   log.add(Attn::O, "Started process module.");
 }
 
 
+Proc::~Proc()
+{
+  this->state_.detach(*this);
+}
+
+
 void
-Proc::next()
+Proc::react(Issue issue)
 {
-  /**
-  // profiling
-  std::chrono::steady_clock::time_point now;
-  std::chrono::steady_clock::time_point then;
-  int since;
-  now = std::chrono::steady_clock::now();
-  //*/
+  if (Issue::StateChanged == issue || Issue::StateRemapped == issue) {
+    this->typed_ = false; // pt_ no longer matches the particles
+  }
+}
 
+
+void
+Proc::next(bool notify /* = true */)
+{
   this->clear();
 
 #if 1 == CL_ENABLED
 
   if (this->cl_good_) {
-    this->seek();
-    this->move();
-    this->notify(Issue::ProcNextDone); // Views react
+    {
+      PROFILE(Seek);
+      this->seek();
+    }
+    {
+      PROFILE(Move);
+      this->move();
+    }
+    if (notify) {
+      this->notify(Issue::ProcNextDone); // Views react
+    }
     return;
   }
 
 #endif /* CL_ENABLED */
 
-  this->plain_seek(this->state_.scope_, this->grid_,
-                   this->grid_cols_, this->grid_rows_, this->grid_stride_,
-                   &Proc::tally_neighborhood);
-  this->plain_move();
-  this->notify(Issue::ProcNextDone); // Views react
-
-  /**
-  // profiling
-  then = std::chrono::steady_clock::now();
-  since = std::chrono::duration_cast<std::chrono::nanoseconds>(
-    then - now).count();
-  std::cout << since << std::endl;
-  //*/
+  {
+    PROFILE(Seek);
+    this->plain_seek(this->state_.scope_, this->grid_,
+                     this->grid_cols_, this->grid_rows_, this->grid_stride_,
+                     &Proc::tally_neighborhood);
+  }
+  {
+    PROFILE(Move);
+    this->plain_move();
+  }
+  if (notify) {
+    this->notify(Issue::ProcNextDone); // Views react
+  }
 }
 
 
 void
 Proc::clear()
 {
+  PROFILE(Clear);
   State& state = this->state_;
-  std::vector<unsigned int>& pn = state.pn_;
-  std::vector<unsigned int>& pl = state.pl_;
-  std::vector<unsigned int>& pr = state.pr_;
-  std::vector<unsigned int>& pan = state.pan_;
-  std::vector<int>& pls = state.pls_;
-  std::vector<int>& prs = state.prs_;
-  std::vector<float>& pld = state.pld_;
-  std::vector<float>& prd = state.prd_;
+  Column<Count>& pn = state.pn_;
+  Column<Count>& pl = state.pl_;
+  Column<Count>& pr = state.pr_;
+  Column<Count>& pan = state.pan_;
+  Column<int>& pls = state.pls_;
+  Column<int>& prs = state.prs_;
+  Column<float>& pld = state.pld_;
+  Column<float>& prd = state.prd_;
   unsigned int n_stride = state.n_stride_;
   unsigned int istride;
   unsigned int jstride;
 
+  this->typed_ = false;
   for (int i = 0; i < state.num_; ++i) {
     pn[i] = 0;
     pl[i] = 0;
@@ -105,6 +132,7 @@ void
 Proc::plot(unsigned int scope, std::vector<int>& grid, int& cols, int& rows,
            unsigned int& stride)
 {
+  PROFILE(Plot);
   State& state = this->state_;
   unsigned int num = state.num_;
   float width = state.width_;
@@ -114,14 +142,25 @@ Proc::plot(unsigned int scope, std::vector<int>& grid, int& cols, int& rows,
   // entire thing will be further flattened later
   cols = 1; if (width  > scope) { cols = floor(width  / scope); }
   rows = 1; if (height > scope) { rows = floor(height / scope); }
+  // coarser units still hold every pair within scope
+  bool clamped = COORD_MAX < cols || COORD_MAX < rows;
+  if (clamped && !this->clamped_) {
+    this->log_.add(Attn::E, "Grid of " + std::to_string(cols) + "x"
+                   + std::to_string(rows) + " units is coarsened to fit "
+                   "coordinates of at most " + std::to_string(COORD_MAX)
+                   + ".");
+  }
+  this->clamped_ = clamped;
+  cols = std::min(cols, static_cast<int>(COORD_MAX));
+  rows = std::min(rows, static_cast<int>(COORD_MAX));
   unsigned int unflat_size = cols * rows;
   auto unflat = std::vector<std::vector<int>>(unflat_size);
   float unit_width = state.width_ / cols;
   float unit_height = state.height_ / rows;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
-  std::vector<int>& gcol = state.gcol_;
-  std::vector<int>& grow = state.grow_;
+  Column<float>& px = state.px_;
+  Column<float>& py = state.py_;
+  Column<Coord>& gcol = state.gcol_;
+  Column<Coord>& grow = state.grow_;
   gcol.resize(num);
   grow.resize(num);
 
@@ -182,7 +221,8 @@ Proc::seek()
                  state.pn_, state.pan_, state.pl_, state.pr_);
   //*/
   /**
-  this->cl_.naive_seek(state.num_, state.scope_squared_, state.ascope_squared_,
+  this->cl_.naive_seek(state.num_, state.width_, state.height_,
+                       state.scope_squared_, state.ascope_squared_,
                        state.px_, state.py_, state.pc_, state.ps_,
                        state.pn_, state.pan_, state.pl_, state.pr_);
   //*/
@@ -193,9 +233,11 @@ void
 Proc::move()
 {
   State& state = this->state_;
+  bool each = this->particle_noise_ && 0.0f != state.noise_;
   this->cl_.move(state.num_, state.width_, state.height_,
                  state.alpha_, state.beta_, state.speed_,
-                 Util::normal_noise(state.noise_),
+                 each ? 0.0f : Util::normal_noise(state.noise_),
+                 each ? state.noise_ : 0.0f, Philox::seed(), this->tick_,
                  state.pn_, state.pl_, state.pr_,
                  state.px_, state.py_, state.pf_, state.pc_, state.ps_);
 }
@@ -210,21 +252,45 @@ Proc::plain_seek(unsigned int scope, std::vector<int>& grid,
 {
   State& state = this->state_;
   unsigned int num = state.num_;
-  std::vector<int>& gcol = state.gcol_;
-  std::vector<int>& grow = state.grow_;
+  Column<Coord>& gcol = state.gcol_;
+  Column<Coord>& grow = state.grow_;
   unsigned int scopesq = scope * scope;
   // scopesq is int because scope needs to be int for plotting anyway
 
   this->plot(scope, grid, cols, rows, stride);
+  if (this->nearest_) {
+    // running minimum of squared distances, rooted once at the end
+    this->nearest_dists_.assign(num, std::numeric_limits<float>::infinity());
+  }
 
   // for each particle index
   for (int srci = 0; srci < num; ++srci) {
     this->plain_seek_vicinity(scopesq, grid, stride, gcol[srci], grow[srci],
                               cols, rows, srci, tally);
   }
+  if (this->nearest_) {
+    std::vector<float>& nearest = this->nearest_dists_;
+    for (int i = 0; i < num; ++i) {
+      nearest[i] = std::isinf(nearest[i]) ? -1.0f : std::sqrt(nearest[i]);
+    }
+  }
+  Column<Count>& pn = state.pn_;
+  Column<Count>& pl = state.pl_;
+  Column<Count>& pr = state.pr_;
+  if (!this->type_ || &Proc::tally_neighborhood != tally) {
+    for (int i = 0; i < num; ++i) {
+      pn[i] = pl[i] + pr[i];
+    }
+    return;
+  }
+  // fuse typing into the last pass (see Exp::type())
+  Column<Count>& pan = state.pan_;
+  Column<Type>& pt = state.pt_;
   for (int i = 0; i < num; ++i) {
-    state.pn_[i] = state.pl_[i] + state.pr_[i];
+    pn[i] = pl[i] + pr[i];
+    pt[i] = State::type_of(pn[i], pan[i]);
   }
+  this->typed_ = true;
 }
 
 
@@ -243,10 +309,20 @@ Proc::plain_seek_vicinity(unsigned int scopesq, std::vector<int>& grid,
   bool cover = false;
   bool runder = false;
   bool rover = false;
-  if      (col == 0)        { cunder = true; c = cols - 1; }
-  else if (col == cols - 1) { cover  = true; cc = 0; }
-  if      (row == 0)        { runder = true; r = rows - 1; }
-  else if (row == rows - 1) { rover  = true; rr = 0; }
+  // (a single column or row is at both edges at once)
+  if (col == 0)        { cunder = true; c = cols - 1; }
+  if (col == cols - 1) { cover  = true; cc = 0; }
+  if (row == 0)        { runder = true; r = rows - 1; }
+  if (row == rows - 1) { rover  = true; rr = 0; }
+  // with fewer than 3 columns or rows, units recur in the vicinity, so that
+  // each is visited once and plain_seek_tally() takes the nearest image
+  bool small = cols < 3 || rows < 3;
+  if (small) {
+    cunder = false;
+    cover = false;
+    runder = false;
+    rover = false;
+  }
   // NOTE 1: World origin is southwest, so top-bottom order is reversed. This
   //         does not affect any core calculations, but helps us match up
   //         with the flattened grid generated by plot().
@@ -260,11 +336,21 @@ Proc::plain_seek_vicinity(unsigned int scopesq, std::vector<int>& grid,
                  /* nw */ c,   rr,  cunder, false, false,  rover,
                  /* n  */ col, rr,  false,  false, false,  rover,
                  /* ne */ cc,  rr,  false,  cover, false,  rover};
+  bool seen;
   unsigned int stride;
   int dsti;
 
   // for every unit in the vicinity (neighborhood)
   for (unsigned int v = 0; v < 54; v += 6) {
+    if (small) {
+      seen = false;
+      for (unsigned int u = 0; u < v; u += 6) {
+        seen = seen || (vic[u] == vic[v] && vic[u + 1] == vic[v + 1]);
+      }
+      if (seen) {
+        continue;
+      }
+    }
     stride = (cols * (vic[v + 1] * gstride)) + (vic[v] * gstride);
     // for each particle index within the unit
     for (unsigned int p = 0; p < gstride; ++p) {
@@ -291,8 +377,8 @@ Proc::plain_seek_tally(unsigned int scopesq, unsigned int srci, unsigned int dst
                        void (Proc::*tally)(int,int,float,float,float))
 {
   State& state = this->state_;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
+  Column<float>& px = state.px_;
+  Column<float>& py = state.py_;
   float srcx = px[srci];
   float srcy = py[srci];
   float dstx = px[dsti];
@@ -303,6 +389,11 @@ Proc::plain_seek_tally(unsigned int scopesq, unsigned int srci, unsigned int dst
   if (cunder) { dx -= width; }  else if (cover) { dx += width; }
   float dy = dsty - srcy;
   if (runder) { dy -= height; } else if (rover) { dy += height; }
+  // nearest image (for small grids; otherwise the flags have seen to it)
+  if      (dx >  0.5f * width)  { dx -= width; }
+  else if (dx < -0.5f * width)  { dx += width; }
+  if      (dy >  0.5f * height) { dy -= height; }
+  else if (dy < -0.5f * height) { dy += height; }
   float distsq = (dx * dx) + (dy * dy);
 
   // ignore comparisons outside the vicinity scope
@@ -310,6 +401,11 @@ Proc::plain_seek_tally(unsigned int scopesq, unsigned int srci, unsigned int dst
     return;
   }
 
+  if (this->nearest_) {
+    std::vector<float>& nearest = this->nearest_dists_;
+    nearest[srci] = std::min(nearest[srci], distsq);
+    nearest[dsti] = std::min(nearest[dsti], distsq);
+  }
   (this->*tally)(srci, dsti, dx, dy, distsq);
 }
 
@@ -323,24 +419,33 @@ Proc::plain_move()
   float alpha = state.alpha_;
   float beta = state.beta_;
   float speed = state.speed_;
-  float noise = Util::normal_noise(state.noise_);
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
-  std::vector<float>& pf = state.pf_;
-  std::vector<float>& pc = state.pc_;
-  std::vector<float>& ps = state.ps_;
-  std::vector<unsigned int>& pn = state.pn_;
-  std::vector<unsigned int>& pl = state.pl_;
-  std::vector<unsigned int>& pr = state.pr_;
+  unsigned int num = state.num_;
+  // one sample for all particles, or one per particle (see particle_noise_)
+  bool each = this->particle_noise_ && 0.0f != state.noise_;
+  float noise = each ? 0.0f : Util::normal_noise(state.noise_);
+  std::vector<float>& noises = this->noises_;
+  Column<float>& px = state.px_;
+  Column<float>& py = state.py_;
+  Column<float>& pf = state.pf_;
+  Column<float>& pc = state.pc_;
+  Column<float>& ps = state.ps_;
+  Column<Count>& pn = state.pn_;
+  Column<Count>& pl = state.pl_;
+  Column<Count>& pr = state.pr_;
   float f;
   float x;
   float y;
 
-  for (int i = 0; i < state.num_; ++i) {
+  if (each) {
+    noises.resize(num);
+    Philox::normals(Philox::seed(), this->tick_, Stream::Noise, state.noise_,
+                    0, num, noises.data());
+  }
+  for (int i = 0; i < num; ++i) {
     f = fmod(pf[i] + alpha
              + (beta * pn[i]
                 * Util::signum(static_cast<int>(pr[i] - pl[i]))), TAU)
-        + noise;
+        + (each ? noises[i] : noise);
     if (f < 0) { f += TAU; }
     pf[i] = f;
     pc[i] = cosf(f);
@@ -359,15 +464,16 @@ void
 Proc::tally_neighborhood(int srci, int dsti, float dx, float dy, float distsq)
 {
   State& state = this->state_;
-  std::vector<float>& pc = state.pc_;
-  std::vector<float>& ps = state.ps_;
-  std::vector<unsigned int>& pn = state.pn_;
-  std::vector<unsigned int>& pl = state.pl_;
-  std::vector<unsigned int>& pr = state.pr_;
-  std::vector<int>& pls = state.pls_;
-  std::vector<int>& prs = state.prs_;
-  std::vector<float>& pld = state.pld_;
-  std::vector<float>& prd = state.prd_;
+  Column<float>& pc = state.pc_;
+  Column<float>& ps = state.ps_;
+  Column<Count>& pn = state.pn_;
+  Column<Count>& pl = state.pl_;
+  Column<Count>& pr = state.pr_;
+  Column<Count>& pan = state.pan_;
+  Column<int>& pls = state.pls_;
+  Column<int>& prs = state.prs_;
+  Column<float>& pld = state.pld_;
+  Column<float>& prd = state.prd_;
   unsigned int n_stride = state.n_stride_;
 
   float srcc = pc[srci];
@@ -388,6 +494,12 @@ Proc::tally_neighborhood(int srci, int dsti, float dx, float dy, float distsq)
   ++pn[srci];
   ++pn[dsti];
 
+  // alternative neighborhood (for spores), as in the OpenCL seek kernel
+  if (state.ascope_squared_ >= distsq) {
+    ++pan[srci];
+    ++pan[dsti];
+  }
+
   if (0.0f > (dx * srcs) - (dy * srcc)) {
     if (n_stride > srcr) {
       prs[srcri] = dsti;
@@ -419,15 +531,92 @@ Proc::tally_neighborhood(int srci, int dsti, float dx, float dy, float distsq)
 
 void
 Proc::tally_neighbors(int srci, int dsti, float /* dx */, float /* dy */,
-                      float distsq)
+                      float /* distsq */)
 {
   std::unordered_map<int,std::vector<int>>& ns = this->neighbors_sets_;
-  std::unordered_map<int,std::vector<float>>& nd = this->neighbors_dists_;
-  float dist = std::sqrt(distsq);
 
   ns[srci].push_back(dsti);
   ns[dsti].push_back(srci);
-  nd[srci].push_back(dist);
-  nd[dsti].push_back(dist);
+}
+
+
+void
+Proc::knn(const std::vector<int>& grid, int cols, int rows,
+          unsigned int stride, int srci, unsigned int k,
+          std::vector<float>& dists)
+{
+  State& state = this->state_;
+  Column<float>& px = state.px_;
+  Column<float>& py = state.py_;
+  float width = state.width_;
+  float height = state.height_;
+  float srcx = px[srci];
+  float srcy = py[srci];
+  // anything beyond ring r is at least r units away
+  float unit = std::min(width / cols, height / rows);
+  int col = state.gcol_[srci];
+  int row = state.grow_[srci];
+  int reach = std::max(cols, rows) / 2 + 1;
+  auto visited = std::vector<bool>(cols * rows, false);
+  auto heap = std::vector<float>(); // max-heap of the k nearest so far
+  float dx;
+  float dy;
+  float distsq;
+  float bound;
+  int dsti;
+  int c;
+  int r;
+  unsigned int u;
+
+  dists.clear();
+  if (0 == k) {
+    return;
+  }
+  for (int ring = 0; ring <= reach; ++ring) {
+    for (int dr = -ring; dr <= ring; ++dr) {
+      for (int dc = -ring; dc <= ring; ++dc) {
+        if (ring != std::max(std::abs(dc), std::abs(dr))) {
+          continue; // inner rings are done
+        }
+        c = ((col + dc) % cols + cols) % cols;
+        r = ((row + dr) % rows + rows) % rows;
+        u = cols * r + c;
+        if (visited[u]) {
+          continue; // wrapped around onto a visited unit
+        }
+        visited[u] = true;
+        for (unsigned int p = 0; p < stride; ++p) {
+          dsti = grid[u * stride + p];
+          if (0 > dsti) {
+            break;
+          }
+          if (srci == dsti) {
+            continue;
+          }
+          // shortest distance across the wrapping edges
+          dx = std::fabs(px[dsti] - srcx); dx = std::min(dx, width - dx);
+          dy = std::fabs(py[dsti] - srcy); dy = std::min(dy, height - dy);
+          distsq = (dx * dx) + (dy * dy);
+          if (k > heap.size()) {
+            heap.push_back(distsq);
+            std::push_heap(heap.begin(), heap.end());
+          } else if (heap.front() > distsq) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = distsq;
+            std::push_heap(heap.begin(), heap.end());
+          }
+        }
+      }
+    }
+    bound = ring * unit;
+    if (k == heap.size() && heap.front() <= bound * bound) {
+      break;
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end());
+  for (float sq : heap) {
+    dists.push_back(std::sqrt(sq));
+  }
 }
 
@@ -20,7 +20,7 @@
 class Cl;
 class State;
 
-class Proc : public Subject
+class Proc : public Subject, public Observer
 {
  public:
   /// constructor: Initialise system processing.
@@ -30,8 +30,18 @@ class Proc : public Subject
   /// \param no_cl  whether user has specified disabling of OpenCL
   Proc(Log& log, State& state, Cl& cl, bool no_cl);
 
+  /// destructor: Stop observing State.
+  ~Proc();
+
+  /// react(): React to State::change() and State::remove(), by forgetting
+  ///          the typing of the last seek (see typed_).
+  /// \param issue  which observed Subject's function to react to
+  void react(Issue issue) override;
+
   /// next(): Let the system perform one action step.
-  void next();
+  /// \param notify  whether Views should react (not for ticks in between
+  ///                drawn frames)
+  void next(bool notify = true);
 
   /// done(): Pause the system and notify Views.
   inline void
@@ -52,6 +62,10 @@ class Proc : public Subject
 
   /// plain_seek(): Non-OpenCL version of seek.
   ///               Entry point of seeking. Also used by Exp.
+  ///               If type_ is set, particles are typed at the end of seeking
+  ///               with tally_neighborhood(), saving Exp::type() a pass.
+  ///               If nearest_ is set, nearest neighbor distances (within
+  ///               scope) are kept in nearest_dists_, alongside any tally.
   /// \param scope  integer divisor of grid
   /// \param grid  reference to flat grid
   /// \param cols  reference to number of columns in grid
@@ -62,8 +76,8 @@ class Proc : public Subject
                   int& cols, int& rows, unsigned int& stride,
                   void (Proc::*tally)(int,int,float,float,float));
 
-  /// tally_neighborhood(): Update N, L, R, and related data structures of the
-  ///                       two particles being compared.
+  /// tally_neighborhood(): Update N, L, R, alternative N, and related data
+  ///                       structures of the two particles being compared.
   ///                       Also used by Exp.
   /// \param srci  index of the first ("source") particle
   /// \param dsti  index of the second ("destination") particle
@@ -73,7 +87,7 @@ class Proc : public Subject
   void tally_neighborhood(int srci, int dsti, float dx, float dy,
                           float distsq);
 
-  /// tally_neighbors(): Update sets of neighbor indices and distances.
+  /// tally_neighbors(): Update sets of neighbor indices.
   ///                    Used by Exp.
   /// \param srci  index of the first ("source") particle
   /// \param dsti  index of the second ("destination") particle
@@ -82,10 +96,29 @@ class Proc : public Subject
   /// \param distsq  squared distance between src and dst
   void tally_neighbors(int srci, int dsti, float dx, float dy, float distsq);
 
+  /// knn(): Radius-free k-nearest-neighbor query, searching the grid of a
+  ///        previous plain_seek() ring by ring outwards from the particle.
+  ///        Meant for particles having no neighbor within the seek scope.
+  /// \param grid  reference to flat grid
+  /// \param cols  number of columns in grid
+  /// \param rows  number of rows in grid
+  /// \param stride  stride (largest grid unit) of grid
+  /// \param srci  index of the query particle
+  /// \param k  number of neighbors sought
+  /// \param dists  destination of (at most k) distances in ascending order
+  void knn(const std::vector<int>& grid, int cols, int rows,
+           unsigned int stride, int srci, unsigned int k,
+           std::vector<float>& dists);
+
   State& state_;
   bool   cl_good_; // retain value of Cl::good()
-  std::unordered_map<int,std::vector<int>> neighbors_sets_;    // used by Exp
-  std::unordered_map<int,std::vector<float>> neighbors_dists_; // used by Exp
+  bool   type_;    // whether plain seek should also type the particles
+  bool   typed_;   // whether particles were typed during the last seek
+  bool   nearest_; // whether plain seek should also find nearest neighbors
+  std::vector<float> nearest_dists_; // nearest neighbor distance (-1 if none)
+  bool     particle_noise_; // whether each particle draws its own noise
+  uint64_t tick_;           // tick being processed (keys per particle noise)
+  std::unordered_map<int,std::vector<int>> neighbors_sets_; // used by Exp
 
  private:
   /// clear(): Clear out seek data. Namely, reinitialise N, L, R, and related
@@ -140,10 +173,13 @@ class Proc : public Subject
   ///               Update X, Y, PHI of every particle.
   void plain_move();
 
+  Log&             log_;
   Cl&              cl_; // NOTE: if a pointer instead, clCreateBuffer fails
   std::vector<int> grid_;        // flat vector of the vicinity overlay grid
   int              grid_cols_;   // number of grid columns
   int              grid_rows_;   // number of grid rows
   unsigned int     grid_stride_; // size of a flattened grid unit
+  std::vector<float> noises_;    // noise per particle (see particle_noise_)
+  bool             clamped_;     // whether plot() coarsened the last grid
 };
 
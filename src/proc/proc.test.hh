@@ -1,5 +1,12 @@
 #include "proc.hh"
+#include "../util/philox.hh"
 #include "../util/util.hh"
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+
+#define PROC_MOVE_TOLERANCE 1e-3f // of kernel move (native_sin/cos)
 
 
 TEST_CASE("Proc::plot")
@@ -19,5 +26,509 @@ TEST_CASE("Proc::plot")
   REQUIRE(static_cast<int>(state.height_ / state.scope_) == rows);
   REQUIRE(0 < gstride);
   REQUIRE(cols * rows * gstride == grid.size());
+
+  // grid coordinates must fit in a Coord (coarser units, in compact builds)
+  state.width_ = 70000;
+  state.height_ = 10;
+  proc.plot(1, grid, cols, rows, gstride);
+  REQUIRE(COORD_MAX >= cols);
+  REQUIRE(cols * rows * gstride == grid.size());
+  for (int i = 0; i < state.num_; ++i) {
+    REQUIRE(cols > state.gcol_[i]);
+  }
+}
+
+
+TEST_CASE("Proc::plain_seek")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto grid = std::vector<int>();
+  int cols;
+  int rows;
+  unsigned int gstride;
+  unsigned int num = 120; // more than n_stride neighbors on one side
+
+  state.num_ = num + 1;
+  for (unsigned int i = 0; i < num; ++i) {
+    state.px_[i] = 100.0f + 0.001f * i;
+    state.py_[i] = 100.0f;
+  }
+  state.px_[num] = 200.0f; // loner
+  state.py_[num] = 200.0f;
+  proc.plain_seek(state.scope_, grid, cols, rows, gstride,
+                  &Proc::tally_neighborhood);
+  REQUIRE(proc.typed_);
+  for (unsigned int i = 0; i < num; ++i) {
+    REQUIRE(num - 1 == state.pn_[i]);
+    REQUIRE(num - 1 == state.pan_[i]);
+    REQUIRE(Type::MatureSpore == state.pt_[i]);
+  }
+  REQUIRE(0 == state.pn_[num]);
+  REQUIRE(0 == state.pan_[num]);
+  REQUIRE(Type::Nutrient == state.pt_[num]);
+
+  // removing particles invalidates the typing until the next seek
+  state.remove({num});
+  REQUIRE(!proc.typed_);
 }
 
+
+TEST_CASE("Proc::knn")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto grid = std::vector<int>();
+  int cols;
+  int rows;
+  unsigned int gstride;
+  std::vector<float> dists;
+
+  state.num_ = 4;
+  state.px_[0] = 10.0f;  state.py_[0] = 10.0f;
+  state.px_[1] = 13.0f;  state.py_[1] = 14.0f; // 5 from 0
+  state.px_[2] = 10.0f;  state.py_[2] = 12.0f; // 2 from 0
+  state.px_[3] = 240.0f; state.py_[3] = 10.0f; // 20 from 0, across the edge
+  proc.nearest_ = true;
+  proc.plain_seek(state.scope_, grid, cols, rows, gstride,
+                  &Proc::tally_neighbors);
+  REQUIRE(Approx(2.0f) == proc.nearest_dists_[0]);
+  REQUIRE(Approx(sqrtf(13.0f)) == proc.nearest_dists_[1]);
+  REQUIRE(Approx(2.0f) == proc.nearest_dists_[2]);
+  REQUIRE(-1.0f == proc.nearest_dists_[3]); // none within scope
+
+  proc.knn(grid, cols, rows, gstride, 3, 2, dists);
+  REQUIRE(2 == dists.size());
+  REQUIRE(Approx(20.0f) == dists[0]);
+  REQUIRE(Approx(sqrtf(404.0f)) == dists[1]);
+  proc.knn(grid, cols, rows, gstride, 0, 5, dists);
+  REQUIRE(3 == dists.size());
+  REQUIRE(Approx(20.0f) == dists[2]);
+}
+
+
+// Layout: A configuration for comparing backends, with its particles placed
+//         uniformly, in clusters, or along the edges of the world.
+
+struct Layout
+{
+  const char*  name;
+  unsigned int num;
+  unsigned int width;
+  unsigned int height;
+  float        scope;    // whole, as plain seek plots the grid by it
+  int          clusters; // 0 for uniform, -1 for along the edges
+};
+
+
+// Seeking: Seek data of every particle, as given by one backend.
+
+struct Seeking
+{
+  std::vector<unsigned int> pn;
+  std::vector<unsigned int> pan;
+  std::vector<unsigned int> pl;
+  std::vector<unsigned int> pr;
+};
+
+
+/// lay_out(): Place the particles of a Layout, reproducibly.
+/// \param state  State to change
+/// \param layout  Layout
+/// \param seed  seed of the placement
+static void
+lay_out(State& state, const Layout& layout, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float w = layout.width;
+  float h = layout.height;
+  std::vector<float> px;
+  std::vector<float> py;
+  std::vector<float> pf;
+  std::vector<float> cx;
+  std::vector<float> cy;
+  for (int c = 0; c < layout.clusters; ++c) {
+    cx.push_back(w * unit(rng));
+    cy.push_back(h * unit(rng));
+  }
+  float x;
+  float y;
+  float across;
+  float along;
+  for (unsigned int i = 0; i < layout.num; ++i) {
+    if (0 < layout.clusters) { // within 3 units of a center
+      x = cx[i % layout.clusters] + 6.0f * (unit(rng) - 0.5f);
+      y = cy[i % layout.clusters] + 6.0f * (unit(rng) - 0.5f);
+    } else if (0 > layout.clusters) { // within 1.5 units of an edge
+      across = 3.0f * (unit(rng) - 0.5f);
+      along = unit(rng);
+      x = i % 2 ? across : w * along;
+      y = i % 2 ? h * along : across;
+    } else {
+      x = w * unit(rng);
+      y = h * unit(rng);
+    }
+    x = std::fmod(x, w); if (x < 0.0f) { x += w; } if (x >= w) { x = 0.0f; }
+    y = std::fmod(y, h); if (y < 0.0f) { y += h; } if (y >= h) { y = 0.0f; }
+    px.push_back(x);
+    py.push_back(y);
+    pf.push_back(TAU * unit(rng));
+  }
+  Stative input = {-1, static_cast<int>(layout.num),
+                   layout.width, layout.height, state.alpha_, state.beta_,
+                   layout.scope, state.ascope_, state.speed_, 0.0f,
+                   state.prad_, state.coloring_};
+  state.change(input, false);
+  state.clear();
+  state.num_ = 0; // as counted by append()
+  state.append(px, py, pf);
+}
+
+
+/// clear_seeking(): Zero the seek data of State, as Proc::next() does.
+/// \param state  State
+static void
+clear_seeking(State& state)
+{
+  for (int i = 0; i < state.num_; ++i) {
+    state.pn_[i] = 0;
+    state.pan_[i] = 0;
+    state.pl_[i] = 0;
+    state.pr_[i] = 0;
+  }
+}
+
+
+/// take_seeking(): Copy the seek data of State.
+/// \param state  State
+/// \returns  Seeking
+static Seeking
+take_seeking(const State& state)
+{
+  Seeking seeking;
+  seeking.pn.assign(state.pn_.begin(), state.pn_.begin() + state.num_);
+  seeking.pan.assign(state.pan_.begin(), state.pan_.begin() + state.num_);
+  seeking.pl.assign(state.pl_.begin(), state.pl_.begin() + state.num_);
+  seeking.pr.assign(state.pr_.begin(), state.pr_.begin() + state.num_);
+  return seeking;
+}
+
+
+/// reference_seek(): Seek by comparing every pair of particles at their
+///                   nearest image, in the order of plain seek.
+/// \param state  State
+/// \returns  Seeking
+static Seeking
+reference_seek(const State& state)
+{
+  unsigned int num = state.num_;
+  float w = state.width_;
+  float h = state.height_;
+  Seeking seeking;
+  seeking.pn.assign(num, 0);
+  seeking.pan.assign(num, 0);
+  seeking.pl.assign(num, 0);
+  seeking.pr.assign(num, 0);
+  float dx;
+  float dy;
+  float distsq;
+  for (unsigned int srci = 0; srci < num; ++srci) {
+    for (unsigned int dsti = 0; dsti < srci; ++dsti) {
+      dx = state.px_[dsti] - state.px_[srci];
+      if      (dx >  0.5f * w) { dx -= w; }
+      else if (dx < -0.5f * w) { dx += w; }
+      dy = state.py_[dsti] - state.py_[srci];
+      if      (dy >  0.5f * h) { dy -= h; }
+      else if (dy < -0.5f * h) { dy += h; }
+      distsq = (dx * dx) + (dy * dy);
+      if (state.scope_squared_ < distsq) {
+        continue;
+      }
+      ++seeking.pn[srci];
+      ++seeking.pn[dsti];
+      if (state.ascope_squared_ >= distsq) {
+        ++seeking.pan[srci];
+        ++seeking.pan[dsti];
+      }
+      if (0.0f > (dx * state.ps_[srci]) - (dy * state.pc_[srci])) {
+        ++seeking.pr[srci];
+      } else {
+        ++seeking.pl[srci];
+      }
+      if (0.0f < (dx * state.ps_[dsti]) - (dy * state.pc_[dsti])) {
+        ++seeking.pr[dsti];
+      } else {
+        ++seeking.pl[dsti];
+      }
+    }
+  }
+  return seeking;
+}
+
+
+/// reference_move(): Move like plain move, given the seek data.
+/// \param state  State (with noise 0)
+/// \param seeking  seek data
+/// \param px  destination of X
+/// \param py  destination of Y
+/// \param pf  destination of PHI
+static void
+reference_move(const State& state, const Seeking& seeking,
+               std::vector<float>& px, std::vector<float>& py,
+               std::vector<float>& pf)
+{
+  float w = state.width_;
+  float h = state.height_;
+  float f;
+  float x;
+  float y;
+  px.clear();
+  py.clear();
+  pf.clear();
+  for (int i = 0; i < state.num_; ++i) {
+    f = fmod(state.pf_[i] + state.alpha_
+             + (state.beta_ * seeking.pn[i]
+                * Util::signum(static_cast<int>(seeking.pr[i] -
+                                                seeking.pl[i]))), TAU);
+    if (f < 0) { f += TAU; }
+    x = fmod(state.px_[i] + state.speed_ * cosf(f), w);
+    if (x < 0) { x += w; }
+    y = fmod(state.py_[i] + state.speed_ * sinf(f), h);
+    if (y < 0) { y += h; }
+    px.push_back(x);
+    py.push_back(y);
+    pf.push_back(f);
+  }
+}
+
+
+/// diverge(): Describe the first particle on which two Seekings differ.
+/// \param state  State that was sought
+/// \param expected  Seeking of the reference
+/// \param actual  Seeking of the backend under test
+/// \returns  description, or empty if they agree
+static std::string
+diverge(const State& state, const Seeking& expected, const Seeking& actual)
+{
+  std::ostringstream text;
+  for (int i = 0; i < state.num_; ++i) {
+    if (expected.pn[i] == actual.pn[i] && expected.pan[i] == actual.pan[i] &&
+        expected.pl[i] == actual.pl[i] && expected.pr[i] == actual.pr[i]) {
+      continue;
+    }
+    text << std::setprecision(9) << "particle " << i << " at ("
+         << state.px_[i] << ", " << state.py_[i] << ") phi " << state.pf_[i]
+         << ": n/an/l/r expected " << expected.pn[i] << "/"
+         << expected.pan[i] << "/" << expected.pl[i] << "/"
+         << expected.pr[i] << ", got " << actual.pn[i] << "/"
+         << actual.pan[i] << "/" << actual.pl[i] << "/" << actual.pr[i];
+    return text.str();
+  }
+  return "";
+}
+
+
+/// layouts(): Get the Layouts to compare backends on: fixed corner cases,
+///            then random ones.
+/// \param random  number of random Layouts
+/// \returns  Layouts
+static std::vector<Layout>
+layouts(unsigned int random)
+{
+  std::vector<Layout> all = {
+    {"small world",     40,  20,  20,  5.0f,  0},
+    {"one column",      30,   8,  40,  5.0f,  0},
+    {"two columns",     60,  14,  50,  6.0f,  0},
+    {"one unit",        25,   9,   9,  5.0f,  0},
+    {"huge scope",     300,  60,  60, 25.0f,  0},
+    {"dense clusters", 600, 100, 100,  5.0f,  3},
+    {"wrap edges",     400, 100,  80,  6.0f, -1},
+  };
+  std::mt19937 rng(2021);
+  std::uniform_int_distribution<unsigned int> num(1, 400);
+  std::uniform_int_distribution<unsigned int> side(4, 150);
+  std::uniform_int_distribution<int> scope(1, 20);
+  std::uniform_int_distribution<int> clusters(-1, 4);
+  for (unsigned int i = 0; i < random; ++i) {
+    all.push_back({"random", num(rng), side(rng), side(rng),
+                   static_cast<float>(scope(rng)), clusters(rng)});
+  }
+  return all;
+}
+
+
+TEST_CASE("Proc seek backends agree")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log, true); // PoCL will do
+  auto proc = Proc(log, state, cl, true);
+  auto grid = std::vector<int>();
+  int cols;
+  int rows;
+  unsigned int gstride;
+  unsigned int seed = 0;
+
+  for (const Layout& layout : layouts(40)) {
+    lay_out(state, layout, ++seed);
+    INFO(layout.name << " (" << seed << "): " << layout.num << " in "
+         << layout.width << "x" << layout.height << ", scope "
+         << layout.scope);
+    Seeking expected = reference_seek(state);
+
+    clear_seeking(state);
+    proc.plain_seek(state.scope_, grid, cols, rows, gstride,
+                    &Proc::tally_neighborhood);
+    CHECK("" == diverge(state, expected, take_seeking(state)));
+
+#if 1 == CL_ENABLED
+
+    if (!cl.good()) {
+      continue;
+    }
+    clear_seeking(state);
+    proc.plot(state.scope_, grid, cols, rows, gstride);
+    cl.seek(state.num_, state.width_, state.height_,
+            state.scope_squared_, state.ascope_squared_, cols, rows, gstride,
+            grid, state.gcol_, state.grow_,
+            state.px_, state.py_, state.pc_, state.ps_,
+            state.pn_, state.pan_, state.pl_, state.pr_);
+    CHECK("" == diverge(state, expected, take_seeking(state)));
+
+    clear_seeking(state);
+    cl.naive_seek(state.num_, state.width_, state.height_,
+                  state.scope_squared_, state.ascope_squared_,
+                  state.px_, state.py_, state.pc_, state.ps_,
+                  state.pn_, state.pan_, state.pl_, state.pr_);
+    CHECK("" == diverge(state, expected, take_seeking(state)));
+
+#endif /* CL_ENABLED */
+
+  }
+}
+
+
+TEST_CASE("Proc move backends agree")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log, true); // PoCL will do
+  auto proc = Proc(log, state, cl, true);
+  std::vector<float> px;
+  std::vector<float> py;
+  std::vector<float> pf;
+  unsigned int seed = 100;
+
+  for (const Layout& layout : layouts(10)) {
+    lay_out(state, layout, ++seed);
+    INFO(layout.name << " (" << seed << ")");
+    reference_move(state, reference_seek(state), px, py, pf);
+
+    proc.next(); // plain seek and move
+    int first = -1;
+    for (int i = 0; i < state.num_ && -1 == first; ++i) {
+      if (px[i] != state.px_[i] || py[i] != state.py_[i] ||
+          pf[i] != state.pf_[i]) {
+        first = i;
+      }
+    }
+    INFO("first divergent particle: " << first);
+    CHECK(-1 == first);
+
+#if 1 == CL_ENABLED
+
+    if (!cl.good()) {
+      continue;
+    }
+    lay_out(state, layout, seed);
+    Seeking seeking = reference_seek(state);
+    for (int i = 0; i < state.num_; ++i) {
+      state.pn_[i] = seeking.pn[i];
+      state.pl_[i] = seeking.pl[i];
+      state.pr_[i] = seeking.pr[i];
+    }
+    cl.move(state.num_, state.width_, state.height_,
+            state.alpha_, state.beta_, state.speed_, 0.0f, 0.0f, 0, 0,
+            state.pn_, state.pl_, state.pr_,
+            state.px_, state.py_, state.pf_, state.pc_, state.ps_);
+    float w = state.width_;
+    float h = state.height_;
+    float dx;
+    float dy;
+    float df;
+    first = -1;
+    for (int i = 0; i < state.num_ && -1 == first; ++i) {
+      dx = std::fabs(px[i] - state.px_[i]); dx = std::min(dx, w - dx);
+      dy = std::fabs(py[i] - state.py_[i]); dy = std::min(dy, h - dy);
+      df = std::fabs(pf[i] - state.pf_[i]); df = std::min(df, TAU - df);
+      if (PROC_MOVE_TOLERANCE < std::max(std::max(dx, dy), df)) {
+        first = i;
+      }
+    }
+    INFO("first divergent particle (kernel move): " << first);
+    CHECK(-1 == first);
+
+#endif /* CL_ENABLED */
+
+  }
+}
+
+
+TEST_CASE("Proc per particle noise")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  unsigned int num = 1000;
+
+  // particles without neighbors turn by alpha plus noise alone
+  auto lay_out_apart = [&state, num]() {
+    state.clear();
+    state.num_ = 0;
+    std::vector<float> px;
+    std::vector<float> py;
+    std::vector<float> pf(num, 1.0f);
+    for (unsigned int i = 0; i < num; ++i) {
+      px.push_back(10.0f * (i % 25) + 5.0f);
+      py.push_back(10.0f * (i / 25) + 5.0f);
+    }
+    state.append(px, py, pf);
+  };
+  state.alpha_ = 0.0f;
+  state.noise_ = 0.1f;
+  state.width_ = 250;
+  state.height_ = 400;
+  proc.particle_noise_ = true;
+  proc.tick_ = 7;
+
+  lay_out_apart();
+  proc.next(false);
+  std::vector<float> turned(state.pf_.begin(), state.pf_.begin() + num);
+  float spread = 0.0f;
+  for (unsigned int i = 0; i < num; ++i) {
+    REQUIRE(Approx(1.0f + Philox::normal(Philox::seed(), 7, i, Stream::Noise,
+                                         0.1f)) == turned[i]);
+    spread = std::max(spread, std::fabs(turned[i] - turned[0]));
+  }
+  REQUIRE(0.0f < spread);
+
+  // the same tick draws the same noise, the next one does not
+  lay_out_apart();
+  proc.next(false);
+  REQUIRE(turned[1] == state.pf_[1]);
+  lay_out_apart();
+  proc.tick_ = 8;
+  proc.next(false);
+  REQUIRE(turned[1] != state.pf_[1]);
+}
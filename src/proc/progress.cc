@@ -0,0 +1,199 @@
+#include "progress.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h> // sysconf
+
+
+/// resident(): Get the resident memory of this process.
+/// \returns  number of bytes (0 if unknown)
+static std::size_t
+resident()
+{
+  std::ifstream stream("/proc/self/statm");
+  std::size_t size = 0;
+  std::size_t pages = 0;
+  if (!(stream >> size >> pages)) {
+    return 0;
+  }
+  return pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+/// hms(): Format a duration as H:MM:SS.
+/// \param seconds  duration
+/// \returns  formatted duration
+static std::string
+hms(double seconds)
+{
+  unsigned long s = static_cast<unsigned long>(seconds + 0.5);
+  std::ostringstream text;
+  text << s / 3600 << ":" << std::setfill('0') << std::setw(2)
+       << s / 60 % 60 << ":" << std::setw(2) << s % 60;
+  return text.str();
+}
+
+
+Progress::Progress(Control& ctrl, std::ostream& out,
+                   unsigned int every /* = PROGRESS_EVERY */)
+  : ctrl_(ctrl), out_(out), every_(every)
+{
+  this->quit_ = false;
+  this->tick_ = ctrl.tick_;
+  this->countdown_ = ctrl.countdown_;
+  for (std::atomic<unsigned int>& count : this->types_) {
+    count = 0;
+  }
+  this->bytes_ = 0;
+  this->wanted_ = true; // for the first report
+  this->held_ = false;
+  this->start_ = std::chrono::steady_clock::now();
+  this->start_tick_ = ctrl.tick_;
+  this->last_ = this->start_;
+  this->last_tick_ = this->start_tick_;
+  ctrl.attach_to_proc(*this);
+  if (0 < every) {
+    this->thread_ = std::thread(&Progress::work, this);
+  }
+}
+
+
+Progress::~Progress()
+{
+  this->stop();
+  this->ctrl_.detach_from_proc(*this);
+}
+
+
+void
+Progress::stop()
+{
+  if (!this->thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->quit_ = true;
+  }
+  this->cond_.notify_all();
+  this->thread_.join();
+  if (!this->held_) {
+    this->out_ << "\r" << std::string(79, ' ') << "\r" << std::flush;
+  }
+}
+
+
+void
+Progress::hold(bool yesno)
+{
+  this->held_ = yesno;
+}
+
+
+std::string
+Progress::line()
+{
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  unsigned long long tick = this->tick_.load(std::memory_order_relaxed);
+  long long countdown = this->countdown_.load(std::memory_order_relaxed);
+  double seconds = std::chrono::duration<double>(now - this->last_).count();
+  double rate = 0.0 < seconds ? (tick - this->last_tick_) / seconds : 0.0;
+  this->last_ = now;
+  this->last_tick_ = tick;
+
+  unsigned int spores = 0;
+  unsigned int cells = 0;
+  unsigned int count;
+  for (int t = 0; t < TYPE_COUNT; ++t) {
+    count = this->types_[t].load(std::memory_order_relaxed);
+    switch (static_cast<Type>(t)) {
+      case Type::PrematureSpore:
+      case Type::MatureSpore:
+        spores += count;
+        break;
+      case Type::None:
+      case Type::Nutrient:
+        break;
+      default:
+        cells += count;
+    }
+  }
+
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(0) << "tick " << tick
+       << "  " << rate << "/s";
+  if (-1 < countdown) {
+    text << "  eta " << (0.0 < rate ? hms(countdown / rate) : "?");
+  }
+  text << "  nutrients "
+       << this->types_[static_cast<int>(Type::Nutrient)].load(
+            std::memory_order_relaxed)
+       << "  spores " << spores << "  cells " << cells
+       << "  mem " << (this->bytes_.load(std::memory_order_relaxed) >> 20)
+       << "/" << (resident() >> 20) << " MiB";
+  return text.str();
+}
+
+
+std::string
+Progress::summary() const
+{
+  unsigned long long ticks = this->tick_ - this->start_tick_;
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - this->start_).count();
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1) << ticks << " ticks in "
+       << seconds << " s (" << (0.0 < seconds ? ticks / seconds : 0.0)
+       << "/s), resident memory " << (resident() >> 20) << " MiB";
+  return text.str();
+}
+
+
+void
+Progress::react(Issue issue)
+{
+  if (Issue::ProcNextDone != issue) {
+    return;
+  }
+  this->tick_.store(this->ctrl_.tick_, std::memory_order_relaxed);
+  this->countdown_.store(this->ctrl_.countdown_, std::memory_order_relaxed);
+  if (this->wanted_.load(std::memory_order_relaxed)) {
+    this->sample();
+    this->wanted_.store(false, std::memory_order_relaxed);
+  }
+}
+
+
+void
+Progress::work()
+{
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  std::string text;
+  while (!this->cond_.wait_for(lock, this->every_,
+                               [this] { return this->quit_; })) {
+    if (!this->held_) {
+      text = this->line();
+      text.resize(std::max<std::size_t>(text.size(), 79), ' ');
+      this->out_ << "\r" << text << std::flush;
+    }
+    this->wanted_ = true; // counted by the next report
+  }
+}
+
+
+void
+Progress::sample()
+{
+  State& state = this->ctrl_.state_;
+  unsigned int num = state.num_;
+  unsigned int counts[TYPE_COUNT] = {0};
+  for (unsigned int i = 0; i < num; ++i) {
+    ++counts[static_cast<int>(state.pt_[i])];
+  }
+  for (int t = 0; t < TYPE_COUNT; ++t) {
+    this->types_[t].store(counts[t], std::memory_order_relaxed);
+  }
+  this->bytes_.store(state.arena_->bytes(), std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+//===-- proc/progress.hh - Progress class declaration ----------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Progress class, which reports the progress of a run on
+/// a wall-clock interval from a thread of its own: tick, tick rate, time left
+/// until the countdown ends, particle types, and memory.
+/// The ticking thread only stores the tick and countdown in atomics after
+/// each tick; counting the types is left to the next tick after the
+/// reporting thread asks for it, so it happens once per interval.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "control.hh"
+#include "../state/type.hh"
+#include "../util/observation.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+
+#define PROGRESS_EVERY 1000 // milliseconds between reports
+
+
+class Progress : Observer
+{
+ public:
+  /// constructor: Observe Proc, and start reporting.
+  /// \param ctrl  Control object
+  /// \param out  destination of reports
+  /// \param every  milliseconds between reports (0 for none, only summary())
+  Progress(Control& ctrl, std::ostream& out,
+           unsigned int every = PROGRESS_EVERY);
+
+  /// destructor: Stop reporting and detach from observation.
+  ~Progress() override;
+
+  /// stop(): Stop the reporting thread, and clear the last report.
+  void stop();
+
+  /// hold(): Suspend reports, eg. while prompting the user.
+  /// \param yesno  whether to suspend
+  void hold(bool yesno);
+
+  /// line(): Compose a report of the progress since the previous one (on
+  ///         the reporting thread, if there is one).
+  /// \returns  one line
+  std::string line();
+
+  /// summary(): Compose a report of the whole run.
+  /// \returns  one line
+  std::string summary() const;
+
+  /// react(): React to Proc::next(), on the ticking thread.
+  /// \param issue  which observed Subject's function to react to
+  void react(Issue issue) override;
+
+ private:
+  /// work(): Reporting thread loop.
+  void work();
+
+  /// sample(): Count the particle types, on the ticking thread.
+  void sample();
+
+  Control&                  ctrl_;
+  std::ostream&             out_;
+  std::chrono::milliseconds every_;
+  std::thread               thread_;
+  std::mutex                mutex_;
+  std::condition_variable   cond_;
+  bool                      quit_;   // (guarded by mutex_)
+  // written by the ticking thread
+  std::atomic<unsigned long long> tick_;
+  std::atomic<long long>          countdown_;
+  std::atomic<unsigned int>       types_[TYPE_COUNT];
+  std::atomic<std::size_t>        bytes_;   // particle memory
+  // written by the reporting thread
+  std::atomic<bool>               wanted_;  // whether to sample()
+  std::atomic<bool>               held_;
+  // read by line() and summary()
+  std::chrono::steady_clock::time_point start_;
+  unsigned long long                    start_tick_;
+  std::chrono::steady_clock::time_point last_;
+  unsigned long long                    last_tick_;
+};
@@ -0,0 +1,56 @@
+#include "progress.hh"
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+
+TEST_CASE("Progress::line")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  std::ostringstream out;
+
+  // without an interval, nothing is printed
+  {
+    Progress progress(ctrl, out, 0);
+    ctrl.countdown_ = 100;
+    for (int i = 0; i < 3; ++i) {
+      ctrl.next();
+    }
+    std::string line = progress.line();
+    REQUIRE(0 == line.find("tick 3 "));
+    REQUIRE(std::string::npos != line.find(" eta "));
+    REQUIRE(std::string::npos != line.find(" nutrients "));
+    REQUIRE(std::string::npos != line.find(" MiB"));
+    REQUIRE(0 == progress.summary().find("3 ticks in "));
+
+    // types were counted after the first tick
+    REQUIRE(std::string::npos == line.find(" nutrients 0 "));
+  }
+  REQUIRE(out.str().empty());
+
+  // eternal runs have no eta
+  ctrl.countdown_ = -1;
+  {
+    Progress progress(ctrl, out, 0);
+    ctrl.next();
+    REQUIRE(std::string::npos == progress.line().find(" eta "));
+  }
+
+  // on an interval, reports come from the reporting thread
+  {
+    Progress progress(ctrl, out, 5);
+    std::chrono::steady_clock::time_point until =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+    while (std::chrono::steady_clock::now() < until) {
+      ctrl.next();
+    }
+    progress.stop();
+  }
+  REQUIRE(std::string::npos != out.str().find("\rtick "));
+}
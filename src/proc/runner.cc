@@ -0,0 +1,178 @@
+#include "runner.hh"
+
+
+Runner::Runner(Log& log, Control& ctrl)
+  : log_(log), ctrl_(ctrl)
+{
+  this->running_ = false;
+  this->wanted_ = false;
+  this->starved_ = 0;
+  this->generation_ = 0;
+  ctrl.attach_to_state(*this);
+  this->publish(); // before there is a simulation thread
+  this->update();
+}
+
+
+Runner::~Runner()
+{
+  this->stop();
+  this->ctrl_.detach_from_state(*this);
+}
+
+
+void
+Runner::start()
+{
+  if (this->thread_.joinable()) {
+    return;
+  }
+  this->running_ = true;
+  this->thread_ = std::thread(&Runner::work, this);
+  this->log_.add(Attn::O, "Started simulation thread.");
+}
+
+
+void
+Runner::stop()
+{
+  if (!this->thread_.joinable()) {
+    return;
+  }
+  this->post([](Control& ctrl) { ctrl.quit(); });
+  this->thread_.join();
+}
+
+
+bool
+Runner::running() const
+{
+  return this->running_;
+}
+
+
+void
+Runner::post(std::function<void(Control&)> command)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->commands_mutex_);
+    this->commands_.push_back(std::move(command));
+  }
+  this->cond_.notify_all(); // in case of idling
+}
+
+
+bool
+Runner::enter(std::chrono::microseconds patience)
+{
+  this->wanted_ = true;
+  if (this->mutex_.try_lock_for(patience)) {
+    this->starved_ = 0;
+    return true;
+  }
+  if (RUNNER_STARVED <= ++this->starved_) {
+    this->mutex_.lock(); // wait out the tick
+    this->starved_ = 0;
+    return true;
+  }
+  this->wanted_ = false;
+  this->cond_.notify_all();
+  return false;
+}
+
+
+void
+Runner::leave()
+{
+  this->wanted_ = false;
+  this->mutex_.unlock();
+  this->cond_.notify_all();
+}
+
+
+bool
+Runner::update()
+{
+  return this->frames_.update();
+}
+
+
+const Frame&
+Runner::frame() const
+{
+  return this->frames_.front();
+}
+
+
+void
+Runner::react(Issue issue)
+{
+  if (Issue::StateChanged == issue) {
+    ++this->generation_;
+    this->remap_.reset();
+  } else if (Issue::StateRemapped == issue) {
+    ++this->generation_;
+    this->remap_ = std::make_shared<const std::vector<int>>(
+      this->ctrl_.state_.remap_);
+  }
+}
+
+
+void
+Runner::work()
+{
+  Control& ctrl = this->ctrl_;
+  std::vector<std::function<void(Control&)>> commands;
+  std::unique_lock<std::timed_mutex> lock(this->mutex_);
+  bool idle;
+
+  while (!ctrl.quit_) {
+    {
+      std::lock_guard<std::mutex> guard(this->commands_mutex_);
+      commands.swap(this->commands_);
+    }
+    for (auto& command : commands) {
+      command(ctrl);
+    }
+    commands.clear();
+    if (ctrl.quit_) {
+      break;
+    }
+
+    idle = ctrl.paused_ && !ctrl.step_;
+    ctrl.next();
+    this->publish();
+
+    // give way to a turn, or idle while paused (a turn or post() wakes up)
+    if (idle) {
+      this->cond_.wait_for(lock, std::chrono::milliseconds(RUNNER_IDLE));
+    } else if (this->wanted_) {
+      this->cond_.wait_for(lock, std::chrono::milliseconds(RUNNER_IDLE),
+                           [this] { return !this->wanted_; });
+    }
+  }
+  this->running_ = false;
+}
+
+
+void
+Runner::publish()
+{
+  Control& ctrl = this->ctrl_;
+  State& state = ctrl.state_;
+  unsigned int num = state.num_;
+  Frame& frame = this->frames_.back();
+
+  ctrl.color(static_cast<Coloring>(state.coloring_));
+  frame.tick = ctrl.tick_;
+  frame.generation = this->generation_;
+  frame.remap = this->remap_;
+  frame.prad = state.prad_;
+  frame.x.assign(state.px_.begin(), state.px_.begin() + num);
+  frame.y.assign(state.py_.begin(), state.py_.begin() + num);
+  frame.r.assign(state.xr_.begin(), state.xr_.begin() + num);
+  frame.g.assign(state.xg_.begin(), state.xg_.begin() + num);
+  frame.b.assign(state.xb_.begin(), state.xb_.begin() + num);
+  frame.a.assign(state.xa_.begin(), state.xa_.begin() + num);
+  this->frames_.publish();
+}
@@ -0,0 +1,124 @@
+//===-- proc/runner.hh - Runner class declaration --------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Runner class, which ticks Control on a thread of its
+/// own, so that the particle system is neither held to the display rate nor
+/// held up by rendering. After every tick it publishes a Frame (particle
+/// positions and colors) through a TripleBuffer, for Canvas to draw the
+/// latest one at display rate.
+/// Anything else touching State does so between ticks: either by posting a
+/// command, which the simulation thread applies before its next tick, or by
+/// taking a turn, during which the simulation thread waits (for the GUI,
+/// which reads and changes State all over).
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "control.hh"
+#include "../util/log.hh"
+#include "../util/observation.hh"
+#include "../util/triple.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+#define RUNNER_IDLE 10   // milliseconds to idle between loops while paused
+#define RUNNER_STARVED 6 // turns given up in a row before insisting on one
+
+
+// Frame: Particles as published after a tick.
+
+struct Frame
+{
+  unsigned long      tick;       // Control::tick_
+  unsigned int       generation; // changes when particles get replaced
+  // State::remap_ if the last change of generation was a removal (else
+  // null), shared by the frames of that generation
+  std::shared_ptr<const std::vector<int>> remap;
+  float              prad;       // particle radius
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> r;
+  std::vector<float> g;
+  std::vector<float> b;
+  std::vector<float> a;
+};
+
+
+class Runner : Observer
+{
+ public:
+  /// constructor: Observe State, and publish a first Frame.
+  /// \param log  Log object
+  /// \param ctrl  Control object
+  Runner(Log& log, Control& ctrl);
+
+  /// destructor: Stop the simulation thread and detach from observation.
+  ~Runner() override;
+
+  /// start(): Start ticking on the simulation thread.
+  void start();
+
+  /// stop(): Have the simulation thread quit, and wait for it.
+  void stop();
+
+  /// running(): Whether the simulation thread is still ticking.
+  /// \returns  false once Control quit
+  bool running() const;
+
+  /// post(): Queue a command to be applied before the next tick.
+  /// \param command  function of Control
+  void post(std::function<void(Control&)> command);
+
+  /// enter(): Try to take a turn at State, between two ticks. The tick that
+  ///          is running gets some patience to finish; without success, the
+  ///          turn is given up, unless it has been so too often in a row.
+  /// \param patience  how long to wait for the running tick
+  /// \returns  whether the turn was taken (then leave() it)
+  bool enter(std::chrono::microseconds patience);
+
+  /// leave(): End a turn, and let the simulation thread go on.
+  void leave();
+
+  /// update(): Take the latest Frame, if a new one has been published.
+  /// \returns  whether frame() changed
+  bool update();
+
+  /// frame(): Latest Frame taken by update().
+  /// \returns  Frame (valid until the next update())
+  const Frame& frame() const;
+
+  /// react(): React to State::change() and State::remove(), by starting a
+  ///          new generation of Frames.
+  /// \param issue  which observed Subject's function to react to
+  void react(Issue issue) override;
+
+ private:
+  /// work(): Simulation thread loop.
+  void work();
+
+  /// publish(): Color the particles, and publish them as a Frame.
+  void publish();
+
+  Log&                 log_;
+  Control&             ctrl_;
+  TripleBuffer<Frame>  frames_;
+  std::thread          thread_;
+  std::timed_mutex     mutex_;     // held by the simulation thread, except
+                                   // between ticks and during turns
+  std::condition_variable_any cond_;
+  std::mutex           commands_mutex_;
+  std::vector<std::function<void(Control&)>> commands_; // posted commands
+  std::atomic<bool>    running_;   // whether the simulation thread ticks
+  std::atomic<bool>    wanted_;    // whether a turn is waited for
+  unsigned int         starved_;   // turns given up in a row
+  unsigned int         generation_; // (guarded by mutex_)
+  std::shared_ptr<const std::vector<int>> remap_; // (guarded by mutex_)
+};
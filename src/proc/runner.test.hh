@@ -0,0 +1,54 @@
+#include "runner.hh"
+#include <chrono>
+#include <thread>
+
+
+TEST_CASE("Runner::work")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  Runner runner(log, ctrl);
+  unsigned int num = state.num_;
+  unsigned int generation = runner.frame().generation;
+
+  REQUIRE(num == runner.frame().x.size());
+  REQUIRE(0 == runner.frame().tick);
+
+  // frames follow the simulation thread
+  runner.start();
+  while (runner.frame().tick < 3) {
+    runner.update();
+    std::this_thread::yield();
+  }
+  REQUIRE(num == runner.frame().a.size());
+
+  // no tick happens during a turn
+  REQUIRE(runner.enter(std::chrono::microseconds(1000000)));
+  unsigned long tick = ctrl.tick_;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  REQUIRE(tick == ctrl.tick_);
+  std::vector<int> remap = state.remove({0});
+  runner.leave();
+
+  // removal starts a generation, which comes with its remap
+  while (runner.frame().generation == generation) {
+    runner.update();
+    std::this_thread::yield();
+  }
+  REQUIRE(generation + 1 == runner.frame().generation);
+  REQUIRE(nullptr != runner.frame().remap);
+  REQUIRE(remap == *runner.frame().remap);
+  REQUIRE(num - 1 == runner.frame().x.size());
+
+  // commands are applied between ticks
+  runner.post([](Control& ctrl) { ctrl.pause(true); });
+  runner.post([](Control& ctrl) { ctrl.quit(); });
+  runner.stop();
+  REQUIRE(!runner.running());
+  REQUIRE(ctrl.paused_);
+}
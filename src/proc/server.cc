@@ -0,0 +1,528 @@
+#include "server.hh"
+#include "../state/state.hh"
+#include "../util/util.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstring> // strerror
+#include <fcntl.h>
+#include <iomanip>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h> // close, pipe, unlink
+
+
+/// oneline(): Fold a multiline message into one line.
+/// \param message  message
+/// \returns  one line
+static std::string
+oneline(std::string message)
+{
+  while (!message.empty() && '\n' == message.back()) {
+    message.pop_back();
+  }
+  std::string line;
+  for (char c : message) {
+    if ('\n' == c) {
+      line += "; ";
+    } else {
+      line += c;
+    }
+  }
+  return line;
+}
+
+
+/// injectable(): Get the type of particle cluster by its name, with
+///               underscores for spaces.
+/// \param name  name, eg. "square_cell"
+/// \param type  type (out)
+/// \returns  whether the type can be injected
+static bool
+injectable(std::string name, Type& type)
+{
+  std::replace(name.begin(), name.end(), '_', ' ');
+  for (int t = static_cast<int>(Type::PrematureSpore);
+       t <= static_cast<int>(Type::Nutrient); ++t) {
+    if (name == TypeNames[t]) {
+      type = static_cast<Type>(t);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/// stative(): Get the current parameters.
+/// \param ctrl  Control object
+/// \returns  parameters
+static Stative
+stative(Control& ctrl)
+{
+  State& truth = ctrl.state_;
+  return {ctrl.duration_, truth.num_, truth.width_, truth.height_,
+          truth.alpha_, truth.beta_, truth.scope_, truth.ascope_,
+          truth.speed_, truth.noise_, truth.prad_, truth.coloring_};
+}
+
+
+/// describe(): Format parameters as KEY=VALUE pairs (angles in degrees).
+/// \param input  parameters
+/// \returns  one line
+static std::string
+describe(const Stative& input)
+{
+  std::ostringstream text;
+  text << "duration=" << input.duration << " num=" << input.num
+       << " width=" << input.width << " height=" << input.height
+       << " alpha=" << Util::rad_to_deg(input.alpha)
+       << " beta=" << Util::rad_to_deg(input.beta)
+       << " scope=" << input.scope << " ascope=" << input.ascope
+       << " speed=" << input.speed
+       << " noise=" << Util::rad_to_deg(input.noise)
+       << " prad=" << input.prad << " coloring=" << input.coloring;
+  return text.str();
+}
+
+
+/// assign(): Set a parameter from a KEY=VALUE pair (angles in degrees).
+/// \param input  parameters
+/// \param pair  KEY=VALUE
+/// \param respawn  whether the change needs a respawn (out, only set)
+/// \returns  whether the pair was understood
+static bool
+assign(Stative& input, const std::string& pair, bool& respawn)
+{
+  std::size_t eq = pair.find('=');
+  if (std::string::npos == eq) {
+    return false;
+  }
+  std::string key = pair.substr(0, eq);
+  std::istringstream value(pair.substr(eq + 1));
+  float angle = 0.0f;
+  bool read;
+
+  if ("duration" == key) {
+    read = static_cast<bool>(value >> input.duration);
+  } else if ("num" == key) {
+    read = static_cast<bool>(value >> input.num) && 0 < input.num;
+    respawn = true;
+  } else if ("width" == key) {
+    read = static_cast<bool>(value >> input.width) && 0 < input.width;
+    respawn = true;
+  } else if ("height" == key) {
+    read = static_cast<bool>(value >> input.height) && 0 < input.height;
+    respawn = true;
+  } else if ("alpha" == key) {
+    read = static_cast<bool>(value >> angle);
+    input.alpha = Util::deg_to_rad(angle);
+  } else if ("beta" == key) {
+    read = static_cast<bool>(value >> angle);
+    input.beta = Util::deg_to_rad(angle);
+  } else if ("scope" == key) {
+    read = static_cast<bool>(value >> input.scope);
+  } else if ("ascope" == key) {
+    read = static_cast<bool>(value >> input.ascope);
+  } else if ("speed" == key) {
+    read = static_cast<bool>(value >> input.speed);
+  } else if ("noise" == key) {
+    read = static_cast<bool>(value >> angle);
+    input.noise = Util::deg_to_rad(angle);
+  } else if ("prad" == key) {
+    read = static_cast<bool>(value >> input.prad);
+  } else if ("coloring" == key) {
+    read = static_cast<bool>(value >> input.coloring);
+  } else {
+    return false;
+  }
+  return read && (value >> std::ws).eof();
+}
+
+
+Server::Server(Log& log, Control& ctrl, const std::string& path,
+               unsigned int patience)
+  : log_(log), ctrl_(ctrl), path_(path), fd_(-1), wake_{-1, -1},
+    patience_(patience)
+{
+  this->quit_ = false;
+  this->tick_ = ctrl.tick_;
+  this->countdown_ = ctrl.countdown_;
+  this->paused_ = ctrl.paused_;
+  this->num_ = ctrl.state_.num_;
+  this->last_ = std::chrono::steady_clock::now();
+  this->last_tick_ = ctrl.tick_;
+
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    log.add(Attn::E, "Socket path too long: '" + path + "'.");
+    return;
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > fd) {
+    log.add(Attn::E, std::string("Could not open a socket: ") +
+                     std::strerror(errno) + ".");
+    return;
+  }
+  if (0 > pipe(this->wake_)) {
+    log.add(Attn::E, std::string("Could not open a pipe: ") +
+                     std::strerror(errno) + ".");
+    close(fd);
+    return;
+  }
+  for (int end : this->wake_) {
+    fcntl(end, F_SETFL, O_NONBLOCK);
+    fcntl(end, F_SETFD, FD_CLOEXEC);
+  }
+  unlink(path.c_str()); // a stale socket of an earlier run
+  if (0 > bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+               sizeof(address)) ||
+      0 > listen(fd, 8)) {
+    log.add(Attn::E, "Could not serve '" + path + "': " +
+                     std::strerror(errno) + ".");
+    close(fd);
+    close(this->wake_[0]);
+    close(this->wake_[1]);
+    this->wake_[0] = this->wake_[1] = -1;
+    return;
+  }
+  this->fd_ = fd;
+  ctrl.attach_to_proc(*this);
+  this->thread_ = std::thread(&Server::work, this);
+  log.add(Attn::O, "Serving control requests at '" + path + "'.");
+}
+
+
+Server::~Server()
+{
+  this->stop();
+}
+
+
+bool
+Server::good() const
+{
+  return 0 <= this->fd_;
+}
+
+
+void
+Server::stop()
+{
+  if (!this->thread_.joinable()) {
+    return;
+  }
+  this->quit_ = true;
+  this->thread_.join();
+  this->ctrl_.detach_from_proc(*this);
+  close(this->fd_);
+  this->fd_ = -1;
+  close(this->wake_[0]);
+  close(this->wake_[1]);
+  this->wake_[0] = this->wake_[1] = -1;
+  unlink(this->path_.c_str());
+}
+
+
+std::shared_ptr<Server::Ticket>
+Server::answer(const std::string& request)
+{
+  std::istringstream words(request);
+  std::string verb;
+  words >> verb;
+
+  if ("stats" == verb) {
+    return done(this->stats());
+  }
+  if ("help" == verb) {
+    return done("ok stats get set pause resume save inject remove cluster "
+                "help");
+  }
+  if ("get" == verb) {
+    return this->queue([](Control& ctrl) {
+      return "ok " + describe(stative(ctrl));
+    });
+  }
+  if ("pause" == verb || "resume" == verb) {
+    bool yesno = "pause" == verb;
+    return this->queue([yesno](Control& ctrl) {
+      ctrl.pause(yesno);
+      return std::string(yesno ? "ok paused" : "ok resumed");
+    });
+  }
+  if ("set" == verb) {
+    std::vector<std::string> pairs;
+    std::string pair;
+    while (words >> pair) {
+      pairs.push_back(pair);
+    }
+    if (pairs.empty()) {
+      return done("error: set KEY=VALUE...");
+    }
+    return this->queue([pairs](Control& ctrl) {
+      Stative input = stative(ctrl);
+      bool respawn = false;
+      for (const std::string& pair : pairs) {
+        if (!assign(input, pair, respawn)) {
+          return "error: bad parameter '" + pair + "'";
+        }
+      }
+      ctrl.change(input, respawn);
+      ctrl.gui_change_ = true; // for UiState to follow
+      return "ok " + describe(stative(ctrl));
+    });
+  }
+  if ("save" == verb) {
+    std::string path;
+    if (!(words >> path)) {
+      return done("error: save FILE");
+    }
+    return this->queue([path](Control& ctrl) {
+      ctrl.save_background(path);
+      return "ok saving to " + path;
+    });
+  }
+  if ("inject" == verb) {
+    std::string name;
+    std::string greater;
+    Type type = Type::None;
+    if (!(words >> name) || !injectable(name, type)) {
+      return done("error: inject TYPE [greater]");
+    }
+    words >> greater;
+    bool cap = "greater" == greater;
+    return this->queue([type, cap](Control& ctrl) {
+      return "ok " + oneline(ctrl.inject(type, cap));
+    });
+  }
+  if ("remove" == verb) {
+    std::vector<unsigned int> particles;
+    unsigned int p;
+    while (words >> p) {
+      particles.push_back(p);
+    }
+    if (particles.empty() || !words.eof()) {
+      return done("error: remove INDEX...");
+    }
+    return this->queue([particles](Control& ctrl) {
+      unsigned int num = ctrl.state_.num_;
+      ctrl.remove(particles);
+      return "ok removed " + std::to_string(num - ctrl.state_.num_)
+             + ", num=" + std::to_string(ctrl.state_.num_);
+    });
+  }
+  if ("cluster" == verb) {
+    float radius = 0.0f;
+    unsigned int minpts = 14;
+    words >> radius >> minpts;
+    return this->queue([radius, minpts](Control& ctrl) {
+      float r = 0.0f < radius ? radius : ctrl.state_.scope_;
+      return "ok " + oneline(ctrl.cluster(r, minpts));
+    });
+  }
+  return done("error: unknown request '" + verb + "' (try help)");
+}
+
+
+void
+Server::react(Issue issue)
+{
+  if (Issue::ProcNextDone != issue) {
+    return;
+  }
+  Control& ctrl = this->ctrl_;
+  this->tick_.store(ctrl.tick_, std::memory_order_relaxed);
+  this->countdown_.store(ctrl.countdown_, std::memory_order_relaxed);
+  this->paused_.store(ctrl.paused_, std::memory_order_relaxed);
+  this->num_.store(ctrl.state_.num_, std::memory_order_relaxed);
+
+  std::vector<Pending> pending;
+  {
+    std::unique_lock<std::mutex> lock(this->pending_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return; // after the next tick
+    }
+    if (this->pending_.empty() && ctrl.paused_ && !ctrl.step_) {
+      // nothing to tick, so wait for requests rather than spin
+      this->pending_cond_.wait_for(lock,
+                                   std::chrono::milliseconds(SERVER_IDLE));
+    }
+    pending.swap(this->pending_);
+  }
+  bool answered = false;
+  for (Pending& each : pending) {
+    int queued = Ticket::Queued;
+    if (!each.ticket->stage.compare_exchange_strong(queued,
+                                                    Ticket::Running)) {
+      continue; // dropped by the serving thread
+    }
+    each.ticket->reply = each.command(ctrl);
+    each.ticket->stage.store(Ticket::Done, std::memory_order_release);
+    answered = true;
+  }
+  if (answered) {
+    char wake = 0;
+    (void) write(this->wake_[1], &wake, 1); // (full pipe: awake anyway)
+  }
+}
+
+
+void
+Server::work()
+{
+  // the listening socket and the wake pipe, then one per client
+  std::vector<struct pollfd> fds(2);
+  std::vector<Client> clients(2);
+  fds[0].fd = this->fd_;
+  fds[1].fd = this->wake_[0];
+  fds[0].events = fds[1].events = POLLIN;
+  char chunk[512];
+
+  while (!this->quit_) {
+    bool owed = false;
+    for (std::size_t i = 2; i < clients.size(); ++i) {
+      owed = owed || !clients[i].tickets.empty();
+    }
+    // while answers are owed, wake in time to drop what is past due
+    if (0 > poll(fds.data(), fds.size(), owed ? SERVER_IDLE : SERVER_POLL)) {
+      continue;
+    }
+    if (fds[1].revents & POLLIN) {
+      while (0 < read(this->wake_[0], chunk, sizeof(chunk))) {
+      }
+    }
+    for (std::size_t i = fds.size(); 2 < i--; ) {
+      Client& client = clients[i];
+      bool gone = false;
+      if (0 != fds[i].revents) {
+        ssize_t got = read(client.fd, chunk, sizeof(chunk));
+        if (0 < got) {
+          client.buffer.append(chunk, got);
+        } else {
+          // answer what was asked before hanging up (eg. nc at EOF)
+          client.closing = true;
+          fds[i].fd = -1; // (not polled any more)
+          gone = 0 > got;
+        }
+      }
+      std::size_t end;
+      while (!gone && std::string::npos != (end = client.buffer.find('\n'))) {
+        std::string request = client.buffer.substr(0, end);
+        client.buffer.erase(0, end + 1);
+        if (!request.empty() && '\r' == request.back()) {
+          request.pop_back();
+        }
+        client.tickets.push_back(this->answer(request));
+      }
+      gone = gone || !this->reply(client);
+      if (!gone && SERVER_LINE < client.buffer.size()) {
+        std::string reply = "error: request too long\n";
+        send(client.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        gone = true;
+      }
+      if (gone || (client.closing && client.tickets.empty())) {
+        // queued requests of a client that is gone are still applied
+        close(client.fd);
+        fds.erase(fds.begin() + i);
+        clients.erase(clients.begin() + i);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      int client = accept(this->fd_, nullptr, nullptr);
+      if (0 <= client) {
+        struct pollfd each;
+        each.fd = client;
+        each.events = POLLIN;
+        each.revents = 0;
+        fds.push_back(each);
+        clients.push_back({client, "", {}, false});
+      }
+    }
+  }
+  for (std::size_t i = 2; i < clients.size(); ++i) {
+    close(clients[i].fd);
+  }
+}
+
+
+bool
+Server::reply(Client& client)
+{
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  while (!client.tickets.empty()) {
+    Ticket& ticket = *client.tickets.front();
+    if (Ticket::Done != ticket.stage.load(std::memory_order_acquire)) {
+      int queued = Ticket::Queued;
+      if (now < ticket.deadline ||
+          !ticket.stage.compare_exchange_strong(queued, Ticket::Dropped)) {
+        return true; // not yet, or running right now
+      }
+      std::lock_guard<std::mutex> lock(this->pending_mutex_);
+      this->pending_.erase(
+        std::remove_if(this->pending_.begin(), this->pending_.end(),
+                       [&ticket](const Pending& each) {
+                         return &ticket == each.ticket.get();
+                       }),
+        this->pending_.end());
+      ticket.reply = "error: not ticking, so the request was dropped";
+    }
+    std::string line = ticket.reply + "\n";
+    client.tickets.pop_front();
+    if (0 > send(client.fd, line.data(), line.size(), MSG_NOSIGNAL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+std::shared_ptr<Server::Ticket>
+Server::done(const std::string& reply)
+{
+  std::shared_ptr<Ticket> ticket = std::make_shared<Ticket>();
+  ticket->stage = Ticket::Done;
+  ticket->reply = reply;
+  return ticket;
+}
+
+
+std::shared_ptr<Server::Ticket>
+Server::queue(Command command)
+{
+  std::shared_ptr<Ticket> ticket = std::make_shared<Ticket>();
+  ticket->stage = Ticket::Queued;
+  ticket->deadline = std::chrono::steady_clock::now() + this->patience_;
+  {
+    std::lock_guard<std::mutex> lock(this->pending_mutex_);
+    this->pending_.push_back({std::move(command), ticket});
+  }
+  this->pending_cond_.notify_one();
+  return ticket;
+}
+
+
+std::string
+Server::stats()
+{
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  unsigned long long tick = this->tick_.load(std::memory_order_relaxed);
+  double seconds = std::chrono::duration<double>(now - this->last_).count();
+  double rate = 0.0 < seconds && tick >= this->last_tick_ ?
+                (tick - this->last_tick_) / seconds : 0.0;
+  this->last_ = now;
+  this->last_tick_ = tick;
+
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1) << "ok tick=" << tick
+       << " countdown=" << this->countdown_.load(std::memory_order_relaxed)
+       << " paused=" << this->paused_.load(std::memory_order_relaxed)
+       << " num=" << this->num_.load(std::memory_order_relaxed)
+       << " rate=" << rate;
+  return text.str();
+}
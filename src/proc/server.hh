@@ -0,0 +1,152 @@
+//===-- proc/server.hh - Server class declaration --------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Server class, which lets other processes query and
+/// steer a run over a Unix domain socket, one request per line and one
+/// answer per line ("ok ..." or "error: ..."):
+///   stats                    tick, countdown, whether paused, particles
+///   get                      parameters (angles in degrees)
+///   set KEY=VALUE...         change parameters (respawning for num, width,
+///                              height)
+///   pause, resume
+///   save FILE                record the state in the background
+///   inject TYPE [greater]    inject a cluster (TYPE as in "square_cell")
+///   remove INDEX...          remove particles (later ones move down)
+///   cluster [RADIUS [MINPTS]]
+///   help
+/// The socket is served from a thread of its own. Stats are answered from
+/// atomics that the ticking thread stores after each tick; anything else is
+/// queued, and applied by the ticking thread between ticks, which never
+/// waits for the queue (it tries again after the next tick if it is busy).
+/// The serving thread never waits for the queue either: it answers a client
+/// once its queued request is done, keeping the client's answers in order,
+/// and drops a request that is still queued after a while ("error: not
+/// ticking"), so it is never applied behind the client's back.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "control.hh"
+#include "../util/log.hh"
+#include "../util/observation.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#define SERVER_POLL 100      // milliseconds between checks for stopping
+#define SERVER_IDLE 10       // milliseconds a paused ticking thread waits
+#define SERVER_PATIENCE 5000 // milliseconds before dropping a queued request
+#define SERVER_LINE 4096     // longest request line
+
+
+class Server : Observer
+{
+ public:
+  /// constructor: Observe Proc, and serve the socket (replacing a stale
+  ///              one at the path).
+  /// \param log  Log object
+  /// \param ctrl  Control object
+  /// \param path  path to the socket
+  /// \param patience  milliseconds before dropping a queued request
+  Server(Log& log, Control& ctrl, const std::string& path,
+         unsigned int patience = SERVER_PATIENCE);
+
+  /// destructor: Stop serving, and detach from observation.
+  ~Server() override;
+
+  /// good(): Whether the socket is served.
+  /// \returns  whether listening
+  bool good() const;
+
+  /// stop(): Stop the serving thread, and remove the socket.
+  void stop();
+
+  // Ticket: Answer of a request, done at once or by the ticking thread.
+  struct Ticket
+  {
+    enum Stage { Queued, Running, Done, Dropped };
+    std::atomic<int> stage;
+    std::string      reply;    // one line (once Done)
+    std::chrono::steady_clock::time_point deadline; // to drop it if Queued
+  };
+
+  /// answer(): Answer a request, or queue it (on the serving thread).
+  /// \param request  one line
+  /// \returns  its ticket
+  std::shared_ptr<Ticket> answer(const std::string& request);
+
+  /// react(): React to Proc::next(), on the ticking thread.
+  /// \param issue  which observed Subject's function to react to
+  void react(Issue issue) override;
+
+ private:
+  using Command = std::function<std::string(Control&)>;
+
+  // Pending: Queued request, with the ticket for its answer.
+  struct Pending
+  {
+    Command                 command;
+    std::shared_ptr<Ticket> ticket;
+  };
+
+  // Client: Connection on the serving thread.
+  struct Client
+  {
+    int                                 fd;      // connected socket
+    std::string                         buffer;  // unfinished request line
+    std::deque<std::shared_ptr<Ticket>> tickets; // answers owed, in order
+    bool                                closing; // no more requests
+  };
+
+  /// work(): Serving thread loop.
+  void work();
+
+  /// reply(): Send a client the answers that are done, in order, dropping
+  ///          queued requests past their deadline.
+  /// \param client  client
+  /// \returns  whether the client is still there
+  bool reply(Client& client);
+
+  /// done(): Ticket of an answer at once.
+  /// \param reply  one line
+  /// \returns  ticket
+  static std::shared_ptr<Ticket> done(const std::string& reply);
+
+  /// queue(): Have the ticking thread run a command.
+  /// \param command  command
+  /// \returns  ticket for its answer
+  std::shared_ptr<Ticket> queue(Command command);
+
+  /// stats(): Answer a stats request from the published atomics.
+  /// \returns  one line
+  std::string stats();
+
+  Log&              log_;
+  Control&          ctrl_;
+  std::string       path_;
+  int               fd_;     // listening socket (-1 if none)
+  int               wake_[2]; // pipe to wake the serving thread with answers
+  std::chrono::milliseconds patience_;
+  std::thread       thread_;
+  std::atomic<bool> quit_;
+  std::mutex        pending_mutex_;
+  std::condition_variable pending_cond_; // a request is queued
+  std::vector<Pending>    pending_;      // (guarded by pending_mutex_)
+  // written by the ticking thread
+  std::atomic<unsigned long long> tick_;
+  std::atomic<long long>          countdown_;
+  std::atomic<bool>               paused_;
+  std::atomic<int>                num_;
+  // read by stats()
+  std::chrono::steady_clock::time_point last_;
+  unsigned long long                    last_tick_;
+};
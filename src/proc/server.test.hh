@@ -0,0 +1,163 @@
+#include "server.hh"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+
+/// ask(): Send a request over a socket, and read the answer.
+/// \param fd  connected socket
+/// \param request  one line
+/// \returns  one line
+static std::string
+ask(int fd, const std::string& request)
+{
+  std::string line = request + "\n";
+  send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+  std::string reply;
+  char c;
+  while (0 < read(fd, &c, 1) && '\n' != c) {
+    reply += c;
+  }
+  return reply;
+}
+
+/// dial(): Connect to a socket.
+/// \param path  path to the socket
+/// \returns  connected socket (-1 if none)
+static int
+dial(const std::string& path)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  if (0 != connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+                   sizeof(address))) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+TEST_CASE("Server::answer")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  std::string path = "testemergence.sock";
+  Server server(log, ctrl, path);
+  REQUIRE(server.good());
+
+  // a client steers the run while this thread ticks
+  std::atomic<bool> done(false);
+  std::vector<std::string> replies;
+  std::thread client([&] {
+    int fd = dial(path);
+    if (0 <= fd) {
+      for (const char* request : {"stats", "pause", "set scope=6 alpha=90",
+                                  "get", "set scope", "inject square_cell",
+                                  "cluster", "remove 0 2", "remove x",
+                                  "resume", "nonsense"}) {
+        replies.push_back(ask(fd, request));
+      }
+    }
+    close(fd);
+    done = true;
+  });
+  while (!done) {
+    ctrl.next();
+  }
+  client.join();
+
+  REQUIRE(11 == replies.size());
+  REQUIRE(0 == replies[0].find("ok tick="));
+  REQUIRE("ok paused" == replies[1]);
+  REQUIRE(std::string::npos != replies[2].find(" alpha=90 "));
+  REQUIRE(std::string::npos != replies[3].find(" scope=6 "));
+  REQUIRE(0 == replies[4].find("error: "));
+  REQUIRE(0 == replies[5].find("ok Injected "));
+  REQUIRE(0 == replies[6].find("ok "));
+  REQUIRE(0 == replies[7].find("ok removed 2, num="));
+  REQUIRE(0 == replies[8].find("error: "));
+  REQUIRE("ok resumed" == replies[9]);
+  REQUIRE(0 == replies[10].find("error: "));
+  REQUIRE(!ctrl.paused_);
+  REQUIRE(6.0f == state.scope_);
+
+  // the socket goes with the server
+  server.stop();
+  REQUIRE(0 != access(path.c_str(), F_OK));
+}
+
+TEST_CASE("Server::answer, not ticking")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  std::string path = "testemergence.sock";
+  Server server(log, ctrl, path, 200);
+  REQUIRE(server.good());
+  int slow = dial(path);
+  int fast = dial(path);
+  REQUIRE(0 <= slow);
+  REQUIRE(0 <= fast);
+
+  // a queued request holds up neither other clients nor stats
+  std::string line = "pause\nstats\n";
+  send(slow, line.data(), line.size(), MSG_NOSIGNAL);
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  REQUIRE(0 == ask(fast, "stats").find("ok tick="));
+  REQUIRE(std::chrono::steady_clock::now() - start <
+          std::chrono::milliseconds(200));
+
+  // it is dropped after a while, and answered in order
+  std::string dropped;
+  std::string stats;
+  char c;
+  while (0 < read(slow, &c, 1) && '\n' != c) {
+    dropped += c;
+  }
+  while (0 < read(slow, &c, 1) && '\n' != c) {
+    stats += c;
+  }
+  REQUIRE(0 == dropped.find("error: not ticking"));
+  REQUIRE(0 == stats.find("ok tick="));
+  ctrl.next();
+  ctrl.next();
+  REQUIRE(!ctrl.paused_);
+
+  // and an answer is owed even to a client that has stopped sending
+  std::atomic<bool> done(false);
+  std::thread ticking([&] {
+    while (!done) {
+      ctrl.next();
+    }
+  });
+  line = "get\n";
+  send(slow, line.data(), line.size(), MSG_NOSIGNAL);
+  shutdown(slow, SHUT_WR);
+  std::string got;
+  while (0 < read(slow, &c, 1) && '\n' != c) {
+    got += c;
+  }
+  done = true;
+  ticking.join();
+  REQUIRE(0 == got.find("ok duration="));
+  close(slow);
+  close(fast);
+  server.stop();
+}
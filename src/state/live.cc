@@ -0,0 +1,149 @@
+#include "live.hh"
+#include "state.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstring> // memcpy, strerror
+#include <fcntl.h> // O_* constants
+#include <sys/mman.h>
+#include <unistd.h> // close, ftruncate
+
+
+/// byte(): Quantise a color component.
+/// \param component  component in [0, 1]
+/// \returns  component in [0, 255]
+static inline uint8_t
+byte(float component)
+{
+  return static_cast<uint8_t>(
+    std::min(std::max(component, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+
+Live::Live(Log& log, const std::string& name, unsigned int capacity,
+           unsigned int slots /* = LIVE_SLOTS */,
+           unsigned int every /* = 1 */, bool colors /* = false */)
+  : log_(log), name_('/' == name[0] ? name : "/" + name), header_(nullptr),
+    bytes_(0), frames_(0)
+{
+  slots = std::max(slots, 2u);
+  std::size_t bytes = Shared::total(slots, capacity, colors);
+  shm_unlink(this->name_.c_str()); // a stale one of an earlier run
+  int fd = shm_open(this->name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (0 > fd) {
+    log.add(Attn::E, "Could not create shared memory '" + this->name_ +
+                     "': " + std::strerror(errno) + ".");
+    return;
+  }
+  void* memory = MAP_FAILED;
+  if (0 == ftruncate(fd, static_cast<off_t>(bytes))) {
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (MAP_FAILED == memory) {
+    log.add(Attn::E, "Could not map shared memory '" + this->name_ +
+                     "': " + std::strerror(errno) + ".");
+    shm_unlink(this->name_.c_str());
+    return;
+  }
+
+  // (ftruncate() zeroed every slot, so every seq starts even)
+  Shared::Header* header = static_cast<Shared::Header*>(memory);
+  header->magic = SHARED_MAGIC;
+  header->version = SHARED_VERSION;
+  header->slots = slots;
+  header->capacity = capacity;
+  header->colors = colors;
+  header->every = every;
+  header->bytes = Shared::slot_bytes(capacity, colors);
+  header->frames.store(0, std::memory_order_relaxed);
+  header->alive.store(1, std::memory_order_release);
+  this->header_ = header;
+  this->bytes_ = bytes;
+  log.add(Attn::O, "Sharing live frames at '" + this->name_ + "'.");
+}
+
+
+Live::~Live()
+{
+  if (nullptr == this->header_) {
+    return;
+  }
+  this->header_->alive.store(0, std::memory_order_release);
+  munmap(this->header_, this->bytes_);
+  shm_unlink(this->name_.c_str());
+}
+
+
+bool
+Live::good() const
+{
+  return nullptr != this->header_;
+}
+
+
+void
+Live::publish(unsigned long tick, const State& state)
+{
+  Shared::Header* header = this->header_;
+  if (nullptr == header) {
+    return;
+  }
+  uint32_t capacity = header->capacity;
+  uint64_t frame = this->frames_;
+  unsigned char* slot = Shared::slot(header, frame % header->slots);
+  Shared::Frame* f = reinterpret_cast<Shared::Frame*>(slot);
+  uint32_t count = std::min<uint32_t>(std::max(state.num_, 0), capacity);
+
+  // odd while writing, and no write may move before the odd seq
+  uint64_t seq = f->seq.load(std::memory_order_relaxed);
+  f->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  Shared::Info& info = f->info;
+  info.tick = tick;
+  info.frame = frame;
+  info.num = state.num_;
+  info.count = count;
+  info.width = state.width_;
+  info.height = state.height_;
+  info.alpha = state.alpha_;
+  info.beta = state.beta_;
+  info.scope = state.scope_;
+  info.ascope = state.ascope_;
+  info.speed = state.speed_;
+  info.noise = state.noise_;
+  info.prad = state.prad_;
+  info.coloring = state.coloring_;
+  std::memcpy(slot + Shared::x_at(capacity), state.px_.data(),
+              count * sizeof(float));
+  std::memcpy(slot + Shared::y_at(capacity), state.py_.data(),
+              count * sizeof(float));
+  std::memcpy(slot + Shared::t_at(capacity), state.pt_.data(), count);
+  if (header->colors) {
+    uint8_t* rgba = slot + Shared::rgba_at(capacity);
+    for (uint32_t i = 0; i < count; ++i) {
+      rgba[4 * i]     = byte(state.xr_[i]);
+      rgba[4 * i + 1] = byte(state.xg_[i]);
+      rgba[4 * i + 2] = byte(state.xb_[i]);
+      rgba[4 * i + 3] = byte(state.xa_[i]);
+    }
+  }
+
+  f->seq.store(seq + 2, std::memory_order_release);
+  this->frames_ = frame + 1;
+  header->frames.store(frame + 1, std::memory_order_release);
+}
+
+
+bool
+Live::colors() const
+{
+  return nullptr != this->header_ && this->header_->colors;
+}
+
+
+const std::string&
+Live::name() const
+{
+  return this->name_;
+}
@@ -0,0 +1,68 @@
+//===-- state/live.hh - Live class declaration -----------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Live class, which publishes the particles of every few
+/// ticks into a ring of frames in POSIX shared memory (see Shared), for other
+/// processes to read while the system goes on (see Tap). The writer never
+/// waits for readers: a frame costs a copy of the X, Y, and type columns
+/// (and colors, if asked for), and readers that fall a whole ring behind
+/// notice that their frame was overwritten.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "shared.hh"
+#include "../util/log.hh"
+#include <string>
+
+
+#define LIVE_SLOTS 4    // frames in the ring
+#define LIVE_HEADROOM 2 // capacity per particle at the start (for growth)
+
+
+class State;
+
+class Live
+{
+ public:
+  /// constructor: Create the shared memory (replacing a stale one by name).
+  /// \param log  Log object
+  /// \param name  name of the shared memory (eg. "/emergence")
+  /// \param capacity  particles a frame holds at most
+  /// \param slots  frames in the ring
+  /// \param every  ticks between frames (for readers)
+  /// \param colors  whether frames hold colors
+  Live(Log& log, const std::string& name, unsigned int capacity,
+       unsigned int slots = LIVE_SLOTS, unsigned int every = 1,
+       bool colors = false);
+
+  /// destructor: Tell readers that the writer is gone, and remove the name
+  ///             (readers keep their mapping).
+  ~Live();
+
+  /// good(): Whether the shared memory is mapped.
+  /// \returns  true if frames can be published
+  bool good() const;
+
+  /// publish(): Write the particles into the next slot of the ring.
+  ///            Particles beyond the capacity are left out.
+  /// \param tick  current time step
+  /// \param state  State object
+  void publish(unsigned long tick, const State& state);
+
+  /// colors(): Whether frames hold colors.
+  /// \returns  true if publish() copies the color columns
+  bool colors() const;
+
+  /// name(): Get the name of the shared memory.
+  /// \returns  name (with a leading slash)
+  const std::string& name() const;
+
+ private:
+  Log&            log_;
+  std::string     name_;
+  Shared::Header* header_; // beginning of the mapping (nullptr if none)
+  std::size_t     bytes_;  // size of the mapping
+  uint64_t        frames_; // frames published so far
+};
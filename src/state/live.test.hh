@@ -0,0 +1,89 @@
+#include "live.hh"
+#include "tap.hh"
+#include "../proc/control.hh"
+#include <algorithm>
+#include <vector>
+
+
+TEST_CASE("Live::publish")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto exp = Exp(log, expctrl, state, proc, true);
+  auto ctrl = Control(log, state, proc, expctrl, exp, "", false);
+  std::string name = "testemergence.live";
+  REQUIRE(!Tap(name).good());
+  REQUIRE(ctrl.share(name, 2, 3, true));
+
+  // nothing yet
+  Tap tap(name);
+  Tap::View view;
+  REQUIRE(tap.good());
+  REQUIRE(tap.alive());
+  REQUIRE(3 == tap.header()->slots);
+  REQUIRE(2 == tap.header()->every);
+  REQUIRE(!tap.latest(view));
+
+  // every other tick, read in place (colors left stale, as headless)
+  std::fill(state.xr_.begin(), state.xr_.end(), 0.0f);
+  std::fill(state.xg_.begin(), state.xg_.end(), 0.0f);
+  std::fill(state.xb_.begin(), state.xb_.end(), 0.0f);
+  std::fill(state.xa_.begin(), state.xa_.end(), 0.0f);
+  for (int i = 0; i < 4; ++i) {
+    ctrl.next();
+  }
+  REQUIRE(2 == tap.frames());
+  REQUIRE(tap.latest(view));
+  REQUIRE(4 == view.info.tick);
+  REQUIRE(1 == view.info.frame);
+  REQUIRE(state.num_ == static_cast<int>(view.info.count));
+  REQUIRE(state.scope_ == view.info.scope);
+  bool same = true;
+  for (int i = 0; i < state.num_; ++i) {
+    same = same && state.px_[i] == view.x[i] && state.py_[i] == view.y[i] &&
+           static_cast<uint8_t>(state.pt_[i]) == view.t[i];
+  }
+  REQUIRE(same);
+  REQUIRE(nullptr != view.rgba);
+  // colored by the tick, without a GUI to have colored them
+  std::vector<uint8_t> rgba(view.rgba, view.rgba + 4 * view.info.count);
+  same = !rgba.empty();
+  for (int i = 0; i < state.num_; ++i) {
+    float color[4] = {state.xr_[i], state.xg_[i], state.xb_[i], state.xa_[i]};
+    for (int c = 0; c < 4; ++c) {
+      same = same && static_cast<uint8_t>(color[c] * 255.0f + 0.5f) ==
+                     rgba[4 * i + c];
+    }
+  }
+  REQUIRE(same);
+  REQUIRE(rgba.end() != std::find_if(rgba.begin(), rgba.end(),
+                                    [](uint8_t c) { return 0 != c; }));
+  REQUIRE(tap.intact(view));
+
+  // a reader a whole ring behind finds its frame overwritten
+  for (int i = 0; i < 2 * 3; ++i) {
+    ctrl.next();
+  }
+  REQUIRE(!tap.intact(view));
+  REQUIRE(tap.latest(view));
+  REQUIRE(10 == view.info.tick);
+
+  // more particles than room leaves some out
+  state.append(std::vector<float>(3 * state.num_, 1.0f),
+               std::vector<float>(3 * state.num_, 1.0f),
+               std::vector<float>(3 * state.num_, 0.0f));
+  ctrl.next();
+  ctrl.next();
+  REQUIRE(tap.latest(view));
+  REQUIRE(state.num_ == view.info.num);
+  REQUIRE(tap.header()->capacity == view.info.count);
+
+  // readers keep their mapping after the writer is gone
+  REQUIRE(ctrl.share(name + ".other"));
+  REQUIRE(!tap.alive());
+  REQUIRE(12 == view.info.tick);
+  REQUIRE(!Tap(name).good());
+}
@@ -0,0 +1,121 @@
+#include "saver.hh"
+
+
+Saver::Saver(Log& log)
+  : log_(log)
+{
+  this->writing_ = 0;
+  this->replaced_ = 0;
+  this->done_ = false;
+  this->thread_ = std::thread(&Saver::work, this);
+}
+
+
+Saver::~Saver()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->done_ = true;
+  }
+  this->cond_.notify_all();
+  this->thread_.join();
+  this->report();
+}
+
+
+void
+Saver::save(const std::string& path, std::unique_ptr<Snapshot::Image> image)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (Request& request : this->queue_) {
+      if (request.first == path) {
+        request.second = std::move(image);
+        ++this->replaced_;
+        return;
+      }
+    }
+    this->queue_.emplace_back(path, std::move(image));
+  }
+  this->cond_.notify_all();
+}
+
+
+void
+Saver::report()
+{
+  std::vector<std::pair<std::string,bool>> finished;
+  unsigned int replaced;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    finished.swap(this->finished_);
+    replaced = this->replaced_;
+    this->replaced_ = 0;
+  }
+  if (0 < replaced) {
+    this->log_.add(Attn::O, "Coalesced " + std::to_string(replaced) +
+                   " save requests into pending ones.");
+  }
+  for (auto& outcome : finished) {
+    if (outcome.second) {
+      this->log_.add(Attn::O, "Saved state to '" + outcome.first + "'.");
+    } else {
+      this->log_.add(Attn::E, "Could not save to file '" + outcome.first +
+                     "'.");
+    }
+  }
+}
+
+
+void
+Saver::wait()
+{
+  {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->cond_.wait(lock, [this] {
+      return this->queue_.empty() && 0 == this->writing_;
+    });
+  }
+  this->report();
+}
+
+
+bool
+Saver::busy()
+{
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return !this->queue_.empty() || 0 < this->writing_;
+}
+
+
+void
+Saver::work()
+{
+  Request request;
+  bool good;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->cond_.wait(lock, [this] {
+        return this->done_ || !this->queue_.empty();
+      });
+      if (this->queue_.empty()) {
+        return; // done and drained
+      }
+      request = std::move(this->queue_.front());
+      this->queue_.pop_front();
+      ++this->writing_;
+    }
+
+    good = Snapshot::write(request.first, *request.second);
+    request.second.reset();
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->finished_.emplace_back(request.first, good);
+      --this->writing_;
+    }
+    this->cond_.notify_all(); // wait() may be waiting for idleness
+  }
+}
@@ -0,0 +1,69 @@
+//===-- state/saver.hh - Saver class declaration ---------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Saver class, which writes images of State (see
+/// Snapshot) on a background thread, so that saving a large state does not
+/// hold up the particle system. Requests to save to a path that is still
+/// waiting for its turn replace the waiting image, and outcomes get reported
+/// to Log by the thread owning the Saver.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "snapshot.hh"
+#include "../util/log.hh"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+class Saver
+{
+ public:
+  /// constructor: Start the writer thread.
+  /// \param log  Log object
+  Saver(Log& log);
+
+  /// destructor: Write the pending images, report, and stop the thread.
+  ~Saver();
+
+  /// save(): Queue an image for writing. If an image for the same path is
+  ///         still waiting, it is replaced (coalesced) instead.
+  /// \param path  path to the destination file
+  /// \param image  image to be written
+  void save(const std::string& path, std::unique_ptr<Snapshot::Image> image);
+
+  /// report(): Log the outcomes of the writes finished since last report.
+  ///           Not thread safe with respect to Log, so call it from the
+  ///           thread that owns the Saver (eg. once per tick).
+  void report();
+
+  /// wait(): Block until every queued image is written, then report().
+  void wait();
+
+  /// busy(): Whether images are waiting or being written.
+  /// \returns  true if the writer thread has work
+  bool busy();
+
+ private:
+  /// work(): Writer thread loop.
+  void work();
+
+  typedef std::pair<std::string,std::unique_ptr<Snapshot::Image>> Request;
+
+  Log&                    log_;
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  std::deque<Request>     queue_;    // images waiting to be written
+  std::vector<std::pair<std::string,bool>> finished_; // path, success
+  unsigned int            writing_;  // number of images being written
+  unsigned int            replaced_; // images coalesced since last report
+  bool                    done_;     // whether writer thread should finish
+};
@@ -0,0 +1,52 @@
+#include "saver.hh"
+#include "snapshot.hh"
+#include "state.hh"
+#include "../proc/control.hh"
+#include "../util/common.hh"
+#include <stdio.h>
+
+
+#define TESTSAVER "testemergence.saver" SNAPSHOT_EXTENSION
+
+
+TEST_CASE("Saver::save")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  auto state2 = State(log, expctrl);
+  long long duration = 0;
+
+  // the image is a copy, so the system may go on while it is written
+  std::vector<float> px;
+  {
+    Saver saver(log);
+    std::unique_ptr<Snapshot::Image> image(new Snapshot::Image());
+    Snapshot::take(state, 42, *image);
+    px.assign(state.px_.begin(), state.px_.end());
+    saver.save(TESTSAVER, std::move(image));
+    proc.next();
+    saver.wait();
+    REQUIRE(!saver.busy());
+  }
+  REQUIRE(Snapshot::load(TESTSAVER, state2, duration));
+  REQUIRE(42 == duration);
+  REQUIRE(state2.px_ == px);
+  REQUIRE(!(state2.px_ == state.px_));
+
+  // the last image queued for a path is the one that ends up in the file
+  {
+    Saver saver(log);
+    for (long long d = 1; d <= 5; ++d) {
+      std::unique_ptr<Snapshot::Image> image(new Snapshot::Image());
+      Snapshot::take(state, d, *image);
+      saver.save(TESTSAVER, std::move(image));
+    }
+  } // destructor writes whatever is pending
+  REQUIRE(Snapshot::load(TESTSAVER, state2, duration));
+  REQUIRE(5 == duration);
+  REQUIRE(state2.px_ == state.px_);
+  remove(TESTSAVER);
+}
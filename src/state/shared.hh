@@ -0,0 +1,145 @@
+//===-- state/shared.hh - Shared class definition --------------*- C++ -*-===//
+///
+/// \file
+/// Definition of the Shared class, the layout of the POSIX shared memory
+/// that Live writes and Tap reads: a Header, followed by a ring of slots,
+/// each holding one frame (an Info
+/// with the tick and parameters) and the particle columns X, Y, types, and
+/// optionally colors (RGBA bytes), every part aligned to SHARED_ALIGN.
+/// Slots are versioned like a seqlock: seq is odd while the writer fills the
+/// slot, and grows by 2 with every frame written to it, so a reader that sees
+/// the same even seq before and after reading has read one whole frame.
+/// Only this header is needed to read the memory (eg. from other programs).
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+#define SHARED_MAGIC 0x4d4c4d45u // "EMLM"
+#define SHARED_VERSION 1
+#define SHARED_ALIGN 64           // bytes (a cache line)
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared atomics must be lock-free (and so address-free)");
+
+
+class Shared
+{
+ public:
+  // Header: Beginning of the shared memory (written once, but for frames
+  //         and alive).
+  struct Header
+  {
+    uint32_t              magic;
+    uint32_t              version;
+    uint32_t              slots;    // number of slots in the ring
+    uint32_t              capacity; // particles a slot holds at most
+    uint32_t              colors;   // whether slots hold colors
+    uint32_t              every;    // ticks between frames
+    uint64_t              bytes;    // bytes of a slot
+    std::atomic<uint64_t> frames;   // frames written so far; the latest is
+                                    // in slot (frames - 1) % slots
+    std::atomic<uint32_t> alive;    // 0 once the writer is gone
+  };
+
+  // Info: Tick and parameters of a frame.
+  struct Info
+  {
+    uint64_t tick;
+    uint64_t frame;    // number of the frame (from 0)
+    int32_t  num;      // number of particles in the system
+    uint32_t count;    // number of particles in the slot (up to capacity)
+    uint32_t width;
+    uint32_t height;
+    float    alpha;    // radians
+    float    beta;     // radians
+    float    scope;
+    float    ascope;
+    float    speed;
+    float    noise;    // radians
+    float    prad;
+    int32_t  coloring;
+  };
+
+  // Frame: Beginning of a slot.
+  struct Frame
+  {
+    std::atomic<uint64_t> seq; // odd while being written
+    Info                  info;
+  };
+
+  /// align(): Round a size up to SHARED_ALIGN.
+  /// \param bytes  size
+  /// \returns  aligned size
+  static inline uint64_t
+  align(uint64_t bytes)
+  {
+    return (bytes + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN;
+  }
+
+  /// Offsets within a slot of a given capacity: X and Y (floats), types
+  /// (bytes), and colors (4 bytes per particle); and the slot size.
+  static inline uint64_t
+  x_at(uint32_t /* capacity */)
+  {
+    return align(sizeof(Frame));
+  }
+
+  static inline uint64_t
+  y_at(uint32_t capacity)
+  {
+    return x_at(capacity) + align(capacity * sizeof(float));
+  }
+
+  static inline uint64_t
+  t_at(uint32_t capacity)
+  {
+    return y_at(capacity) + align(capacity * sizeof(float));
+  }
+
+  static inline uint64_t
+  rgba_at(uint32_t capacity)
+  {
+    return t_at(capacity) + align(capacity);
+  }
+
+  static inline uint64_t
+  slot_bytes(uint32_t capacity, bool colors)
+  {
+    return rgba_at(capacity) + (colors ? align(4ull * capacity) : 0);
+  }
+
+  /// total(): Get the size of the whole shared memory.
+  /// \param slots  number of slots
+  /// \param capacity  particles a slot holds at most
+  /// \param colors  whether slots hold colors
+  /// \returns  number of bytes
+  static inline uint64_t
+  total(uint32_t slots, uint32_t capacity, bool colors)
+  {
+    return align(sizeof(Header)) + slots * slot_bytes(capacity, colors);
+  }
+
+  /// slot(): Get the beginning of a slot.
+  /// \param header  beginning of the shared memory
+  /// \param index  index of the slot
+  /// \returns  beginning of the slot
+  static inline unsigned char*
+  slot(Header* header, uint64_t index)
+  {
+    return reinterpret_cast<unsigned char*>(header) +
+           align(sizeof(Header)) + index * header->bytes;
+  }
+
+  static inline const unsigned char*
+  slot(const Header* header, uint64_t index)
+  {
+    return reinterpret_cast<const unsigned char*>(header) +
+           align(sizeof(Header)) + index * header->bytes;
+  }
+};
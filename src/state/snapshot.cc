@@ -0,0 +1,223 @@
+#include "snapshot.hh"
+#include "state.hh"
+#include "../util/util.hh"
+#include <cstring>
+#include <fcntl.h>    // open
+#include <fstream>
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+
+static_assert(64 == sizeof(Snapshot::Header), "Snapshot header is 64 bytes");
+
+
+/// padded(): Get the size of a column in the file.
+/// \param bytes  size of the column values
+/// \returns  size padded to a multiple of 64 bytes
+static inline std::size_t
+padded(std::size_t bytes)
+{
+  return (bytes + 63) / 64 * 64;
+}
+
+
+/// put(): Write a column, padded.
+/// \param stream  destination stream
+/// \param values  column values
+/// \param bytes  size of the column values
+static void
+put(std::ofstream& stream, const void* values, std::size_t bytes)
+{
+  static const char zeros[64] = {};
+  stream.write(static_cast<const char*>(values), bytes);
+  stream.write(zeros, padded(bytes) - bytes);
+}
+
+
+bool
+Snapshot::is(const std::string& path)
+{
+  std::ifstream stream(path, std::ios::binary);
+  char magic[4];
+  return stream.read(magic, 4) && 0 == std::memcmp(magic, "EMSS", 4);
+}
+
+
+bool
+Snapshot::named(const std::string& path)
+{
+  std::string extension = SNAPSHOT_EXTENSION;
+  return path.size() > extension.size() &&
+         0 == path.compare(path.size() - extension.size(), extension.size(),
+                           extension);
+}
+
+
+void
+Snapshot::take(const State& state, long long duration, Image& image)
+{
+  std::size_t num = state.num_;
+  Header& header = image.header;
+  std::memcpy(header.magic, "EMSS", 4);
+  header.version  = SNAPSHOT_VERSION;
+  header.flags    = SNAPSHOT_TYPES | SNAPSHOT_COLORS;
+  header.num      = num;
+  header.duration = duration;
+  header.width    = state.width_;
+  header.height   = state.height_;
+  header.alpha    = state.alpha_;
+  header.beta     = state.beta_;
+  header.scope    = state.scope_;
+  header.ascope   = state.ascope_;
+  header.speed    = state.speed_;
+  header.noise    = state.noise_;
+  header.prad     = state.prad_;
+  header.coloring = state.coloring_;
+  image.x.assign(state.px_.begin(), state.px_.begin() + num);
+  image.y.assign(state.py_.begin(), state.py_.begin() + num);
+  image.f.assign(state.pf_.begin(), state.pf_.begin() + num);
+  image.t.assign(state.pt_.begin(), state.pt_.begin() + num);
+  image.r.assign(state.xr_.begin(), state.xr_.begin() + num);
+  image.g.assign(state.xg_.begin(), state.xg_.begin() + num);
+  image.b.assign(state.xb_.begin(), state.xb_.begin() + num);
+  image.a.assign(state.xa_.begin(), state.xa_.begin() + num);
+}
+
+
+/// write_text(): Write an image in the text format of Control::load_file().
+/// \param path  path to the destination file
+/// \param image  source image
+/// \returns  whether the write was successful
+static bool
+write_text(const std::string& path, const Snapshot::Image& image)
+{
+  std::ofstream stream(path);
+  if (!stream) {
+    return false;
+  }
+  const Snapshot::Header& header = image.header;
+  stream << header.duration << ' '
+         << header.width << ' '
+         << header.height << ' '
+         << Util::rad_to_deg(header.alpha) << ' '
+         << Util::rad_to_deg(header.beta) << ' '
+         << header.scope << ' '
+         << header.ascope << ' '
+         << header.speed << ' '
+         << Util::rad_to_deg(header.noise) << ' '
+         << header.prad << '\n';
+  for (unsigned int i = 0; i < header.num; ++i) {
+    stream << i << ' '
+           << image.x[i] << ' '
+           << image.y[i] << ' '
+           << Util::rad_to_deg(image.f[i]) << '\n';
+  }
+  stream.close();
+  return static_cast<bool>(stream);
+}
+
+
+bool
+Snapshot::write(const std::string& path, const Image& image)
+{
+  if (!Snapshot::named(path)) {
+    return write_text(path, image);
+  }
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    return false;
+  }
+  std::size_t num = image.header.num;
+  stream.write(reinterpret_cast<const char*>(&image.header), sizeof(Header));
+  put(stream, image.x.data(), num * sizeof(float));
+  put(stream, image.y.data(), num * sizeof(float));
+  put(stream, image.f.data(), num * sizeof(float));
+  put(stream, image.t.data(), num * sizeof(Type));
+  put(stream, image.r.data(), num * sizeof(float));
+  put(stream, image.g.data(), num * sizeof(float));
+  put(stream, image.b.data(), num * sizeof(float));
+  put(stream, image.a.data(), num * sizeof(float));
+  stream.close();
+  return static_cast<bool>(stream);
+}
+
+
+bool
+Snapshot::load(const std::string& path, State& state, long long& duration)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (0 > fd) {
+    return false;
+  }
+  struct stat info;
+  if (0 != fstat(fd, &info) ||
+      static_cast<std::size_t>(info.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  std::size_t size = info.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping stays valid
+  if (MAP_FAILED == map) {
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(map);
+  const Header& header = *reinterpret_cast<const Header*>(bytes);
+
+  std::size_t num = header.num;
+  std::size_t floats = padded(num * sizeof(float));
+  std::size_t types = padded(num * sizeof(Type));
+  std::size_t need = sizeof(Header) + 3 * floats;
+  need += (header.flags & SNAPSHOT_TYPES) ? types : 0;
+  need += (header.flags & SNAPSHOT_COLORS) ? 4 * floats : 0;
+  if (0 != std::memcmp(header.magic, "EMSS", 4) ||
+      SNAPSHOT_VERSION != header.version || size < need) {
+    munmap(map, size);
+    return false;
+  }
+
+  duration        = header.duration;
+  state.width_    = header.width;
+  state.height_   = header.height;
+  state.alpha_    = header.alpha;
+  state.beta_     = header.beta;
+  state.scope_    = header.scope;
+  state.ascope_   = header.ascope;
+  state.speed_    = header.speed;
+  state.noise_    = header.noise;
+  state.prad_     = header.prad;
+  state.coloring_ = header.coloring;
+  state.scope_squared_ = state.scope_ * state.scope_;
+  state.ascope_squared_ = state.ascope_ * state.ascope_;
+
+  const char* column = bytes + sizeof(Header);
+  state.clear();
+  state.num_ = 0;
+  state.reserve(num);
+  for (Column<float>* p : {&state.px_, &state.py_, &state.pf_}) {
+    p->resize(num);
+    std::memcpy(p->data(), column, num * sizeof(float));
+    column += floats;
+  }
+  state.complete();
+  num = state.num_; // (capped)
+  if (header.flags & SNAPSHOT_TYPES) {
+    std::memcpy(state.pt_.data(), column, num * sizeof(Type));
+    for (Type& type : state.pt_) {
+      if (Type::CellCore < type) {
+        type = Type::None; // unknown to this version
+      }
+    }
+    column += types;
+  }
+  if (header.flags & SNAPSHOT_COLORS) {
+    for (Column<float>* x : {&state.xr_, &state.xg_, &state.xb_,
+                             &state.xa_}) {
+      std::memcpy(x->data(), column, num * sizeof(float));
+      column += floats;
+    }
+  }
+  munmap(map, size);
+  return true;
+}
@@ -0,0 +1,109 @@
+//===-- state/snapshot.hh - Snapshot class declaration ---------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Snapshot class, which saves the system parameters and
+/// particles of State to a binary file of aligned columns, and loads them
+/// back by memory-mapping the file, without any parsing. This is the binary
+/// alternative to the text format of Control::load_file() and save_file(),
+/// both of which get written from an Image, a copy of the needed columns
+/// that can be encoded while the particle system goes on.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_EXTENSION ".snapshot" // saving to such a path saves binary
+#define SNAPSHOT_TYPES 1u              // flag: TYPE column present
+#define SNAPSHOT_COLORS 2u             // flag: R, G, B, A columns present
+
+
+enum class Type : uint8_t;
+class State;
+
+class Snapshot
+{
+ public:
+  /// is(): Whether a file is a snapshot (by its magic number).
+  /// \param path  path to the file
+  /// \returns  true if the file starts like a snapshot
+  static bool is(const std::string& path);
+
+  /// named(): Whether a path names a snapshot (by its extension).
+  /// \param path  path to the file
+  /// \returns  true if the path ends in SNAPSHOT_EXTENSION
+  static bool named(const std::string& path);
+
+  struct Image; // below
+
+  /// take(): Copy the system parameters and particle columns to be saved.
+  /// \param state  State object
+  /// \param duration  duration to record
+  /// \param image  destination image
+  static void take(const State& state, long long duration, Image& image);
+
+  /// write(): Write an image to a file, as a snapshot if the path is named()
+  ///          so, or else in the text format of Control::load_file().
+  /// \param path  path to the destination file
+  /// \param image  source image
+  /// \returns  whether the write was successful
+  static bool write(const std::string& path, const Image& image);
+
+  /// load(): Replace the system parameters and particles with those of a
+  ///         snapshot, which is memory-mapped and copied column by column.
+  ///         On failure, State is left unchanged.
+  /// \param path  path to the source file
+  /// \param state  State object
+  /// \param duration  recorded duration
+  /// \returns  whether the load was successful
+  static bool load(const std::string& path, State& state,
+                   long long& duration);
+
+  /* snapshot file format (native endianness)
+   *
+   * Header (64 bytes, below)
+   * X(f32 * NUM) Y(f32 * NUM) PHI(f32 * NUM)  // PHI in radians
+   * TYPE(u8 * NUM)                            // if SNAPSHOT_TYPES
+   * R(f32 * NUM) G(f32 * NUM) B(f32 * NUM) A(f32 * NUM) // if SNAPSHOT_COLORS
+   * where every column is padded to a multiple of 64 bytes
+   */
+
+  // Header: Leading system parameters, as laid out in the file.
+  struct Header
+  {
+    char     magic[4]; // "EMSS"
+    uint32_t version;  // SNAPSHOT_VERSION
+    uint32_t flags;    // SNAPSHOT_TYPES | SNAPSHOT_COLORS
+    uint32_t num;      // number of particles
+    int64_t  duration; // countdown duration
+    uint32_t width;
+    uint32_t height;
+    float    alpha;    // radians
+    float    beta;     // radians
+    float    scope;
+    float    ascope;
+    float    speed;
+    float    noise;    // radians
+    float    prad;
+    int32_t  coloring;
+  };
+
+  // Image: Copy of what gets saved (the header, and the columns).
+  struct Image
+  {
+    Header             header;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> f;
+    std::vector<Type>  t;
+    std::vector<float> r;
+    std::vector<float> g;
+    std::vector<float> b;
+    std::vector<float> a;
+  };
+};
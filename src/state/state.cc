@@ -1,10 +1,23 @@
 #include "state.hh"
+#include "../util/binary.hh"
 #include "../util/common.hh"
+#include "../util/philox.hh"
 #include "../util/util.hh"
+#include <algorithm>
 
 
 State::State(Log& log, ExpControl& expctrl)
-  : log_(log), expctrl_(expctrl)
+  : arena_(new Arena()),
+    px_(*arena_, "px"), py_(*arena_, "py"), pf_(*arena_, "pf"),
+    pc_(*arena_, "pc"), ps_(*arena_, "ps"),
+    pn_(*arena_, "pn"), pl_(*arena_, "pl"), pr_(*arena_, "pr"),
+    pan_(*arena_, "pan"),
+    pls_(*arena_, "pls", STATE_N_STRIDE), prs_(*arena_, "prs", STATE_N_STRIDE),
+    pld_(*arena_, "pld", STATE_N_STRIDE), prd_(*arena_, "prd", STATE_N_STRIDE),
+    pt_(*arena_, "pt"), gcol_(*arena_, "gcol"), grow_(*arena_, "grow"),
+    xr_(*arena_, "xr"), xg_(*arena_, "xg"), xb_(*arena_, "xb"),
+    xa_(*arena_, "xa"),
+    expctrl_(expctrl), log_(log)
 {
   // transportable
   this->num_      = 5000; // 0.08 dpe
@@ -22,12 +35,15 @@ State::State(Log& log, ExpControl& expctrl)
   this->scope_squared_ = this->scope_ * this->scope_;
   this->ascope_squared_ = this->ascope_ * this->ascope_;
   // fixed
-  this->n_stride_ = 100;
+  this->n_stride_ = STATE_N_STRIDE;
+  // bookkeeping
+  this->spawns_ = 0;
 
   expctrl.state(*this);
   this->spawn();
 
   log.add(Attn::O, "Started state module.");
+  log.add(Attn::O, "Particle memory: " + this->arena_->describe() + ".");
 }
 
 
@@ -37,37 +53,219 @@ State::spawn()
   float w = static_cast<float>(this->width_);
   float h = static_cast<float>(this->height_);
   unsigned int num = this->num_;
-  unsigned int n_stride = this->n_stride_;
+  std::size_t from = this->px_.size();
+  // spawns are keyed like ticks, so that each respawn differs
+  uint64_t seed = Philox::seed();
+  uint64_t spawn = this->spawns_++;
 
+  this->reserve(from + num);
   if (!this->expctrl_.spawn(*this)) {
-    for (int i = 0; i < num; ++i) {
-      this->px_.push_back(Util::distr(0.0f, w));
-      this->py_.push_back(Util::distr(0.0f, h));
+    this->px_.resize(from + num);
+    this->py_.resize(from + num);
+    Philox::uniforms(seed, spawn, Stream::SpawnX, 0.0f, w, 0, num,
+                     this->px_.data() + from);
+    Philox::uniforms(seed, spawn, Stream::SpawnY, 0.0f, h, 0, num,
+                     this->py_.data() + from);
+  }
+  from = this->pf_.size();
+  this->pf_.resize(from + num);
+  Philox::uniforms(seed, spawn, Stream::SpawnF, 0.0f, TAU, 0, num,
+                   this->pf_.data() + from);
+  this->num_ = 0;
+  this->complete();
+}
+
+
+void
+State::reserve(unsigned int num)
+{
+  this->arena_->reserve(std::min<unsigned long long>(num, STATE_NUM_MAX));
+}
+
+
+unsigned int
+State::append(const std::vector<float>& px, const std::vector<float>& py,
+              const std::vector<float>& pf, Type type /* = Type::None */,
+              float opacity /* = 0.5f */)
+{
+  std::size_t from = this->px_.size();
+  std::size_t to = from + px.size();
+  this->reserve(to);
+  this->px_.resize(to);
+  this->py_.resize(to);
+  this->pf_.resize(to);
+  std::copy(px.begin(), px.end(), this->px_.begin() + from);
+  std::copy(py.begin(), py.end(), this->py_.begin() + from);
+  std::copy(pf.begin(), pf.end(), this->pf_.begin() + from);
+  return this->complete(type, opacity);
+}
+
+
+unsigned int
+State::complete(Type type /* = Type::None */, float opacity /* = 0.5f */)
+{
+  std::size_t from = this->pc_.size();
+  std::size_t to = this->px_.size();
+  std::size_t n_stride = this->n_stride_;
+
+  if (STATE_NUM_MAX < to) {
+    this->log_.add(Attn::E, "At most " + std::to_string(STATE_NUM_MAX)
+                   + " particles are counted in this build, so "
+                   + std::to_string(to - STATE_NUM_MAX) + " are left out.");
+    to = STATE_NUM_MAX;
+    this->px_.resize(to);
+    this->py_.resize(to);
+    this->pf_.resize(to);
+  }
+  this->pc_.resize(to);
+  this->ps_.resize(to);
+  for (std::size_t i = from; i < to; ++i) {
+    this->pc_[i] = cosf(this->pf_[i]);
+    this->ps_[i] = sinf(this->pf_[i]);
+  }
+  this->pn_.resize(to, 0);
+  this->pl_.resize(to, 0);
+  this->pr_.resize(to, 0);
+  this->pan_.resize(to, 0);
+  this->pls_.resize(n_stride * to, -1);
+  this->prs_.resize(n_stride * to, -1);
+  this->pld_.resize(n_stride * to, -1.0f);
+  this->prd_.resize(n_stride * to, -1.0f);
+  this->pt_.resize(to, type);
+  this->gcol_.resize(to, 0);
+  this->grow_.resize(to, 0);
+  this->xr_.resize(to, 1.0f);
+  this->xg_.resize(to, 1.0f);
+  this->xb_.resize(to, 1.0f);
+  this->xa_.resize(to, opacity);
+  this->num_ += to - from;
+  return from;
+}
+
+
+/// compact(): Move the kept rows of a particle array to their new indices.
+/// \param values  particle array
+/// \param remap  new index per old index (-1 if removed)
+/// \param kept  number of kept particles
+/// \param stride  number of values per particle
+template<typename T> static void
+compact(Column<T>& values, const std::vector<int>& remap,
+        unsigned int kept, unsigned int stride = 1)
+{
+  unsigned int num = remap.size();
+  for (unsigned int i = 0; i < num; ++i) {
+    if (0 > remap[i] || static_cast<unsigned int>(remap[i]) == i) {
+      continue;
     }
+    std::copy(values.begin() + i * stride, values.begin() + (i + 1) * stride,
+              values.begin() + remap[i] * stride);
   }
-  for (int i = 0; i < num; ++i) {
-    this->pf_.push_back(Util::distr(0.0f, TAU));
-    this->pc_.push_back(cosf(this->pf_[i]));
-    this->ps_.push_back(sinf(this->pf_[i]));
-    this->pn_.push_back(0);
-    this->pl_.push_back(0);
-    this->pr_.push_back(0);
-    this->pan_.push_back(0);
-    for (int j = 0; j < n_stride; ++j) { this->pls_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { this->prs_.push_back(-1); }
-    for (int j = 0; j < n_stride; ++j) { this->pld_.push_back(-1.0f); }
-    for (int j = 0; j < n_stride; ++j) { this->prd_.push_back(-1.0f); }
-    this->pt_.push_back(Type::None);
-    this->gcol_.push_back(0);
-    this->grow_.push_back(0);
-    this->xr_.push_back(1.0f);
-    this->xg_.push_back(1.0f);
-    this->xb_.push_back(1.0f);
-    this->xa_.push_back(0.5f);
+  values.resize(kept * stride);
+}
+
+
+/// compact_neighbors(): Remap the neighbor list of a (kept) particle, and
+///                      drop its removed neighbors.
+/// \param ps  neighbor indices of the particle (-1 terminated, unless full)
+/// \param pd  neighbor distances of the particle
+/// \param remap  new index per old index (-1 if removed)
+/// \param stride  neighbor list stride
+/// \param ascope_squared  squared alternative vicinity radius
+/// \param dropped  number of dropped neighbors
+/// \param adropped  number of dropped neighbors within the alternative radius
+static void
+compact_neighbors(int* ps, float* pd, const std::vector<int>& remap,
+                  unsigned int stride, float ascope_squared,
+                  unsigned int& dropped, unsigned int& adropped)
+{
+  unsigned int to = 0;
+  int index;
+  for (unsigned int k = 0; k < stride && 0 <= ps[k]; ++k) {
+    index = remap[ps[k]];
+    if (0 > index) {
+      ++dropped;
+      adropped += ascope_squared >= pd[k];
+      continue;
+    }
+    ps[to] = index;
+    pd[to] = pd[k];
+    ++to;
+  }
+  for (unsigned int k = to; k < stride && 0 <= ps[k]; ++k) {
+    ps[k] = -1;
+    pd[k] = -1.0f;
   }
 }
 
 
+std::vector<int>
+State::remove(const std::vector<unsigned int>& particles)
+{
+  unsigned int num = this->px_.size();
+  unsigned int n_stride = this->n_stride_;
+  std::vector<int> remap(num, 0);
+  for (unsigned int i : particles) {
+    if (i < num) {
+      remap[i] = -1;
+    }
+  }
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < num; ++i) {
+    if (0 <= remap[i]) {
+      remap[i] = kept;
+      ++kept;
+    }
+  }
+
+  compact(this->px_, remap, kept);
+  compact(this->py_, remap, kept);
+  compact(this->pf_, remap, kept);
+  compact(this->pc_, remap, kept);
+  compact(this->ps_, remap, kept);
+  compact(this->pn_, remap, kept);
+  compact(this->pl_, remap, kept);
+  compact(this->pr_, remap, kept);
+  compact(this->pan_, remap, kept);
+  compact(this->pls_, remap, kept, n_stride);
+  compact(this->prs_, remap, kept, n_stride);
+  compact(this->pld_, remap, kept, n_stride);
+  compact(this->prd_, remap, kept, n_stride);
+  compact(this->pt_, remap, kept);
+  compact(this->gcol_, remap, kept);
+  compact(this->grow_, remap, kept);
+  compact(this->xr_, remap, kept);
+  compact(this->xg_, remap, kept);
+  compact(this->xb_, remap, kept);
+  compact(this->xa_, remap, kept);
+
+  unsigned int ldropped;
+  unsigned int rdropped;
+  unsigned int adropped;
+  unsigned int istride;
+  if (kept < num) {
+    for (unsigned int i = 0; i < kept; ++i) {
+      ldropped = 0;
+      rdropped = 0;
+      adropped = 0;
+      istride = n_stride * i;
+      compact_neighbors(&this->pls_[istride], &this->pld_[istride], remap,
+                        n_stride, this->ascope_squared_, ldropped, adropped);
+      compact_neighbors(&this->prs_[istride], &this->prd_[istride], remap,
+                        n_stride, this->ascope_squared_, rdropped, adropped);
+      this->pl_[i] -= ldropped;
+      this->pr_[i] -= rdropped;
+      this->pn_[i] -= ldropped + rdropped;
+      this->pan_[i] -= adropped;
+    }
+  }
+  this->num_ = kept;
+
+  this->remap_ = remap;
+  this->notify(Issue::StateRemapped); // Canvas reacts
+  return remap;
+}
+
+
 void
 State::clear()
 {
@@ -138,6 +336,91 @@ State::type_name(Type type)
 }
 
 
+void
+State::checkpoint(std::ostream& stream) const
+{
+  Binary::put<int32_t>(stream, this->num_);
+  Binary::put<uint32_t>(stream, this->width_);
+  Binary::put<uint32_t>(stream, this->height_);
+  Binary::put(stream, this->alpha_);
+  Binary::put(stream, this->beta_);
+  Binary::put(stream, this->scope_);
+  Binary::put(stream, this->ascope_);
+  Binary::put(stream, this->speed_);
+  Binary::put(stream, this->noise_);
+  Binary::put(stream, this->prad_);
+  Binary::put<int32_t>(stream, this->coloring_);
+  Binary::put<uint8_t>(stream, sizeof(Count)); // storage layout
+  Binary::put<uint8_t>(stream, sizeof(Coord));
+  Binary::put(stream, this->px_);
+  Binary::put(stream, this->py_);
+  Binary::put(stream, this->pf_);
+  Binary::put(stream, this->pc_);
+  Binary::put(stream, this->ps_);
+  Binary::put(stream, this->pn_);
+  Binary::put(stream, this->pl_);
+  Binary::put(stream, this->pr_);
+  Binary::put(stream, this->pan_);
+  Binary::put(stream, this->pt_);
+  Binary::put(stream, this->gcol_);
+  Binary::put(stream, this->grow_);
+  Binary::put(stream, this->xr_);
+  Binary::put(stream, this->xg_);
+  Binary::put(stream, this->xb_);
+  Binary::put(stream, this->xa_);
+}
+
+
+bool
+State::restore(std::istream& stream)
+{
+  int32_t num;
+  uint32_t width;
+  uint32_t height;
+  int32_t coloring;
+  uint8_t count_size;
+  uint8_t coord_size;
+  if (!Binary::get(stream, num) || !Binary::get(stream, width) ||
+      !Binary::get(stream, height) || !Binary::get(stream, this->alpha_) ||
+      !Binary::get(stream, this->beta_) || !Binary::get(stream, this->scope_) ||
+      !Binary::get(stream, this->ascope_) || !Binary::get(stream, this->speed_)
+      || !Binary::get(stream, this->noise_) ||
+      !Binary::get(stream, this->prad_) || !Binary::get(stream, coloring) ||
+      !Binary::get(stream, count_size) || sizeof(Count) != count_size ||
+      !Binary::get(stream, coord_size) || sizeof(Coord) != coord_size ||
+      !Binary::get(stream, this->px_) || !Binary::get(stream, this->py_) ||
+      !Binary::get(stream, this->pf_) || !Binary::get(stream, this->pc_) ||
+      !Binary::get(stream, this->ps_) || !Binary::get(stream, this->pn_) ||
+      !Binary::get(stream, this->pl_) || !Binary::get(stream, this->pr_) ||
+      !Binary::get(stream, this->pan_) || !Binary::get(stream, this->pt_) ||
+      !Binary::get(stream, this->gcol_) || !Binary::get(stream, this->grow_) ||
+      !Binary::get(stream, this->xr_) || !Binary::get(stream, this->xg_) ||
+      !Binary::get(stream, this->xb_) || !Binary::get(stream, this->xa_)) {
+    return false;
+  }
+  if (STATE_NUM_MAX < this->px_.size()) {
+    this->log_.add(Attn::E, "Checkpoint holds more particles than are "
+                   "counted in this build.");
+    return false;
+  }
+  this->num_ = num;
+  this->width_ = width;
+  this->height_ = height;
+  this->coloring_ = coloring;
+  // derived
+  this->scope_squared_ = this->scope_ * this->scope_;
+  this->ascope_squared_ = this->ascope_ * this->ascope_;
+  // recomputed by the next seek
+  std::size_t neighbors = this->n_stride_ * this->px_.size();
+  this->pls_.assign(neighbors, -1);
+  this->prs_.assign(neighbors, -1);
+  this->pld_.assign(neighbors, -1.0f);
+  this->prd_.assign(neighbors, -1.0f);
+  this->notify(Issue::StateChanged); // Canvas reacts
+  return true;
+}
+
+
 float
 State::dpe()
 {
@@ -1,53 +1,29 @@
 //===-- state/state.hh - State class declaration ---------------*- C++ -*-===//
 ///
 /// \file
-/// Definition of the Type enum and declaration of the State class, which acts
-/// as the main data store for the particle system.
+/// Declaration of the State class, which acts as the main data store for the
+/// particle system (of particles of a Type, see type.hh).
 ///
 //===---------------------------------------------------------------------===//
 
 #pragma once
 
+#include "type.hh"
 #include "../exp/control.hh"
 #include "../proc/control.hh"
+#include "../util/arena.hh"
+#include "../util/common.hh"
 #include "../util/log.hh"
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <string>
 #include <vector>
 
 
-// Type: Type of particle, by its vicinity/neighborhood/local density.
-//       While a type gets assigned per particle, this enum can also be used to
-//       refer to particle groups/structures/clusters.
-//       Should be continuous for TypeNames[].
-
-enum class Type
-{
-  None = 0,
-  PrematureSpore, // coloring and injecting
-  MatureSpore,    // coloring and injecting
-  Ring,           // injecting
-  PrematureCell,  // injecting
-  TriangleCell,   // injecting
-  SquareCell,     // injecting
-  PentagonCell,   // injecting
-  Nutrient,       // coloring
-  CellHull,       // coloring
-  CellCore        // coloring
-};
-
-static const std::string TypeNames[] = {
-  "(none)",
-  "premature spore",
-  "mature spore",
-  "ring",
-  "premature cell",
-  "triangle cell",
-  "square cell",
-  "pentagon cell",
-  "nutrient",
-  "cell hull",
-  "cell core"
-};
+#define STATE_N_STRIDE 100 // neighbor list stride
+// most particles, as neighbor counts reach num - 1 (see complete())
+#define STATE_NUM_MAX (static_cast<unsigned long long>(COUNT_MAX) + 1)
 
 
 struct Stative; // from control.hh
@@ -71,6 +47,42 @@ class State : public Subject
   /// respawn(): Reinitialise the particle parameters.
   void respawn();
 
+  /// reserve(): Reserve capacity for a number of particles in every particle
+  ///            array at once (one arena layout), so that appending does not
+  ///            reallocate.
+  /// \param num  total number of particles
+  void reserve(unsigned int num);
+
+  /// append(): Append particles to every particle array at once.
+  /// \param px  X parameters
+  /// \param py  Y parameters (as many as px)
+  /// \param pf  PHI parameters (as many as px)
+  /// \param type  type of every appended particle
+  /// \param opacity  opacity of every appended particle
+  /// \returns  index of the first appended particle
+  unsigned int append(const std::vector<float>& px,
+                      const std::vector<float>& py,
+                      const std::vector<float>& pf, Type type = Type::None,
+                      float opacity = 0.5f);
+
+  /// complete(): Complete particles that so far only were pushed onto px_,
+  ///             py_ and pf_ (eg. while parsing), by deriving or defaulting
+  ///             their other parameters, and count them into num_. Every way
+  ///             of adding particles ends here, so particles beyond
+  ///             STATE_NUM_MAX are left out (and logged).
+  /// \param type  type of every completed particle
+  /// \param opacity  opacity of every completed particle
+  /// \returns  index of the first completed particle
+  unsigned int complete(Type type = Type::None, float opacity = 0.5f);
+
+  /// remove(): Remove particles from every particle array at once, keeping
+  ///           the order of the remaining ones (stable compaction). Neighbor
+  ///           lists are remapped, dropping the removed neighbors.
+  ///           Observers get Issue::StateRemapped, with remap_ set.
+  /// \param particles  indices of particles to remove (in any order)
+  /// \returns  new index per old index (-1 if removed)
+  std::vector<int> remove(const std::vector<unsigned int>& particles);
+
   /// change(): Mutate the system parameters.
   /// \param input  system parameters to change to
   /// \param respawn  whether system should respawn
@@ -82,35 +94,68 @@ class State : public Subject
   /// \returns  name of particle type
   static std::string type_name(Type type);
 
+  /// type_of(): Get type of a particle by its neighborhood sizes.
+  ///            Branchless, so that typing loops can be vectorised.
+  /// \param n  N parameter of the particle
+  /// \param an  alternative N parameter of the particle
+  /// \returns  particle type
+  static inline Type
+  type_of(unsigned int n, unsigned int an)
+  {
+    int spore = 15 < n && 15 < an;
+    int hull = !spore && 15 < n && n <= 35;
+    int core = !spore && 35 < n;
+    int premature = 13 <= n && n <= 15;
+    int nutrient = !(spore | hull | core | premature);
+    return static_cast<Type>(
+      spore       * static_cast<int>(Type::MatureSpore)
+      + hull      * static_cast<int>(Type::CellHull)
+      + core      * static_cast<int>(Type::CellCore)
+      + premature * static_cast<int>(Type::PrematureSpore)
+      + nutrient  * static_cast<int>(Type::Nutrient));
+  }
+
+  /// checkpoint(): Write the system parameters and particles, except for the
+  ///               neighbor lists, which the next seek recomputes.
+  /// \param stream  destination binary stream
+  void checkpoint(std::ostream& stream) const;
+
+  /// restore(): Replace the system parameters and particles with those
+  ///            written by checkpoint().
+  /// \param stream  source binary stream
+  /// \returns  whether reading was successful
+  bool restore(std::istream& stream);
+
   /// dpe(): Get density of particles in the surrounding environment (DPE).
   /// \returns  dpe
   float dpe();
 
-  //// particle (volatile)
+  //// particle (volatile), laid out together by arena_
+  std::unique_ptr<Arena> arena_;  // memory of all particle columns
   // location & direction
-  std::vector<float> px_;         // X parameter
-  std::vector<float> py_;         // Y parameter
-  std::vector<float> pf_;         // PHI parameter
-  std::vector<float> pc_;         // cos(PHI) parameter
-  std::vector<float> ps_;         // sin(PHI) parameter
+  Column<float> px_;              // X parameter
+  Column<float> py_;              // Y parameter
+  Column<float> pf_;              // PHI parameter
+  Column<float> pc_;              // cos(PHI) parameter
+  Column<float> ps_;              // sin(PHI) parameter
   // vicinity
-  std::vector<unsigned int> pn_;  // N(=L+R) parameter
-  std::vector<unsigned int> pl_;  // L parameter
-  std::vector<unsigned int> pr_;  // R parameter
-  std::vector<unsigned int> pan_; // alternative N parameter (for spores)
-  std::vector<int>          pls_; // L neighbor indices (signed!)
-  std::vector<int>          prs_; // R neighbor indices (signed!)
-  std::vector<float>        pld_; // L neighbor distances
-  std::vector<float>        prd_; // R neighbor distances
-  std::vector<Type>         pt_;  // type (nutrient, mature spore, ring, etc.)
+  Column<Count> pn_;              // N(=L+R) parameter
+  Column<Count> pl_;              // L parameter
+  Column<Count> pr_;              // R parameter
+  Column<Count> pan_;             // alternative N parameter (for spores)
+  Column<int>          pls_;      // L neighbor indices (signed!)
+  Column<int>          prs_;      // R neighbor indices (signed!)
+  Column<float>        pld_;      // L neighbor distances
+  Column<float>        prd_;      // R neighbor distances
+  Column<Type>         pt_;       // type (nutrient, mature spore, ring, etc.)
   // grid
-  std::vector<int> gcol_;         // grid column the particle is in
-  std::vector<int> grow_;         // grid row the particle is in
+  Column<Coord> gcol_;            // grid column the particle is in
+  Column<Coord> grow_;            // grid row the particle is in
   // color
-  std::vector<float> xr_;         // red
-  std::vector<float> xg_;         // green
-  std::vector<float> xb_;         // blue
-  std::vector<float> xa_;         // opacity
+  Column<float> xr_;              // red
+  Column<float> xg_;              // green
+  Column<float> xb_;              // blue
+  Column<float> xa_;              // opacity
 
   // transportable
   int          num_;      // # particles (negative for encoding input error)
@@ -132,6 +177,10 @@ class State : public Subject
   // fixed
   unsigned int n_stride_;         // neighbor list stride
 
+  // bookkeeping
+  std::vector<int> remap_;        // new index per old index of last remove()
+  uint64_t         spawns_;       // number of spawn()s (keys their randomness)
+
  private:
   ExpControl& expctrl_;
   Log&        log_;
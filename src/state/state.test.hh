@@ -88,10 +88,77 @@ TEST_CASE("State::clear")
   REQUIRE(0 == state.grow_.size());
 }
 
+TEST_CASE("State::append")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  unsigned int num = state.num_;
+  unsigned int n_stride = state.n_stride_;
+
+  state.reserve(num + 2);
+  REQUIRE(num + 2 <= state.px_.capacity());
+  REQUIRE(n_stride * (num + 2) <= state.pls_.capacity());
+  unsigned int first = state.append({1.0f, 2.0f}, {3.0f, 4.0f},
+                                    {0.0f, 1.0f}, Type::Ring, 1.0f);
+  REQUIRE(num == first);
+  REQUIRE(num + 2 == state.num_);
+  REQUIRE(num + 2 == state.px_.size());
+  REQUIRE(num + 2 == state.pan_.size());
+  REQUIRE(num + 2 == state.gcol_.size());
+  REQUIRE(num + 2 == state.grow_.size());
+  REQUIRE(num + 2 == state.xa_.size());
+  REQUIRE(n_stride * (num + 2) == state.pls_.size());
+  REQUIRE(n_stride * (num + 2) == state.prd_.size());
+  REQUIRE(2.0f == state.px_[num + 1]);
+  REQUIRE(4.0f == state.py_[num + 1]);
+  REQUIRE(cosf(1.0f) == state.pc_[num + 1]);
+  REQUIRE(sinf(1.0f) == state.ps_[num + 1]);
+  REQUIRE(Type::Ring == state.pt_[num + 1]);
+  REQUIRE(1.0f == state.xa_[num + 1]);
+  REQUIRE(-1 == state.pls_[n_stride * (num + 1)]);
+}
+
+TEST_CASE("State::remove")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  unsigned int n_stride = state.n_stride_;
+
+  state.clear();
+  state.num_ = 0;
+  state.append({0.0f, 1.0f, 2.0f, 3.0f}, {0.0f, 0.0f, 0.0f, 0.0f},
+               {0.0f, 0.0f, 0.0f, 0.0f});
+  // particle 3 has left neighbors 0, 1, 2 (1 within the alternative radius)
+  state.pls_[3 * n_stride + 0] = 0; state.pld_[3 * n_stride + 0] = 9.0f;
+  state.pls_[3 * n_stride + 1] = 1; state.pld_[3 * n_stride + 1] = 4.0f;
+  state.pls_[3 * n_stride + 2] = 2; state.pld_[3 * n_stride + 2] = 1.0f;
+  state.pl_[3] = 3; state.pn_[3] = 3; state.pan_[3] = 1;
+
+  std::vector<int> remap = state.remove({2, 0});
+  REQUIRE((std::vector<int>{-1, 0, -1, 1}) == remap);
+  REQUIRE(remap == state.remap_);
+  REQUIRE(2 == state.num_);
+  REQUIRE((std::vector<float>{1.0f, 3.0f}) == state.px_);
+  REQUIRE(2 == state.pc_.size());
+  REQUIRE(2 == state.xa_.size());
+  REQUIRE(2 * n_stride == state.pls_.size());
+  REQUIRE(2 * n_stride == state.prd_.size());
+  REQUIRE(0 == state.pls_[n_stride + 0]);
+  REQUIRE(4.0f == state.pld_[n_stride + 0]);
+  REQUIRE(-1 == state.pls_[n_stride + 1]);
+  REQUIRE(-1.0f == state.pld_[n_stride + 1]);
+  REQUIRE(-1 == state.pls_[n_stride + 2]);
+  REQUIRE(1 == state.pl_[1]);
+  REQUIRE(1 == state.pn_[1]);
+  REQUIRE(0 == state.pan_[1]);
+}
+
 TEST_CASE("State::change")
 {
   auto log = Log(2, QUIET);
-  REQUIRE(0 == log.messages_.size());
+  REQUIRE(0 == log.messages().size());
 
   auto expctrl = ExpControl(log, 0);
   auto state = State(log, expctrl);
@@ -110,12 +177,14 @@ TEST_CASE("State::change")
     state.coloring_
   };
   state.change(stative, false);
-  REQUIRE(2 == log.messages_.size());
-  REQUIRE("Changed state without respawn." == log.messages_.front().second);
+  log.flush();
+  REQUIRE(2 == log.messages().size());
+  REQUIRE("Changed state without respawn." == log.messages().front().second);
 
   state.change(stative, QUIET);
-  REQUIRE(2 == log.messages_.size());
-  REQUIRE("Changed state with respawn." == log.messages_.front().second);
+  log.flush();
+  REQUIRE(2 == log.messages().size());
+  REQUIRE("Changed state with respawn." == log.messages().front().second);
 
   stative = {
     -1,
@@ -132,8 +201,20 @@ TEST_CASE("State::change")
     state.coloring_
   };
   state.change(stative, QUIET);
-  REQUIRE(2 == log.messages_.size());
-  REQUIRE("Changed state with respawn." == log.messages_.front().second);
+  log.flush();
+  REQUIRE(2 == log.messages().size());
+  REQUIRE("Changed state with respawn." == log.messages().front().second);
+
+#if 1 == STATE_COMPACT
+  // neighbor counts must fit in a Count, however particles are added
+  stative.num = STATE_NUM_MAX + 1;
+  state.change(stative, QUIET);
+  REQUIRE(STATE_NUM_MAX == state.num_);
+  REQUIRE(STATE_NUM_MAX == state.px_.size());
+  state.append({1.0f}, {1.0f}, {0.0f});
+  REQUIRE(STATE_NUM_MAX == state.num_);
+  REQUIRE(STATE_NUM_MAX == state.pt_.size());
+#endif
 }
 
 
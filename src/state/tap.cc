@@ -0,0 +1,126 @@
+#include "tap.hh"
+#include <fcntl.h> // O_* constants
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h> // close
+
+
+Tap::Tap(const std::string& name)
+  : header_(nullptr), bytes_(0)
+{
+  std::string path = !name.empty() && '/' == name[0] ? name : "/" + name;
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (0 > fd) {
+    return;
+  }
+  struct stat status;
+  void* memory = MAP_FAILED;
+  if (0 == fstat(fd, &status) &&
+      sizeof(Shared::Header) <= static_cast<std::size_t>(status.st_size)) {
+    memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (MAP_FAILED == memory) {
+    return;
+  }
+
+  const Shared::Header* header = static_cast<const Shared::Header*>(memory);
+  std::size_t bytes = static_cast<std::size_t>(status.st_size);
+  if (SHARED_MAGIC != header->magic || SHARED_VERSION != header->version ||
+      Shared::total(header->slots, header->capacity, header->colors) !=
+        bytes) {
+    munmap(memory, bytes);
+    return;
+  }
+  this->header_ = header;
+  this->bytes_ = bytes;
+}
+
+
+Tap::~Tap()
+{
+  if (nullptr != this->header_) {
+    munmap(const_cast<Shared::Header*>(this->header_), this->bytes_);
+  }
+}
+
+
+bool
+Tap::good() const
+{
+  return nullptr != this->header_;
+}
+
+
+bool
+Tap::alive() const
+{
+  return this->good() &&
+         0 != this->header_->alive.load(std::memory_order_acquire);
+}
+
+
+uint64_t
+Tap::frames() const
+{
+  if (!this->good()) {
+    return 0;
+  }
+  return this->header_->frames.load(std::memory_order_acquire);
+}
+
+
+bool
+Tap::latest(View& view) const
+{
+  const Shared::Header* header = this->header_;
+  if (nullptr == header) {
+    return false;
+  }
+  uint32_t capacity = header->capacity;
+
+  for (int tries = 0; tries < TAP_TRIES; ++tries) {
+    uint64_t frames = header->frames.load(std::memory_order_acquire);
+    if (0 == frames) {
+      return false;
+    }
+    const unsigned char* slot =
+      Shared::slot(header, (frames - 1) % header->slots);
+    const Shared::Frame* frame =
+      reinterpret_cast<const Shared::Frame*>(slot);
+    uint64_t seq = frame->seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      std::this_thread::yield(); // being written
+      continue;
+    }
+    view.info = frame->info;
+    view.seq = seq;
+    view.frame = frame;
+    if (!this->intact(view) || frames - 1 != view.info.frame) {
+      continue; // overwritten while reading, or already by a later frame
+    }
+    view.x = reinterpret_cast<const float*>(slot + Shared::x_at(capacity));
+    view.y = reinterpret_cast<const float*>(slot + Shared::y_at(capacity));
+    view.t = slot + Shared::t_at(capacity);
+    view.rgba = header->colors ? slot + Shared::rgba_at(capacity) : nullptr;
+    return true;
+  }
+  return false;
+}
+
+
+bool
+Tap::intact(const View& view) const
+{
+  // no read of the frame may move after the seq
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return view.frame->seq.load(std::memory_order_relaxed) == view.seq;
+}
+
+
+const Shared::Header*
+Tap::header() const
+{
+  return this->header_;
+}
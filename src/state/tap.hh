@@ -0,0 +1,79 @@
+//===-- state/tap.hh - Tap class declaration -------------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Tap class, which reads the live frames that Live
+/// publishes in shared memory, from any process. Frames are read in place,
+/// without copies: latest() points into the newest whole frame, and
+/// intact() tells afterwards whether the writer has since overwritten it
+/// (after going a whole ring further), in which case what was read is to be
+/// dropped. Tap only depends on Shared, for other programs to build it.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "shared.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+#define TAP_TRIES 64 // attempts at reading a frame being written
+
+
+class Tap
+{
+ public:
+  // View: Frame as read in place.
+  struct View
+  {
+    Shared::Info   info;
+    const float*   x;    // info.count X parameters
+    const float*   y;    // info.count Y parameters
+    const uint8_t* t;    // info.count types (see Type)
+    const uint8_t* rgba; // info.count colors (nullptr unless shared)
+    uint64_t       seq;  // version of the slot when read
+    const Shared::Frame* frame;
+  };
+
+  /// constructor: Map the shared memory of a Live writer, read-only.
+  /// \param name  name of the shared memory (eg. "/emergence")
+  Tap(const std::string& name);
+
+  /// destructor: Unmap the shared memory.
+  ~Tap();
+
+  Tap(const Tap&) = delete;
+  Tap& operator=(const Tap&) = delete;
+
+  /// good(): Whether the shared memory is mapped, and laid out as expected.
+  /// \returns  true if frames can be read
+  bool good() const;
+
+  /// alive(): Whether the writer still publishes.
+  /// \returns  true until the writer is gone
+  bool alive() const;
+
+  /// frames(): Get the number of frames published so far.
+  /// \returns  number of frames
+  uint64_t frames() const;
+
+  /// latest(): Read the newest frame in place.
+  /// \param view  destination of the frame
+  /// \returns  false if there is none yet, or it kept being written
+  bool latest(View& view) const;
+
+  /// intact(): Whether a frame read by latest() is still in place, ie. what
+  ///           has been read from it since is whole.
+  /// \param view  frame
+  /// \returns  false if the writer has overwritten it
+  bool intact(const View& view) const;
+
+  /// header(): Get the beginning of the shared memory.
+  /// \returns  header (nullptr if not good())
+  const Shared::Header* header() const;
+
+ private:
+  const Shared::Header* header_; // beginning of the mapping (nullptr if none)
+  std::size_t           bytes_;  // size of the mapping
+};
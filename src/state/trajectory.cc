@@ -0,0 +1,343 @@
+#include "trajectory.hh"
+#include "state.hh"
+#include "../util/binary.hh"
+#include "../util/common.hh"
+#include <algorithm>
+#include <cmath>
+
+
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_KEY 0
+#define TRAJECTORY_DELTA 1
+#define TRAJECTORY_DELTA_MAX 32767.0f // quantisation steps per SPEED
+#define TRAJECTORY_PHI_STEPS 65536.0f // quantisation steps per TAU
+#define TRAJECTORY_QUEUE_MAX 8        // frames queued before record() blocks
+
+
+namespace
+{
+
+/// wrap(): Bring a coordinate back into [0, size).
+inline float
+wrap(float v, float size)
+{
+  if (v < 0.0f) { v += size; }
+  if (v >= size) { v -= size; }
+  return v;
+}
+
+} // namespace
+
+
+Trajectory::Trajectory(Log& log, const std::string& path,
+                       unsigned int keyframe /* = 100 */)
+  : log_(log), file_(path, std::ios::out | std::ios::binary | std::ios::trunc),
+    keyframe_(std::max(1u, keyframe))
+{
+  this->done_ = false;
+  this->since_ = 0;
+  this->last_.num = 0;
+  if (!this->file_) {
+    log.add(Attn::E, "Could not open trajectory file '" + path + "'.");
+    return;
+  }
+  uint32_t version = TRAJECTORY_VERSION;
+  uint32_t interval = this->keyframe_;
+  this->file_.write("EMTR", 4);
+  Binary::put(this->file_, version);
+  Binary::put(this->file_, interval);
+  this->thread_ = std::thread(&Trajectory::work, this);
+
+  log.add(Attn::O, "Recording trajectory to '" + path + "'.");
+}
+
+
+Trajectory::~Trajectory()
+{
+  if (!this->thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->done_ = true;
+  }
+  this->cond_.notify_all();
+  this->thread_.join();
+  for (Frame* frame : this->pool_) {
+    delete frame;
+  }
+
+  std::ofstream& file = this->file_;
+  uint64_t index = file.tellp();
+  uint64_t count = this->index_.size();
+  Binary::put(file, count);
+  for (auto& entry : this->index_) {
+    Binary::put(file, entry.first);
+    Binary::put(file, entry.second);
+  }
+  Binary::put(file, index);
+  file.write("EMTX", 4);
+  file.close();
+  if (!file) {
+    this->log_.add(Attn::E, "Could not finish trajectory file.");
+  }
+}
+
+
+bool
+Trajectory::good() const
+{
+  return this->thread_.joinable();
+}
+
+
+void
+Trajectory::record(unsigned long tick, const State& state)
+{
+  if (!this->good()) {
+    return;
+  }
+  unsigned int num = static_cast<unsigned int>(state.num_);
+  Frame* frame;
+  {
+    // wait for the writer thread to catch up rather than growing unbounded
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->cond_.wait(lock, [this] {
+      return TRAJECTORY_QUEUE_MAX > this->queue_.size();
+    });
+    if (this->pool_.empty()) {
+      frame = new Frame;
+    } else {
+      frame = this->pool_.back();
+      this->pool_.pop_back();
+    }
+  }
+
+  frame->tick = tick;
+  frame->num = num;
+  frame->width = state.width_;
+  frame->height = state.height_;
+  frame->speed = state.speed_;
+  frame->x.assign(state.px_.begin(), state.px_.begin() + num);
+  frame->y.assign(state.py_.begin(), state.py_.begin() + num);
+  frame->f.assign(state.pf_.begin(), state.pf_.begin() + num);
+  frame->t.resize(num);
+  for (unsigned int i = 0; i < num; ++i) {
+    frame->t[i] = static_cast<uint8_t>(state.pt_[i]);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->queue_.push_back(frame);
+  }
+  this->cond_.notify_all();
+}
+
+
+void
+Trajectory::work()
+{
+  Frame* frame;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->cond_.wait(lock, [this] {
+        return this->done_ || !this->queue_.empty();
+      });
+      if (this->queue_.empty()) {
+        return; // done and drained
+      }
+      frame = this->queue_.front();
+      this->queue_.pop_front();
+    }
+    this->cond_.notify_all(); // record() may be waiting for room
+
+    this->write(*frame);
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->pool_.push_back(frame);
+    }
+  }
+}
+
+
+void
+Trajectory::write(const Frame& frame)
+{
+  std::ofstream& file = this->file_;
+  Frame& last = this->last_;
+  unsigned int num = frame.num;
+  float w = static_cast<float>(frame.width);
+  float h = static_cast<float>(frame.height);
+  bool key = this->since_ >= this->keyframe_ || 0 == last.num
+             || num != last.num || frame.width != last.width
+             || frame.height != last.height || frame.speed != last.speed
+             || 0.0f >= frame.speed;
+
+  // deltas are taken from the last reconstructed frame rather than the last
+  // true frame, so that quantisation errors do not accumulate
+  if (!key) {
+    float step = last.speed / TRAJECTORY_DELTA_MAX;
+    float limit = last.speed * 1.001f;
+    float dx;
+    float dy;
+    long qx;
+    long qy;
+    this->dx_.resize(num);
+    this->dy_.resize(num);
+    this->df_.resize(num);
+    for (unsigned int i = 0; i < num; ++i) {
+      dx = frame.x[i] - last.x[i];
+      dy = frame.y[i] - last.y[i];
+      // moving over a border looks like a jump across the whole space
+      if      (dx >  0.5f * w) { dx -= w; }
+      else if (dx < -0.5f * w) { dx += w; }
+      if      (dy >  0.5f * h) { dy -= h; }
+      else if (dy < -0.5f * h) { dy += h; }
+      if (fabsf(dx) > limit || fabsf(dy) > limit) {
+        key = true; // particle was displaced, eg. by injection
+        break;
+      }
+      qx = std::lround(dx / step);
+      qy = std::lround(dy / step);
+      qx = std::max(-32767l, std::min(32767l, qx));
+      qy = std::max(-32767l, std::min(32767l, qy));
+      this->dx_[i] = static_cast<int16_t>(qx);
+      this->dy_[i] = static_cast<int16_t>(qy);
+      this->df_[i] = static_cast<uint16_t>(
+        std::lround(frame.f[i] / TAU * TRAJECTORY_PHI_STEPS) & 0xffff);
+    }
+  }
+
+  uint8_t kind = key ? TRAJECTORY_KEY : TRAJECTORY_DELTA;
+  uint64_t tick = frame.tick;
+  uint32_t n = num;
+  if (key) {
+    this->index_.push_back({tick, static_cast<uint64_t>(file.tellp())});
+  }
+  Binary::put(file, kind);
+  Binary::put(file, tick);
+  Binary::put(file, n);
+
+  if (key) {
+    uint32_t width = frame.width;
+    uint32_t height = frame.height;
+    float speed = frame.speed;
+    Binary::put(file, width);
+    Binary::put(file, height);
+    Binary::put(file, speed);
+    Binary::put(file, frame.x, num);
+    Binary::put(file, frame.y, num);
+    Binary::put(file, frame.f, num);
+    Binary::put(file, frame.t, num);
+    last.tick = frame.tick;
+    last.num = num;
+    last.width = frame.width;
+    last.height = frame.height;
+    last.speed = frame.speed;
+    last.x = frame.x;
+    last.y = frame.y;
+    this->since_ = 1;
+  } else {
+    Binary::put(file, this->dx_, num);
+    Binary::put(file, this->dy_, num);
+    Binary::put(file, this->df_, num);
+    Binary::put(file, frame.t, num);
+    float step = last.speed / TRAJECTORY_DELTA_MAX;
+    for (unsigned int i = 0; i < num; ++i) {
+      last.x[i] = wrap(last.x[i] + this->dx_[i] * step, w);
+      last.y[i] = wrap(last.y[i] + this->dy_[i] * step, h);
+    }
+    last.tick = frame.tick;
+    ++this->since_;
+  }
+
+  if (!file) {
+    this->log_.add(Attn::E, "Could not write to trajectory file.");
+  }
+}
+
+
+bool
+Trajectory::read(const std::string& path, unsigned long tick, Frame& frame)
+{
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  char magic[4];
+  uint64_t index;
+  uint64_t count;
+
+  if (!file.read(magic, 4) || 0 != std::string(magic, 4).compare("EMTR")) {
+    return false;
+  }
+  file.seekg(-static_cast<std::streamoff>(sizeof(uint64_t) + 4), std::ios::end);
+  if (!Binary::get(file, index) || !file.read(magic, 4)
+      || 0 != std::string(magic, 4).compare("EMTX")) {
+    return false; // unfinished recording
+  }
+  file.seekg(index);
+  if (!Binary::get(file, count)) {
+    return false;
+  }
+  std::vector<std::pair<uint64_t,uint64_t>> keys(count);
+  for (auto& key : keys) {
+    Binary::get(file, key.first);
+    Binary::get(file, key.second);
+  }
+  // find the latest keyframe at or before tick
+  auto after = std::upper_bound(
+    keys.begin(), keys.end(), std::make_pair(static_cast<uint64_t>(tick),
+                                             static_cast<uint64_t>(-1)));
+  if (keys.begin() == after) {
+    return false;
+  }
+  file.seekg((after - 1)->second);
+
+  uint8_t kind;
+  uint64_t t;
+  uint32_t num;
+  uint32_t width;
+  uint32_t height;
+  std::vector<int16_t> dx;
+  std::vector<int16_t> dy;
+  std::vector<uint16_t> df;
+  while (static_cast<std::streamoff>(file.tellg())
+         < static_cast<std::streamoff>(index)) {
+    if (!Binary::get(file, kind) || !Binary::get(file, t) || !Binary::get(file, num)) {
+      return false;
+    }
+    if (t > tick) {
+      return false; // tick was not recorded
+    }
+    frame.tick = t;
+    frame.num = num;
+    if (TRAJECTORY_KEY == kind) {
+      if (!Binary::get(file, width) || !Binary::get(file, height) || !Binary::get(file, frame.speed)
+          || !Binary::get(file, frame.x, num) || !Binary::get(file, frame.y, num)
+          || !Binary::get(file, frame.f, num) || !Binary::get(file, frame.t, num)) {
+        return false;
+      }
+      frame.width = width;
+      frame.height = height;
+    } else {
+      if (frame.x.size() != num || !Binary::get(file, dx, num) || !Binary::get(file, dy, num)
+          || !Binary::get(file, df, num) || !Binary::get(file, frame.t, num)) {
+        return false;
+      }
+      float step = frame.speed / TRAJECTORY_DELTA_MAX;
+      float w = static_cast<float>(frame.width);
+      float h = static_cast<float>(frame.height);
+      for (unsigned int i = 0; i < num; ++i) {
+        frame.x[i] = wrap(frame.x[i] + dx[i] * step, w);
+        frame.y[i] = wrap(frame.y[i] + dy[i] * step, h);
+        frame.f[i] = df[i] * TAU / TRAJECTORY_PHI_STEPS;
+      }
+    }
+    if (t == tick) {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,113 @@
+//===-- state/trajectory.hh - Trajectory class declaration -----*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Trajectory class, which streams every tick of the
+/// particle system to a binary file for offline analysis.
+/// Periodic keyframes hold full X, Y, PHI, and types, while the frames in
+/// between hold positions as quantised deltas. Encoding and writing happen on
+/// a background thread.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "../util/log.hh"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class State;
+
+class Trajectory
+{
+ public:
+  // Frame: Snapshot of the particles at one tick.
+  struct Frame
+  {
+    unsigned long        tick;
+    unsigned int         num;
+    unsigned int         width;
+    unsigned int         height;
+    float                speed;
+    std::vector<float>   x;
+    std::vector<float>   y;
+    std::vector<float>   f;
+    std::vector<uint8_t> t;
+  };
+
+  /// constructor: Open the trajectory file and start the writer thread.
+  /// \param log  Log object
+  /// \param path  path to the trajectory file
+  /// \param keyframe  number of frames between keyframes
+  Trajectory(Log& log, const std::string& path, unsigned int keyframe = 100);
+
+  /// destructor: Drain pending frames, write the index, and close the file.
+  ~Trajectory();
+
+  /// good(): Whether the trajectory file is writable.
+  /// \returns  true if the trajectory file is writable
+  bool good() const;
+
+  /// record(): Queue a snapshot of the particles for writing.
+  ///           Only blocks if the writer thread is many frames behind.
+  /// \param tick  current time step
+  /// \param state  State object
+  void record(unsigned long tick, const State& state);
+
+  /// read(): Reconstruct the frame at a tick from a trajectory file, using
+  ///         the keyframe index.
+  /// \param path  path to the trajectory file
+  /// \param tick  time step
+  /// \param frame  destination frame
+  /// \returns  whether the frame was found
+  static bool read(const std::string& path, unsigned long tick, Frame& frame);
+
+  /* trajectory file format (native endianness)
+   *
+   * "EMTR" VERSION(u32) KEYFRAME(u32)
+   * frames, each being:
+   *   KIND(u8) TICK(u64) NUM(u32)
+   *   key (KIND 0):   WIDTH(u32) HEIGHT(u32) SPEED(f32)
+   *                   X(f32 * NUM) Y(f32 * NUM) PHI(f32 * NUM) TYPE(u8 * NUM)
+   *   delta (KIND 1): DX(i16 * NUM) DY(i16 * NUM) PHI(u16 * NUM)
+   *                   TYPE(u8 * NUM)
+   * index: COUNT(u64) (TICK(u64) OFFSET(u64)) * COUNT   (of keyframes)
+   * footer: INDEX_OFFSET(u64) "EMTX"
+   *
+   * - DX and DY are in units of SPEED / 32767 of the last keyframe, since
+   *   particles move at most SPEED per tick.
+   * - PHI of delta frames is in units of TAU / 65536.
+   */
+
+ private:
+  /// work(): Writer thread loop.
+  void work();
+
+  /// write(): Encode and write one frame.
+  /// \param frame  frame to be written
+  void write(const Frame& frame);
+
+  Log&                    log_;
+  std::ofstream           file_;
+  unsigned int            keyframe_; // frames between keyframes
+  // writer thread
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  std::deque<Frame*>      queue_;    // frames waiting to be written
+  std::vector<Frame*>     pool_;     // frames available for reuse
+  bool                    done_;     // whether writer thread should finish
+  // encoder (writer thread only)
+  Frame                   last_;     // last reconstructed frame
+  unsigned int            since_;    // frames since last keyframe
+  std::vector<int16_t>    dx_;
+  std::vector<int16_t>    dy_;
+  std::vector<uint16_t>   df_;
+  std::vector<std::pair<uint64_t,uint64_t>> index_; // keyframe tick, offset
+};
@@ -0,0 +1,62 @@
+#include "trajectory.hh"
+#include "state.hh"
+#include "../proc/control.hh"
+#include "../util/common.hh"
+#include <cmath>
+#include <stdio.h>
+
+
+#define TESTTRAJECTORY "testemergence.traj"
+
+
+TEST_CASE("Trajectory::record")
+{
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+  auto state = State(log, expctrl);
+  auto cl = Cl(log);
+  auto proc = Proc(log, state, cl, true);
+  Stative stative = {
+    -1, 300, 100, 100,
+    state.alpha_, state.beta_, state.scope_, state.ascope_,
+    state.speed_, state.noise_, state.prad_, state.coloring_
+  };
+  state.change(stative, true);
+  std::vector<std::vector<float>> xs;
+  std::vector<std::vector<float>> ys;
+  std::vector<std::vector<float>> fs;
+  {
+    Trajectory trajectory(log, TESTTRAJECTORY, 10);
+    REQUIRE(trajectory.good());
+    for (unsigned long tick = 0; tick < 25; ++tick) {
+      proc.next();
+      trajectory.record(tick, state);
+      xs.emplace_back(state.px_.begin(), state.px_.end());
+      ys.emplace_back(state.py_.begin(), state.py_.end());
+      fs.emplace_back(state.pf_.begin(), state.pf_.end());
+    }
+  }
+
+  // wrapped distance, as a particle may sit right at a border
+  auto near = [](float a, float b, float size, float margin) {
+    float d = fabsf(a - b);
+    return d <= margin || size - d <= margin;
+  };
+  Trajectory::Frame frame;
+  for (unsigned long tick : {0ul, 9ul, 10ul, 17ul, 24ul}) {
+    REQUIRE(Trajectory::read(TESTTRAJECTORY, tick, frame));
+    REQUIRE(tick == frame.tick);
+    REQUIRE(300 == frame.num);
+    REQUIRE(100 == frame.width);
+    for (unsigned int i = 0; i < frame.num; ++i) {
+      REQUIRE(near(xs[tick][i], frame.x[i], 100.0f, 0.001f));
+      REQUIRE(near(ys[tick][i], frame.y[i], 100.0f, 0.001f));
+      REQUIRE(near(fs[tick][i], frame.f[i], TAU, 0.001f));
+    }
+  }
+  for (unsigned int i = 0; i < frame.num; ++i) {
+    REQUIRE(static_cast<uint8_t>(state.pt_[i]) == frame.t[i]);
+  }
+  REQUIRE_FALSE(Trajectory::read(TESTTRAJECTORY, 25, frame));
+  remove(TESTTRAJECTORY);
+}
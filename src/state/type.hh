@@ -0,0 +1,54 @@
+//===-- state/type.hh - Type enum definition -------------------*- C++ -*-===//
+///
+/// \file
+/// Definition of the Type enum and its names, on their own for programs that
+/// only read types (eg. from live frames, see Tap).
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+#define TYPE_COUNT 11 // number of Type values, including Type::None
+
+
+// Type: Type of particle, by its vicinity/neighborhood/local density.
+//       While a type gets assigned per particle, this enum can also be used to
+//       refer to particle groups/structures/clusters.
+//       Should be continuous for TypeNames[], and fit in a byte.
+
+enum class Type : uint8_t
+{
+  None = 0,
+  PrematureSpore, // coloring and injecting
+  MatureSpore,    // coloring and injecting
+  Ring,           // injecting
+  PrematureCell,  // injecting
+  TriangleCell,   // injecting
+  SquareCell,     // injecting
+  PentagonCell,   // injecting
+  Nutrient,       // coloring
+  CellHull,       // coloring
+  CellCore        // coloring
+};
+
+static const std::string TypeNames[] = {
+  "(none)",
+  "premature spore",
+  "mature spore",
+  "ring",
+  "premature cell",
+  "triangle cell",
+  "square cell",
+  "pentagon cell",
+  "nutrient",
+  "cell hull",
+  "cell core"
+};
+
+static_assert(static_cast<int>(Type::CellCore) + 1 == TYPE_COUNT &&
+              sizeof(TypeNames) / sizeof(TypeNames[0]) == TYPE_COUNT,
+              "TYPE_COUNT counts every Type, and each has a name");
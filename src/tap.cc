@@ -0,0 +1,106 @@
+//===-- tap.cc - live frame consumer entry point ---------------*- C++ -*-===//
+
+#include "state/tap.hh"
+#include "state/type.hh"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h> // getopt, optarg, optind
+
+
+#define TAP_EVERY 100 // milliseconds between looks at the ring
+
+
+/// help(): Print usage help.
+static void
+help()
+{
+  std::cout << "Usage: tapemergence -(?h|i NUM|n NUM) NAME\n"
+            << "\nFollow the live frames that a run shares with -l, and\n"
+            << "print a summary of each frame read.\n\n"
+            << "Options:\n"
+            << "  -?|-h  show this help\n"
+            << "  -i NUM milliseconds between looks at the ring ("
+            << TAP_EVERY << ")\n"
+            << "  -n NUM stop after NUM frames (0 for until the run ends)\n"
+            << std::endl;
+}
+
+
+/// summary(): Summarise a frame, read in place.
+/// \param view  frame
+/// \returns  one line
+static std::string
+summary(const Tap::View& view)
+{
+  double x = 0.0;
+  double y = 0.0;
+  unsigned int types[TYPE_COUNT] = {0};
+  uint32_t count = view.info.count;
+  for (uint32_t i = 0; i < count; ++i) {
+    x += view.x[i];
+    y += view.y[i];
+    if (view.t[i] < TYPE_COUNT) {
+      ++types[view.t[i]];
+    }
+  }
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1) << "frame " << view.info.frame
+       << "  tick " << view.info.tick << "  particles " << count << "/"
+       << view.info.num << "  centroid " << (0 < count ? x / count : 0.0)
+       << "," << (0 < count ? y / count : 0.0) << "  types";
+  for (int t = 0; t < TYPE_COUNT; ++t) {
+    text << " " << types[t];
+  }
+  return text.str();
+}
+
+
+/// main(): Program entry point.
+int
+main(int argc, char* argv[])
+{
+  unsigned int every = TAP_EVERY;
+  unsigned long most = 0;
+  int opt;
+  while (-1 != (opt = getopt(argc, argv, "?hi:n:"))) {
+    if      ('i' == opt) { every = std::stoul(optarg); }
+    else if ('n' == opt) { most = std::stoul(optarg); }
+    else { help(); return '?' == opt || 'h' == opt ? 0 : -1; }
+  }
+  if (optind + 1 != argc) {
+    help();
+    return -1;
+  }
+
+  Tap tap(argv[optind]);
+  if (!tap.good()) {
+    std::cerr << "Error: no live frames at '" << argv[optind] << "'."
+              << std::endl;
+    return -1;
+  }
+
+  Tap::View view;
+  uint64_t seen = 0;    // frames published when last read
+  unsigned long read = 0;
+  unsigned long torn = 0;
+  while (tap.alive() && (0 == most || read < most)) {
+    if (tap.frames() != seen && tap.latest(view)) {
+      std::string line = summary(view);
+      if (tap.intact(view)) {
+        seen = view.info.frame + 1;
+        ++read;
+        std::cout << line << std::endl;
+      } else {
+        ++torn; // overwritten while summarising
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(every));
+  }
+  std::cout << read << " frames read, " << torn << " dropped as overwritten"
+            << std::endl;
+  return 0;
+}
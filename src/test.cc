@@ -2,8 +2,24 @@
 #include <catch2/catch.hpp>
 
 #define QUIET 1
+#include "exp/convergence.test.hh"
+#include "exp/heatmap.test.hh"
+#include "exp/history.test.hh"
+#include "exp/metrics.test.hh"
+#include "exp/rdf.test.hh"
+#include "exp/shape.test.hh"
 #include "proc/control.test.hh"
 #include "proc/proc.test.hh"
+#include "proc/progress.test.hh"
+#include "proc/runner.test.hh"
+#include "proc/server.test.hh"
+#include "state/live.test.hh"
+#include "state/saver.test.hh"
 #include "state/state.test.hh"
+#include "state/trajectory.test.hh"
+#include "util/arena.test.hh"
+#include "util/philox.test.hh"
+#include "util/profiler.test.hh"
+#include "util/triple.test.hh"
 #include "util/util.test.hh"
 
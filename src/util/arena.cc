@@ -0,0 +1,117 @@
+#include "arena.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <sys/mman.h> // madvise
+
+
+Arena::Arena(bool huge /* = true */)
+  : huge_(huge), block_(nullptr), bytes_(0), capacity_(0)
+{}
+
+
+Arena::~Arena()
+{
+  free(this->block_);
+}
+
+
+void
+Arena::add(ColumnBase& column)
+{
+  this->columns_.push_back(&column);
+}
+
+
+void
+Arena::rebind(const ColumnBase& from, ColumnBase& to)
+{
+  std::replace(this->columns_.begin(), this->columns_.end(),
+               const_cast<ColumnBase*>(&from), &to);
+}
+
+
+void
+Arena::reserve(std::size_t particles)
+{
+  if (particles <= this->capacity_) {
+    return;
+  }
+
+  // capacity per column, padded to whole ARENA_ALIGN bytes
+  std::vector<std::size_t> capacities;
+  std::size_t bytes = 0;
+  std::size_t capacity;
+  for (ColumnBase* column : this->columns_) {
+    capacity = particles * column->stride_ * column->width_;
+    capacity = (capacity + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    bytes += capacity;
+    capacities.push_back(capacity / column->width_);
+  }
+
+  bool huge = this->huge_ && ARENA_HUGE_MIN <= bytes;
+  std::size_t align = ARENA_ALIGN;
+  if (huge) {
+    align = ARENA_HUGE_PAGE;
+    bytes = (bytes + align - 1) / align * align;
+  }
+  void* memory = nullptr;
+  if (0 != posix_memalign(&memory, align, bytes)) {
+    throw std::bad_alloc();
+  }
+  char* block = static_cast<char*>(memory);
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    madvise(block, bytes, MADV_HUGEPAGE); // only advice, so failure is fine
+  }
+#endif
+
+  char* data = block;
+  unsigned int c = 0;
+  for (ColumnBase* column : this->columns_) {
+    if (0 < column->size_) {
+      std::memcpy(data, column->data_, column->size_ * column->width_);
+    }
+    column->data_ = data;
+    column->capacity_ = capacities[c];
+    data += capacities[c] * column->width_;
+    ++c;
+  }
+  free(this->block_);
+  this->block_ = block;
+  this->bytes_ = bytes;
+  this->capacity_ = particles;
+}
+
+
+std::size_t
+Arena::used() const
+{
+  std::size_t bytes = 0;
+  for (ColumnBase* column : this->columns_) {
+    bytes += column->size_ * column->width_;
+  }
+  return bytes;
+}
+
+
+std::string
+Arena::describe() const
+{
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1);
+  for (ColumnBase* column : this->columns_) {
+    text << column->name_ << " "
+         << column->size_ * column->width_ / 1024.0 << "/"
+         << column->capacity_ * column->width_ / 1024.0 << " KiB, ";
+  }
+  text << "total " << this->bytes_ / 1048576.0 << " MiB for "
+       << this->capacity_ << " particles";
+  if (this->huge_ && ARENA_HUGE_MIN <= this->bytes_) {
+    text << " (huge pages advised)";
+  }
+  return text.str();
+}
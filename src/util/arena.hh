@@ -0,0 +1,226 @@
+//===-- util/arena.hh - Arena and Column class declarations ----*- C++ -*-===//
+///
+/// \file
+/// Declarations of the Arena class, which lays out a set of columns (the
+/// particle arrays of State) in one contiguous block of memory, and of the
+/// Column class template, a vector-like view of one such column.
+/// Every column starts 64-byte aligned and has its capacity padded to a
+/// multiple of 64 bytes, so that vectorised loops need neither peeling nor
+/// remainders. The block only gets laid out again when a column overflows.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+#define ARENA_ALIGN 64                // alignment and padding of columns
+#define ARENA_HUGE_PAGE (2ull << 20)  // size of a (transparent) huge page
+#define ARENA_HUGE_MIN  (8ull << 20)  // least block size to back by them
+
+
+class Arena;
+
+/// ColumnBase: Untyped part of a Column, which is what an Arena lays out.
+struct ColumnBase
+{
+  char*        data_;     // first element (ARENA_ALIGN aligned)
+  std::size_t  size_;     // number of elements in use
+  std::size_t  capacity_; // number of elements that fit
+  std::size_t  width_;    // bytes per element
+  unsigned int stride_;   // elements per particle
+  const char*  name_;     // column name (for reporting)
+  Arena*       arena_;    // arena the column lives in
+};
+
+
+class Arena
+{
+ public:
+  /// constructor: Prepare an arena without columns.
+  /// \param huge  whether to advise huge pages for large blocks
+  Arena(bool huge = true);
+
+  /// destructor: Release the block.
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// add(): Register a column (before the first reserve()).
+  /// \param column  column to lay out
+  void add(ColumnBase& column);
+
+  /// rebind(): Replace a registered column with a moved one.
+  /// \param from  registered column
+  /// \param to  column moved to
+  void rebind(const ColumnBase& from, ColumnBase& to);
+
+  /// reserve(): Lay out every column for a number of particles, if they do
+  ///            not fit yet, keeping the elements in use.
+  /// \param particles  number of particles
+  void reserve(std::size_t particles);
+
+  /// capacity(): Get the number of particles every column has room for.
+  /// \returns  number of particles
+  inline std::size_t
+  capacity() const
+  {
+    return this->capacity_;
+  }
+
+  /// bytes(): Get the size of the block.
+  /// \returns  number of bytes
+  inline std::size_t
+  bytes() const
+  {
+    return this->bytes_;
+  }
+
+  /// used(): Get the size of the elements in use, over all columns.
+  /// \returns  number of bytes
+  std::size_t used() const;
+
+  /// describe(): Describe the memory usage per column, eg. for logging.
+  /// \returns  "name size/capacity" per column and the block total
+  std::string describe() const;
+
+  bool huge_; // whether to advise huge pages for large blocks
+
+ private:
+  std::vector<ColumnBase*> columns_;  // registered columns
+  char*                    block_;    // contiguous memory of all columns
+  std::size_t              bytes_;    // size of the block
+  std::size_t              capacity_; // particles every column has room for
+};
+
+
+/// Column: Vector-like view of a column of trivially copyable values, laid
+///         out by an Arena. Growing past the capacity lays out the whole
+///         arena again, which, as with std::vector, invalidates pointers.
+template<typename T>
+class Column : public ColumnBase
+{
+ public:
+  /// constructor: Register an empty column with an arena.
+  /// \param arena  arena to live in
+  /// \param name  column name (for reporting)
+  /// \param stride  elements per particle
+  Column(Arena& arena, const char* name, unsigned int stride = 1)
+  {
+    this->data_ = nullptr;
+    this->size_ = 0;
+    this->capacity_ = 0;
+    this->width_ = sizeof(T);
+    this->stride_ = stride;
+    this->name_ = name;
+    this->arena_ = &arena;
+    arena.add(*this);
+  }
+
+  /// move constructor: Take over the registration of another column.
+  Column(Column&& other)
+    : ColumnBase(other)
+  {
+    this->arena_->rebind(other, *this);
+  }
+
+  Column(const Column&) = delete;
+  Column& operator=(const Column&) = delete;
+
+  inline std::size_t size() const { return this->size_; }
+  inline std::size_t capacity() const { return this->capacity_; }
+  inline bool empty() const { return 0 == this->size_; }
+
+  inline T* data() { return reinterpret_cast<T*>(this->data_); }
+  inline const T*
+  data() const
+  {
+    return reinterpret_cast<const T*>(this->data_);
+  }
+
+  inline T* begin() { return this->data(); }
+  inline T* end() { return this->data() + this->size_; }
+  inline const T* begin() const { return this->data(); }
+  inline const T* end() const { return this->data() + this->size_; }
+
+  inline T& operator[](std::size_t i) { return this->data()[i]; }
+  inline const T& operator[](std::size_t i) const { return this->data()[i]; }
+
+  /// reserve(): Make room for a number of elements (for the whole arena).
+  /// \param num  number of elements
+  inline void
+  reserve(std::size_t num)
+  {
+    if (num > this->capacity_) {
+      this->arena_->reserve((num + this->stride_ - 1) / this->stride_);
+    }
+  }
+
+  /// push_back(): Append an element, growing the arena geometrically.
+  /// \param value  element
+  inline void
+  push_back(const T& value)
+  {
+    this->fit(this->size_ + 1);
+    this->data()[this->size_] = value;
+    ++this->size_;
+  }
+
+  /// resize(): Change the number of elements, filling new ones.
+  /// \param num  number of elements
+  /// \param value  value of new elements
+  inline void
+  resize(std::size_t num, const T& value = T())
+  {
+    this->fit(num);
+    for (std::size_t i = this->size_; i < num; ++i) {
+      this->data()[i] = value;
+    }
+    this->size_ = num;
+  }
+
+  /// assign(): Replace all elements with copies of a value.
+  /// \param num  number of elements
+  /// \param value  value of every element
+  inline void
+  assign(std::size_t num, const T& value)
+  {
+    this->size_ = 0;
+    this->resize(num, value);
+  }
+
+  /// clear(): Remove all elements (keeping the capacity).
+  inline void clear() { this->size_ = 0; }
+
+ private:
+  /// fit(): Grow the arena geometrically if a number of elements overflows.
+  /// \param num  number of elements
+  inline void
+  fit(std::size_t num)
+  {
+    if (num > this->capacity_) {
+      std::size_t particles = (num + this->stride_ - 1) / this->stride_;
+      std::size_t doubled = 2 * this->arena_->capacity();
+      this->arena_->reserve(particles > doubled ? particles : doubled);
+    }
+  }
+};
+
+
+/// operator==(): Compare the elements of columns (or of a column and vector).
+template<typename T, typename U> inline bool
+operator==(const Column<T>& a, const U& b)
+{
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template<typename T> inline bool
+operator==(const std::vector<T>& a, const Column<T>& b)
+{
+  return b == a;
+}
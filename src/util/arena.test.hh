@@ -0,0 +1,42 @@
+#include "arena.hh"
+#include <cstdint>
+
+
+TEST_CASE("Arena::reserve")
+{
+  Arena arena(false);
+  auto a = Column<float>(arena, "a");
+  auto b = Column<uint8_t>(arena, "b");
+  auto c = Column<int>(arena, "c", 3);
+
+  arena.reserve(5);
+  REQUIRE(5 == arena.capacity());
+  REQUIRE(16 == a.capacity()); // padded to 64 bytes
+  REQUIRE(64 == b.capacity());
+  REQUIRE(16 == c.capacity());
+  REQUIRE(3 * 64 == arena.bytes());
+  for (ColumnBase* column : std::vector<ColumnBase*>{&a, &b, &c}) {
+    REQUIRE(0 == reinterpret_cast<uintptr_t>(column->data_) % ARENA_ALIGN);
+  }
+
+  for (int i = 0; i < 20; ++i) {
+    a.push_back(i * 0.5f);
+    b.push_back(i);
+    c.resize(3 * (i + 1), -i);
+  }
+  REQUIRE(20 <= arena.capacity());
+  REQUIRE(20 == a.size());
+  REQUIRE(60 == c.size());
+  REQUIRE(20 * sizeof(float) + 20 + 60 * sizeof(int) == arena.used());
+  for (int i = 0; i < 20; ++i) {
+    REQUIRE(i * 0.5f == a[i]);
+    REQUIRE(i == b[i]);
+    REQUIRE(-i == c[3 * i + 2]);
+  }
+
+  auto d = std::move(a); // still laid out by the arena
+  arena.reserve(1000);
+  REQUIRE(1000 <= d.capacity());
+  REQUIRE(9.5f == d[19]);
+  REQUIRE(0 == reinterpret_cast<uintptr_t>(d.data()) % ARENA_ALIGN);
+}
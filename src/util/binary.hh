@@ -0,0 +1,127 @@
+//===-- util/binary.hh - binary stream functions ---------------*- C++ -*-===//
+///
+/// \file
+/// Declarations of static functions for writing and reading values, strings,
+/// and vectors or columns of trivially copyable values to and from binary
+/// streams (in native endianness), as used by checkpoints.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include "arena.hh"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+#define BINARY_SIZE_MAX (4ull << 30) // sizes read beyond this are corrupt
+
+
+class Binary
+{
+ public:
+  /// put(): Write a value.
+  /// \param stream  destination stream
+  /// \param value  trivially copyable value
+  template<typename T> static inline void
+  put(std::ostream& stream, const T& value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  /// string version of put(), prefixed by its length.
+  static inline void
+  put(std::ostream& stream, const std::string& text)
+  {
+    Binary::put<uint64_t>(stream, text.size());
+    stream.write(text.data(), text.size());
+  }
+
+  /// vector version of put(), prefixed by its size.
+  template<typename T> static inline void
+  put(std::ostream& stream, const std::vector<T>& values)
+  {
+    Binary::put<uint64_t>(stream, values.size());
+    stream.write(reinterpret_cast<const char*>(values.data()),
+                 values.size() * sizeof(T));
+  }
+
+  /// vector version of put(), of its first num values, without a size prefix
+  /// (the reader knows num).
+  template<typename T> static inline void
+  put(std::ostream& stream, const std::vector<T>& values, std::size_t num)
+  {
+    stream.write(reinterpret_cast<const char*>(values.data()),
+                 num * sizeof(T));
+  }
+
+  /// column version of put(), prefixed by its size (as for vectors).
+  template<typename T> static inline void
+  put(std::ostream& stream, const Column<T>& values)
+  {
+    Binary::put<uint64_t>(stream, values.size());
+    stream.write(reinterpret_cast<const char*>(values.data()),
+                 values.size() * sizeof(T));
+  }
+
+  /// get(): Read a value.
+  /// \param stream  source stream
+  /// \param value  destination value
+  /// \returns  whether reading was successful
+  template<typename T> static inline bool
+  get(std::istream& stream, T& value)
+  {
+    return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+  }
+
+  /// string version of get().
+  static inline bool
+  get(std::istream& stream, std::string& text)
+  {
+    uint64_t size;
+    if (!Binary::get(stream, size) || BINARY_SIZE_MAX < size) {
+      return false;
+    }
+    text.resize(size);
+    return static_cast<bool>(stream.read(&text[0], size));
+  }
+
+  /// vector version of get().
+  template<typename T> static inline bool
+  get(std::istream& stream, std::vector<T>& values)
+  {
+    uint64_t size;
+    if (!Binary::get(stream, size) || BINARY_SIZE_MAX / sizeof(T) < size) {
+      return false;
+    }
+    values.resize(size);
+    return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+  }
+
+  /// vector version of get(), of num values, without a size prefix.
+  template<typename T> static inline bool
+  get(std::istream& stream, std::vector<T>& values, std::size_t num)
+  {
+    values.resize(num);
+    return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(values.data()), num * sizeof(T)));
+  }
+
+  /// column version of get().
+  template<typename T> static inline bool
+  get(std::istream& stream, Column<T>& values)
+  {
+    uint64_t size;
+    if (!Binary::get(stream, size) || BINARY_SIZE_MAX / sizeof(T) < size) {
+      return false;
+    }
+    values.resize(size);
+    return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+  }
+};
@@ -7,8 +7,26 @@
 
 #pragma once
 
+#include <cstdint>
+#include <limits>
+
 #define ME "Emergence" // first character capitalised for usage help
 #define VERSION "0.1"
 #define GLSL_VERSION "#version 330 core"
 #define TAU 6.2831853072f // 360 degreens in radians
 
+// element types of the particle counters and grid coordinates (see State),
+// halved by building with STATE_COMPACT, which runs on the CPU only (the
+// OpenCL kernels count with 32-bit atomics)
+#if 1 == STATE_COMPACT && 1 == CL_ENABLED
+#error "STATE_COMPACT needs CL_ENABLED=0."
+#endif
+#if 1 == STATE_COMPACT
+typedef uint16_t Count; // neighbor count (a few hundred at most)
+typedef int16_t  Coord; // grid column or row (32767 at most)
+#else
+typedef unsigned int Count;
+typedef int          Coord;
+#endif
+#define COUNT_MAX std::numeric_limits<Count>::max()
+#define COORD_MAX std::numeric_limits<Coord>::max()
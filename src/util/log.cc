@@ -1,29 +1,308 @@
 #include "log.hh"
+#include <chrono>
+#include <csignal>
+#include <cstdlib> // atexit
+#include <cstring> // strlen
+#include <unistd.h> // write
+
+
+static std::atomic<Log*> live[LOG_LIVE];   // logs to salvage on a crash
+static struct sigaction crashed[NSIG];     // handlers before ours
+static const int crashes[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+
+
+/// prefix(): Get the prefix of a type of message.
+/// \param attn  type of message
+/// \returns  prefix
+static const char*
+prefix(Attn attn)
+{
+  if      (attn == Attn::E)   { return "Error: "; }
+  else if (attn == Attn::Ecl) { return "Error(cl): "; }
+  else if (attn == Attn::Egl) { return "Error(gl): "; }
+  return "";
+}
+
+
+/// on_crash(): Salvage the pending messages of every live Log, and go on
+///             with the handler from before.
+/// \param signal  signal
+static void
+on_crash(int signal)
+{
+  for (std::atomic<Log*>& each : live) {
+    Log* log = each.load();
+    if (nullptr != log) {
+      log->salvage();
+    }
+  }
+  sigaction(signal, &crashed[signal], nullptr);
+  raise(signal);
+}
+
+
+/// on_exit(): Flush every live Log (for exits that skip its destructor).
+static void
+on_exit()
+{
+  for (std::atomic<Log*>& each : live) {
+    Log* log = each.load();
+    if (nullptr != log) {
+      log->flush();
+    }
+  }
+}
 
 
 Log::Log(unsigned int limit, bool quiet /* = false */)
-  : limit_(limit), quiet_(quiet)
-{}
+  : quiet_(quiet), limit_(limit)
+{
+  this->start();
+}
+
+
+Log::Log(Log&& other)
+  : quiet_(other.quiet_), limit_(other.limit_)
+{
+  other.stop();
+  this->history_ = std::move(other.history_);
+  this->observers_ = std::move(other.observers_);
+  this->start();
+}
+
+
+Log::~Log()
+{
+  this->stop();
+}
+
+
+void
+Log::start()
+{
+  static std::once_flag once;
+  std::call_once(once, [] {
+    struct sigaction action;
+    action.sa_handler = on_crash;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    for (int signal : crashes) {
+      sigaction(signal, &action, &crashed[signal]);
+    }
+    std::atexit(on_exit);
+  });
+
+  this->ring_.reset(new Slot[LOG_RING]);
+  for (uint64_t i = 0; i < LOG_RING; ++i) {
+    this->ring_[i].seq.store(i, std::memory_order_relaxed);
+  }
+  this->tail_ = 0;
+  this->head_ = 0;
+  this->asleep_ = false;
+  this->quit_ = false;
+  for (std::atomic<Log*>& each : live) {
+    Log* none = nullptr;
+    if (each.compare_exchange_strong(none, this)) {
+      break;
+    }
+  }
+  this->thread_ = std::thread(&Log::work, this);
+}
+
+
+void
+Log::stop()
+{
+  if (!this->thread_.joinable()) {
+    return;
+  }
+  this->quit_ = true;
+  this->wake_.notify_one();
+  this->thread_.join();
+  for (std::atomic<Log*>& each : live) {
+    Log* me = this;
+    each.compare_exchange_strong(me, nullptr);
+  }
+}
 
 
 void
 Log::add(Attn attn, const std::string& message, bool stdout)
 {
-  if (this->limit_ <= this->messages_.size()) {
-    this->messages_.pop_back();
+  uint64_t ticket = this->tail_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &this->ring_[ticket & (LOG_RING - 1)];
+    int64_t lag = static_cast<int64_t>(
+      slot->seq.load(std::memory_order_acquire) - ticket);
+    if (0 == lag) {
+      if (this->tail_.compare_exchange_weak(ticket, ticket + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (0 > lag) {
+      // full: the thread is behind by a whole ring
+      this->wake_.notify_one();
+      std::this_thread::yield();
+      ticket = this->tail_.load(std::memory_order_relaxed);
+    } else {
+      ticket = this->tail_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->attn = attn;
+  slot->out = stdout;
+  slot->text = message;
+  slot->seq.store(ticket + 1, std::memory_order_release);
+  if (this->asleep_.load(std::memory_order_relaxed)) {
+    this->wake_.notify_one();
+  }
+}
+
+
+void
+Log::flush()
+{
+  if (std::this_thread::get_id() == this->thread_.get_id() ||
+      !this->thread_.joinable()) {
+    return;
+  }
+  uint64_t target = this->tail_.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(this->drained_mutex_);
+  while (this->head_.load(std::memory_order_acquire) < target) {
+    this->wake_.notify_one();
+    this->drained_.wait_for(lock, std::chrono::milliseconds(LOG_IDLE));
+  }
+}
+
+
+std::deque<std::pair<Attn,std::string>>
+Log::messages() const
+{
+  std::lock_guard<std::mutex> lock(this->history_mutex_);
+  return this->history_;
+}
+
+
+std::pair<Attn,std::string>
+Log::latest() const
+{
+  std::lock_guard<std::mutex> lock(this->history_mutex_);
+  if (this->history_.empty()) {
+    return std::pair<Attn,std::string>(Attn::O, "");
+  }
+  return this->history_.front();
+}
+
+
+void
+Log::attach(Observer& observer)
+{
+  std::lock_guard<std::mutex> lock(this->observers_mutex_);
+  Subject::attach(observer);
+}
+
+
+void
+Log::detach(Observer& observer)
+{
+  std::lock_guard<std::mutex> lock(this->observers_mutex_);
+  Subject::detach(observer);
+}
+
+
+void
+Log::salvage() const
+{
+  if (this->quiet_) {
+    return;
   }
-  std::string m = message;
-  if      (attn == Attn::E)   { m = "Error: "     + m; }
-  else if (attn == Attn::Ecl) { m = "Error(cl): " + m; }
-  else if (attn == Attn::Egl) { m = "Error(gl): " + m; }
-  this->messages_.push_front(std::pair<Attn,std::string>(attn, m));
-  this->notify(Issue::NewMessage); // Headless reacts
-  std::ostream* stream = &std::cerr;
-  if (!this->quiet_ && stdout) {
-    if (attn == Attn::O) {
-      stream = &std::cout;
+  uint64_t tail = this->tail_.load();
+  for (uint64_t at = this->head_.load(); at < tail; ++at) {
+    const Slot& slot = this->ring_[at & (LOG_RING - 1)];
+    if (at + 1 != slot.seq.load() || !slot.out) {
+      continue;
     }
-    *stream << m << std::endl;
+    int fd = Attn::O == slot.attn ? STDOUT_FILENO : STDERR_FILENO;
+    const char* pre = prefix(slot.attn);
+    ssize_t ignored = write(fd, pre, strlen(pre));
+    ignored = write(fd, slot.text.data(), slot.text.size());
+    ignored = write(fd, "\n", 1);
+    (void) ignored;
   }
 }
 
+
+void
+Log::work()
+{
+  std::unique_lock<std::mutex> lock(this->wake_mutex_, std::defer_lock);
+  while (true) {
+    if (0 < this->drain()) {
+      continue;
+    }
+    if (this->quit_) {
+      if (0 == this->drain() &&
+          this->head_.load() == this->tail_.load()) {
+        break;
+      }
+      continue;
+    }
+    // (a wakeup lost to the race with add() costs at most LOG_IDLE)
+    lock.lock();
+    this->asleep_ = true;
+    this->wake_.wait_for(lock, std::chrono::milliseconds(LOG_IDLE));
+    this->asleep_ = false;
+    lock.unlock();
+  }
+}
+
+
+unsigned int
+Log::drain()
+{
+  uint64_t at = this->head_.load(std::memory_order_relaxed);
+  unsigned int count = 0;
+  bool printed = false;
+  std::string m;
+
+  while (true) {
+    Slot& slot = this->ring_[at & (LOG_RING - 1)];
+    if (at + 1 != slot.seq.load(std::memory_order_acquire)) {
+      break;
+    }
+    Attn attn = slot.attn;
+    bool out = slot.out;
+    m = prefix(attn) + slot.text;
+    slot.seq.store(at + LOG_RING, std::memory_order_release);
+    ++at;
+    ++count;
+
+    {
+      std::lock_guard<std::mutex> lock(this->history_mutex_);
+      if (this->limit_ <= this->history_.size()) {
+        this->history_.pop_back();
+      }
+      this->history_.push_front(std::pair<Attn,std::string>(attn, m));
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->observers_mutex_);
+      this->notify(Issue::NewMessage); // Headless reacts
+    }
+    if (!this->quiet_ && out) {
+      (attn == Attn::O ? std::cout : std::cerr) << m << '\n';
+      printed = true;
+    }
+  }
+  if (printed) {
+    std::cout.flush();
+    std::cerr.flush();
+  }
+  if (0 < count) {
+    {
+      std::lock_guard<std::mutex> lock(this->drained_mutex_);
+      this->head_.store(at, std::memory_order_release);
+    }
+    this->drained_.notify_all();
+  }
+  return count;
+}
@@ -3,15 +3,30 @@
 /// \file
 /// Definition of the Attn enum and declaration of the Log class, which
 /// provides a logging mechanism for the entire program.
+/// Any thread may add() messages without locking: they go into a bounded
+/// multi-producer ring, which a thread of the Log drains in order, keeping
+/// the history, printing, and notifying observers (on that thread). Pending
+/// messages are flushed on destruction, at exit, and on crashing signals.
 ///
 //===---------------------------------------------------------------------===//
 
 #pragma once
 
 #include "../util/observation.hh"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+
+
+#define LOG_RING 1024 // pending messages at most (a power of two)
+#define LOG_IDLE 10   // milliseconds between checks of an idle ring
+#define LOG_LIVE 8    // logs at most salvaged on a crash
 
 
 // Attn: Type of log message.
@@ -28,21 +43,85 @@ enum class Attn
 class Log : public Subject
 {
  public:
-  /// constructor: Set a limit to the number of messages retained.
+  /// constructor: Set a limit to the number of messages retained, and start
+  ///              the thread handling messages.
   /// \param limit  limit to the number of messages
   /// \param quiet  whether to suppress standard printing
   Log(unsigned int limit, bool quiet = false);
 
-  /// add(): Push a new message into the log.
+  /// move constructor: Take over the history (the other Log is stopped).
+  /// \param other  Log object
+  Log(Log&& other);
+
+  /// destructor: Handle the pending messages, and stop the thread.
+  ~Log() override;
+
+  /// add(): Queue a new message (lock-free, unless the ring is full, when it
+  ///        waits for room).
   /// \param attn  type of message
   /// \param message  message
   /// \param stdout  whether to print to stdout
   void add(Attn attn, const std::string& message, bool stdout = true);
 
-  std::deque<std::pair<Attn,std::string>> messages_; // queue of messages
+  /// flush(): Wait until the messages added so far have been handled.
+  ///          Does not wait when called by an observer (the Log's thread).
+  void flush();
+
+  /// messages(): Get the retained messages.
+  /// \returns  messages, latest first
+  std::deque<std::pair<Attn,std::string>> messages() const;
+
+  /// latest(): Get the latest handled message, eg. in react().
+  /// \returns  message (empty if none)
+  std::pair<Attn,std::string> latest() const;
+
+  /// attach(), detach(): Subject's, but safe while messages are handled.
+  void attach(Observer& observer);
+  void detach(Observer& observer);
+
+  /// salvage(): Print the pending messages from a signal handler, with
+  ///            write(2) only, leaving them in the ring.
+  void salvage() const;
+
   bool quiet_;         // whether to suppress standard printing
 
  private:
+  // Slot: Pending message. seq tells whose turn it is (Vyukov's bounded
+  //       queue): the producer of ticket t when t, the consumer when t + 1.
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;
+    Attn                  attn;
+    bool                  out;
+    std::string           text;
+  };
+
+  /// start(): Prepare the ring, register for salvage, and start the thread.
+  void start();
+
+  /// stop(): Handle the pending messages, and stop the thread.
+  void stop();
+
+  /// work(): Thread loop.
+  void work();
+
+  /// drain(): Handle the messages that are ready, in order.
+  /// \returns  number of messages handled
+  unsigned int drain();
+
   unsigned int limit_; // limit to the number of messages
-};
 
+  std::unique_ptr<Slot[]> ring_;
+  std::atomic<uint64_t>   tail_;    // tickets handed out to producers
+  std::atomic<uint64_t>   head_;    // messages handled
+  std::atomic<bool>       asleep_;  // whether the thread waits for messages
+  std::atomic<bool>       quit_;
+  std::thread             thread_;
+  std::mutex              wake_mutex_;
+  std::condition_variable wake_;    // messages are ready
+  std::mutex              drained_mutex_;
+  std::condition_variable drained_; // head_ has advanced
+  mutable std::mutex      history_mutex_;
+  std::deque<std::pair<Attn,std::string>> history_; // latest first
+  std::mutex              observers_mutex_;
+};
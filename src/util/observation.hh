@@ -17,6 +17,7 @@
 enum class Issue
 {
   StateChanged = 0,
+  StateRemapped, // particles were removed, State::remap_ tells where to
   ProcNextDone,
   ProcDone,
   NewMessage
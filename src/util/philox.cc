@@ -0,0 +1,126 @@
+#include "philox.hh"
+#include "util.hh"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+/// entropy(): Get a random seed, for runs not given one.
+/// \returns  seed
+static uint64_t
+entropy()
+{
+  std::random_device rd;
+  return static_cast<uint64_t>(rd()) << 32 | rd();
+}
+
+
+std::atomic<uint64_t> Philox::seed_(entropy());
+
+
+/// spread(): Run a job over a range of particles, in chunks on threads if
+///           the range is long enough to be worth it.
+/// \param n  number of particles
+/// \param job  job of a chunk, given its offset and length
+template<typename F> static void
+spread(uint32_t n, F job)
+{
+  unsigned int threads = std::min(std::thread::hardware_concurrency(),
+                                  n / PHILOX_PARALLEL);
+  if (threads < 2) {
+    job(0, n);
+    return;
+  }
+  std::vector<std::thread> workers;
+  uint32_t chunk = (n + threads - 1) / threads;
+  for (uint32_t from = 0; from < n; from += chunk) {
+    workers.emplace_back(job, from, std::min(chunk, n - from));
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+
+void
+Philox::uniforms(uint64_t seed, uint64_t tick, Stream stream,
+                 float a, float b, uint32_t first, uint32_t n, float* out)
+{
+  spread(n, [=](uint32_t from, uint32_t count) {
+    uint32_t w[4];
+    for (uint32_t i = from; i < from + count; ++i) {
+      Philox::words(seed, tick, first + i, stream, w);
+      out[i] = a + (b - a) * Philox::unit(w[0]);
+    }
+  });
+}
+
+
+void
+Philox::normals(uint64_t seed, uint64_t tick, Stream stream, float stddev,
+                uint32_t first, uint32_t n, float* out)
+{
+  spread(n, [=](uint32_t from, uint32_t count) {
+    uint32_t w[4];
+    for (uint32_t i = from; i < from + count; ++i) {
+      Philox::words(seed, tick, first + i, stream, w);
+      out[i] = stddev * Philox::gauss(w[0], w[1]);
+    }
+  });
+}
+
+
+void
+Philox::reseed(uint64_t seed)
+{
+  Philox::seed_ = seed;
+  uint32_t w[4];
+  for (unsigned int r = 0; r < UTIL_RNGS; ++r) {
+    Philox::words(seed, 0, r, Stream::Count, w);
+    std::seed_seq sequence(w, w + 4);
+    Util::rng(r).seed(sequence);
+  }
+}
+
+
+const std::string&
+Philox::cl_source()
+{
+  static const std::string code =
+    "void philox_words(\n"
+    "  uint K0, uint K1, uint T0, uint T1, uint particle, uint stream,\n"
+    "  uint* w\n"
+    ") {\n"
+    "  uint c0 = particle;\n"
+    "  uint c1 = stream;\n"
+    "  uint c2 = T0;\n"
+    "  uint c3 = T1;\n"
+    "  for (int round = 0; round < 10; ++round) {\n"
+    "    uint hi0 = mul_hi(0xD2511F53u, c0);\n"
+    "    uint lo0 = 0xD2511F53u * c0;\n"
+    "    uint hi1 = mul_hi(0xCD9E8D57u, c2);\n"
+    "    uint lo1 = 0xCD9E8D57u * c2;\n"
+    "    c0 = hi1 ^ c1 ^ K0;\n"
+    "    c2 = hi0 ^ c3 ^ K1;\n"
+    "    c1 = lo1;\n"
+    "    c3 = lo0;\n"
+    "    K0 += 0x9E3779B9u;\n"
+    "    K1 += 0xBB67AE85u;\n"
+    "  }\n"
+    "  w[0] = c0;\n"
+    "  w[1] = c1;\n"
+    "  w[2] = c2;\n"
+    "  w[3] = c3;\n"
+    "}\n"
+    "\n"
+    "float philox_unit(uint word) {\n"
+    "  return (word >> 8) * (1.0f / 16777216.0f);\n"
+    "}\n"
+    "\n"
+    "float philox_gauss(uint a, uint b) {\n"
+    "  float u = ((a >> 8) + 1) * (1.0f / 16777216.0f);\n"
+    "  return sqrt(-2.0f * log(u)) * cos(6.28318530718f * philox_unit(b));\n"
+    "}\n"
+    "\n";
+  return code;
+}
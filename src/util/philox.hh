@@ -0,0 +1,183 @@
+//===-- util/philox.hh - Philox class declaration --------------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Philox class, a counter-based random number generator
+/// (Philox4x32-10, after Salmon et al., "Parallel Random Numbers: As Easy as
+/// 1, 2, 3"). A number is a pure function of (seed, tick, particle, stream),
+/// so particles may draw theirs in any order, on any thread, or in an OpenCL
+/// kernel (see cl_source()), and always get the same ones. There is no state
+/// besides the seed, which also seeds the engines of Util::rng().
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <math.h> // cosf, logf, sqrtf
+#include <string>
+
+
+#define PHILOX_PARALLEL 65536 // fewest numbers worth spreading over threads
+
+
+// Stream: What a number is drawn for, so that draws of a particle in a tick
+//         are independent of each other.
+
+enum class Stream : uint32_t
+{
+  SpawnX = 0, // State::spawn()
+  SpawnY,
+  SpawnF,
+  Noise,      // Proc::plain_move() and Cl::move(), per particle
+  Count
+};
+
+
+class Philox
+{
+ public:
+  /// block(): Encrypt a counter with a key, ten rounds of Philox4x32.
+  /// \param counter  counter, replaced by four random words
+  /// \param key  key (the seed)
+  static inline void
+  block(uint32_t counter[4], const uint32_t key[2])
+  {
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    uint64_t p0;
+    uint64_t p1;
+    for (int round = 0; round < 10; ++round) {
+      p0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+      p1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+      counter[0] = static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k0;
+      counter[2] = static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k1;
+      counter[1] = static_cast<uint32_t>(p1);
+      counter[3] = static_cast<uint32_t>(p0);
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+  }
+
+  /// words(): Get the four random words of a particle in a tick.
+  /// \param seed  seed
+  /// \param tick  tick
+  /// \param particle  particle index
+  /// \param stream  what the words are for
+  /// \param words  destination of four words
+  static inline void
+  words(uint64_t seed, uint64_t tick, uint32_t particle, Stream stream,
+        uint32_t words[4])
+  {
+    const uint32_t key[2] = {static_cast<uint32_t>(seed),
+                             static_cast<uint32_t>(seed >> 32)};
+    words[0] = particle;
+    words[1] = static_cast<uint32_t>(stream);
+    words[2] = static_cast<uint32_t>(tick);
+    words[3] = static_cast<uint32_t>(tick >> 32);
+    Philox::block(words, key);
+  }
+
+  /// unit(): Map a random word onto [0, 1).
+  /// \param word  random word
+  /// \returns  uniformly distributed float (24 bits of the word)
+  static inline float
+  unit(uint32_t word)
+  {
+    return (word >> 8) * (1.0f / 16777216.0f);
+  }
+
+  /// gauss(): Map two random words onto a standard normal (Box-Muller).
+  /// \param a  random word
+  /// \param b  random word
+  /// \returns  normally distributed float
+  static inline float
+  gauss(uint32_t a, uint32_t b)
+  {
+    float u = ((a >> 8) + 1) * (1.0f / 16777216.0f); // (0, 1], for logf
+    return sqrtf(-2.0f * logf(u)) * cosf(6.28318530718f * Philox::unit(b));
+  }
+
+  /// uniform(): Draw from a uniformly distributed range.
+  /// \param seed  seed
+  /// \param tick  tick
+  /// \param particle  particle index
+  /// \param stream  what the number is for
+  /// \param a  start of range
+  /// \param b  end of range
+  /// \returns  uniformly distributed float in [a, b)
+  static inline float
+  uniform(uint64_t seed, uint64_t tick, uint32_t particle, Stream stream,
+          float a, float b)
+  {
+    uint32_t w[4];
+    Philox::words(seed, tick, particle, stream, w);
+    return a + (b - a) * Philox::unit(w[0]);
+  }
+
+  /// normal(): Draw from a normal distribution of mean 0.
+  /// \param seed  seed
+  /// \param tick  tick
+  /// \param particle  particle index
+  /// \param stream  what the number is for
+  /// \param stddev  standard deviation
+  /// \returns  normally distributed float
+  static inline float
+  normal(uint64_t seed, uint64_t tick, uint32_t particle, Stream stream,
+         float stddev)
+  {
+    uint32_t w[4];
+    Philox::words(seed, tick, particle, stream, w);
+    return stddev * Philox::gauss(w[0], w[1]);
+  }
+
+  /// uniforms(): Draw uniform() for a range of particles at once, spread
+  ///             over threads if there are many.
+  /// \param seed  seed
+  /// \param tick  tick
+  /// \param stream  what the numbers are for
+  /// \param a  start of range
+  /// \param b  end of range
+  /// \param first  index of the first particle
+  /// \param n  number of particles
+  /// \param out  destination of n numbers
+  static void uniforms(uint64_t seed, uint64_t tick, Stream stream,
+                       float a, float b, uint32_t first, uint32_t n,
+                       float* out);
+
+  /// normals(): Draw normal() for a range of particles at once, spread over
+  ///            threads if there are many.
+  /// \param seed  seed
+  /// \param tick  tick
+  /// \param stream  what the numbers are for
+  /// \param stddev  standard deviation
+  /// \param first  index of the first particle
+  /// \param n  number of particles
+  /// \param out  destination of n numbers
+  static void normals(uint64_t seed, uint64_t tick, Stream stream,
+                      float stddev, uint32_t first, uint32_t n, float* out);
+
+  /// seed(): Get the seed of the run.
+  /// \returns  seed (random unless reseed())
+  static inline uint64_t
+  seed()
+  {
+    return Philox::seed_.load(std::memory_order_relaxed);
+  }
+
+  /// reseed(): Set the seed of the run, and seed the engines of Util::rng()
+  ///           from it too, so that a run is reproducible.
+  /// \param seed  seed
+  static void reseed(uint64_t seed);
+
+  /// cl_source(): Get OpenCL C functions equivalent to words(), unit() and
+  ///              gauss(), for inclusion in kernels: philox_words(K0, K1,
+  ///              T0, T1, particle, stream, uint w[4]), philox_unit(word)
+  ///              and philox_gauss(a, b), with the seed and tick split into
+  ///              low and high words.
+  /// \returns  OpenCL C source
+  static const std::string& cl_source();
+
+ private:
+  static std::atomic<uint64_t> seed_;
+};
@@ -0,0 +1,109 @@
+#include "philox.hh"
+#include "util.hh"
+#include "../state/state.hh"
+#include <vector>
+
+
+TEST_CASE("Philox::block")
+{
+  // known answers of Philox4x32-10 (Random123)
+  uint32_t zeros[4] = {0, 0, 0, 0};
+  const uint32_t zero_key[2] = {0, 0};
+  Philox::block(zeros, zero_key);
+  REQUIRE(0x6627e8d5u == zeros[0]);
+  REQUIRE(0xe169c58du == zeros[1]);
+  REQUIRE(0xbc57ac4cu == zeros[2]);
+  REQUIRE(0x9b00dbd8u == zeros[3]);
+
+  uint32_t ones[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+  const uint32_t ones_key[2] = {0xffffffffu, 0xffffffffu};
+  Philox::block(ones, ones_key);
+  REQUIRE(0x408f276du == ones[0]);
+  REQUIRE(0x41c83b0eu == ones[1]);
+  REQUIRE(0xa20bc7c6u == ones[2]);
+  REQUIRE(0x6d5451fdu == ones[3]);
+
+  uint32_t pi[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+  const uint32_t pi_key[2] = {0xa4093822u, 0x299f31d0u};
+  Philox::block(pi, pi_key);
+  REQUIRE(0xd16cfe09u == pi[0]);
+  REQUIRE(0x94fdccebu == pi[1]);
+  REQUIRE(0x5001e420u == pi[2]);
+  REQUIRE(0x24126ea1u == pi[3]);
+}
+
+TEST_CASE("Philox::uniforms")
+{
+  // batches, threaded or not, draw what single draws do
+  uint32_t n = 3 * PHILOX_PARALLEL + 7;
+  std::vector<float> batch(n);
+  Philox::uniforms(42, 7, Stream::SpawnX, -1.0f, 3.0f, 5, n, batch.data());
+  for (uint32_t i = 0; i < n; i += 997) {
+    REQUIRE(Philox::uniform(42, 7, 5 + i, Stream::SpawnX, -1.0f, 3.0f) ==
+            batch[i]);
+  }
+  double sum = 0.0;
+  bool inside = true;
+  for (float u : batch) {
+    inside = inside && -1.0f <= u && u < 3.0f;
+    sum += u;
+  }
+  REQUIRE(inside);
+  REQUIRE(Approx(1.0).epsilon(0.01) == sum / n);
+
+  // draws differ by every part of the counter and the key
+  float u = Philox::uniform(42, 7, 5, Stream::SpawnX, 0.0f, 1.0f);
+  REQUIRE(u != Philox::uniform(43, 7, 5, Stream::SpawnX, 0.0f, 1.0f));
+  REQUIRE(u != Philox::uniform(42, 8, 5, Stream::SpawnX, 0.0f, 1.0f));
+  REQUIRE(u != Philox::uniform(42, 7, 6, Stream::SpawnX, 0.0f, 1.0f));
+  REQUIRE(u != Philox::uniform(42, 7, 5, Stream::SpawnY, 0.0f, 1.0f));
+  REQUIRE(u != Philox::uniform(42, 7 + (1ull << 32), 5, Stream::SpawnX,
+                               0.0f, 1.0f));
+}
+
+TEST_CASE("Philox::normals")
+{
+  uint32_t n = 200000;
+  std::vector<float> batch(n);
+  Philox::normals(1, 0, Stream::Noise, 2.0f, 0, n, batch.data());
+  REQUIRE(Philox::normal(1, 0, 123, Stream::Noise, 2.0f) == batch[123]);
+  double sum = 0.0;
+  double squares = 0.0;
+  bool finite = true;
+  for (float z : batch) {
+    finite = finite && std::isfinite(z);
+    sum += z;
+    squares += z * z;
+  }
+  REQUIRE(finite);
+  double mean = sum / n;
+  REQUIRE(Approx(0.0).margin(0.02) == mean);
+  REQUIRE(Approx(2.0).epsilon(0.01) == std::sqrt(squares / n - mean * mean));
+}
+
+TEST_CASE("Philox::reseed")
+{
+  uint64_t before = Philox::seed();
+  auto log = Log(1, QUIET);
+  auto expctrl = ExpControl(log, 0);
+
+  // a seed reproduces spawns, and the engines of Util::rng()
+  Philox::reseed(2021);
+  REQUIRE(2021 == Philox::seed());
+  float a = Util::distr(0.0f, 1.0f);
+  auto state = State(log, expctrl);
+  Philox::reseed(2021);
+  REQUIRE(a == Util::distr(0.0f, 1.0f));
+  auto again = State(log, expctrl);
+  for (int i = 0; i < state.num_; ++i) {
+    REQUIRE(state.px_[i] == again.px_[i]);
+    REQUIRE(state.py_[i] == again.py_[i]);
+    REQUIRE(state.pf_[i] == again.pf_[i]);
+  }
+
+  // but respawns differ
+  again.respawn();
+  REQUIRE(state.px_[0] != again.px_[0]);
+
+  Philox::reseed(before);
+}
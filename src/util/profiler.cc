@@ -0,0 +1,215 @@
+#include "profiler.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+
+std::atomic<bool> Profiler::enabled_(false);
+
+
+// Ring: Samples of one thread, each phase << 56 | nanoseconds. Only the
+//       owning thread writes; collect() reads behind it.
+struct Ring
+{
+  std::atomic<uint64_t> slots[PROFILER_RING];
+  std::atomic<uint64_t> head; // samples ever written
+  uint64_t              tail; // samples ever read (collect() only)
+};
+
+// Window: Latest samples of one phase.
+struct Window
+{
+  std::vector<float> samples; // microseconds, circular
+  unsigned int       next;    // where the next sample goes
+  unsigned long      count;   // samples ever collected
+};
+
+static std::mutex rings_mutex;                    // guards rings
+static std::vector<std::unique_ptr<Ring>> rings;  // one per sampling thread
+static std::mutex windows_mutex;                  // guards windows
+static Window windows[static_cast<int>(Phase::Count)];
+static thread_local Ring* ring = nullptr;         // of this thread
+static const uint64_t nanos = (static_cast<uint64_t>(1) << 56) - 1; // mask
+
+
+/// percentile(): Get a percentile of some samples.
+/// \param sorted  samples in ascending order
+/// \param p  percentile in [0, 1]
+/// \returns  nearest-rank percentile
+static float
+percentile(const std::vector<float>& sorted, float p)
+{
+  std::size_t rank = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5f);
+  return sorted[rank];
+}
+
+
+void
+Profiler::enable(bool yesno)
+{
+  Profiler::enabled_ = yesno;
+}
+
+
+void
+Profiler::add(Phase phase, uint64_t nanoseconds)
+{
+  if (nullptr == ring) {
+    std::unique_ptr<Ring> mine(new Ring());
+    for (std::atomic<uint64_t>& slot : mine->slots) {
+      slot.store(0, std::memory_order_relaxed);
+    }
+    mine->head = 0;
+    mine->tail = 0;
+    ring = mine.get();
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    rings.push_back(std::move(mine));
+  }
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  nanoseconds = std::min(nanoseconds, nanos);
+  ring->slots[head % PROFILER_RING].store(
+    static_cast<uint64_t>(phase) << 56 | nanoseconds,
+    std::memory_order_relaxed);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+
+unsigned long
+Profiler::collect()
+{
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  std::lock_guard<std::mutex> lock_windows(windows_mutex);
+  unsigned long lost = 0;
+  uint64_t sample;
+  uint64_t head;
+  int phase;
+
+  for (std::unique_ptr<Ring>& each : rings) {
+    head = each->head.load(std::memory_order_acquire);
+    if (PROFILER_RING < head - each->tail) {
+      lost += head - each->tail - PROFILER_RING;
+      each->tail = head - PROFILER_RING;
+    }
+    for (; each->tail < head; ++each->tail) {
+      sample = each->slots[each->tail % PROFILER_RING].load(
+        std::memory_order_relaxed);
+      phase = static_cast<int>(sample >> 56);
+      if (static_cast<int>(Phase::Count) <= phase) {
+        continue;
+      }
+      Window& window = windows[phase];
+      float micro = (sample & nanos) / 1000.0f;
+      if (window.samples.size() < PROFILER_WINDOW) {
+        window.samples.push_back(micro);
+      } else {
+        window.samples[window.next] = micro;
+      }
+      window.next = (window.next + 1) % PROFILER_WINDOW;
+      ++window.count;
+    }
+  }
+  return lost;
+}
+
+
+std::vector<Profiler::Stat>
+Profiler::stats()
+{
+  Profiler::collect();
+  std::lock_guard<std::mutex> lock(windows_mutex);
+  std::vector<Stat> stats;
+  std::vector<float> sorted;
+  for (int p = 0; p < static_cast<int>(Phase::Count); ++p) {
+    Window& window = windows[p];
+    if (window.samples.empty()) {
+      continue;
+    }
+    sorted = window.samples;
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    for (float sample : sorted) {
+      sum += sample;
+    }
+    stats.push_back({static_cast<Phase>(p), window.count,
+                     static_cast<unsigned int>(sorted.size()),
+                     sum / sorted.size(), percentile(sorted, 0.5f),
+                     percentile(sorted, 0.9f), percentile(sorted, 0.99f),
+                     sorted.back()});
+  }
+  return stats;
+}
+
+
+void
+Profiler::reset()
+{
+  Profiler::collect();
+  std::lock_guard<std::mutex> lock(windows_mutex);
+  for (Window& window : windows) {
+    window.samples.clear();
+    window.next = 0;
+    window.count = 0;
+  }
+}
+
+
+const char*
+Profiler::name(Phase phase)
+{
+  static const char* names[] = {
+    "tick", "clear", "plot", "seek", "move", "type", "exp", "color",
+    "pack", "upload", "draw", "gui", "frame",
+    "seek_device", "move_device", "draw_device"
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) ==
+                static_cast<std::size_t>(Phase::Count),
+                "a name per phase");
+  return names[static_cast<int>(phase)];
+}
+
+
+std::string
+Profiler::describe()
+{
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1)
+       << std::left << std::setw(12) << "phase" << std::right
+       << std::setw(10) << "count" << std::setw(10) << "mean"
+       << std::setw(10) << "p50" << std::setw(10) << "p90"
+       << std::setw(10) << "p99" << std::setw(10) << "max" << "  (us)";
+  for (const Stat& stat : Profiler::stats()) {
+    text << "\n" << std::left << std::setw(12) << Profiler::name(stat.phase)
+         << std::right << std::setw(10) << stat.count
+         << std::setw(10) << stat.mean << std::setw(10) << stat.p50
+         << std::setw(10) << stat.p90 << std::setw(10) << stat.p99
+         << std::setw(10) << stat.max;
+  }
+  return text.str();
+}
+
+
+bool
+Profiler::dump(const std::string& path)
+{
+  std::ofstream stream(path);
+  if (!stream) {
+    return false;
+  }
+  stream << "{\"unit\":\"us\",\"window\":" << PROFILER_WINDOW
+         << ",\"phases\":[";
+  bool first = true;
+  for (const Stat& stat : Profiler::stats()) {
+    stream << (first ? "" : ",") << "\n{\"phase\":\""
+           << Profiler::name(stat.phase) << "\",\"count\":" << stat.count
+           << ",\"window\":" << stat.window << ",\"mean\":" << stat.mean
+           << ",\"p50\":" << stat.p50 << ",\"p90\":" << stat.p90
+           << ",\"p99\":" << stat.p99 << ",\"max\":" << stat.max << "}";
+    first = false;
+  }
+  stream << "\n]}\n";
+  stream.close();
+  return static_cast<bool>(stream);
+}
@@ -0,0 +1,154 @@
+//===-- util/profiler.hh - Profiler class declaration ----------*- C++ -*-===//
+///
+/// \file
+/// Declaration of the Profiler class, which times the phases of ticking and
+/// drawing. Scoped timers (PROFILE()) append samples to a ring buffer of the
+/// calling thread without locking; collect() drains the rings into rolling
+/// windows per phase, from which percentiles are taken. Device time (OpenCL
+/// events, OpenGL timer queries) is added as phases of its own.
+/// When disabled, a timer costs one relaxed atomic load.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+#define PROFILER_RING 4096  // samples per thread ring (a power of two)
+#define PROFILER_WINDOW 512 // latest samples per phase for percentiles
+
+
+// Phase: What is being timed.
+
+enum class Phase : uint8_t
+{
+  Tick = 0,   // Control::tick(), all of it
+  Clear,      // Proc::clear()
+  Plot,       // Proc::plot()
+  Seek,       // Proc::plain_seek() or Proc::seek() (host)
+  Move,       // Proc::plain_move() or Proc::move() (host)
+  Type,       // Exp::type()
+  Exp,        // ExpControl::next()
+  Color,      // Exp::color()
+  Pack,       // packing of Canvas vertex data
+  Upload,     // upload of Canvas vertex buffers
+  Draw,       // Canvas::draw() (host)
+  Gui,        // Gui::draw()
+  Frame,      // Canvas::exec() or Canvas::present(), all of it
+  SeekDevice, // seek kernel (OpenCL event)
+  MoveDevice, // move kernel (OpenCL event)
+  DrawDevice, // draw call (OpenGL timer query)
+  Count
+};
+
+
+class Profiler
+{
+ public:
+  // Stat: Summary of the latest samples of a phase, in microseconds.
+  struct Stat
+  {
+    Phase         phase;
+    unsigned long count;   // samples ever collected
+    unsigned int  window;  // samples summarised
+    float         mean;
+    float         p50;
+    float         p90;
+    float         p99;
+    float         max;
+  };
+
+  // Scope: Timer of the enclosing scope.
+  class Scope
+  {
+   public:
+    inline explicit
+    Scope(Phase phase)
+      : phase_(phase), on_(Profiler::enabled())
+    {
+      if (this->on_) {
+        this->start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    inline
+    ~Scope()
+    {
+      this->stop();
+    }
+
+    /// stop(): End timing before the end of the scope.
+    inline void
+    stop()
+    {
+      if (this->on_) {
+        Profiler::add(this->phase_,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - this->start_
+                      ).count());
+        this->on_ = false;
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Phase phase_;
+    bool  on_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /// enable(): Turn profiling on or off.
+  /// \param yesno  whether to take samples
+  static void enable(bool yesno);
+
+  /// enabled(): Whether profiling is on.
+  /// \returns  true if samples are being taken
+  static inline bool
+  enabled()
+  {
+    return Profiler::enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// add(): Append a sample to the ring of the calling thread (lock-free).
+  /// \param phase  timed phase
+  /// \param nanoseconds  duration
+  static void add(Phase phase, uint64_t nanoseconds);
+
+  /// collect(): Drain the rings of all threads into the windows.
+  /// \returns  number of samples lost to full rings since last collect()
+  static unsigned long collect();
+
+  /// stats(): Collect, and summarise the phases that have samples.
+  /// \returns  summary per phase
+  static std::vector<Stat> stats();
+
+  /// reset(): Forget all samples.
+  static void reset();
+
+  /// name(): Get the name of a phase.
+  /// \param phase  phase
+  /// \returns  lowercase name
+  static const char* name(Phase phase);
+
+  /// describe(): Tabulate stats() for humans.
+  /// \returns  one line per phase
+  static std::string describe();
+
+  /// dump(): Write stats() as a JSON document.
+  /// \param path  path to the destination file
+  /// \returns  whether the write was successful
+  static bool dump(const std::string& path);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+
+#define PROFILE(phase) Profiler::Scope profile_scope_(Phase::phase)
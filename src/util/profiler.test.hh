@@ -0,0 +1,92 @@
+#include "profiler.hh"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <thread>
+
+
+#define TESTPROFILE "testemergence.profile.json"
+
+
+/// find_stat(): Find the summary of a phase.
+/// \param stats  summaries as given by Profiler::stats()
+/// \param phase  phase
+/// \returns  summary, or one with a count of 0
+static Profiler::Stat
+find_stat(const std::vector<Profiler::Stat>& stats, Phase phase)
+{
+  for (const Profiler::Stat& each : stats) {
+    if (phase == each.phase) {
+      return each;
+    }
+  }
+  return {phase, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+
+TEST_CASE("Profiler::stats")
+{
+  Profiler::reset();
+
+  // nothing is sampled while disabled
+  Profiler::enable(false);
+  {
+    PROFILE(Seek);
+  }
+  REQUIRE(Profiler::stats().empty());
+
+  // samples 1..100 us give known percentiles
+  Profiler::enable(true);
+  for (uint64_t i = 1; i <= 100; ++i) {
+    Profiler::add(Phase::Move, i * 1000);
+  }
+  Profiler::Stat move = find_stat(Profiler::stats(), Phase::Move);
+  REQUIRE(100 == move.count);
+  REQUIRE(100 == move.window);
+  REQUIRE(Approx(50.5f) == move.mean);
+  REQUIRE(Approx(51.0f) == move.p50);
+  REQUIRE(Approx(90.0f) == move.p90);
+  REQUIRE(Approx(99.0f) == move.p99);
+  REQUIRE(Approx(100.0f) == move.max);
+
+  // the window keeps the latest samples only
+  for (int i = 0; i < PROFILER_WINDOW; ++i) {
+    Profiler::add(Phase::Move, 1000000);
+  }
+  move = find_stat(Profiler::stats(), Phase::Move);
+  REQUIRE(100 + PROFILER_WINDOW == move.count);
+  REQUIRE(PROFILER_WINDOW == move.window);
+  REQUIRE(Approx(1000.0f) == move.p50);
+
+  // scopes sample on every thread
+  std::thread other([] {
+    for (int i = 0; i < 10; ++i) {
+      PROFILE(Seek);
+    }
+  });
+  for (int i = 0; i < 5; ++i) {
+    PROFILE(Seek);
+  }
+  other.join();
+  REQUIRE(15 == find_stat(Profiler::stats(), Phase::Seek).count);
+
+  // a stopped scope samples only once
+  {
+    Profiler::Scope scope(Phase::Plot);
+    scope.stop();
+  }
+  REQUIRE(1 == find_stat(Profiler::stats(), Phase::Plot).count);
+
+  // reports
+  REQUIRE(std::string::npos != Profiler::describe().find("seek"));
+  REQUIRE(Profiler::dump(TESTPROFILE));
+  std::ifstream stream(TESTPROFILE);
+  std::stringstream json;
+  json << stream.rdbuf();
+  REQUIRE(std::string::npos != json.str().find("\"phase\":\"move\""));
+  remove(TESTPROFILE);
+
+  Profiler::enable(false);
+  Profiler::reset();
+  REQUIRE(Profiler::stats().empty());
+}
@@ -0,0 +1,80 @@
+//===-- util/triple.hh - TripleBuffer class template -----------*- C++ -*-===//
+///
+/// \file
+/// Definition of the TripleBuffer class template, which hands the latest of
+/// a stream of values from one writer thread to one reader thread without
+/// locks. The writer fills the back slot and publishes it by swapping it
+/// with the middle slot; the reader takes the middle slot, if it is fresh,
+/// by swapping it with the front slot. Neither side ever waits, and the
+/// reader only ever sees whole values.
+///
+//===---------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+
+
+#define TRIPLE_FRESH 4u // flag on the middle index: published, not yet taken
+
+
+template<typename T>
+class TripleBuffer
+{
+ public:
+  /// constructor: Start with slot 0 at the back, 1 in the middle, and 2 in
+  ///              front, none of them fresh.
+  TripleBuffer()
+    : middle_(1), back_(0), front_(2)
+  {}
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /// back(): Slot for the writer to fill in.
+  /// \returns  back slot (writer only)
+  inline T&
+  back()
+  {
+    return this->slots_[this->back_];
+  }
+
+  /// publish(): Make the back slot the latest value, and get a new back slot
+  ///            (which holds some older value, to be overwritten).
+  inline void
+  publish()
+  {
+    unsigned int old = this->middle_.exchange(this->back_ | TRIPLE_FRESH,
+                                              std::memory_order_acq_rel);
+    this->back_ = old & ~TRIPLE_FRESH;
+  }
+
+  /// update(): Take the latest value into the front slot, if there is one
+  ///           that has not been taken yet.
+  /// \returns  whether front() changed (reader only)
+  inline bool
+  update()
+  {
+    if (!(this->middle_.load(std::memory_order_acquire) & TRIPLE_FRESH)) {
+      return false;
+    }
+    unsigned int old = this->middle_.exchange(this->front_,
+                                              std::memory_order_acq_rel);
+    this->front_ = old & ~TRIPLE_FRESH;
+    return true;
+  }
+
+  /// front(): Latest value taken by update().
+  /// \returns  front slot (reader only)
+  inline const T&
+  front() const
+  {
+    return this->slots_[this->front_];
+  }
+
+ private:
+  T                         slots_[3];
+  std::atomic<unsigned int> middle_; // index of middle slot | TRIPLE_FRESH
+  unsigned int              back_;   // index of back slot (writer's)
+  unsigned int              front_;  // index of front slot (reader's)
+};
@@ -0,0 +1,51 @@
+#include "triple.hh"
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("TripleBuffer::update")
+{
+  TripleBuffer<int> triple;
+  REQUIRE(!triple.update());
+
+  triple.back() = 1;
+  triple.publish();
+  triple.back() = 2;
+  triple.publish(); // replaces 1, which was never taken
+  REQUIRE(triple.update());
+  REQUIRE(2 == triple.front());
+  REQUIRE(!triple.update());
+  REQUIRE(2 == triple.front());
+
+  triple.back() = 3;
+  triple.publish();
+  REQUIRE(triple.update());
+  REQUIRE(3 == triple.front());
+
+  // values are whole and in order, even when written concurrently
+  TripleBuffer<std::vector<int>> vectors;
+  std::thread writer([&vectors] {
+    for (int i = 1; i <= 20000; ++i) {
+      std::vector<int>& back = vectors.back();
+      back.assign(64, i);
+      vectors.publish();
+    }
+  });
+  int last = 0;
+  bool whole = true;
+  bool ordered = true;
+  while (last < 20000) {
+    if (!vectors.update()) {
+      continue;
+    }
+    const std::vector<int>& front = vectors.front();
+    for (int value : front) {
+      whole = whole && value == front[0];
+    }
+    ordered = ordered && last < front[0];
+    last = front[0];
+  }
+  writer.join();
+  REQUIRE(whole);
+  REQUIRE(ordered);
+}
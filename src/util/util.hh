@@ -21,6 +21,8 @@
 #define DOGL(x) Util::prep_debug_gl(); x; \
   if (!Util::debug_gl(#x, __FILE__, __LINE__)) __builtin_trap()
 
+#define UTIL_RNGS 3 // number of random number engines (see Util::rng())
+
 
 class Util
 {
@@ -54,6 +56,21 @@ class Util
 
   // math /////////////////////////////////////////////////////////////////////
 
+  /// rng(): Get one of the random number engines behind distr() and
+  ///        normal_noise(), eg. for checkpointing their states.
+  /// \param which  0 for distr<int>(), 1 for distr<float>(), and 2 for
+  ///               normal_noise()
+  /// \returns  random number engine
+  static inline std::mt19937&
+  rng(unsigned int which)
+  {
+    static std::random_device rd;
+    static std::mt19937 rngs[UTIL_RNGS] = {
+      std::mt19937(rd()), std::mt19937(rd()), std::mt19937(rd())
+    };
+    return rngs[which];
+  }
+
   /// distr(): Pick a number from a uniformly distributed range.
   /// \param a  start of range
   /// \param b  end of range
@@ -65,20 +82,16 @@ class Util
   template<> inline int
   distr<int>(int a, int b)
   {
-    static std::random_device rd;
-    static std::mt19937 rng(rd());
     std::uniform_int_distribution<int> distribution(a, b);
-    return distribution(rng);
+    return distribution(Util::rng(0));
   }
 
   /// float version of distr().
   template<> inline float
   distr<float>(float a, float b)
   {
-    static std::random_device rd;
-    static std::mt19937 rng(rd());
     std::uniform_real_distribution<float> distribution(a, b);
-    return distribution(rng);
+    return distribution(Util::rng(1));
   }
 
   /// deg_to_rad(): Convert from degrees to radians.
@@ -124,10 +137,8 @@ class Util
   static inline float
   normal_noise(float stddev)
   {
-    static std::random_device rd;
-    static std::mt19937 rng(rd());
     std::normal_distribution<float> distribution(0.0f, stddev);
-    return distribution(rng);
+    return distribution(Util::rng(2));
   }
 
   // string ///////////////////////////////////////////////////////////////////
@@ -2,6 +2,8 @@
 #include "log.hh"
 #include "observation.hh"
 #include "util.hh"
+#include <sstream>
+#include <thread>
 
 
 // common
@@ -22,29 +24,76 @@ TEST_CASE("util/common")
 TEST_CASE("Log::Log")
 {
   Log log = Log(1, true);
-  REQUIRE(0 == log.messages_.size());
+  REQUIRE(0 == log.messages().size());
 }
 
 TEST_CASE("Log::add")
 {
   Log log = Log(2, true);
   log.add(Attn::E, "bar", false);
-  std::pair<Attn,std::string> message = log.messages_.front();
+  log.flush();
+  std::pair<Attn,std::string> message = log.messages().front();
   REQUIRE(Attn::E == message.first);
   REQUIRE("Error: bar" == message.second);
+  REQUIRE(message == log.latest());
   log.add(Attn::O, "foo", false);
-  message = log.messages_.front();
+  log.flush();
+  message = log.messages().front();
   REQUIRE(Attn::O == message.first);
   REQUIRE("foo" == message.second);
   log.add(Attn::O, "baz", false);
-  message = log.messages_.front();
+  log.flush();
+  message = log.messages().front();
   REQUIRE(Attn::O == message.first);
   REQUIRE("baz" == message.second);
-  message = log.messages_.back();
+  message = log.messages().back();
   REQUIRE(Attn::O == message.first);
   REQUIRE("foo" == message.second);
 }
 
+TEST_CASE("Log::add (threads)")
+{
+  // more messages than the ring holds, from several threads at once
+  unsigned int threads = 4;
+  unsigned int each = LOG_RING;
+  Log log = Log(threads * each, true);
+  struct Counter : Observer
+  {
+    std::atomic<unsigned int> count{0};
+    void react(Issue issue) override { count += Issue::NewMessage == issue; }
+  } counter;
+  log.attach(counter);
+  std::vector<std::thread> producers;
+  for (unsigned int t = 0; t < threads; ++t) {
+    producers.emplace_back([&log, t, each] {
+      for (unsigned int i = 0; i < each; ++i) {
+        log.add(Attn::O, std::to_string(t) + " " + std::to_string(i), false);
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  log.flush();
+  log.detach(counter);
+  REQUIRE(threads * each == counter.count);
+
+  // nothing is lost, and each thread's messages keep their order
+  std::vector<unsigned int> last(threads, each);
+  unsigned int t;
+  unsigned int i;
+  bool ordered = true;
+  for (const std::pair<Attn,std::string>& message : log.messages()) {
+    std::istringstream(message.second) >> t >> i;
+    ordered = ordered && i + 1 == last[t];
+    last[t] = i;
+  }
+  REQUIRE(ordered);
+  for (unsigned int first : last) {
+    REQUIRE(0 == first);
+  }
+}
+
 
 // observation
 
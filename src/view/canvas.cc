@@ -1,4 +1,5 @@
 #include "canvas.hh"
+#include "../util/profiler.hh"
 #include "../util/util.hh"
 
 
@@ -54,6 +55,17 @@ Canvas::Canvas(Log& log, Control& ctrl, UiState& uistate,
   this->pivotd_ = 1.0f;
   this->zoomd_ = 0.05f;
 
+  this->queries_[0] = 0;
+  this->queries_[1] = 0;
+  DOGL(glGenQueries(2, this->queries_));
+  this->queried_[0] = false;
+  this->queried_[1] = false;
+  this->query_ = 0;
+  this->runner_ = NULL;
+  this->generation_ = 0;
+  this->tick_ = 0;
+  this->num_ = 0;
+
   this->shader_ = new Shader(this->log_);
   this->shader_->bind();
   this->camera_set();
@@ -120,6 +132,7 @@ Canvas::~Canvas()
   delete this->vertex_buffer_quad_;
   delete this->vertex_array_;
   delete this->shader_;
+  DOGL(glDeleteQueries(2, this->queries_));
 }
 
 
@@ -131,30 +144,15 @@ Canvas::intro()
 void
 Canvas::exec()
 {
-  if (this->closing()) {
+  if (this->runner_ != NULL) {
+    this->present();
     return;
   }
-
-  /**
-  // profiling
-  GLuint64 start, stop;
-  unsigned int queryID[2];
-  glGenQueries(2, queryID);
-  glQueryCounter(queryID[0], GL_TIMESTAMP);
-  GLint stopAvailable = 0;
-  bool profiled = false;
-  //*/
-
-  /**
-  // timing
-  double now;
-  now = glfwGetTime();
-  if (now - this->ago_ < 1.0f / 60.0f) {
+  if (this->closing()) {
     return;
   }
-  this->ago_ = now;
-  //*/
 
+  PROFILE(Frame);
   Control& ctrl = this->ctrl_;
   State& state = ctrl.state_;
   Gui* gui = this->gui_;
@@ -171,7 +169,7 @@ Canvas::exec()
 
   this->clear();
   ctrl.color(static_cast<Coloring>(state.coloring_));
-  this->draw(4, num, this->vertex_array_, this->shader_);
+  this->render(num);
   if (this->gui_on_) {
     gui->draw();
   }
@@ -184,33 +182,119 @@ Canvas::exec()
     }
   }
   this->next();
+}
+
+
+bool
+Canvas::decouple(Runner& runner)
+{
+  runner.update();
+  this->runner_ = &runner;
+  this->generation_ = runner.frame().generation;
+  this->tick_ = runner.frame().tick;
+  this->log_.add(Attn::O, "Decoupled canvas from simulation.");
+  return true;
+}
+
+
+void
+Canvas::present()
+{
+  Runner& runner = *this->runner_;
+  Gui* gui = this->gui_;
+  if (this->closing()) {
+    runner.post([](Control& ctrl) { ctrl.quit(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(RUNNER_IDLE));
+    return;
+  }
+
+  PROFILE(Frame);
+  bool fresh = runner.update();
+  const Frame& frame = runner.frame();
+  bool capturing = false;
+  if (gui != NULL) {
+    capturing = gui->capturing_;
+  }
+  bool turn = runner.enter(std::chrono::microseconds(CANVAS_PATIENCE));
+
+  // a new generation has other particles, so rebuild (once State is ours,
+  // as Gui has to follow), or else move on if the frame is of a new tick
+  if (frame.generation != this->generation_) {
+    if (turn) {
+      bool one = frame.generation == this->generation_ + 1;
+      if (gui != NULL && (!one || frame.remap)) {
+        gui->remap(one ? *frame.remap : std::vector<int>()); // or drop it
+      }
+      this->generation_ = frame.generation;
+      this->tick_ = frame.tick;
+      this->respawn();
+    }
+  } else if (fresh && !capturing && frame.tick != this->tick_) {
+    this->tick_ = frame.tick;
+    if (this->three_) {
+      this->next3d();
+    } else {
+      this->next2d();
+    }
+  }
 
-  /**
-  // profiling
-  glQueryCounter(queryID[1], GL_TIMESTAMP);
-  while (!stopAvailable) {
-    glGetQueryObjectiv(queryID[1], GL_QUERY_RESULT_AVAILABLE,
-                       &stopAvailable);
+  unsigned int num = this->num_;
+  if (this->three_) {
+    num *= this->level_;
+  } else if (this->trail_) {
+    num *= this->trail_count_ + 1;
+  }
+  this->clear();
+  this->render(num);
+  if (this->gui_on_) {
+    if (turn) {
+      gui->draw();
+    } else {
+      gui->redraw();
+    }
   }
-  if (!profiled) {
-    profiled = true;
-    glGetQueryObjectui64v(queryID[0], GL_QUERY_RESULT, &start);
-    glGetQueryObjectui64v(queryID[1], GL_QUERY_RESULT, &stop);
-    std::cout << "time spent: " << (stop - start) / 1000000.0 << "\n";
+  glfwSwapBuffers(this->window_);
+  if (turn) {
+    glfwPollEvents(); // input handlers touch State
+    runner.leave();
   }
-  //*/
+}
+
+
+Canvas::Sight
+Canvas::sight() const
+{
+  if (this->runner_ != NULL) {
+    const Frame& frame = this->runner_->frame();
+    return {static_cast<unsigned int>(frame.x.size()), frame.prad,
+            frame.x.data(), frame.y.data(), frame.r.data(),
+            frame.g.data(), frame.b.data(), frame.a.data()};
+  }
+  State& state = this->ctrl_.state_;
+  return {static_cast<unsigned int>(state.num_), state.prad_,
+          state.px_.data(), state.py_.data(), state.xr_.data(),
+          state.xg_.data(), state.xb_.data(), state.xa_.data()};
 }
 
 
 void
 Canvas::react(Issue issue)
 {
+  if (this->runner_ != NULL) {
+    return; // on the simulation thread; present() follows Frames instead
+  }
   if (Issue::ProcNextDone == issue) {
     this->exec();
     return;
   } if (Issue::StateChanged == issue) {
     this->respawn();
     return;
+  } if (Issue::StateRemapped == issue) {
+    if (this->gui_ != NULL) {
+      this->gui_->remap(this->ctrl_.state_.remap_);
+    }
+    this->respawn(); // buffers are sized and ordered by particle
+    return;
   } if (Issue::ProcDone == issue) {
     // empty
   }
@@ -220,17 +304,18 @@ Canvas::react(Issue issue)
 void
 Canvas::spawn()
 {
-  State& state = this->ctrl_.state_;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
-  std::vector<float>& xr = state.xr_;
-  std::vector<float>& xg = state.xg_;
-  std::vector<float>& xb = state.xb_;
-  std::vector<float>& xa = state.xa_;
+  Sight sight = this->sight();
+  const float* px = sight.px;
+  const float* py = sight.py;
+  const float* xr = sight.xr;
+  const float* xg = sight.xg;
+  const float* xb = sight.xb;
+  const float* xa = sight.xa;
   std::vector<GLfloat>& xyz = this->xyz_;
   std::vector<GLfloat>& rgba = this->rgba_;
   GLfloat near = this->neardef_;
-  for (int i = 0; i < state.num_; ++i) {
+  this->num_ = sight.num;
+  for (unsigned int i = 0; i < sight.num; ++i) {
     xyz.push_back(px[i]);
     xyz.push_back(py[i]);
     xyz.push_back(near);
@@ -239,7 +324,7 @@ Canvas::spawn()
     rgba.push_back(xb[i]);
     rgba.push_back(xa[i]);
   }
-  GLfloat prad = state.prad_;
+  GLfloat prad = sight.prad;
   GLfloat quad[] = {0.0f, prad,
                    -prad, 0.0f,
                     prad, 0.0f,
@@ -304,21 +389,66 @@ Canvas::draw(GLuint instances, GLuint instance_count,
 
 
 void
-Canvas::next2d()
+Canvas::render(GLuint instance_count)
 {
-  State& state = this->ctrl_.state_;
-  unsigned int num = state.num_;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
-  std::vector<float>& xr = state.xr_;
-  std::vector<float>& xg = state.xg_;
-  std::vector<float>& xb = state.xb_;
-  std::vector<float>& xa = state.xa_;
+  PROFILE(Draw);
+  bool timed = Profiler::enabled();
+  unsigned int q = this->query_;
+  GLuint query = this->queries_[q];
+
+  // the query of the frame before last is done by now, without stalling
+  if (this->queried_[q]) {
+    GLint ready = 0;
+    DOGL(glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &ready));
+    if (ready) {
+      GLuint64 nanoseconds;
+      DOGL(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds));
+      Profiler::add(Phase::DrawDevice, nanoseconds);
+    }
+    this->queried_[q] = false;
+  }
+  if (timed) {
+    DOGL(glBeginQuery(GL_TIME_ELAPSED, query));
+  }
+  this->draw(4, instance_count, this->vertex_array_, this->shader_);
+  if (timed) {
+    DOGL(glEndQuery(GL_TIME_ELAPSED));
+    this->queried_[q] = true;
+    this->query_ = 1 - q;
+  }
+}
+
+
+void
+Canvas::upload()
+{
+  PROFILE(Upload);
   std::vector<GLfloat>& xyz = this->xyz_;
   std::vector<GLfloat>& rgba = this->rgba_;
   VertexBuffer* vb_xyz = this->vertex_buffer_xyz_;
   VertexBuffer* vb_rgba = this->vertex_buffer_rgba_;
   VertexArray* va = this->vertex_array_;
+  vb_xyz->update(&xyz[0], xyz.size() * sizeof(float));
+  vb_rgba->update(&rgba[0], rgba.size() * sizeof(float));
+  va->add_buffer(0, *vb_xyz, VertexBufferAttribs::gen<GLfloat>(3, 3, 0));
+  va->add_buffer(1, *vb_rgba, VertexBufferAttribs::gen<GLfloat>(4, 4, 0));
+}
+
+
+void
+Canvas::next2d()
+{
+  Profiler::Scope pack(Phase::Pack);
+  Sight sight = this->sight();
+  unsigned int num = sight.num;
+  const float* px = sight.px;
+  const float* py = sight.py;
+  const float* xr = sight.xr;
+  const float* xg = sight.xg;
+  const float* xb = sight.xb;
+  const float* xa = sight.xa;
+  std::vector<GLfloat>& xyz = this->xyz_;
+  std::vector<GLfloat>& rgba = this->rgba_;
   GLfloat near = this->neardef_;
   unsigned int xyzspan = 3 * num;
   unsigned int rgbaspan = 4 * num;
@@ -386,31 +516,25 @@ Canvas::next2d()
   }
 
 
-  GLfloat* p_xyz = &xyz[0];
-  GLfloat* p_rgba = &rgba[0];
-  vb_xyz->update(p_xyz, xyz.size() * sizeof(float));
-  vb_rgba->update(p_rgba, rgba.size() * sizeof(float));
-  va->add_buffer(0, *vb_xyz, VertexBufferAttribs::gen<GLfloat>(3, 3, 0));
-  va->add_buffer(1, *vb_rgba, VertexBufferAttribs::gen<GLfloat>(4, 4, 0));
+  pack.stop();
+  this->upload();
 }
 
 
 void
 Canvas::next3d()
 {
-  State &state = this->ctrl_.state_;
-  unsigned int num = state.num_;
-  std::vector<float>& px = state.px_;
-  std::vector<float>& py = state.py_;
-  std::vector<float>& xr = state.xr_;
-  std::vector<float>& xg = state.xg_;
-  std::vector<float>& xb = state.xb_;
-  std::vector<float>& xa = state.xa_;
+  Profiler::Scope pack(Phase::Pack);
+  Sight sight = this->sight();
+  unsigned int num = sight.num;
+  const float* px = sight.px;
+  const float* py = sight.py;
+  const float* xr = sight.xr;
+  const float* xg = sight.xg;
+  const float* xb = sight.xb;
+  const float* xa = sight.xa;
   std::vector<GLfloat>& xyz = this->xyz_;
   std::vector<GLfloat>& rgba = this->rgba_;
-  VertexBuffer* vb_xyz = this->vertex_buffer_xyz_;
-  VertexBuffer* vb_rgba = this->vertex_buffer_rgba_;
-  VertexArray* va = this->vertex_array_;
   GLfloat near = this->neardef_;
   bool end = (this->levels_ <= this->level_);
   bool shift = this->shift_counts_ <= this->shift_count_;
@@ -486,12 +610,8 @@ Canvas::next3d()
     rgba[rgbastride + rgbai++] = xa[p];
   }
 
-  GLfloat* p_xyz = &xyz[0];
-  GLfloat* p_rgba = &rgba[0];
-  vb_xyz->update(p_xyz, xyz.size() * sizeof(float));
-  vb_rgba->update(p_rgba, rgba.size() * sizeof(float));
-  va->add_buffer(0, *vb_xyz, VertexBufferAttribs::gen<GLfloat>(3, 3, 0));
-  va->add_buffer(1, *vb_rgba, VertexBufferAttribs::gen<GLfloat>(4, 4, 0));
+  pack.stop();
+  this->upload();
 }
 
 
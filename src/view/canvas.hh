@@ -13,11 +13,15 @@
 #include "gl.hh"
 #include "gui.hh"
 #include "view.hh"
+#include "../proc/runner.hh"
 #include "../util/common.hh"
 #include "../util/log.hh"
 #include <GLFW/glfw3.h>
 
 
+#define CANVAS_PATIENCE 2000 // microseconds to wait for a turn (decoupled)
+
+
 class Gui;
 
 class Canvas : public View, Observer
@@ -46,6 +50,12 @@ class Canvas : public View, Observer
   /// exec(): Render one iteration of all the graphics.
   void exec() override;
 
+  /// decouple(): Draw the Frames of a Runner from now on, at display rate,
+  ///             and only touch State (GUI, input) while taking a turn.
+  /// \param runner  Runner object
+  /// \returns  true
+  bool decouple(Runner& runner) override;
+
   /// react(): React to State::change(), Proc::next(), Proc::done().
   /// \param issue  which observed Subject's function to react to.
   void react(Issue issue) override;
@@ -64,6 +74,9 @@ class Canvas : public View, Observer
   void draw(GLuint instances, GLuint instance_count,
             VertexArray* vertex_array, Shader* shader) const;
 
+  /// present(): Render one iteration of all the graphics, when decoupled.
+  void present();
+
   /// next2d(): Update OpenGL vertex constructs for the 2D render.
   ///           Note: 2D rendering still happens in a 3D environment.
   void next2d();
@@ -157,7 +170,39 @@ class Canvas : public View, Observer
   GLfloat zoomd_;  // camera zoom delta
 
  private:
+  // Sight: Particles to depict, in State, or in the latest Frame of Runner
+  //        when decoupled.
+  struct Sight
+  {
+    unsigned int num;
+    GLfloat      prad;
+    const float* px;
+    const float* py;
+    const float* xr;
+    const float* xg;
+    const float* xb;
+    const float* xa;
+  };
+
+  /// sight(): Get the particles to depict.
+  Sight sight() const;
+
+  /// render(): Draw the particles, timing the draw call on the device too
+  ///           while profiling.
+  /// \param instance_count  number of particles to be rendered.
+  void render(GLuint instance_count);
+
+  /// upload(): Upload the packed vertex data to the vertex buffers.
+  void upload();
+
   Log&      log_;
+  Runner*   runner_;          // source of Frames (if decoupled)
+  unsigned int generation_;   // generation of Frame in the vertex buffers
+  unsigned long tick_;        // tick of Frame in the vertex buffers
+  unsigned int num_;          // number of particles in the vertex buffers
+  GLuint    queries_[2];      // OpenGL timer queries, used alternately
+  bool      queried_[2];      // whether a query awaits its result
+  unsigned int query_;        // query to be used next
   std::vector<GLfloat> xyz_;  // position vector
   std::vector<GLfloat> rgba_; // color vector
   GLfloat   width_;           // canvas width
@@ -89,12 +89,16 @@ Gui::~Gui()
 void
 Gui::draw()
 {
+  PROFILE(Gui);
   double now = glfwGetTime();
   ++this->frames_;
   if (now - this->ago_ >= 1.0) {
     this->fps_ = this->frames_;
     this->frames_ = 0;
     this->ago_ = now;
+    if (Profiler::enabled()) {
+      this->profile_ = Profiler::stats();
+    }
   }
 
   // take picture, expecting Canvas to not process particle movement, and
@@ -147,6 +151,35 @@ Gui::draw()
 }
 
 
+void
+Gui::redraw() const
+{
+  ImDrawData* data = ImGui::GetDrawData();
+  if (data != NULL) {
+    ImGui_ImplOpenGL3_RenderDrawData(data);
+  }
+}
+
+
+void
+Gui::remap(const std::vector<int>& remap)
+{
+  State& state = this->uistate_.ctrl_.state_;
+  int p = this->inspect_particle_;
+
+  this->uistate_.num_ = state.num_;
+  this->inspect_cluster_ = -1;
+  this->inspect_cluster_particle_ = -1;
+  if (0 <= p && p < remap.size() && 0 <= remap[p]) {
+    this->inspect_particle_ = remap[p];
+    this->gen_message_exp_inspect();
+  } else {
+    this->inspect_particle_ = -1;
+    this->message_exp_inspect_ = this->message_exp_inspect_default_;
+  }
+}
+
+
 void
 Gui::draw_brief(bool draw)
 {
@@ -231,6 +264,19 @@ Gui::draw_brief(bool draw)
     ImGui::TextColored(text_normal, "%d", ctrl.pid_);
     ImGui::PopFont();
 
+    // profile
+    if (Profiler::enabled()) {
+      for (const Profiler::Stat& stat : this->profile_) {
+        ImGui::TextColored(text_normal, "%s", Profiler::name(stat.phase));
+        ImGui::SameLine();
+        ImGui::PushFont(font_b);
+        ImGui::TextColored(text_bright, "%.2f", stat.p50 / 1000.0f);
+        ImGui::PopFont();
+        this->backspace(-1);
+        ImGui::TextColored(text_normal, "/%.2f ms", stat.p99 / 1000.0f);
+      }
+    }
+
     // more
     ImGui::PushFont(this->font_i_);
     ImGui::TextColored(text_normal, "Escape");
@@ -258,7 +304,7 @@ Gui::draw_messages(bool draw)
   auto text_error_cl = ImVec4(1.0f, 1.0f, 0.5f, 1.0f);
   auto text_error_gl = ImVec4(1.0f, 0.5f, 1.0f, 1.0f);
   ImVec4& text_color = text_error;
-  std::deque<std::pair<Attn,std::string>>& messages = this->log_.messages_;
+  std::deque<std::pair<Attn,std::string>> messages = this->log_.messages();
   unsigned int count = messages.size();
 
   ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
@@ -1162,7 +1208,10 @@ Gui::draw_load_save(Box box)
     }
     ImGui::PopItemWidth();
     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + 20);
-    if (0 < this->load_save_) {
+    if (1 < this->load_save_) {
+      what += " started in the background";
+      ImGui::TextColored(this->text_color_good_, "%s", what.c_str());
+    } else if (0 < this->load_save_) {
       what += " succeeded";
       ImGui::TextColored(this->text_color_good_, "%s", what.c_str());
     } else if (-1 == this->load_save_) {
@@ -1313,11 +1362,9 @@ Gui::box_confirm(Box box)
   }
 
   if (Box::Load == box || Box::Save == box) {
-    bool (UiState::*fn)(const std::string&) = &UiState::save;
     path = std::string(this->save_path_);
     if (Box::Load == box) {
       path = std::string(this->load_path_);
-      fn = &UiState::load;
     }
     if (path.empty()) {
       this->load_save_ = -2;
@@ -1325,8 +1372,13 @@ Gui::box_confirm(Box box)
                                  std::regex(this->input_allowed_)))
     {
       this->load_save_ = -3;
+    } else if (Box::Save == box) {
+      uistate.save_background(path); // outcome gets logged
+      this->load_save_ = 2;
+      uistate.ctrl_.pause(true);
+      uistate.deceive();
     } else {
-      if ((uistate.*fn)(path)) {
+      if (uistate.load(path)) {
         this->load_save_ = 1;
         uistate.ctrl_.pause(true);
         uistate.deceive();
@@ -1363,10 +1415,10 @@ Gui::gen_message_exp_inspect()
   State& state = ctrl.state_;
   Exp& exp = ctrl.exp_;
   bool no_cl = !ctrl.cl_good();
-  std::vector<int>& pls = state.pls_;
-  std::vector<int>& prs = state.prs_;
-  std::vector<float>& pld = state.pld_;
-  std::vector<float>& prd = state.prd_;
+  Column<int>& pls = state.pls_;
+  Column<int>& prs = state.prs_;
+  Column<float>& pld = state.pld_;
+  Column<float>& prd = state.prd_;
   unsigned int n_stride = state.n_stride_;
   std::ostringstream message;
 
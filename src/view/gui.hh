@@ -15,6 +15,7 @@
 #include "canvas.hh"
 #include "image.hh"
 #include "state.hh"
+#include "../util/profiler.hh"
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
@@ -55,6 +56,15 @@ class Gui
   /// draw(): Render the window and the UI.
   void draw();
 
+  /// redraw(): Render the UI as last drawn, without handling it (when State
+  ///           cannot be touched at the moment).
+  void redraw() const;
+
+  /// remap(): Follow the inspected particle to its new index after some
+  ///          particles were removed, and drop cluster inspection.
+  /// \param remap  new index per old index (-1 if removed)
+  void remap(const std::vector<int>& remap);
+
   int capturing_; // workaround to close render boxes during capture
 
  private:
@@ -155,6 +165,7 @@ class Gui
   double       ago_;         // last moment when counting of frames began (~1s)
   unsigned int frames_;      // accumulated number of draws
   float        fps_;         // calculated frames per second
+  std::vector<Profiler::Stat> profile_; // latest Profiler::stats() (~1s)
   double       x_;           // mouse cursor's x position
   double       y_;           // mouse cursor's y position
   bool         trail_;       // whether trailing is enabled
@@ -182,7 +193,8 @@ class Gui
   char         save_path_[256];      // path to save
   char         quit_save_path_[256]; // path to quit save
   int          capture_;        // picture taking status (0=none,1=good,0>bad)
-  int          load_save_;      // load/save status (0=none,1=good,0>bad)
+  int          load_save_;      // load/save status (0=none,1=good,2=queued,
+                                // 0>bad)
   int          quit_;           // quit status (0=none,1=good,0>bad)
   int          coloring_;       // particle coloring scheme
   float        cluster_radius_; // DBSCAN radius
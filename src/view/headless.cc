@@ -1,4 +1,5 @@
 #include "headless.hh"
+#include "../util/profiler.hh"
 #include "../util/util.hh"
 #include <signal.h>
 
@@ -11,8 +12,13 @@ Headless::Headless(Log& log, Control& ctrl, UiState& uistate)
   : log_(log), ctrl_(ctrl), uistate_(uistate)
 {
   hoc = this;
+  this->batch_ = log.quiet_;
   log.attach(*this);
   ctrl.attach_to_proc(*this);
+  if (!ctrl.expctrl_.experiment_) {
+    this->progress_.reset(new Progress(ctrl, std::cout,
+                                       this->batch_ ? 0 : PROGRESS_EVERY));
+  }
   struct sigaction sig;
   sig.sa_handler = this->sigint_callback;
   sigemptyset(&sig.sa_mask);
@@ -20,7 +26,7 @@ Headless::Headless(Log& log, Control& ctrl, UiState& uistate)
   sigaction(SIGINT, &sig, NULL);
   if (ctrl.paused_) {
     ctrl.paused_ = false;
-    this->prompt_base();
+    this->interact();
     return;
   }
   this->current_ = "";
@@ -29,6 +35,7 @@ Headless::Headless(Log& log, Control& ctrl, UiState& uistate)
 
 Headless::~Headless()
 {
+  this->progress_.reset();
   this->log_.detach(*this);
   this->ctrl_.detach_from_proc(*this);
 }
@@ -37,29 +44,17 @@ Headless::~Headless()
 void
 Headless::exec()
 {
-  //return; // when profiling
-  Control& ctrl = this->ctrl_;
-
-  if (ctrl.expctrl_.experiment_) {
-    return;
-  }
-
-  if (-1 == ctrl.countdown_) {
-    std::cout << "   Processing for eternity... (tick "
-              << ctrl.tick_ << ")   \r"
-              << std::flush;
-  } else {
-    // flushing makes ticking appear smooth but slows processing
-    std::cout << "   Tick " << ctrl.countdown_ << "          \r"
-              << std::flush;
-  }
+  // nothing to print per tick: Progress samples the ticks and reports on a
+  // wall-clock interval, so that the terminal does not hold up ticking
 }
 
 
 void
 Headless::intro()
 {
-  this->tell_usage();
+  if (!this->batch_) {
+    this->tell_usage();
+  }
 }
 
 
@@ -68,8 +63,9 @@ Headless::react(Issue issue)
 {
   if (Issue::ProcNextDone == issue) {
     this->exec();
-  } else if (Issue::NewMessage == issue && !this->ctrl_.expctrl_.experiment_) {
-    std::cout << this->log_.messages_.front().second << std::endl;
+  } else if (Issue::NewMessage == issue && !this->batch_ &&
+             !this->ctrl_.expctrl_.experiment_) {
+    std::cout << this->log_.latest().second << std::endl;
   } else if (Issue::ProcDone == issue) {
     this->report(When::Done);
     this->ctrl_.quit();
@@ -89,7 +85,11 @@ Headless::report(When when) const
 {
   Control& ctrl = this->ctrl_;
   State& state = ctrl.state_;
+  this->log_.flush(); // so that pending messages come before the report
   if (When::Done == when) {
+    if (this->progress_) {
+      this->progress_->stop();
+    }
     std::cout << "\nProcessing finished after " << ctrl.tick_ << " ticks.";
   } else if (When::Paused == when) {
     std::cout << "\nPaused after " << ctrl.tick_ << " ticks.";
@@ -103,8 +103,33 @@ Headless::report(When when) const
             << " (" << Util::rad_to_deg(state.beta_) << " deg)"
             << "\n  scope:  " << state.scope_
             << "\n  ascope: " << state.ascope_
-            << "\n  speed:  " << state.speed_
-            << std::flush;
+            << "\n  speed:  " << state.speed_;
+  if (this->progress_) {
+    std::cout << "\n  run:    " << this->progress_->summary();
+  }
+  if (Profiler::enabled()) {
+    std::string table = Profiler::describe();
+    std::size_t at = 0;
+    while (std::string::npos != (at = table.find('\n', at))) {
+      table.replace(at, 1, "\n  ");
+      at += 3;
+    }
+    std::cout << "\n\n  " << table;
+  }
+  std::cout << std::flush;
+}
+
+
+void
+Headless::interact()
+{
+  if (this->progress_) {
+    this->progress_->hold(true);
+  }
+  this->prompt_base();
+  if (this->progress_) {
+    this->progress_->hold(false);
+  }
 }
 
 
@@ -162,10 +187,7 @@ Headless::prompt_base()
         std::cerr << "Saving canceled." << std::flush;
         continue;
       }
-      if (!ctrl.save(file)) {
-        std::cerr << "Saving to \"" << file << "\" failed!" << std::flush;
-        continue;
-      }
+      ctrl.save_background(file); // outcome gets logged
       this->tell_usage();
       return;
     }
@@ -561,6 +583,6 @@ Headless::sigint_callback(int /* signal */)
     return;
   }
 
-  hoc->prompt_base();
+  hoc->interact();
 }
 
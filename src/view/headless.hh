@@ -4,14 +4,17 @@
 /// Definition of the When enum and declaration of the Headless class, which is
 /// responsible for non-graphical (commandline) access to the particle system.
 /// Headless is a subclass of the View class and observes the Proc and Control
-/// classes.
+/// classes. Progress is reported by a Progress object on a thread of its own,
+/// or not at all in batch mode (quiet Log), which prints only the summary.
 ///
 //===---------------------------------------------------------------------===//
 
 #pragma once
 
 #include "view.hh"
+#include "../proc/progress.hh"
 #include "../util/log.hh"
+#include <memory>
 
 
 // When: Type of report.
@@ -39,7 +42,7 @@ class Headless : public View, Observer
   /// intro(): Print message about pausing before starting process loop.
   void intro() override;
 
-  /// exec(): Take account of iterations by printing the tick count.
+  /// exec(): Take account of iterations (Progress reports them instead).
   void exec() override;
 
   /// react(): React to Log::add(), Proc::next(), Proc::done().
@@ -53,6 +56,9 @@ class Headless : public View, Observer
   /// \param when  whether processing is paused or done
   void report(When when) const;
 
+  /// interact(): Prompt the user, holding progress reports meanwhile.
+  void interact();
+
   /// prompt_*(): Produce menu-based prompts and handle input.
   void prompt_base();
   void prompt_config();
@@ -98,6 +104,8 @@ class Headless : public View, Observer
   Control& ctrl_;
   UiState& uistate_;
 
+  std::unique_ptr<Progress> progress_; // none while experimenting
+  bool                      batch_;    // whether to print only the summary
   std::string current_;
 };
 
@@ -193,6 +193,13 @@ UiState::save(const std::string& path)
 }
 
 
+void
+UiState::save_background(const std::string& path)
+{
+  this->ctrl_.save_background(path);
+}
+
+
 bool
 UiState::load(const std::string& path)
 {
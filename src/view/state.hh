@@ -50,6 +50,10 @@ public:
   /// \param path  string of path to the save file
   bool save(const std::string& path);
 
+  /// save_background(): Thin wrapper around Control.save_background().
+  /// \param path  string of path to the save file
+  void save_background(const std::string& path);
+
   /// load(): Thin wrapper around Control.load().
   ///         Also update UiState parameters immediately as a difference check
   ///         would be circuitous.
@@ -15,6 +15,8 @@
 #include <memory>
 
 
+class Runner;
+
 class View
 {
  public:
@@ -36,5 +38,11 @@ class View
 
   /// intro(): Preamble to the process loop.
   virtual void intro() = 0;
+
+  /// decouple(): Stop reacting to every tick, and instead be executed by the
+  ///             process loop, showing the Frames of a Runner.
+  /// \param runner  Runner object
+  /// \returns  whether the view supports this
+  virtual bool decouple(Runner& /* runner */) { return false; }
 };
 